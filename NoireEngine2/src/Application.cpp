@@ -116,6 +116,12 @@ void Application::Run()
 			RunRender();
 			if (StatsDirty)
 				ApplicationRenderTime = timer.GetElapsed(false);
+
+			if (StartupTime == 0) {
+				StartupTime = m_StartupTimer.GetElapsed(false);
+				NE_INFO("First frame after {:.1f}ms, pipeline cache was {}", StartupTime,
+					VulkanContext::Get()->getPipelineCache().IsWarm() ? "warm" : "cold");
+			}
 		}
 		StatsDirty = false;
 	}
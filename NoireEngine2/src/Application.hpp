@@ -10,6 +10,7 @@
 #include "core/events/ApplicationEvent.hpp"
 #include "core/layers/LayerStack.hpp"
 #include "core/resources/Module.hpp"
+#include "core/Timer.hpp"
 
 int main(int argc, char** argv);
 
@@ -32,7 +33,9 @@ struct ApplicationSpecification
 	uint32_t height = 1080;
 	ApplicationCommandLineArgs CommandLineArgs;
 	
-	enum class Culling { None, Frustum } Culling = Culling::None;
+	enum class Culling { None, Frustum, GPU, Occlusion } Culling = Culling::None;
+	bool ValidateGPUCulling = false; // compare the gpu's visible set against the cpu culler
+	bool ValidateLightClusters = false; // compare the gpu's light clusters against the cpu assignment
 	std::optional<std::string> PhysicalDeviceName = std::nullopt;
 	std::optional<std::string> CameraName = std::nullopt;
 	std::optional<std::string> InitialScene = std::nullopt;
@@ -65,8 +68,12 @@ public:
 	static const LayerStack& GetLayerStack() { return s_Instance->m_LayerStack; }
 	static bool IsMinimized() { return s_Instance->m_Minimized; }
 
+	// when the device cannot do the culling asked for on the command line
+	static void FallbackCulling(ApplicationSpecification::Culling culling) { s_Instance->m_Specification.Culling = culling; }
+
 
 	inline static float ApplicationUpdateTime, ApplicationRenderTime;
+	inline static float StartupTime = 0; // from construction until the first frame was submitted, in ms
 	inline static bool StatsDirty = true;
 
 private:
@@ -90,6 +97,7 @@ private:
 
 private:
 	ApplicationSpecification			m_Specification;
+	Timer								m_StartupTimer;
 	bool								m_Running = true;
 	bool								m_Minimized = false;
 	float								m_LastFrameTime = 0.0f;
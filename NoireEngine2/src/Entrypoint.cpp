@@ -28,15 +28,27 @@ static void Parse(ApplicationCommandLineArgs args, ApplicationSpecification& spe
         }
         else if (strcmp(args[argi], "--culling") == 0) 
         {
-            if (argi + 1 >= args.Count) throw std::runtime_error("--culling requires one parameter (none|frustum)");
+            if (argi + 1 >= args.Count) throw std::runtime_error("--culling requires one parameter (none|frustum|gpu|occlusion)");
             argi++;
             if (strcmp(args[argi], "none") == 0)
                 spec.Culling = ApplicationSpecification::Culling::None;
             else if (strcmp(args[argi], "frustum") == 0)
                 spec.Culling = ApplicationSpecification::Culling::Frustum;
+            else if (strcmp(args[argi], "gpu") == 0)
+                spec.Culling = ApplicationSpecification::Culling::GPU;
+            else if (strcmp(args[argi], "occlusion") == 0)
+                spec.Culling = ApplicationSpecification::Culling::Occlusion;
             else
                 throw std::runtime_error("Not a valid culling option: " + std::string(args[argi]));
         }
+        else if (strcmp(args[argi], "--validate-culling") == 0)
+        {
+            spec.ValidateGPUCulling = true;
+        }
+        else if (strcmp(args[argi], "--validate-clusters") == 0)
+        {
+            spec.ValidateLightClusters = true;
+        }
         else if (strcmp(args[argi], "--physical-device") == 0) 
         {
             if (argi + 1 >= args.Count) throw std::runtime_error("--physical-device requires one parameter: physical device name");
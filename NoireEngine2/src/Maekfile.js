@@ -32,7 +32,9 @@ const core_objs = [
 	maek.CPP('core/resources/nodes/NodeConstView.cpp'),
 	maek.CPP('core/resources/nodes/NodeView.cpp'),
 	maek.CPP('core/resources/Resources.cpp'),
-	maek.CPP('core/input/NativeInput.cpp')
+	maek.CPP('core/input/NativeInput.cpp'),
+	maek.CPP('core/jobs/JobSystem.cpp'),
+	maek.CPP('core/jobs/RadixSort.cpp')
 ];
 
 
@@ -58,14 +60,17 @@ const renderer_objs = [
 	maek.CPP('renderer/vertices/PosColVertex.cpp'),
 	maek.CPP('renderer/vertices/PosVertex.cpp'),
 	maek.CPP('renderer/Frustum.cpp'),
+	maek.CPP('renderer/culling/FrustumCuller.cpp'),
+	maek.CPP('renderer/culling/BVH.cpp'),
 	maek.CPP('renderer/Camera.cpp'),
 	maek.CPP('renderer/scene/Transform.cpp'),
 	maek.CPP('renderer/scene/Scene.cpp'),
 	maek.CPP('renderer/scene/Entity.cpp'),
-	maek.CPP('renderer/scene/TransformMatrixStack.cpp'),
+	maek.CPP('renderer/scene/TransformHierarchy.cpp'),
 	maek.CPP('renderer/scene/SceneNode.cpp'),
 	maek.CPP('renderer/object/Mesh.cpp'),
 	maek.CPP('renderer/object/ObjectInstance.cpp'),
+	maek.CPP('renderer/object/InstanceRegistry.cpp'),
 	maek.CPP('renderer/materials/Material.cpp'),
 	maek.CPP('renderer/materials/LambertianMaterial.cpp'),
 	maek.CPP('renderer/materials/PBRMaterial.cpp'),
@@ -76,6 +81,8 @@ const renderer_objs = [
 	maek.CPP('renderer/animation/Animator.cpp'),
 	maek.CPP('renderer/animation/Keyframe.cpp'),
 	maek.CPP('renderer/lighting/Light.cpp'),
+	maek.CPP('renderer/lighting/LightClusters.cpp'),
+	maek.CPP('renderer/lighting/ShadowAtlas.cpp'),
 	maek.CPP('renderer/Renderer.cpp', undefined, { depends: [...renderer_shaders] } ),
 ]
 
@@ -119,7 +126,10 @@ const vulkan_objs = [
 	maek.CPP('backend/images/Image2D.cpp'),
 	maek.CPP('backend/images/ImageCube.cpp'),
 	maek.CPP('backend/images/ImageDepth.cpp'),
+	maek.CPP('backend/images/DepthPyramid.cpp'),
 	maek.CPP('backend/buffers/Buffer.cpp'),
+	maek.CPP('backend/buffers/StagingRing.cpp'),
+	maek.CPP('backend/memory/MemoryAllocator.cpp'),
 	maek.CPP('backend/renderpass/Swapchain.cpp'),
 	maek.CPP('backend/renderpass/Renderpass.cpp'),
 	maek.CPP('backend/shader/VulkanShader.cpp'),
@@ -127,6 +137,7 @@ const vulkan_objs = [
 	maek.CPP('backend/descriptor/DescriptorLayoutCache.cpp'),
 	maek.CPP('backend/descriptor/DescriptorBuilder.cpp'),
 	maek.CPP('backend/pipeline/VulkanGraphicsPipelineBuilder.cpp'),
+	maek.CPP('backend/pipeline/PipelineCache.cpp'),
 	maek.CPP('backend/pipeline/BloomPipeline.cpp'),
 	maek.CPP('backend/pipeline/UIPipeline.cpp'),
 	maek.CPP('backend/pipeline/GizmosPipeline.cpp'),
@@ -164,10 +175,30 @@ use_vert_frag('shaders/skybox', 'backend/pipeline/SkyboxPipeline.cpp');
 // shadow
 const shadowmapping_shaders = [
 	maek.GLSLC('shaders/shadow/shadowmapping.vert'),
+	maek.GLSLC('shaders/shadow/shadowmapping_omni.vert'),
 	maek.GLSLC('shaders/shadow/shadowmapping.frag'),
 ];
 vulkan_objs.push(maek.CPP('backend/pipeline/ShadowPipeline.cpp', undefined, { depends: [...shadowmapping_shaders] }));
 
+// gpu culling
+const culling_shaders = [
+	maek.GLSLC('shaders/culling/cull.comp'),
+	maek.GLSLC('shaders/culling/compact.comp'),
+];
+vulkan_objs.push(maek.CPP('backend/pipeline/CullingPipeline.cpp', undefined, { depends: [...culling_shaders] }));
+
+// hi-z depth pyramid
+const hiz_shaders = [
+	maek.GLSLC('shaders/culling/hiz.comp'),
+];
+vulkan_objs.push(maek.CPP('backend/pipeline/HiZPipeline.cpp', undefined, { depends: [...hiz_shaders] }));
+
+// clustered light assignment
+const clustering_shaders = [
+	maek.GLSLC('shaders/culling/lightclusters.comp'),
+];
+vulkan_objs.push(maek.CPP('backend/pipeline/ClusteringPipeline.cpp', undefined, { depends: [...clustering_shaders] }));
+
 const imgui_objs = [
 	maek.CPP('../vendor/imgui/imgui.cpp'),
 	maek.CPP('../vendor/imgui/imgui_demo.cpp'),
@@ -196,46 +196,51 @@ void RaytracingContext::CreateBottomLevelAccelerationStructure()
 
 void RaytracingContext::CreateTopLevelAccelerationStructure(bool update)
 {
-	m_TlasBuildStructs.clear();
-	const auto& allInstances = SceneManager::Get()->getScene()->getObjectInstances();
+	// an update can only refit, it can't change the instance count
+	size_t previousCount = m_TlasBuildStructs.size();
 
-	uint32_t instanceIndex = 0;
+	m_TlasBuildStructs.clear();
+	const InstanceRegistry& registry = SceneManager::Get()->getScene()->getInstanceRegistry();
 
-	for (int workflowIndex = 0; workflowIndex < allInstances.size(); ++workflowIndex)
+	for (uint32_t slot = 0; slot < registry.capacity(); slot++)
 	{
-		const auto& workflowInstances = allInstances[workflowIndex];
-		for (uint32_t i = 0; i < workflowInstances.size(); i++)
+		if (!registry.IsAlive(slot))
+			continue;
+
+		const ObjectInstance& instance = registry[slot];
+
+		VkAccelerationStructureInstanceKHR rayInst{};
+		rayInst.transform = ToTransformMatrixKHR(instance.m_TransformUniform.modelMatrix); // Position of the instance
+		rayInst.instanceCustomIndex = slot; // gl_InstanceCustomIndexEXT, same slot the rasterizer uses
+		rayInst.accelerationStructureReference = m_RTBuilder.getBlasDeviceAddress(instance.mesh->getID());
+
+		uint32_t mask;
+		VkGeometryInstanceFlagsKHR flags;
+		switch (instance.material->getWorkflow())
 		{
-			VkAccelerationStructureInstanceKHR rayInst{};
-			rayInst.transform = ToTransformMatrixKHR(workflowInstances[i].m_TransformUniform.modelMatrix); // Position of the instance
-			rayInst.instanceCustomIndex = instanceIndex; // gl_InstanceCustomIndexEXT
-			rayInst.accelerationStructureReference = m_RTBuilder.getBlasDeviceAddress(workflowInstances[i].mesh->getID());
-
-			uint32_t mask;
-			VkGeometryInstanceFlagsKHR flags;
-			switch (workflowInstances[i].material->getWorkflow())
-			{
-			case Material::Workflow::Lambertian: case Material::Workflow::PBR:
-				mask = INSTANCE_OPAQUE;
-				flags = VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR;
-				break;
-			case Material::Workflow::Glass:
-				flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
-				mask = INSTANCE_TRANSLUCENT;
-				break;
-			default:
-				flags = 0;
-				mask = INSTANCE_IS_SOMETHING_ELSE;
-			}
-
-			rayInst.mask = mask;
-			rayInst.flags = flags;
-
-			rayInst.instanceShaderBindingTableRecordOffset = (uint32_t)workflowInstances[i].material->getWorkflow();
-
-			m_TlasBuildStructs.emplace_back(rayInst);
-			instanceIndex++;
+		case Material::Workflow::Lambertian: case Material::Workflow::PBR:
+			mask = INSTANCE_OPAQUE;
+			flags = VK_GEOMETRY_INSTANCE_FORCE_OPAQUE_BIT_KHR;
+			break;
+		case Material::Workflow::Glass:
+			flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
+			mask = INSTANCE_TRANSLUCENT;
+			break;
+		default:
+			flags = 0;
+			mask = INSTANCE_IS_SOMETHING_ELSE;
 		}
+
+		rayInst.mask = mask;
+		rayInst.flags = flags;
+
+		rayInst.instanceShaderBindingTableRecordOffset = (uint32_t)instance.material->getWorkflow();
+
+		m_TlasBuildStructs.emplace_back(rayInst);
 	}
+
+	if (m_TlasBuildStructs.size() != previousCount)
+		update = false;
+
 	m_RTBuilder.BuildTlas(m_TlasBuildStructs, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR, update);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "VulkanContext.hpp"
+#include "Application.hpp"
 
 #include <atomic>
 #include "utils/Enumerate.hpp"
@@ -8,7 +9,8 @@
 VulkanContext::VulkanContext() :
     s_VulkanInstance(std::make_unique<VulkanInstance>()),
     s_PhysicalDevice(std::make_unique<PhysicalDevice>(*s_VulkanInstance)),
-    s_LogicalDevice(std::make_unique<LogicalDevice>(*s_VulkanInstance, *s_PhysicalDevice))
+    s_LogicalDevice(std::make_unique<LogicalDevice>(*s_VulkanInstance, *s_PhysicalDevice)),
+    s_MemoryAllocator(std::make_unique<MemoryAllocator>(*s_LogicalDevice, *s_PhysicalDevice))
 {
     CreatePipelineCache();
 }
@@ -17,9 +19,13 @@ VulkanContext::~VulkanContext()
 {
     WaitIdle();
 
+    s_StagingRing.reset();
+
     m_Swapchains.clear();
 
-    vkDestroyPipelineCache(*s_LogicalDevice, m_PipelineCache, nullptr);
+    // every pipeline has been created by now, keep them for the next launch
+    m_PipelineCache->Save();
+    m_PipelineCache.reset();
     m_CommandPools.clear();
 
     DestroyPerSurfaceStructs();
@@ -29,15 +35,29 @@ VulkanContext::~VulkanContext()
 
 void VulkanContext::LateInitialize()
 {
+    s_StagingRing = std::make_unique<StagingRing>();
+
     // create a default image so texture descriptors dont segfault
     Image2D::Create(Files::Path("../textures/default.png"), VK_FORMAT_R8G8B8A8_SRGB, VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, false, false, true);
 
+    // gpu culled draws read their counts from a buffer, without it cull on the cpu instead
+    auto culling = Application::GetSpecification().Culling;
+    if ((culling == ApplicationSpecification::Culling::GPU || culling == ApplicationSpecification::Culling::Occlusion)
+        && !s_LogicalDevice->IsExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+    {
+        NE_WARN("{} culling needs {}, falling back to frustum culling",
+            culling == ApplicationSpecification::Culling::GPU ? "gpu" : "occlusion", VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        Application::FallbackCulling(ApplicationSpecification::Culling::Frustum);
+    }
+
     s_Renderer = std::make_unique<Renderer>();
     s_RaytracingContext = std::make_unique<RaytracingContext>();
 }
 
 void VulkanContext::Update()
 {
+    s_StagingRing->Update();
+
     s_Renderer->Update();
 
     for (auto [surfaceId, swapchain] : Enumerate(m_Swapchains))
@@ -62,6 +82,9 @@ void VulkanContext::Update()
 
         s_Renderer->Render(*commandBuffer);
 
+        // uploads queued so far go to the queue ahead of the frame that uses them
+        s_StagingRing->Flush();
+
         // submit the command buffer
         commandBuffer->Submit(perSurfaceBuffer->getPresentSemaphore(),
             perSurfaceBuffer->getRenderSemaphore(),
@@ -167,8 +190,7 @@ std::shared_ptr<CommandPool> VulkanContext::GetCommandPool(const TID& threadId)
 
 void VulkanContext::CreatePipelineCache()
 {
-    VkPipelineCacheCreateInfo pipelineCacheCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
-    VK(vkCreatePipelineCache(*s_LogicalDevice, &pipelineCacheCreateInfo, nullptr, &m_PipelineCache));
+    m_PipelineCache = std::make_unique<PipelineCache>(*s_LogicalDevice, s_PhysicalDevice->getProperties());
 }
 
 void VulkanContext::RecreateSwapchain()
@@ -31,7 +31,11 @@
 #include "RaytracingContext.hpp"
 
 #include "backend/descriptor/DescriptorLayoutCache.hpp"
+#include "backend/buffers/StagingRing.hpp"
+#include "backend/memory/MemoryAllocator.hpp"
+#include "backend/pipeline/PipelineCache.hpp"
 #include "core/resources/Resources.hpp"
+#include "core/jobs/JobSystem.hpp"
 
 /**
  * Manages Instance, Physical/Logical devices, Swapchains (to a certain extent) and surfaces.
@@ -41,7 +45,7 @@ class VulkanContext : public Module::Registrar<VulkanContext>
 	inline static const bool Registered = Register(
 		UpdateStage::Render, 
 		DestroyStage::Post, 
-		Requires<Window, Resources>()
+		Requires<Window, Resources, JobSystem>()
 	);
 
 public:
@@ -79,7 +83,7 @@ public:
 	inline const LogicalDevice*				getLogicalDevice() const { return s_LogicalDevice.get(); }
 	inline const VulkanInstance*			getInstance() const { return s_VulkanInstance.get(); }
 	inline const PhysicalDevice*			getPhysicalDevice() const { return s_PhysicalDevice.get(); }
-	inline const VkPipelineCache&			getPipelineCache() const { return m_PipelineCache; }
+	inline const PipelineCache&				getPipelineCache() const { return *m_PipelineCache; }
 
 	std::shared_ptr<CommandPool>			GetCommandPool(const TID& threadId = std::this_thread::get_id());
 
@@ -106,10 +110,15 @@ public:
 
 	inline DescriptorLayoutCache*			getDescriptorLayoutCache() { return &m_DescriptorLayoutCache; }
 
+	inline StagingRing*						getStagingRing() { return s_StagingRing.get(); }
+
+	inline MemoryAllocator*					getMemoryAllocator() { return s_MemoryAllocator.get(); }
+
 private:
 	std::unique_ptr<VulkanInstance>				s_VulkanInstance;
 	std::unique_ptr<PhysicalDevice>				s_PhysicalDevice;
 	std::unique_ptr<LogicalDevice>				s_LogicalDevice;
+	std::unique_ptr<MemoryAllocator>			s_MemoryAllocator; // outlives every buffer and image owned by the context
 
 	struct PerSurfaceBuffers 
 	{
@@ -133,7 +142,10 @@ private:
 		std::vector<std::unique_ptr<Buffer>>			drawIndirectBuffers;
 	};
 
-	VkPipelineCache												m_PipelineCache = VK_NULL_HANDLE;
+	std::unique_ptr<PipelineCache>								m_PipelineCache;
+
+	// declared before anything holding buffers or images, which report their destruction to it
+	DescriptorLayoutCache										m_DescriptorLayoutCache;
 
 	std::unordered_map<TID, std::shared_ptr<CommandPool>>		m_CommandPools;
 
@@ -144,7 +156,7 @@ private:
 	std::unique_ptr<Renderer>									s_Renderer;
 	std::unique_ptr<RaytracingContext>							s_RaytracingContext;
 
-	DescriptorLayoutCache										m_DescriptorLayoutCache;
+	std::unique_ptr<StagingRing>								s_StagingRing;
 
 private:
 	void CreatePipelineCache();
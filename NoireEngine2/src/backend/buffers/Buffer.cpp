@@ -6,34 +6,28 @@
 Buffer::Buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map) :
 	m_Size(size)
 {
-	if (usage | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
-	{
-		VkMemoryAllocateFlagsInfoKHR flags_info{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR };
-		flags_info.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-
-		CreateBuffer(usage, properties, map, &flags_info);
-	}
-	else
-		CreateBuffer(usage, properties, map);
+	CreateBuffer(usage, properties, map);
 }
 
 void Buffer::Destroy()
 {
-	if (buffer == VK_NULL_HANDLE || bufferMemory == VK_NULL_HANDLE)
+	if (buffer == VK_NULL_HANDLE || !allocation.IsValid())
 		return;
 
 	if (mapped != nullptr)
 		UnmapMemory();
 
+	// a new buffer may get the same handle, its descriptors have to be written again
+	VulkanContext::Get()->getDescriptorLayoutCache()->ForgetResource((uint64_t)buffer);
+
 	vkDestroyBuffer(VulkanContext::GetDevice(), buffer, nullptr);
-	vkFreeMemory(VulkanContext::GetDevice(), bufferMemory, nullptr);
+	VulkanContext::Get()->getMemoryAllocator()->Free(allocation);
 
 	buffer = VK_NULL_HANDLE;
-	bufferMemory = VK_NULL_HANDLE;
 	m_Size = 0;
 }
 
-void Buffer::CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map, void* memoryAllocationInfoPNext)
+void Buffer::CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map)
 {
 	// Create the buffer handle.
 	VkBufferCreateInfo bufferCreateInfo{
@@ -44,33 +38,38 @@ void Buffer::CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags proper
 	};
 	VulkanContext::VK(vkCreateBuffer(VulkanContext::GetDevice(), &bufferCreateInfo, nullptr, &buffer));
 
-	// Create the memory backing up the buffer handle.
-	VkMemoryRequirements memoryRequirements;
-	vkGetBufferMemoryRequirements(VulkanContext::GetDevice(), buffer, &memoryRequirements);
+	// acceleration structures, scratch and shader binding tables want their device addresses aligned further than the buffer itself
+	constexpr VkBufferUsageFlags addressedUsage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR
+		| VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR;
+	VkDeviceSize minAlignment = (usage & addressedUsage) ? 256 : 0;
 
-	VkMemoryAllocateInfo memoryAllocateInfo{
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.pNext = memoryAllocationInfoPNext,
-		.allocationSize = memoryRequirements.size,
-		.memoryTypeIndex = VulkanContext::FindMemoryType(memoryRequirements.memoryTypeBits, properties),
-	};
-	VulkanContext::VK(vkAllocateMemory(VulkanContext::GetDevice(), &memoryAllocateInfo, nullptr, &bufferMemory));
+	// Sub-allocate the memory backing up the buffer handle, and attach it.
+	allocation = VulkanContext::Get()->getMemoryAllocator()->Allocate(buffer, properties, minAlignment);
 
 	if (map == Mapped)
 		MapMemory(&mapped);
+}
+
+bool Buffer::Reserve(Buffer& buffer, VkDeviceSize bytes, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map)
+{
+	if (buffer.getBuffer() != VK_NULL_HANDLE && buffer.getSize() >= bytes)
+		return false;
 
-	// Attach the memory to the buffer object.
-	VulkanContext::VK(vkBindBufferMemory(VulkanContext::GetDevice(), buffer, bufferMemory, 0));
+	//round to next multiple of 4k to avoid re-allocating continuously if the contents grow slowly:
+	VkDeviceSize new_bytes = ((bytes + 4096) / 4096) * 4096;
+
+	buffer.Destroy();
+	buffer = Buffer(new_bytes, usage, properties, map);
+	return true;
 }
 
 void Buffer::MapMemory(void **data) const 
 {
-	VulkanContext::VK(vkMapMemory(VulkanContext::GetDevice(), bufferMemory, 0, m_Size, 0, data));
+	*data = allocation.mapped;
 }
 
 void Buffer::UnmapMemory() 
 {
-	vkUnmapMemory(VulkanContext::GetDevice(), bufferMemory);
 	mapped = nullptr;
 }
 
@@ -84,29 +83,18 @@ void Buffer::CopyBuffer(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkBuffer
 	vkCmdCopyBuffer(cmdBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 }
 
-void Buffer::CopyFromHost(VkCommandBuffer cmdBuffer, const Buffer& hostBuffer, Buffer& deviceBuffer, VkDeviceSize size, const void* data)
+void Buffer::CopyBufferRegions(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* regions)
 {
-	memcpy(hostBuffer.data(), data, size);
-	CopyBuffer(cmdBuffer, hostBuffer.getBuffer(), deviceBuffer.getBuffer(), size);
+	if (regionCount == 0)
+		return;
+
+	vkCmdCopyBuffer(cmdBuffer, srcBuffer, dstBuffer, regionCount, regions);
 }
 
-void Buffer::TransferToBufferIdle(void* data, size_t size, VkBuffer dstBuffer)
+void Buffer::CopyFromHost(VkCommandBuffer cmdBuffer, const Buffer& hostBuffer, Buffer& deviceBuffer, VkDeviceSize size, const void* data)
 {
-	Buffer transferSource = Buffer(
-		size,
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		Mapped
-	);
-
-	std::memcpy(transferSource.mapped, data, size);
-
-	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
-
-	CopyBuffer(commandBuffer, transferSource.getBuffer(), dstBuffer, size);
-
-	commandBuffer.SubmitIdle();
-	transferSource.Destroy();
+	memcpy(hostBuffer.data(), data, size);
+	CopyBuffer(cmdBuffer, hostBuffer.getBuffer(), deviceBuffer.getBuffer(), size);
 }
 
 VkDeviceAddress Buffer::GetBufferDeviceAddress() const
@@ -2,9 +2,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include "backend/memory/MemoryAllocator.hpp"
+
 class CommandBuffer;
 
-// Buffer with NO automatic memory management
+// Buffer with NO automatic memory management, its memory is sub-allocated through the MemoryAllocator
 // NOTE: You HAVE TO deallocate manually
 class Buffer {
 public:
@@ -20,8 +22,12 @@ public:
 
 	Buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map=Unmapped);
 
-	void CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped, void* memoryAllocationInfoPNext=nullptr);
+	void CreateBuffer(VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
+
+	// grows a buffer to hold at least bytes, rounded up to 4k, dropping its contents. Returns true if it was reallocated
+	static bool Reserve(Buffer& buffer, VkDeviceSize bytes, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, MapFlag map = Unmapped);
 
+	// host visible memory is mapped persistently by the allocator, this only hands out the pointer
 	void MapMemory(void **data) const;
 
 	void UnmapMemory();
@@ -29,12 +35,11 @@ public:
 	// executes a copy action command.
 	static void CopyBuffer(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
+	// executes a single copy command over several regions
+	static void CopyBufferRegions(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkBuffer dstBuffer, uint32_t regionCount, const VkBufferCopy* regions);
+
 	// executes a memcpy and a copy buffer command
 	static void CopyFromHost(VkCommandBuffer cmdBuffer, const Buffer& hostBuffer, Buffer& deviceBuffer, VkDeviceSize size, const void* data);
-	
-	// transfer to a device local buffer using memcpy. Allocates a new command buffer and idle submits.
-	// This is quite slow cuz it waits idle on the graphics queue. Should NOT be called in a loop
-	static void TransferToBufferIdle(void* data, size_t size, VkBuffer dstBuffer);
 
 	VkDeviceAddress GetBufferDeviceAddress() const;
 
@@ -45,13 +50,14 @@ public:
 public:
 	VkDeviceSize				getSize() const { return m_Size; }
 	VkBuffer					getBuffer() const { return buffer; }
-	const VkDeviceMemory&		getBufferMemory() const { return bufferMemory; }
+	const VkDeviceMemory&		getBufferMemory() const { return allocation.memory; }
+	VkDeviceSize				getMemoryOffset() const { return allocation.offset; }
 	void*						data() const { return mapped; }
 
 protected:
 	VkBuffer				buffer = VK_NULL_HANDLE;
 	VkDeviceSize			m_Size = 0;
-	VkDeviceMemory			bufferMemory = VK_NULL_HANDLE;
+	MemoryAllocation		allocation;
 	void*					mapped = nullptr;
 };
 
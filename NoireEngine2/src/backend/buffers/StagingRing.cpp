@@ -0,0 +1,261 @@
+#include "StagingRing.hpp"
+
+#include "backend/VulkanContext.hpp"
+
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+// every staged copy source starts at a multiple of this
+static constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+StagingRing::StagingRing(VkDeviceSize size) :
+	m_Buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Buffer::Mapped),
+	m_Size(size)
+{
+	VkSemaphoreTypeCreateInfo timelineCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0
+	};
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &timelineCreateInfo
+	};
+
+	VulkanContext::VK(vkCreateSemaphore(VulkanContext::GetDevice(), &semaphoreCreateInfo, nullptr, &m_Timeline),
+		"[vulkan] Error: cannot create staging timeline semaphore");
+}
+
+StagingRing::~StagingRing()
+{
+	WaitIdle();
+
+	vkDestroySemaphore(VulkanContext::GetDevice(), m_Timeline, nullptr);
+	m_Buffer.Destroy();
+}
+
+uint64_t StagingRing::Upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+	if (size == 0)
+		return m_NextValue;
+
+	auto [srcBuffer, srcOffset] = Stage(data, size, STAGING_ALIGNMENT);
+
+	Copy& copy = m_Pending.emplace_back();
+	copy.srcBuffer = srcBuffer;
+	copy.dstBuffer = dstBuffer;
+	copy.bufferRegion = { srcOffset, dstOffset, size };
+
+	return m_NextValue;
+}
+
+uint64_t StagingRing::Upload(const void* data, VkDeviceSize size, VkImage dstImage, VkBufferImageCopy region, VkDeviceSize texelSize)
+{
+	if (size == 0)
+		return m_NextValue;
+
+	// buffer offsets of image copies have to be a multiple of the texel size
+	auto [srcBuffer, srcOffset] = Stage(data, size, std::lcm(STAGING_ALIGNMENT, texelSize));
+
+	region.bufferOffset = srcOffset;
+
+	Copy& copy = m_Pending.emplace_back();
+	copy.srcBuffer = srcBuffer;
+	copy.dstImage = dstImage;
+	copy.imageRegion = region;
+
+	return m_NextValue;
+}
+
+uint64_t StagingRing::Record(std::function<void(const CommandBuffer&)>&& commands)
+{
+	m_Pending.emplace_back().commands = std::move(commands);
+	return m_NextValue;
+}
+
+std::pair<VkBuffer, VkDeviceSize> StagingRing::Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+	m_NumCopies++;
+	m_BytesUploaded += size;
+
+	// anything larger than half the ring would stall every other upload, give it its own buffer
+	if (size > m_Size / 2)
+	{
+		Buffer& dedicated = m_PendingDedicated.emplace_back(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Buffer::Mapped);
+		std::memcpy(dedicated.data(), data, size);
+		return { dedicated.getBuffer(), 0 };
+	}
+
+	VkDeviceSize offset = Allocate(size, alignment);
+	std::memcpy(static_cast<std::byte*>(m_Buffer.data()) + offset, data, size);
+	return { m_Buffer.getBuffer(), offset };
+}
+
+VkDeviceSize StagingRing::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	while (true)
+	{
+		// nothing is staged or in flight, start over at the front
+		if (m_Head == m_Tail && m_InFlight.empty())
+			m_Head = m_Tail = 0;
+
+		uint64_t position = m_Head;
+		VkDeviceSize offset = position % m_Size;
+		VkDeviceSize aligned = (offset + alignment - 1) / alignment * alignment;
+
+		// regions never wrap around the end of the ring, skip to the front instead
+		if (aligned + size > m_Size)
+			position += m_Size - offset;
+		else
+			position += aligned - offset;
+
+		if (position + size - m_Tail <= m_Size)
+		{
+			m_Head = position + size;
+			return position % m_Size;
+		}
+
+		// the ring is full: submit what is queued so its space can be reclaimed, and wait for the oldest batch
+		m_NumStalls++;
+		if (!m_Pending.empty())
+			Flush();
+
+		if (m_InFlight.empty())
+			continue;
+
+		Wait(m_InFlight.front().value);
+	}
+}
+
+void StagingRing::RecordCopies(const CommandBuffer& commandBuffer)
+{
+	std::vector<VkBufferCopy> bufferRegions;
+	std::vector<VkBufferImageCopy> imageRegions;
+
+	// consecutive copies between the same pair of resources go into a single copy command
+	for (size_t i = 0; i < m_Pending.size();)
+	{
+		const Copy& first = m_Pending[i];
+
+		if (first.commands)
+		{
+			first.commands(commandBuffer);
+			++i;
+		}
+		else if (first.dstBuffer != VK_NULL_HANDLE)
+		{
+			bufferRegions.clear();
+			for (; i < m_Pending.size() && !m_Pending[i].commands && m_Pending[i].srcBuffer == first.srcBuffer && m_Pending[i].dstBuffer == first.dstBuffer; ++i)
+				bufferRegions.push_back(m_Pending[i].bufferRegion);
+
+			vkCmdCopyBuffer(commandBuffer, first.srcBuffer, first.dstBuffer, (uint32_t)bufferRegions.size(), bufferRegions.data());
+		}
+		else
+		{
+			imageRegions.clear();
+			for (; i < m_Pending.size() && !m_Pending[i].commands && m_Pending[i].srcBuffer == first.srcBuffer && m_Pending[i].dstImage == first.dstImage; ++i)
+				imageRegions.push_back(m_Pending[i].imageRegion);
+
+			vkCmdCopyBufferToImage(commandBuffer, first.srcBuffer, first.dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				(uint32_t)imageRegions.size(), imageRegions.data());
+		}
+	}
+
+	// buffer copies are made visible to everything submitted after this batch on the queue
+	VkMemoryBarrier barrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+uint64_t StagingRing::Flush()
+{
+	if (m_Pending.empty())
+		return m_NextValue - 1;
+
+	Batch& batch = m_InFlight.emplace_back();
+	batch.value = m_NextValue++;
+	batch.head = m_Head;
+	batch.dedicated = std::move(m_PendingDedicated);
+	batch.commandBuffer = std::make_unique<CommandBuffer>(true, VK_QUEUE_GRAPHICS_BIT);
+
+	RecordCopies(*batch.commandBuffer);
+	batch.commandBuffer->End();
+
+	m_Pending.clear();
+	m_PendingDedicated.clear();
+
+	VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = 1,
+		.pSignalSemaphoreValues = &batch.value
+	};
+
+	VkSubmitInfo submitInfo{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = &timelineSubmitInfo,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch.commandBuffer->getCommandBuffer(),
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &m_Timeline
+	};
+
+	VulkanContext::VK(vkQueueSubmit(VulkanContext::Get()->getLogicalDevice()->getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE),
+		"[vulkan] Error: cannot submit staging batch");
+
+	m_NumBatches++;
+	return batch.value;
+}
+
+void StagingRing::Wait(uint64_t value)
+{
+	// anything queued is submitted first, values that were never submitted have nothing to wait for
+	if (value >= m_NextValue)
+		value = std::min(value, Flush());
+
+	if (value > m_CompletedValue)
+	{
+		VkSemaphoreWaitInfo waitInfo{
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &m_Timeline,
+			.pValues = &value
+		};
+		VulkanContext::VK(vkWaitSemaphores(VulkanContext::GetDevice(), &waitInfo, UINT64_MAX),
+			"[vulkan] Error: failed to wait on staging timeline semaphore");
+	}
+
+	Update();
+}
+
+void StagingRing::WaitIdle()
+{
+	Wait(Flush());
+}
+
+bool StagingRing::IsComplete(uint64_t value)
+{
+	if (value > m_CompletedValue)
+		Update();
+	return value <= m_CompletedValue;
+}
+
+void StagingRing::Update()
+{
+	VulkanContext::VK(vkGetSemaphoreCounterValue(VulkanContext::GetDevice(), m_Timeline, &m_CompletedValue));
+
+	while (!m_InFlight.empty() && m_InFlight.front().value <= m_CompletedValue)
+	{
+		Batch& batch = m_InFlight.front();
+		m_Tail = batch.head;
+		for (Buffer& dedicated : batch.dedicated)
+			dedicated.Destroy();
+		m_InFlight.pop_front();
+	}
+}
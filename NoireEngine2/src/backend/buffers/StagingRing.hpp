@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Buffer.hpp"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+
+class CommandBuffer;
+
+/**
+ * Persistent host visible staging memory that every upload is sub-allocated from, as a ring.
+ * Copies are deferred: they are staged right away but only recorded on Flush(), where every queued copy
+ * goes into one command buffer on the graphics queue that signals a timeline semaphore.
+ * The space of a batch is reclaimed once the semaphore reaches its value, nothing waits for the queue to idle.
+ * VulkanContext flushes before submitting each frame, so queued uploads are visible to that frame.
+ * Not thread safe, uploads are queued from the main thread.
+ */
+class StagingRing
+{
+public:
+	static constexpr VkDeviceSize RING_SIZE = 64 * 1024 * 1024;
+
+	explicit StagingRing(VkDeviceSize size = RING_SIZE);
+
+	~StagingRing();
+
+	// stages data and queues a copy into dstBuffer. Returns the timeline value the copy is complete at
+	uint64_t Upload(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0);
+
+	// stages data and queues a copy into dstImage, region.bufferOffset is filled in.
+	// The image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL by then, record the transition with Record().
+	// texelSize is the size of one texel of the image format, the staged data is aligned to it
+	uint64_t Upload(const void* data, VkDeviceSize size, VkImage dstImage, VkBufferImageCopy region, VkDeviceSize texelSize = 4);
+
+	// records commands into the batch, after every copy queued before it
+	uint64_t Record(std::function<void(const CommandBuffer&)>&& commands);
+
+	// submits every queued copy as one batch, returns the batch's timeline value
+	uint64_t Flush();
+
+	// flushes if the value is still queued, and blocks until the semaphore reaches it
+	void Wait(uint64_t value);
+
+	// flushes and waits for every batch
+	void WaitIdle();
+
+	bool IsComplete(uint64_t value);
+
+	// reclaims the space, command buffers and dedicated buffers of completed batches
+	void Update();
+
+	inline VkDeviceSize getSize() const { return m_Size; }
+	inline VkDeviceSize getUsed() const { return m_Head - m_Tail; }
+	inline uint32_t getNumInFlight() const { return (uint32_t)m_InFlight.size(); }
+	inline uint64_t getNumBatches() const { return m_NumBatches; }
+	inline uint64_t getNumCopies() const { return m_NumCopies; }
+	inline uint64_t getBytesUploaded() const { return m_BytesUploaded; }
+	inline uint32_t getNumStalls() const { return m_NumStalls; }
+
+private:
+	struct Copy
+	{
+		VkBuffer										srcBuffer = VK_NULL_HANDLE;
+		VkBuffer										dstBuffer = VK_NULL_HANDLE;
+		VkImage											dstImage = VK_NULL_HANDLE;
+		VkBufferCopy									bufferRegion{};
+		VkBufferImageCopy								imageRegion{};
+		std::function<void(const CommandBuffer&)>		commands; // set if this is not a copy
+	};
+
+	struct Batch
+	{
+		uint64_t						value;
+		uint64_t						head; // ring position the tail moves to once the batch completes
+		std::unique_ptr<CommandBuffer>	commandBuffer;
+		std::vector<Buffer>				dedicated;
+	};
+
+	// copies data into the ring (or a dedicated buffer if it is too large), returns where it was written
+	std::pair<VkBuffer, VkDeviceSize> Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+
+	// reserves space in the ring, flushing and waiting for older batches while it is full. Returns the offset
+	VkDeviceSize Allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	void RecordCopies(const CommandBuffer& commandBuffer);
+
+	Buffer						m_Buffer;
+	VkDeviceSize				m_Size;
+
+	// absolute positions that only grow, the offset into the ring is position % size
+	uint64_t					m_Head = 0;
+	uint64_t					m_Tail = 0;
+
+	VkSemaphore					m_Timeline = VK_NULL_HANDLE;
+	uint64_t					m_NextValue = 1; // signaled by the batch that is being queued
+	uint64_t					m_CompletedValue = 0;
+
+	std::vector<Copy>			m_Pending;
+	std::vector<Buffer>			m_PendingDedicated;
+	std::deque<Batch>			m_InFlight;
+
+	uint64_t					m_NumBatches = 0;
+	uint64_t					m_NumCopies = 0;
+	uint64_t					m_BytesUploaded = 0;
+	uint32_t					m_NumStalls = 0; // times the ring was full and had to wait on the gpu
+};
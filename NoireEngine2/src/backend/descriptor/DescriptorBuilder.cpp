@@ -93,6 +93,9 @@ bool DescriptorBuilder::Build(VkDescriptorSet& set, VkDescriptorSetLayout& layou
 	bool success = alloc->Allocate(&set, layout, pNextAlloc);
 	if (!success) { return false; };
 
+	// the handle may be reused from a set that was freed, nothing written to that one applies
+	cache->ForgetSet(set);
+
 	//write descriptor
 	Write(set);
 
@@ -115,12 +118,14 @@ void DescriptorBuilder::BuildLayout(VkDescriptorSetLayout& layout, const void* p
 
 void DescriptorBuilder::Write(VkDescriptorSet& set)
 {
+	// only write the bindings whose resources changed
+	std::erase_if(writes, [this, &set](VkWriteDescriptorSet& w) {
+		w.dstSet = set;
+		return !cache->ShouldWrite(w);
+	});
+
 	if (writes.empty())
 		return;
 
-	for (VkWriteDescriptorSet& w : writes) {
-		w.dstSet = set;
-	}
-
 	vkUpdateDescriptorSets(VulkanContext::GetDevice(), (uint32_t)writes.size(), writes.data(), 0, nullptr);
 }
@@ -1,17 +1,176 @@
 #include "DescriptorLayoutCache.hpp"
 
 #include "backend/VulkanContext.hpp"
+#include "math/Math.hpp"
+
+#include <numeric>
+#include <algorithm>
 
 void DescriptorLayoutCache::Cleanup() {
 	//delete every descriptor layout held
 	for (auto layout : allLayouts) {
 		vkDestroyDescriptorSetLayout(VulkanContext::GetDevice(), layout, nullptr);
 	}
+	allLayouts.clear();
+	layoutCache.clear();
+	writeCache.clear();
+	writesByResource.clear();
 }
 
 VkDescriptorSetLayout DescriptorLayoutCache::CreateDescriptorLayout(const VkDescriptorSetLayoutCreateInfo* info) {
+	layoutRequests++;
+
+	const VkDescriptorSetLayoutBindingFlagsCreateInfo* flagsInfo = nullptr;
+	bool cacheable = true;
+	for (auto* next = static_cast<const VkBaseInStructure*>(info->pNext); next != nullptr; next = next->pNext) {
+		if (next->sType == VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO)
+			flagsInfo = reinterpret_cast<const VkDescriptorSetLayoutBindingFlagsCreateInfo*>(next);
+		else
+			cacheable = false;
+	}
+
+	// immutable samplers are not part of the key
+	for (uint32_t i = 0; i < info->bindingCount; i++) {
+		if (info->pBindings[i].pImmutableSamplers != nullptr)
+			cacheable = false;
+	}
+
+	DescriptorLayoutInfo layoutInfo;
+	if (cacheable) {
+		// sort the bindings (and their flags along with them), so the order they were added in does not matter
+		std::vector<uint32_t> order(info->bindingCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [info](uint32_t a, uint32_t b) {
+			return info->pBindings[a].binding < info->pBindings[b].binding;
+		});
+
+		layoutInfo.flags = info->flags;
+		layoutInfo.bindings.reserve(info->bindingCount);
+		for (uint32_t i : order)
+			layoutInfo.bindings.push_back(info->pBindings[i]);
+
+		if (flagsInfo && flagsInfo->bindingCount > 0) {
+			layoutInfo.bindingFlags.reserve(info->bindingCount);
+			for (uint32_t i : order)
+				layoutInfo.bindingFlags.push_back(flagsInfo->pBindingFlags[i]);
+		}
+
+		auto it = layoutCache.find(layoutInfo);
+		if (it != layoutCache.end())
+			return it->second;
+	}
+
 	VkDescriptorSetLayout layout;
-	vkCreateDescriptorSetLayout(VulkanContext::GetDevice(), info, nullptr, &layout);
+	VulkanContext::VK(vkCreateDescriptorSetLayout(VulkanContext::GetDevice(), info, nullptr, &layout),
+		"[vulkan] Error: cannot create descriptor set layout");
 	allLayouts.push_back(layout);
+
+	if (cacheable)
+		layoutCache[std::move(layoutInfo)] = layout;
+
 	return layout;
-}
\ No newline at end of file
+}
+
+bool DescriptorLayoutCache::ShouldWrite(const VkWriteDescriptorSet& write)
+{
+	// acceleration structures and inline uniforms are chained, always write them
+	if (write.pNext != nullptr)
+		return true;
+
+	size_t contentHash = 0;
+	std::vector<uint64_t> resources;
+	resources.reserve(write.descriptorCount);
+
+	Math::HashCombine(contentHash, write.descriptorType);
+	Math::HashCombine(contentHash, write.descriptorCount);
+	for (uint32_t i = 0; i < write.descriptorCount; i++) {
+		if (write.pImageInfo) {
+			const VkDescriptorImageInfo& image = write.pImageInfo[i];
+			Math::HashCombine(contentHash, (uint64_t)image.sampler);
+			Math::HashCombine(contentHash, (uint64_t)image.imageView);
+			Math::HashCombine(contentHash, image.imageLayout);
+			resources.push_back((uint64_t)image.imageView);
+		}
+		else if (write.pBufferInfo) {
+			const VkDescriptorBufferInfo& buffer = write.pBufferInfo[i];
+			Math::HashCombine(contentHash, (uint64_t)buffer.buffer);
+			Math::HashCombine(contentHash, buffer.offset);
+			Math::HashCombine(contentHash, buffer.range);
+			resources.push_back((uint64_t)buffer.buffer);
+		}
+		else if (write.pTexelBufferView) {
+			// texel buffer views are not tracked for destruction, never skip them
+			return true;
+		}
+	}
+
+	WriteKey key{ write.dstSet, write.dstBinding, write.dstArrayElement };
+	auto [it, inserted] = writeCache.try_emplace(key, contentHash);
+	if (!inserted) {
+		if (it->second == contentHash) {
+			skippedWrites++;
+			return false;
+		}
+		it->second = contentHash;
+	}
+
+	for (uint64_t resource : resources)
+		writesByResource[resource].push_back(key);
+
+	return true;
+}
+
+void DescriptorLayoutCache::ForgetSet(VkDescriptorSet set)
+{
+	std::erase_if(writeCache, [set](const auto& entry) { return entry.first.set == set; });
+}
+
+void DescriptorLayoutCache::ForgetResource(uint64_t handle)
+{
+	auto it = writesByResource.find(handle);
+	if (it == writesByResource.end())
+		return;
+
+	for (const WriteKey& key : it->second)
+		writeCache.erase(key);
+	writesByResource.erase(it);
+}
+
+bool DescriptorLayoutCache::DescriptorLayoutInfo::operator==(const DescriptorLayoutInfo& other) const
+{
+	if (flags != other.flags || bindings.size() != other.bindings.size() || bindingFlags != other.bindingFlags)
+		return false;
+
+	for (size_t i = 0; i < bindings.size(); i++) {
+		const VkDescriptorSetLayoutBinding& a = bindings[i];
+		const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+		if (a.binding != b.binding || a.descriptorType != b.descriptorType ||
+			a.descriptorCount != b.descriptorCount || a.stageFlags != b.stageFlags)
+			return false;
+	}
+	return true;
+}
+
+size_t DescriptorLayoutCache::DescriptorLayoutInfo::hash() const
+{
+	size_t result = 0;
+	Math::HashCombine(result, flags);
+	for (const VkDescriptorSetLayoutBinding& b : bindings) {
+		Math::HashCombine(result, b.binding);
+		Math::HashCombine(result, b.descriptorType);
+		Math::HashCombine(result, b.descriptorCount);
+		Math::HashCombine(result, b.stageFlags);
+	}
+	for (VkDescriptorBindingFlags f : bindingFlags)
+		Math::HashCombine(result, f);
+	return result;
+}
+
+size_t DescriptorLayoutCache::WriteKeyHash::operator()(const WriteKey& k) const
+{
+	size_t result = 0;
+	Math::HashCombine(result, (uint64_t)k.set);
+	Math::HashCombine(result, k.binding);
+	Math::HashCombine(result, k.arrayElement);
+	return result;
+}
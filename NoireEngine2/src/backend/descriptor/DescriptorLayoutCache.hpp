@@ -4,12 +4,64 @@
 #include <vector>
 #include <unordered_map>
 
+// Referenced from https://vkguide.dev/docs/extra-chapter/abstracting_descriptors/
+// Hands out one VkDescriptorSetLayout per distinct set of bindings, and remembers what was written
+// into each descriptor set so rewriting the same resources is skipped.
 class DescriptorLayoutCache {
 public:
 	void Cleanup();
 
+	// returns the cached layout if an equal one was created before. Only binding flags are understood in the pNext chain,
+	// layouts with any other extension structure are created uncached
 	VkDescriptorSetLayout CreateDescriptorLayout(const VkDescriptorSetLayoutCreateInfo* info);
+
+	// true if the write changes what the set holds at its binding, and records it. Writes with a pNext chain are always made
+	bool ShouldWrite(const VkWriteDescriptorSet& write);
+
+	// a freshly allocated set may reuse the handle of a freed one
+	void ForgetSet(VkDescriptorSet set);
+
+	// drops every write that referenced the buffer or image view, so a new one with the same handle is written again
+	void ForgetResource(uint64_t handle);
+
+	inline uint32_t getNumLayouts() const { return (uint32_t)allLayouts.size(); }
+	inline uint32_t getNumLayoutRequests() const { return layoutRequests; }
+	inline uint32_t getNumSkippedWrites() const { return skippedWrites; }
+
+	struct DescriptorLayoutInfo {
+		VkDescriptorSetLayoutCreateFlags flags = 0;
+		std::vector<VkDescriptorSetLayoutBinding> bindings; // sorted by binding
+		std::vector<VkDescriptorBindingFlags> bindingFlags; // parallel to bindings, empty if none were given
+
+		bool operator==(const DescriptorLayoutInfo& other) const;
+
+		size_t hash() const;
+	};
+
 private:
+	struct DescriptorLayoutHash {
+		size_t operator()(const DescriptorLayoutInfo& k) const { return k.hash(); }
+	};
+
+	struct WriteKey {
+		VkDescriptorSet set;
+		uint32_t binding;
+		uint32_t arrayElement;
+
+		bool operator==(const WriteKey& other) const = default;
+	};
 
+	struct WriteKeyHash {
+		size_t operator()(const WriteKey& k) const;
+	};
+
+	std::unordered_map<DescriptorLayoutInfo, VkDescriptorSetLayout, DescriptorLayoutHash> layoutCache;
 	std::vector<VkDescriptorSetLayout> allLayouts;
-};
\ No newline at end of file
+
+	// hash of the resources last written per binding, and the writes each resource is part of
+	std::unordered_map<WriteKey, size_t, WriteKeyHash> writeCache;
+	std::unordered_map<uint64_t, std::vector<WriteKey>> writesByResource;
+
+	uint32_t layoutRequests = 0;
+	uint32_t skippedWrites = 0;
+};
@@ -1,4 +1,6 @@
 #include <optional>
+#include <algorithm>
+#include <cstring>
 
 #include "backend/VulkanContext.hpp"
 
@@ -21,6 +23,11 @@ const std::vector<const char*> LogicalDevice::DeviceExtensions = {
 #endif
 };
 
+const std::vector<const char*> LogicalDevice::OptionalDeviceExtensions = {
+	VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME, // gl_ViewportIndex from vertex shaders, point light shadows in one pass
+	VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME, // gpu culled draw counts, gpu and occlusion culling
+};
+
 LogicalDevice::LogicalDevice(const VulkanInstance& instance, const PhysicalDevice& physicalDevice) :
 	m_Instance(instance),
 	m_PhysicalDevice(physicalDevice) 
@@ -34,6 +41,11 @@ LogicalDevice::~LogicalDevice() {
 	vkDestroyDevice(m_LogicalDevice, nullptr);
 }
 
+bool LogicalDevice::IsExtensionEnabled(const char* extension) const
+{
+	return std::find(m_EnabledExtensions.begin(), m_EnabledExtensions.end(), extension) != m_EnabledExtensions.end();
+}
+
 void LogicalDevice::CreateQueueIndices() 
 {
 	uint32_t deviceQueueFamilyPropertyCount;
@@ -173,6 +185,11 @@ void LogicalDevice::CreateLogicalDevice()
 	else
 		NE_WARN("Selected GPU does not support shader storage write without format!");
 
+	if (physicalDeviceFeatures.shaderStorageImageArrayDynamicIndexing)
+		enabledFeatures.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+	else
+		NE_WARN("Selected GPU does not support dynamic indexing of storage image arrays!");
+
 	//enabledFeatures.shaderClipDistance = VK_TRUE;
 	//enabledFeatures.shaderCullDistance = VK_TRUE;
 
@@ -235,11 +252,19 @@ void LogicalDevice::CreateLogicalDevice()
 
 	physicalDeviceDescriptorIndexingFeatures.pNext = &sync2Ext;
 
+	// enable timeline semaphores, used to track staging uploads
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+		.timelineSemaphore = VK_TRUE
+	};
+
+	sync2Ext.pNext = &timelineSemaphoreFeatures;
+
 	// enable device addressing
 	VkPhysicalDeviceBufferDeviceAddressFeatures enabledBufferDeviceAddresFeatures{};
 	enabledBufferDeviceAddresFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
 	enabledBufferDeviceAddresFeatures.bufferDeviceAddress = VK_TRUE;
-	sync2Ext.pNext = &enabledBufferDeviceAddresFeatures;
+	timelineSemaphoreFeatures.pNext = &enabledBufferDeviceAddresFeatures;
 
 #ifdef _NE_USE_RTX
 	// add ray tracing features
@@ -274,9 +299,27 @@ void LogicalDevice::CreateLogicalDevice()
 		deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(VulkanInstance::ValidationLayers.size());
 		deviceCreateInfo.ppEnabledLayerNames = VulkanInstance::ValidationLayers.data();
 	}
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(DeviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = DeviceExtensions.data();
+	// required extensions were checked when the physical device was picked, optional ones are added if present
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(m_PhysicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	std::vector<const char*> extensions = DeviceExtensions;
+	for (const char* extension : OptionalDeviceExtensions)
+	{
+		auto isExtension = [extension](const VkExtensionProperties& properties) { return strcmp(properties.extensionName, extension) == 0; };
+		if (std::any_of(availableExtensions.begin(), availableExtensions.end(), isExtension))
+			extensions.push_back(extension);
+		else
+			NE_WARN("Selected GPU does not support {}!", extension);
+	}
+	m_EnabledExtensions.assign(extensions.begin(), extensions.end());
+
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 	deviceCreateInfo.pEnabledFeatures = &enabledFeatures;
+	m_EnabledFeatures = enabledFeatures;
 
 	VulkanContext::VK(vkCreateDevice(m_PhysicalDevice, &deviceCreateInfo, nullptr, &m_LogicalDevice), 
 		"[vulkan] Error: cannot create physical device");
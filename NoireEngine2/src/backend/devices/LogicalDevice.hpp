@@ -2,6 +2,9 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+#include <string>
+
 class VulkanInstance;
 class PhysicalDevice;
 
@@ -24,7 +27,11 @@ public:
 	uint32_t						getComputeFamily() const { return m_ComputeFamily; }
 	uint32_t						getTransferFamily() const { return m_TransferFamily; }
 
+	// whether one of the OptionalDeviceExtensions was found and enabled
+	bool IsExtensionEnabled(const char* extension) const;
+
 	static const std::vector<const char*> DeviceExtensions;
+	static const std::vector<const char*> OptionalDeviceExtensions; // enabled only when the device has them
 
 private:
 	void CreateQueueIndices();
@@ -35,6 +42,7 @@ private:
 
 	VkDevice							m_LogicalDevice = VK_NULL_HANDLE;
 	VkPhysicalDeviceFeatures			m_EnabledFeatures = {};
+	std::vector<std::string>			m_EnabledExtensions;
 
 	VkQueueFlags						m_SupportedQueues = {};
 	uint32_t							m_GraphicsFamily = 0;
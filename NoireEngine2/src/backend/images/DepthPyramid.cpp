@@ -0,0 +1,43 @@
+#include "DepthPyramid.hpp"
+#include "backend/VulkanContext.hpp"
+
+#include <algorithm>
+
+static uint32_t PadToTile(uint32_t size)
+{
+	return std::max(1u, (size + DepthPyramid::TILE_SIZE - 1) / DepthPyramid::TILE_SIZE) * DepthPyramid::TILE_SIZE;
+}
+
+DepthPyramid::DepthPyramid(const glm::uvec2 depthExtent) :
+	Image(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R32_SFLOAT,
+		1, 1, { PadToTile(depthExtent.x), PadToTile(depthExtent.y), 1 })
+{
+	mipLevels = std::min(getMipLevels(extent), MAX_LEVELS);
+
+	CreateImage(image, allocation, extent, format, samples, VK_IMAGE_TILING_OPTIMAL,
+		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mipLevels, 1, VK_IMAGE_TYPE_2D);
+	CreateImageSampler(sampler, filter, addressMode, false, mipLevels);
+	CreateImageView(image, view, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, 1, 0);
+
+	m_LevelViews.resize(mipLevels);
+	for (uint32_t level = 0; level < mipLevels; ++level)
+		CreateImageView(image, m_LevelViews[level], VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, 1, level, 1, 0);
+
+	TransitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, layout, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+DepthPyramid::~DepthPyramid()
+{
+	for (VkImageView levelView : m_LevelViews)
+	{
+		VulkanContext::Get()->getDescriptorLayoutCache()->ForgetResource((uint64_t)levelView);
+		vkDestroyImageView(VulkanContext::GetDevice(), levelView, nullptr);
+	}
+	m_LevelViews.clear();
+}
+
+VkDescriptorImageInfo DepthPyramid::GetLevelDescriptorInfo(uint32_t level) const
+{
+	return { VK_NULL_HANDLE, m_LevelViews[level], VK_IMAGE_LAYOUT_GENERAL };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Image.hpp"
+
+#include <vector>
+
+/**
+ * Hierarchical depth of the main depth buffer, for occlusion culling. Every texel holds the farthest depth
+ * of the texels below it. Mip 0 is the depth extent padded to a multiple of TILE_SIZE, so the first levels
+ * halve exactly; the padding is far depth, which never occludes anything.
+ * Stays in the general layout, written as storage images and read through the sampler.
+ */
+class DepthPyramid : public Image {
+public:
+	static constexpr uint32_t TILE_SIZE = 64; // texels of mip 0 one build group reduces
+	static constexpr uint32_t MAX_LEVELS = 16;
+
+	explicit DepthPyramid(const glm::uvec2 depthExtent);
+
+	~DepthPyramid();
+
+	// a view of a single level, for storage writes
+	VkImageView getLevelView(uint32_t level) const { return m_LevelViews[level]; }
+
+	VkDescriptorImageInfo GetLevelDescriptorInfo(uint32_t level) const;
+
+private:
+	std::vector<VkImageView> m_LevelViews;
+};
@@ -26,7 +26,15 @@ Image::~Image() {
 void Image::Destroy()
 {
 	auto logicalDevice = VulkanContext::GetDevice();
+
+	// copies queued into this image must not run after it is gone
+	if (image != VK_NULL_HANDLE && (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) {
+		if (StagingRing* ring = VulkanContext::Get()->getStagingRing())
+			ring->WaitIdle();
+	}
+
 	if (view != VK_NULL_HANDLE) {
+		VulkanContext::Get()->getDescriptorLayoutCache()->ForgetResource((uint64_t)view);
 		vkDestroyImageView(logicalDevice, view, nullptr);
 		view = VK_NULL_HANDLE;
 	}
@@ -36,15 +44,12 @@ void Image::Destroy()
 		sampler = VK_NULL_HANDLE;
 	}
 	
-	if (memory != VK_NULL_HANDLE) {
-		vkFreeMemory(logicalDevice, memory, nullptr);
-		memory = VK_NULL_HANDLE;
-	}
-
 	if (image != VK_NULL_HANDLE) {
 		vkDestroyImage(logicalDevice, image, nullptr);
 		image = VK_NULL_HANDLE;
 	}
+
+	VulkanContext::Get()->getMemoryAllocator()->Free(allocation);
 }
 
 VkDescriptorImageInfo Image::GetDescriptorInfo() const
@@ -61,11 +66,14 @@ VkDescriptorImageInfo Image::GetDescriptorInfo() const
 std::unique_ptr<Bitmap> Image::getBitmap(uint32_t mipLevel, uint32_t arrayLayer, uint32_t bytesPerPixel) const {
 	auto logicalDevice = VulkanContext::GetDevice();
 
+	// the image may still have uploads queued on the staging ring
+	VulkanContext::Get()->getStagingRing()->WaitIdle();
+
 	glm::vec2 size(int32_t(extent.width >> mipLevel), int32_t(extent.height >> mipLevel));
 
 	VkImage dstImage;
-	VkDeviceMemory dstImageMemory;
-	CopyImage(image, dstImage, dstImageMemory, format, { static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y),  1 }, layout, mipLevel, arrayLayer, 1);
+	MemoryAllocation dstImageAllocation;
+	CopyImage(image, dstImage, dstImageAllocation, format, { static_cast<uint32_t>(size.x), static_cast<uint32_t>(size.y),  1 }, layout, mipLevel, arrayLayer, 1);
 
 	VkImageSubresource dstImageSubresource = {};
 	dstImageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -77,13 +85,12 @@ std::unique_ptr<Bitmap> Image::getBitmap(uint32_t mipLevel, uint32_t arrayLayer,
 
 	auto bitmap = std::make_unique<Bitmap>(std::make_unique<uint8_t[]>(dstSubresourceLayout.size), size, bytesPerPixel);
 
-	void* data;
-	vkMapMemory(logicalDevice, dstImageMemory, dstSubresourceLayout.offset, dstSubresourceLayout.size, 0, &data);
+	// host visible allocations stay mapped
+	const std::byte* data = static_cast<const std::byte*>(dstImageAllocation.mapped) + dstSubresourceLayout.offset;
 	std::memcpy(bitmap->data.get(), data, static_cast<std::size_t>(dstSubresourceLayout.size));
-	vkUnmapMemory(logicalDevice, dstImageMemory);
 
-	vkFreeMemory(logicalDevice, dstImageMemory, nullptr);
 	vkDestroyImage(logicalDevice, dstImage, nullptr);
+	VulkanContext::Get()->getMemoryAllocator()->Free(dstImageAllocation);
 
 	return bitmap;
 }
@@ -105,7 +112,7 @@ bool Image::HasStencil(VkFormat format) {
 	return std::find(STENCIL_FORMATS.begin(), STENCIL_FORMATS.end(), format) != std::end(STENCIL_FORMATS);
 }
 
-void Image::CreateImage(VkImage& image, VkDeviceMemory& memory, const VkExtent3D& extent, VkFormat format, VkSampleCountFlagBits samples,
+void Image::CreateImage(VkImage& image, MemoryAllocation& allocation, const VkExtent3D& extent, VkFormat format, VkSampleCountFlagBits samples,
 	VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t mipLevels, uint32_t arrayLayers, VkImageType type) {
 
 	auto logicalDevice = VulkanContext::GetDevice();
@@ -125,16 +132,8 @@ void Image::CreateImage(VkImage& image, VkDeviceMemory& memory, const VkExtent3D
 	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 	VulkanContext::VK(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &image), "[vulkan] Error: failed to create image!");
 
-	VkMemoryRequirements memoryRequirements;
-	vkGetImageMemoryRequirements(logicalDevice, image, &memoryRequirements);
-
-	VkMemoryAllocateInfo memoryAllocateInfo = {};
-	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	memoryAllocateInfo.memoryTypeIndex = VulkanContext::FindMemoryType(memoryRequirements.memoryTypeBits, properties);
-	VulkanContext::VK(vkAllocateMemory(logicalDevice, &memoryAllocateInfo, nullptr, &memory), "[vulkan] Error: cannot allocate image memory.");
-
-	VulkanContext::VK(vkBindImageMemory(logicalDevice, image, memory, 0), "[vulkan] Error: cannot bind image memory.");
+	// sub-allocates and binds the memory
+	allocation = VulkanContext::Get()->getMemoryAllocator()->Allocate(image, properties, tiling);
 }
 
 void Image::CreateImageSampler(VkSampler& sampler, VkFilter filter, VkSamplerAddressMode addressMode, bool anisotropic, uint32_t mipLevels) {
@@ -179,7 +178,7 @@ void Image::CreateImageView(const VkImage& image, VkImageView& imageView, VkImag
 		"[vulkan] Cannot create image view");
 }
 
-void Image::CreateMipmaps(const VkImage& image, const VkExtent3D& extent, VkFormat format, VkImageLayout dstImageLayout, uint32_t mipLevels,
+void Image::CreateMipmaps(const CommandBuffer& commandBuffer, const VkImage& image, const VkExtent3D& extent, VkFormat format, VkImageLayout dstImageLayout, uint32_t mipLevels,
 	uint32_t baseArrayLayer, uint32_t layerCount) {
 
 	// Get device properites for the requested Image format.
@@ -190,8 +189,6 @@ void Image::CreateMipmaps(const VkImage& image, const VkExtent3D& extent, VkForm
 	assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
 	assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
 
-	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
-
 	for (uint32_t i = 1; i < mipLevels; i++) {
 		VkImageMemoryBarrier barrier0 = {};
 		barrier0.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -254,16 +251,18 @@ void Image::CreateMipmaps(const VkImage& image, const VkExtent3D& extent, VkForm
 	barrier.subresourceRange.baseArrayLayer = baseArrayLayer;
 	barrier.subresourceRange.layerCount = layerCount;
 	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
 
+void Image::CreateMipmaps(const VkImage& image, const VkExtent3D& extent, VkFormat format, VkImageLayout dstImageLayout, uint32_t mipLevels,
+	uint32_t baseArrayLayer, uint32_t layerCount) {
+	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
+	CreateMipmaps(commandBuffer, image, extent, format, dstImageLayout, mipLevels, baseArrayLayer, layerCount);
 	commandBuffer.SubmitIdle();
 }
 
-void Image::TransitionImageLayout(const VkImage& image, VkFormat format, VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
+void Image::TransitionImageLayout(const CommandBuffer& commandBuffer, const VkImage& image, VkFormat format, VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
 	VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer) 
 {
-	// Create a command buffer for the transition
-	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
-
 	// Set up access masks and pipeline stages based on source layout
 	VkAccessFlags srcAccessMask = 0;
 	VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
@@ -321,6 +320,7 @@ void Image::TransitionImageLayout(const VkImage& image, VkFormat format, VkImage
 		dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 		break;
 	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
 		dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 		dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 		break;
@@ -348,6 +348,15 @@ void Image::TransitionImageLayout(const VkImage& image, VkFormat format, VkImage
 		layerCount,
 		baseArrayLayer
 	);
+}
+
+void Image::TransitionImageLayout(const VkImage& image, VkFormat format, VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
+	VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer) 
+{
+	// Create a command buffer for the transition
+	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
+
+	TransitionImageLayout(commandBuffer, image, format, srcImageLayout, dstImageLayout, imageAspect, mipLevels, baseMipLevel, layerCount, baseArrayLayer);
 
 	// Submit the command buffer and wait for completion
 	commandBuffer.SubmitIdle();
@@ -358,6 +367,39 @@ void Image::TransitionLayout(VkImageLayout srcLayout, VkImageLayout dstLayout, V
 	TransitionImageLayout(image, format, srcLayout, dstLayout, aspect, mipLevels, 0, arrayLayers, 0);
 }
 
+void Image::QueueTransitionLayout(VkImageLayout srcLayout, VkImageLayout dstLayout, VkImageAspectFlags aspect)
+{
+	VulkanContext::Get()->getStagingRing()->Record(
+		[dstImage = image, imageFormat = format, srcLayout, dstLayout, aspect, levels = mipLevels, layers = arrayLayers](const CommandBuffer& commandBuffer) {
+			TransitionImageLayout(commandBuffer, dstImage, imageFormat, srcLayout, dstLayout, aspect, levels, 0, layers, 0);
+		});
+}
+
+void Image::QueueUpload(const void* pixels, VkDeviceSize size, uint32_t texelSize, bool generateMipmaps)
+{
+	StagingRing* ring = VulkanContext::Get()->getStagingRing();
+
+	QueueTransitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = arrayLayers;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = extent;
+	ring->Upload(pixels, size, image, region, texelSize);
+
+	if (generateMipmaps) {
+		ring->Record([dstImage = image, imageExtent = extent, imageFormat = format, dstLayout = layout, levels = mipLevels, layers = arrayLayers](const CommandBuffer& commandBuffer) {
+			CreateMipmaps(commandBuffer, dstImage, imageExtent, imageFormat, dstLayout, levels, 0, layers);
+		});
+	}
+	else {
+		QueueTransitionLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, VK_IMAGE_ASPECT_COLOR_BIT);
+	}
+}
+
 void Image::InsertImageMemoryBarrier(const CommandBuffer& commandBuffer, const VkImage& image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
 	VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
 	VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer) 
@@ -398,7 +440,7 @@ void Image::CopyBufferToImage(const VkBuffer& buffer, const VkImage& image, cons
 	commandBuffer.SubmitIdle();
 }
 
-bool Image::CopyImage(const VkImage& srcImage, VkImage& dstImage, VkDeviceMemory& dstImageMemory, VkFormat srcFormat, const VkExtent3D& extent,
+bool Image::CopyImage(const VkImage& srcImage, VkImage& dstImage, MemoryAllocation& dstImageAllocation, VkFormat srcFormat, const VkExtent3D& extent,
 	VkImageLayout srcImageLayout, uint32_t mipLevel, uint32_t arrayLayer, uint32_t numLayers) {
 	auto physicalDevice = VulkanContext::Get()->getPhysicalDevice();
 	auto surface = VulkanContext::Get()->getSurface(0);
@@ -429,7 +471,7 @@ bool Image::CopyImage(const VkImage& srcImage, VkImage& dstImage, VkDeviceMemory
 	}
 
 start:
-	CreateImage(dstImage, dstImageMemory, extent, VK_FORMAT_R8G8B8A8_SRGB, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_LINEAR,
+	CreateImage(dstImage, dstImageAllocation, extent, VK_FORMAT_R8G8B8A8_SRGB, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_LINEAR,
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1, numLayers, VK_IMAGE_TYPE_2D);
 
 	CommandBuffer commandBuffer(true, VK_QUEUE_TRANSFER_BIT);
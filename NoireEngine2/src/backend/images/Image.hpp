@@ -5,6 +5,7 @@
 #include <memory>
 #include <optional>
 #include "core/Bitmap.hpp"
+#include "backend/memory/MemoryAllocator.hpp"
 
 class CommandBuffer;
 	
@@ -40,7 +41,7 @@ public:
 	VkSamplerAddressMode	getAddressMode() const { return addressMode; }
 	VkImageLayout			getLayout() const { return layout; }
 	VkImage					getImage() const { return image; }
-	VkDeviceMemory			getMemory() const { return memory; }
+	VkDeviceMemory			getMemory() const { return allocation.memory; }
 	VkSampler				getSampler() const { return sampler; }
 	VkImageView				getView() const { return view; }
 	VkImageView&			getViewRef() { return view; }
@@ -51,7 +52,7 @@ public:
 
 	static bool HasStencil(VkFormat format);
 
-	static void CreateImage(VkImage& image, VkDeviceMemory& memory, const VkExtent3D& extent, VkFormat format, VkSampleCountFlagBits samples,
+	static void CreateImage(VkImage& image, MemoryAllocation& allocation, const VkExtent3D& extent, VkFormat format, VkSampleCountFlagBits samples,
 		VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t mipLevels, uint32_t arrayLayers, VkImageType type);
 
 	static void CreateImageSampler(VkSampler& sampler, VkFilter filter, VkSamplerAddressMode addressMode, bool anisotropic, uint32_t mipLevels);
@@ -62,21 +63,39 @@ public:
 	static void CreateMipmaps(const VkImage& image, const VkExtent3D& extent, VkFormat format, VkImageLayout dstImageLayout, uint32_t mipLevels,
 		uint32_t baseArrayLayer, uint32_t layerCount);
 
+	// records the mip chain into a command buffer instead of submitting it
+	static void CreateMipmaps(const CommandBuffer& commandBuffer, const VkImage& image, const VkExtent3D& extent, VkFormat format, VkImageLayout dstImageLayout, 
+		uint32_t mipLevels, uint32_t baseArrayLayer, uint32_t layerCount);
+
 	static void TransitionImageLayout(const VkImage& image, VkFormat format, VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
 		VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer);
 
+	// records the transition into a command buffer instead of submitting it
+	static void TransitionImageLayout(const CommandBuffer& commandBuffer, const VkImage& image, VkFormat format, VkImageLayout srcImageLayout, VkImageLayout dstImageLayout,
+		VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer);
+
 	void TransitionLayout(VkImageLayout srcLayout, VkImageLayout dstLayout, VkImageAspectFlags aspect);
 
+	// same as TransitionLayout, but queued on the staging ring so it stays ordered with uploads queued there
+	void QueueTransitionLayout(VkImageLayout srcLayout, VkImageLayout dstLayout, VkImageAspectFlags aspect);
+
 	static void InsertImageMemoryBarrier(const CommandBuffer& commandBuffer, const VkImage& image, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
 		VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
 		VkImageAspectFlags imageAspect, uint32_t mipLevels, uint32_t baseMipLevel, uint32_t layerCount, uint32_t baseArrayLayer);
 
 	static void CopyBufferToImage(const VkBuffer& buffer, const VkImage& image, const VkExtent3D& extent, uint32_t layerCount, uint32_t baseArrayLayer, uint32_t miplevel=0);
 
-	static bool CopyImage(const VkImage& srcImage, VkImage& dstImage, VkDeviceMemory& dstImageMemory, VkFormat srcFormat, const VkExtent3D& extent,
+	static bool CopyImage(const VkImage& srcImage, VkImage& dstImage, MemoryAllocation& dstImageAllocation, VkFormat srcFormat, const VkExtent3D& extent,
 		VkImageLayout srcImageLayout, uint32_t mipLevel, uint32_t arrayLayer, uint32_t numLayers);
 
 protected:
+	/**
+	  * Queues the pixels of every layer of mip 0 on the staging ring, along with the transition into transfer dst before
+	  * and either the mip chain or the transition into layout after. Nothing is submitted here.
+	  * @param texelSize Bytes per texel of the pixels.
+	*/
+	void QueueUpload(const void* pixels, VkDeviceSize size, uint32_t texelSize, bool generateMipmaps);
+
 	VkExtent3D extent;
 	VkSampleCountFlagBits samples;
 	VkImageUsageFlags usage;
@@ -90,7 +109,7 @@ protected:
 	VkImageLayout layout;
 
 	VkImage image = VK_NULL_HANDLE;
-	VkDeviceMemory memory = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
 	VkSampler sampler = VK_NULL_HANDLE;
 	VkImageView view = VK_NULL_HANDLE;
 };
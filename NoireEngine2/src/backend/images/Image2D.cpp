@@ -1,16 +1,18 @@
 #include "Image2D.hpp"
 
 #include "core/resources/Resources.hpp"
-#include "backend/buffers/Buffer.hpp"
+#include "backend/VulkanContext.hpp"
 #include "core/Timer.hpp"
 #include "utils/Logger.hpp"
+#include "core/jobs/JobSystem.hpp"
 
 std::shared_ptr<Image2D> Image2D::Create(const Node& node) {
 	if (auto resource = Resources::Get()->Find<Image2D>(node))
 		return resource;
 
 	auto result = std::make_shared<Image2D>();
-	Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+	if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+		return std::dynamic_pointer_cast<Image2D>(cached);
 	node >> *result;
 	result->Load();
 
@@ -53,22 +55,51 @@ Image2D::Image2D(uint32_t w, uint32_t h, VkFormat format, VkImageLayout layout,
 }
 
 void Image2D::SetPixels(const uint8_t* pixels, uint32_t layerCount, uint32_t baseArrayLayer) {
-	Buffer bufferStaging(extent.width * extent.height * components * arrayLayers, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = baseArrayLayer;
+	region.imageSubresource.layerCount = layerCount;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = extent;
+
+	VulkanContext::Get()->getStagingRing()->Upload(pixels, extent.width * extent.height * components * arrayLayers, image, region, components);
+}
 
-	void* data;
-	bufferStaging.MapMemory(&data);
-	std::memcpy(data, pixels, bufferStaging.getSize());
-	bufferStaging.UnmapMemory();
+void Image2D::Prefetch(const std::vector<std::filesystem::path>& filenames, JobCounter& counter) {
+	// every slot is created up front, jobs only write into their own one
+	std::vector<std::pair<const std::string*, std::unique_ptr<Bitmap>*>> slots;
+	for (const auto& filename : filenames) {
+		if (!Files::Exists(filename.string()))
+			continue;
 
-	CopyBufferToImage(bufferStaging.getBuffer(), image, extent, layerCount, baseArrayLayer);
+		auto [it, inserted] = s_Prefetched.try_emplace(filename.string());
+		if (inserted)
+			slots.emplace_back(&it->first, &it->second);
+	}
 
-	bufferStaging.Destroy();
+	// the slots vector is gone by the time the jobs run, so each job gets its pair by value
+	for (const auto& slot : slots) {
+		JobSystem::Get()->Execute(counter, [slot]() {
+			*slot.second = std::make_unique<Bitmap>(std::filesystem::path(*slot.first));
+		});
+	}
+}
+
+void Image2D::ClearPrefetched() {
+	s_Prefetched.clear();
 }
 
 void Image2D::Load(std::unique_ptr<Bitmap> loadBitmap, bool useSampler, bool useView) {
 	if (!filename.empty() && !loadBitmap) {
-		loadBitmap = std::make_unique<Bitmap>(filename);
+		auto it = s_Prefetched.find(filename.string());
+		if (it != s_Prefetched.end() && it->second) {
+			loadBitmap = std::move(it->second);
+			s_Prefetched.erase(it);
+		}
+		else {
+			loadBitmap = std::make_unique<Bitmap>(filename);
+		}
 		extent = { static_cast<uint32_t>(loadBitmap->size.x), static_cast<uint32_t>(loadBitmap->size.y), 1 };
 		components = loadBitmap->bytesPerPixel;
 	}
@@ -78,7 +109,7 @@ void Image2D::Load(std::unique_ptr<Bitmap> loadBitmap, bool useSampler, bool use
 
 	mipLevels = mipmap ? getMipLevels(extent) : 1;
 
-	CreateImage(image, memory, extent, format, samples, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	CreateImage(image, allocation, extent, format, samples, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		mipLevels, arrayLayers, VK_IMAGE_TYPE_2D);
 	
 	if (useSampler)
@@ -87,30 +118,14 @@ void Image2D::Load(std::unique_ptr<Bitmap> loadBitmap, bool useSampler, bool use
 	if (useView)
 		CreateImageView(image, view, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 
-	if (loadBitmap || mipmap) {
-		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
-	}
-
 	if (loadBitmap) {
-		Buffer bufferStaging(loadBitmap->GetLength(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		uint8_t* data;
-		bufferStaging.MapMemory(reinterpret_cast<void**>(&data));
-		std::memcpy(data, loadBitmap->data.get(), bufferStaging.getSize());
-		bufferStaging.UnmapMemory();
-
-		CopyBufferToImage(bufferStaging.getBuffer(), image, extent, arrayLayers, 0);
-
-		bufferStaging.Destroy();
+		// staged and recorded on the ring, the copy runs with its next batch
+		QueueUpload(loadBitmap->data.get(), loadBitmap->GetLength(), loadBitmap->bytesPerPixel, mipmap);
 	}
-
-	if (mipmap) {
+	else if (mipmap) {
+		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 		CreateMipmaps(image, extent, format, layout, mipLevels, 0, arrayLayers);
 	}
-	else if (loadBitmap) {
-		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
-	}
 	else {
 		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 	}
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <filesystem>
+#include <unordered_map>
 
 #include "Image.hpp"
 #include "core/resources/Resource.hpp"
 #include "core/resources/nodes/Node.hpp"
 
+struct JobCounter;
+
 class Image2D : public Image, public Resource 
 {
 public:
@@ -28,6 +31,13 @@ public:
 
 	void Load(std::unique_ptr<Bitmap> loadBitmap = nullptr, bool useSampler=true, bool useView=true);
 
+	// decodes the files on the job system ahead of time, Load() then only uploads them.
+	// Wait on the counter before loading any of these files
+	static void Prefetch(const std::vector<std::filesystem::path>& filenames, JobCounter& counter);
+
+	// drops decoded files that were never loaded
+	static void ClearPrefetched();
+
 	/**
 	  * Sets the pixels of this image.
 	  * @param pixels The pixels to copy from.
@@ -49,6 +59,9 @@ public:
 private:
 	static std::shared_ptr<Image2D> Create(const Node& node);
 
+	// decoded bitmaps by filename, filled by Prefetch and taken by Load
+	inline static std::unordered_map<std::string, std::unique_ptr<Bitmap>> s_Prefetched;
+
 	std::filesystem::path filename;
 
 	bool anisotropic;
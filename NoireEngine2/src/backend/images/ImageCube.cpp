@@ -3,7 +3,7 @@
 #include <cstring>
 
 #include "core/resources/Resources.hpp"
-#include "backend/buffers/Buffer.hpp"
+#include "backend/VulkanContext.hpp"
 #include "utils/Logger.hpp"
 #include "core/resources/Files.hpp"
 
@@ -12,7 +12,8 @@ std::shared_ptr<ImageCube> ImageCube::Create(const Node& node) {
 		return resource;
 
 	auto result = std::make_shared<ImageCube>("");
-	Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+	if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+		return std::dynamic_pointer_cast<ImageCube>(cached);
 	node >> *result;
 	result->Load();
 	return result;
@@ -63,17 +64,16 @@ ImageCube::ImageCube(const glm::vec2 extent, VkFormat format, VkImageLayout layo
 void ImageCube::SetPixels(const uint8_t* pixels, uint32_t layerCount, uint32_t baseArrayLayer, uint32_t miplevel) 
 {
 	VkExtent3D copyExtent = { extent.width >> miplevel, extent.height >> miplevel, extent.depth };
-	Buffer bufferStaging(copyExtent.width * copyExtent.height * components * arrayLayers, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
-	void* data;
-	bufferStaging.MapMemory(&data);
-	memcpy(data, pixels, bufferStaging.getSize());
-	bufferStaging.UnmapMemory();
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = miplevel;
+	region.imageSubresource.baseArrayLayer = baseArrayLayer;
+	region.imageSubresource.layerCount = layerCount;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = copyExtent;
 
-	CopyBufferToImage(bufferStaging.getBuffer(), image, copyExtent, layerCount, baseArrayLayer, miplevel);
-
-	bufferStaging.Destroy();
+	VulkanContext::Get()->getStagingRing()->Upload(pixels, copyExtent.width * copyExtent.height * components * arrayLayers, image, region, components);
 }
 
 void ImageCube::SaveAsPNG(const std::string& out, const glm::uvec2 size)
@@ -132,35 +132,19 @@ void ImageCube::Load(std::unique_ptr<Bitmap> loadBitmap) {
 
 	mipLevels = mipmap ? getMipLevels(extent) : 1;
 
-	CreateImage(image, memory, extent, format, samples, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	CreateImage(image, allocation, extent, format, samples, VK_IMAGE_TILING_OPTIMAL, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		mipLevels, arrayLayers, VK_IMAGE_TYPE_2D);
 	CreateImageSampler(sampler, filter, addressMode, anisotropic, mipLevels);
 	CreateImageView(image, view, VK_IMAGE_VIEW_TYPE_CUBE, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 
-	if (loadBitmap || mipmap) {
-		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
-	}
-
 	if (loadBitmap) {
-		Buffer bufferStaging(loadBitmap->GetLength(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-		uint8_t* data;
-		bufferStaging.MapMemory(reinterpret_cast<void**>(&data));
-		std::memcpy(data, loadBitmap->data.get(), bufferStaging.getSize());
-		bufferStaging.UnmapMemory();
-
-		CopyBufferToImage(bufferStaging.getBuffer(), image, extent, arrayLayers, 0);
-
-		bufferStaging.Destroy();
+		// every face is staged and recorded on the ring at once, the copy runs with its next batch
+		QueueUpload(loadBitmap->data.get(), loadBitmap->GetLength(), loadBitmap->bytesPerPixel, mipmap);
 	}
-
-	if (mipmap) {
+	else if (mipmap) {
+		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 		CreateMipmaps(image, extent, format, layout, mipLevels, 0, arrayLayers);
 	}
-	else if (loadBitmap) {
-		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
-	}
 	else {
 		TransitionImageLayout(image, format, VK_IMAGE_LAYOUT_UNDEFINED, layout, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, 0, arrayLayers, 0);
 	}
@@ -19,7 +19,7 @@ ImageDepth::ImageDepth(const glm::uvec2 extent, VkSampleCountFlagBits samples) :
 	if (HasStencil(format))
 		aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
 
-	CreateImage(image, memory, this->extent, format, samples, VK_IMAGE_TILING_OPTIMAL,
+	CreateImage(image, allocation, this->extent, format, samples, VK_IMAGE_TILING_OPTIMAL,
 		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, 1, VK_IMAGE_TYPE_2D);
 	CreateImageSampler(sampler, filter, addressMode, false, 1);
 	CreateImageView(image, view, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, 1, 0);
@@ -33,7 +33,7 @@ ImageDepth::ImageDepth(const glm::uvec2 extent, VkFormat format) :
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 		format, 1, 1, { static_cast<uint32_t>(extent.x), static_cast<uint32_t>(extent.y), 1 })
 {
-	CreateImage(image, memory, this->extent, format, samples, VK_IMAGE_TILING_OPTIMAL,
+	CreateImage(image, allocation, this->extent, format, samples, VK_IMAGE_TILING_OPTIMAL,
 		usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 1, 1, VK_IMAGE_TYPE_2D);
 	CreateImageSampler(sampler, filter, addressMode, false, 1);
 	CreateImageView(image, view, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_ASPECT_DEPTH_BIT, 1, 0, 1, 0);
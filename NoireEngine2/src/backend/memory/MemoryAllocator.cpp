@@ -0,0 +1,532 @@
+#include "MemoryAllocator.hpp"
+
+#include "backend/VulkanContext.hpp"
+#include "imgui/imgui.h"
+
+#include <bit>
+#include <algorithm>
+
+namespace {
+	// every first level list is split into 2^SL_LOG2 second level lists
+	constexpr uint32_t SL_LOG2 = 5;
+	constexpr uint32_t SL_COUNT = 1u << SL_LOG2;
+
+	// sizes below 2^SMALL_LOG2 share the first level list 0, in steps of 2^(SMALL_LOG2 - SL_LOG2) bytes
+	constexpr uint32_t SMALL_LOG2 = 8;
+	constexpr VkDeviceSize SMALL_STEP = 1ull << (SMALL_LOG2 - SL_LOG2);
+	constexpr uint32_t FL_COUNT = 64 - SMALL_LOG2 + 1;
+
+	// remainders smaller than this stay attached to the allocation instead of becoming a free range
+	constexpr VkDeviceSize MIN_SPLIT = 256;
+
+	constexpr uint32_t NONE = UINT32_MAX;
+
+	void Mapping(VkDeviceSize size, uint32_t& fl, uint32_t& sl)
+	{
+		if (size < (1ull << SMALL_LOG2)) {
+			fl = 0;
+			sl = (uint32_t)(size / SMALL_STEP);
+		}
+		else {
+			uint32_t msb = 63 - (uint32_t)std::countl_zero(size);
+			fl = msb - SMALL_LOG2 + 1;
+			sl = (uint32_t)(size >> (msb - SL_LOG2)) & (SL_COUNT - 1);
+		}
+	}
+
+	// rounds up to the start of the next list, so every range in the list found is large enough
+	VkDeviceSize RoundUpToList(VkDeviceSize size)
+	{
+		if (size < (1ull << SMALL_LOG2))
+			return (size + SMALL_STEP - 1) & ~(SMALL_STEP - 1);
+
+		uint32_t msb = 63 - (uint32_t)std::countl_zero(size);
+		VkDeviceSize round = (1ull << (msb - SL_LOG2)) - 1;
+		return size + round;
+	}
+
+	inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+/**
+ * One VkDeviceMemory, split into physically linked ranges. Free ranges are also linked into
+ * segregated lists by size, with bitmaps of the non empty lists to find a fitting one in constant time.
+ */
+class MemoryBlock
+{
+public:
+	MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void* mapped, uint32_t pool) :
+		memory(memory), size(size), mapped(mapped), pool(pool)
+	{
+		for (auto& heads : m_Heads)
+			std::fill(std::begin(heads), std::end(heads), NONE);
+
+		uint32_t root = NewNode();
+		m_Nodes[root].offset = 0;
+		m_Nodes[root].size = size;
+		InsertFree(root);
+	}
+
+	// returns false if no free range fits
+	bool Allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& outOffset, uint32_t& outNode)
+	{
+		uint32_t node = FindFree(allocationSize + alignment - 1);
+		if (node == NONE)
+			return false;
+
+		RemoveFree(node);
+
+		// the front padding up to the alignment becomes its own free range
+		VkDeviceSize aligned = AlignUp(m_Nodes[node].offset, alignment);
+		VkDeviceSize padding = aligned - m_Nodes[node].offset;
+		if (padding > 0) {
+			uint32_t front = NewNode();
+			Node& n = m_Nodes[node];
+			m_Nodes[front].offset = n.offset;
+			m_Nodes[front].size = padding;
+			LinkBefore(front, node);
+			n.offset = aligned;
+			n.size -= padding;
+			InsertFree(front);
+		}
+
+		if (m_Nodes[node].size - allocationSize >= MIN_SPLIT) {
+			uint32_t back = NewNode();
+			Node& n = m_Nodes[node];
+			m_Nodes[back].offset = n.offset + allocationSize;
+			m_Nodes[back].size = n.size - allocationSize;
+			LinkAfter(back, node);
+			n.size = allocationSize;
+			InsertFree(back);
+		}
+
+		m_Nodes[node].free = false;
+		m_Used += m_Nodes[node].size;
+		m_NumAllocations++;
+
+		outOffset = m_Nodes[node].offset;
+		outNode = node;
+		return true;
+	}
+
+	void Free(uint32_t node)
+	{
+		m_Used -= m_Nodes[node].size;
+		m_NumAllocations--;
+		m_Nodes[node].free = true;
+
+		// neighbours that are free are merged right away, so two free ranges are never adjacent
+		uint32_t next = m_Nodes[node].nextPhys;
+		if (next != NONE && m_Nodes[next].free) {
+			RemoveFree(next);
+			m_Nodes[node].size += m_Nodes[next].size;
+			Unlink(next);
+		}
+
+		uint32_t prev = m_Nodes[node].prevPhys;
+		if (prev != NONE && m_Nodes[prev].free) {
+			RemoveFree(prev);
+			m_Nodes[prev].size += m_Nodes[node].size;
+			Unlink(node);
+			node = prev;
+		}
+
+		InsertFree(node);
+	}
+
+	inline bool IsEmpty() const { return m_NumAllocations == 0; }
+	inline VkDeviceSize getUsed() const { return m_Used; }
+	inline uint32_t getNumAllocations() const { return m_NumAllocations; }
+
+	const VkDeviceMemory	memory;
+	const VkDeviceSize		size;
+	void* const				mapped;
+	const uint32_t			pool;
+
+private:
+	struct Node
+	{
+		VkDeviceSize	offset = 0;
+		VkDeviceSize	size = 0;
+		uint32_t		prevPhys = NONE, nextPhys = NONE;
+		uint32_t		prevFree = NONE, nextFree = NONE;
+		bool			free = false;
+	};
+
+	uint32_t NewNode()
+	{
+		if (!m_FreeSlots.empty()) {
+			uint32_t slot = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+			m_Nodes[slot] = Node{};
+			return slot;
+		}
+		m_Nodes.emplace_back();
+		return (uint32_t)m_Nodes.size() - 1;
+	}
+
+	void LinkBefore(uint32_t node, uint32_t before)
+	{
+		m_Nodes[node].prevPhys = m_Nodes[before].prevPhys;
+		m_Nodes[node].nextPhys = before;
+		if (m_Nodes[before].prevPhys != NONE)
+			m_Nodes[m_Nodes[before].prevPhys].nextPhys = node;
+		m_Nodes[before].prevPhys = node;
+	}
+
+	void LinkAfter(uint32_t node, uint32_t after)
+	{
+		m_Nodes[node].nextPhys = m_Nodes[after].nextPhys;
+		m_Nodes[node].prevPhys = after;
+		if (m_Nodes[after].nextPhys != NONE)
+			m_Nodes[m_Nodes[after].nextPhys].prevPhys = node;
+		m_Nodes[after].nextPhys = node;
+	}
+
+	// removes a node from the physical list and recycles its slot
+	void Unlink(uint32_t node)
+	{
+		Node& n = m_Nodes[node];
+		if (n.prevPhys != NONE)
+			m_Nodes[n.prevPhys].nextPhys = n.nextPhys;
+		if (n.nextPhys != NONE)
+			m_Nodes[n.nextPhys].prevPhys = n.prevPhys;
+		m_FreeSlots.push_back(node);
+	}
+
+	void InsertFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		Mapping(m_Nodes[node].size, fl, sl);
+
+		Node& n = m_Nodes[node];
+		n.free = true;
+		n.prevFree = NONE;
+		n.nextFree = m_Heads[fl][sl];
+		if (n.nextFree != NONE)
+			m_Nodes[n.nextFree].prevFree = node;
+		m_Heads[fl][sl] = node;
+
+		m_FlBitmap |= 1ull << fl;
+		m_SlBitmap[fl] |= 1u << sl;
+	}
+
+	void RemoveFree(uint32_t node)
+	{
+		uint32_t fl, sl;
+		Mapping(m_Nodes[node].size, fl, sl);
+
+		Node& n = m_Nodes[node];
+		if (n.prevFree != NONE)
+			m_Nodes[n.prevFree].nextFree = n.nextFree;
+		else
+			m_Heads[fl][sl] = n.nextFree;
+		if (n.nextFree != NONE)
+			m_Nodes[n.nextFree].prevFree = n.prevFree;
+
+		if (m_Heads[fl][sl] == NONE) {
+			m_SlBitmap[fl] &= ~(1u << sl);
+			if (m_SlBitmap[fl] == 0)
+				m_FlBitmap &= ~(1ull << fl);
+		}
+	}
+
+	uint32_t FindFree(VkDeviceSize requested)
+	{
+		if (requested > size)
+			return NONE;
+
+		uint32_t fl, sl;
+		Mapping(RoundUpToList(requested), fl, sl);
+
+		uint32_t slMap = m_SlBitmap[fl] & (~0u << sl);
+		if (slMap == 0) {
+			uint64_t flMap = fl + 1 < 64 ? m_FlBitmap & (~0ull << (fl + 1)) : 0;
+			if (flMap == 0)
+				return NONE;
+			fl = (uint32_t)std::countr_zero(flMap);
+			slMap = m_SlBitmap[fl];
+		}
+		sl = (uint32_t)std::countr_zero(slMap);
+
+		return m_Heads[fl][sl];
+	}
+
+	std::vector<Node>		m_Nodes;
+	std::vector<uint32_t>	m_FreeSlots;
+
+	uint64_t				m_FlBitmap = 0;
+	uint32_t				m_SlBitmap[FL_COUNT] = {};
+	uint32_t				m_Heads[FL_COUNT][SL_COUNT];
+
+	VkDeviceSize			m_Used = 0;
+	uint32_t				m_NumAllocations = 0;
+};
+
+struct MemoryAllocator::Pool
+{
+	std::vector<std::unique_ptr<MemoryBlock>> blocks;
+};
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) :
+	m_Device(device)
+{
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_MaxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+	m_Pools.resize(m_MemoryProperties.memoryTypeCount * 2);
+	for (auto& pool : m_Pools)
+		pool = std::make_unique<Pool>();
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+	Statistics stats = GetStatistics();
+	if (stats.numAllocations > 0)
+		NE_WARN("[vulkan] {} device memory allocations were never freed", stats.numAllocations);
+
+	for (auto& pool : m_Pools) {
+		for (auto& block : pool->blocks)
+			vkFreeMemory(m_Device, block->memory, nullptr);
+	}
+}
+
+MemoryAllocation MemoryAllocator::Allocate(VkBuffer buffer, VkMemoryPropertyFlags properties, VkDeviceSize minAlignment)
+{
+	VkMemoryDedicatedRequirements dedicated{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated };
+	VkBufferMemoryRequirementsInfo2 info{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2, nullptr, buffer };
+	vkGetBufferMemoryRequirements2(m_Device, &info, &requirements);
+
+	requirements.memoryRequirements.alignment = std::max(requirements.memoryRequirements.alignment, minAlignment);
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+	dedicatedInfo.buffer = buffer;
+
+	MemoryAllocation allocation = Allocate(requirements.memoryRequirements, dedicated, properties, true, dedicatedInfo);
+	VulkanContext::VK(vkBindBufferMemory(m_Device, buffer, allocation.memory, allocation.offset), "[vulkan] Error: cannot bind buffer memory");
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling)
+{
+	VkMemoryDedicatedRequirements dedicated{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS };
+	VkMemoryRequirements2 requirements{ VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2, &dedicated };
+	VkImageMemoryRequirementsInfo2 info{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2, nullptr, image };
+	vkGetImageMemoryRequirements2(m_Device, &info, &requirements);
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{ VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO };
+	dedicatedInfo.image = image;
+
+	MemoryAllocation allocation = Allocate(requirements.memoryRequirements, dedicated, properties, tiling == VK_IMAGE_TILING_LINEAR, dedicatedInfo);
+	VulkanContext::VK(vkBindImageMemory(m_Device, image, allocation.memory, allocation.offset), "[vulkan] Error: cannot bind image memory.");
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, const VkMemoryDedicatedRequirements& dedicated,
+	VkMemoryPropertyFlags properties, bool linear, const VkMemoryDedicatedAllocateInfo& dedicatedInfo)
+{
+	uint32_t memoryType = FindMemoryType(requirements.memoryTypeBits, properties);
+	VkDeviceSize blockSize = GetBlockSize(memoryType);
+
+	std::lock_guard lock(m_Mutex);
+
+	if (dedicated.prefersDedicatedAllocation || dedicated.requiresDedicatedAllocation || requirements.size > blockSize / 2)
+		return AllocateDedicated(requirements, memoryType, dedicatedInfo);
+
+	uint32_t poolIndex = memoryType * 2 + (linear ? 0 : 1);
+	Pool& pool = *m_Pools[poolIndex];
+
+	MemoryAllocation allocation;
+	allocation.size = requirements.size;
+
+	// newest blocks are the emptiest, try them first
+	for (auto it = pool.blocks.rbegin(); it != pool.blocks.rend(); ++it) {
+		MemoryBlock* block = it->get();
+		if (block->Allocate(requirements.size, requirements.alignment, allocation.offset, allocation.node)) {
+			allocation.memory = block->memory;
+			allocation.block = block;
+			allocation.mapped = block->mapped ? static_cast<std::byte*>(block->mapped) + allocation.offset : nullptr;
+			return allocation;
+		}
+	}
+
+	// no room, add a block. Halve it if the heap cannot fit a full one anymore
+	VkMemoryAllocateFlagsInfo flagsInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO };
+	flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+	void* mapped = nullptr;
+	VkDeviceMemory memory = AllocateDeviceMemory(blockSize, memoryType, &flagsInfo, &mapped);
+	while (memory == VK_NULL_HANDLE && blockSize / 2 >= requirements.size * 2) {
+		blockSize /= 2;
+		memory = AllocateDeviceMemory(blockSize, memoryType, &flagsInfo, &mapped);
+	}
+
+	if (memory == VK_NULL_HANDLE) {
+		m_NumFailedBlocks++;
+		return AllocateDedicated(requirements, memoryType, dedicatedInfo);
+	}
+
+	auto& block = pool.blocks.emplace_back(std::make_unique<MemoryBlock>(memory, blockSize, mapped, poolIndex));
+	block->Allocate(requirements.size, requirements.alignment, allocation.offset, allocation.node);
+
+	allocation.memory = memory;
+	allocation.block = block.get();
+	allocation.mapped = mapped ? static_cast<std::byte*>(mapped) + allocation.offset : nullptr;
+	return allocation;
+}
+
+MemoryAllocation MemoryAllocator::AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, const VkMemoryDedicatedAllocateInfo& dedicatedInfo)
+{
+	// buffers may be used with device addresses
+	VkMemoryAllocateFlagsInfo flagsInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO };
+	flagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT;
+
+	VkMemoryDedicatedAllocateInfo chainedDedicatedInfo = dedicatedInfo;
+	if (dedicatedInfo.buffer != VK_NULL_HANDLE)
+		chainedDedicatedInfo.pNext = &flagsInfo;
+
+	MemoryAllocation allocation;
+	allocation.size = requirements.size;
+	allocation.memory = AllocateDeviceMemory(requirements.size, memoryType, &chainedDedicatedInfo, &allocation.mapped);
+
+	if (allocation.memory == VK_NULL_HANDLE)
+		NE_ERROR("[vulkan] Error: out of device memory, cannot allocate {} bytes", requirements.size);
+
+	m_NumDedicated++;
+	m_DedicatedBytes += requirements.size;
+	return allocation;
+}
+
+VkDeviceMemory MemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, const void* pNext, void** mapped)
+{
+	VkMemoryAllocateInfo memoryAllocateInfo{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = pNext,
+		.allocationSize = size,
+		.memoryTypeIndex = memoryType,
+	};
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(m_Device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	*mapped = nullptr;
+	if (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		VulkanContext::VK(vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, mapped), "[vulkan] Error: cannot map device memory");
+
+	return memory;
+}
+
+void MemoryAllocator::Free(MemoryAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::lock_guard lock(m_Mutex);
+
+	if (MemoryBlock* block = allocation.block) {
+		block->Free(allocation.node);
+
+		// keep one empty block around per pool so load/unload cycles do not thrash vkAllocateMemory
+		if (block->IsEmpty()) {
+			Pool& pool = *m_Pools[block->pool];
+			bool hasOtherEmpty = std::any_of(pool.blocks.begin(), pool.blocks.end(),
+				[block](const auto& other) { return other.get() != block && other->IsEmpty(); });
+
+			if (hasOtherEmpty) {
+				vkFreeMemory(m_Device, block->memory, nullptr);
+				std::erase_if(pool.blocks, [block](const auto& other) { return other.get() == block; });
+			}
+		}
+	}
+	else {
+		vkFreeMemory(m_Device, allocation.memory, nullptr);
+		m_NumDedicated--;
+		m_DedicatedBytes -= allocation.size;
+	}
+
+	allocation = {};
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	}
+
+	NE_ERROR("[vulkan] Error: failed to find suitable memory type!");
+}
+
+VkDeviceSize MemoryAllocator::GetBlockSize(uint32_t memoryType) const
+{
+	// small heaps (e.g. the 256MB device local + host visible bar) get blocks of an eighth of their size
+	VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[m_MemoryProperties.memoryTypes[memoryType].heapIndex].size;
+	return std::min(MAX_BLOCK_SIZE, std::bit_floor(heapSize / 8));
+}
+
+MemoryAllocator::Statistics MemoryAllocator::GetStatistics() const
+{
+	std::lock_guard lock(m_Mutex);
+
+	Statistics stats;
+	for (const auto& pool : m_Pools) {
+		for (const auto& block : pool->blocks) {
+			stats.numBlocks++;
+			stats.numAllocations += block->getNumAllocations();
+			stats.blockBytes += block->size;
+			stats.usedBytes += block->getUsed();
+		}
+	}
+
+	stats.numDedicated = m_NumDedicated;
+	stats.numAllocations += m_NumDedicated;
+	stats.dedicatedBytes = m_DedicatedBytes;
+	stats.numDeviceMemories = stats.numBlocks + m_NumDedicated;
+	return stats;
+}
+
+void MemoryAllocator::OnUIRender()
+{
+	constexpr float MB = 1024.0f * 1024.0f;
+
+	Statistics stats = GetStatistics();
+	ImGui::Text("Device Memory: %u allocations in %u vkAllocateMemory (limit %u)", stats.numAllocations, stats.numDeviceMemories, m_MaxAllocationCount);
+	ImGui::Text("Blocks: %u, %.1f / %.1f MB used", stats.numBlocks, stats.usedBytes / MB, stats.blockBytes / MB);
+	ImGui::Text("Dedicated: %u, %.1f MB", stats.numDedicated, stats.dedicatedBytes / MB);
+	if (m_NumFailedBlocks > 0)
+		ImGui::Text("Failed block allocations: %u", m_NumFailedBlocks);
+
+	if (ImGui::TreeNode("Memory Types"))
+	{
+		std::lock_guard lock(m_Mutex);
+		for (uint32_t i = 0; i < (uint32_t)m_Pools.size(); ++i) {
+			const Pool& pool = *m_Pools[i];
+			if (pool.blocks.empty())
+				continue;
+
+			VkDeviceSize used = 0, size = 0;
+			uint32_t allocations = 0;
+			for (const auto& block : pool.blocks) {
+				used += block->getUsed();
+				size += block->size;
+				allocations += block->getNumAllocations();
+			}
+
+			uint32_t memoryType = i / 2;
+			VkMemoryPropertyFlags flags = m_MemoryProperties.memoryTypes[memoryType].propertyFlags;
+			ImGui::BulletText("Type %u (%s%s) %s: %u blocks, %u allocations, %.1f / %.1f MB", memoryType,
+				(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "device local " : "",
+				(flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? "host visible" : "",
+				(i % 2) ? "images" : "linear", (uint32_t)pool.blocks.size(), allocations, used / MB, size / MB);
+		}
+		ImGui::TreePop();
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+class MemoryBlock;
+
+// A range of device memory handed out by the MemoryAllocator
+struct MemoryAllocation
+{
+	VkDeviceMemory	memory = VK_NULL_HANDLE;
+	VkDeviceSize	offset = 0;
+	VkDeviceSize	size = 0;
+	void*			mapped = nullptr; // host visible memory stays mapped for its whole lifetime
+
+	// the block this was sub-allocated from, null for dedicated allocations
+	MemoryBlock*	block = nullptr;
+	uint32_t		node = 0;
+
+	bool IsValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+/**
+ * Sub-allocates buffers and images from large VkDeviceMemory blocks instead of one vkAllocateMemory per resource.
+ * Blocks are pooled by memory type, with linear resources and optimal images kept apart so bufferImageGranularity never matters.
+ * Inside a block, ranges are handed out by a two level segregated fit (TLSF) allocator in constant time.
+ * Resources the driver prefers a dedicated allocation for (VK_KHR_dedicated_allocation), and very large ones, get their own memory.
+ */
+class MemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize MAX_BLOCK_SIZE = 256ull * 1024 * 1024;
+
+	MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+
+	~MemoryAllocator();
+
+	// allocates memory for the buffer and binds it. minAlignment raises the alignment the driver asks for
+	MemoryAllocation Allocate(VkBuffer buffer, VkMemoryPropertyFlags properties, VkDeviceSize minAlignment = 0);
+
+	// allocates memory for the image and binds it
+	MemoryAllocation Allocate(VkImage image, VkMemoryPropertyFlags properties, VkImageTiling tiling);
+
+	void Free(MemoryAllocation& allocation);
+
+	struct Statistics
+	{
+		uint32_t		numDeviceMemories = 0; // actual vkAllocateMemory calls alive
+		uint32_t		numBlocks = 0;
+		uint32_t		numDedicated = 0;
+		uint32_t		numAllocations = 0;
+		VkDeviceSize	blockBytes = 0;
+		VkDeviceSize	usedBytes = 0; // sub-allocated out of blocks
+		VkDeviceSize	dedicatedBytes = 0;
+	};
+
+	Statistics GetStatistics() const;
+
+	void OnUIRender();
+
+private:
+	struct Pool;
+
+	MemoryAllocation Allocate(const VkMemoryRequirements& requirements, const VkMemoryDedicatedRequirements& dedicated, VkMemoryPropertyFlags properties,
+		bool linear, const VkMemoryDedicatedAllocateInfo& dedicatedInfo);
+
+	MemoryAllocation AllocateDedicated(const VkMemoryRequirements& requirements, uint32_t memoryType, const VkMemoryDedicatedAllocateInfo& dedicatedInfo);
+
+	VkDeviceMemory AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, const void* pNext, void** mapped);
+
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDeviceSize GetBlockSize(uint32_t memoryType) const;
+
+	VkDevice									m_Device;
+	VkPhysicalDeviceMemoryProperties			m_MemoryProperties;
+	uint32_t									m_MaxAllocationCount;
+
+	mutable std::mutex							m_Mutex;
+
+	// indexed by memory type * 2 + (linear ? 0 : 1)
+	std::vector<std::unique_ptr<Pool>>			m_Pools;
+
+	uint32_t									m_NumDedicated = 0;
+	VkDeviceSize								m_DedicatedBytes = 0;
+	uint32_t									m_NumFailedBlocks = 0;
+};
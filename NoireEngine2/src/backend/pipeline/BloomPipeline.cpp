@@ -78,9 +78,13 @@ void BloomPipeline::OnUIRender()
     ImGui::DragFloat("Filter Radius", &m_BloomPush.filterRadius, 0.01f, 0.0f, 1.0f, "%.4f");
 }
 
-void BloomPipeline::CreatePipeline()
+void BloomPipeline::CreatePipelineLayouts()
 {
     CreateBloomPipelineLayout();
+}
+
+void BloomPipeline::CreatePipeline()
+{
     CreateBloomPipelines();
 }
 
@@ -278,6 +282,7 @@ void BloomPipeline::DestroyWorkspaces()
         // Clean up bloom image views
         for (VkImageView& bloomImageView : workspace.m_BloomImageViews) {
             if (bloomImageView != VK_NULL_HANDLE) {
+                VulkanContext::Get()->getDescriptorLayoutCache()->ForgetResource((uint64_t)bloomImageView);
                 vkDestroyImageView(VulkanContext::GetDevice(), bloomImageView, nullptr);
                 bloomImageView = VK_NULL_HANDLE;
             }
@@ -2,7 +2,6 @@
 
 #include "VulkanPipeline.hpp"
 #include "math/Math.hpp"
-#include "utils/ThreadPool.hpp"
 #include <array>
 
 #include "backend/images/ImageDepth.hpp"
@@ -23,6 +22,8 @@ public:
 
 	void Rebuild(const std::vector<Image2D*>& workspaces);
 
+	void CreatePipelineLayouts() override;
+
 	void CreatePipeline() override;
 
 	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
@@ -0,0 +1,283 @@
+#include "ClusteringPipeline.hpp"
+
+#include "backend/shader/VulkanShader.h"
+#include "backend/VulkanContext.hpp"
+#include "renderer/Renderer.hpp"
+#include "renderer/scene/Scene.hpp"
+#include "renderer/components/CameraComponent.hpp"
+#include "Application.hpp"
+
+#include "imgui/imgui.h"
+
+#include <algorithm>
+
+#define CLUSTERING_GROUP_SIZE 64
+
+ClusteringPipeline::~ClusteringPipeline()
+{
+	for (Workspace& workspace : workspaces)
+	{
+		workspace.BoundsSrc.Destroy();
+		workspace.Bounds.Destroy();
+		workspace.ShapesSrc.Destroy();
+		workspace.Shapes.Destroy();
+		workspace.Clusters.Destroy();
+		workspace.Indices.Destroy();
+		workspace.Stats.Destroy();
+		workspace.ClustersReadback.Destroy();
+		workspace.IndicesReadback.Destroy();
+	}
+	workspaces.clear();
+
+	m_DescriptorAllocator.Cleanup(); // destroy pool and sets
+
+	if (m_PipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(VulkanContext::GetDevice(), m_PipelineLayout, nullptr);
+		m_PipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (m_Pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(VulkanContext::GetDevice(), m_Pipeline, nullptr);
+		m_Pipeline = VK_NULL_HANDLE;
+	}
+}
+
+void ClusteringPipeline::Rebuild(glm::uvec2 extent)
+{
+	// the boxes are rebuilt for it on the next prepare
+	m_Extent = extent;
+}
+
+void ClusteringPipeline::CreatePipelineLayouts()
+{
+	m_Validate = Application::GetSpecification().ValidateLightClusters;
+
+	workspaces.resize(VulkanContext::Get()->getFramesInFlight());
+
+	for (Workspace& workspace : workspaces)
+	{
+		DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // cluster bounds
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // light shapes
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // clusters
+			.AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // light indices
+			.AddBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // statistics
+			.Build(workspace.set0_Clustering, set0_ClusteringLayout);
+	}
+
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push) };
+	VkPipelineLayoutCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &set0_ClusteringLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstant,
+	};
+
+	VulkanContext::VK(vkCreatePipelineLayout(VulkanContext::GetDevice(), &createInfo, nullptr, &m_PipelineLayout), "[vulkan] Error: cannot create light clustering pipeline layout");
+}
+
+void ClusteringPipeline::CreatePipeline()
+{
+	VulkanShader clusterShader("../spv/shaders/culling/lightclusters.comp.spv", VulkanShader::ShaderStage::Compute);
+
+	VkComputePipelineCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = clusterShader.shaderStage(),
+		.layout = m_PipelineLayout
+	};
+
+	VulkanContext::VK(vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(), 1, &createInfo, nullptr, &m_Pipeline),
+		"[vulkan] Error: cannot create light clustering pipeline");
+}
+
+void ClusteringPipeline::Prepare(const Scene* scene, const CommandBuffer& commandBuffer)
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+	Renderer* renderer = Renderer::Instance;
+
+	// this workspace's fence has been waited on, so what it last assigned is complete
+	if (workspace.Recorded)
+	{
+		const uint32_t* stats = static_cast<const uint32_t*>(workspace.Stats.data());
+		m_NumIndices = stats[0];
+		m_MaxClusterLights = stats[1];
+
+		// the clusters past the capacity went dark for that frame
+		if (m_NumIndices > workspace.IndexCapacity)
+		{
+			m_IndexCapacity = std::max(m_IndexCapacity, m_NumIndices + m_NumIndices / 2);
+			NE_WARN("Light clusters asked for {} indices, {} fit. Growing to {}", m_NumIndices, workspace.IndexCapacity, m_IndexCapacity);
+		}
+		else if (m_Validate && workspace.HasReference)
+			Validate();
+	}
+
+	// the lit pass shades from the render camera, so it is clustered from there
+	const Camera* camera = scene->GetRenderCam()->camera();
+	if (m_Clusters.BuildBounds(camera->getProjectionMatrix(), camera->nearClipPlane, camera->farClipPlane, m_Extent.x, m_Extent.y))
+		m_BoundsVersion++;
+
+	m_Clusters.BuildShapes(scene->getLightInstances(), camera->getViewMatrix());
+
+	constexpr VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	// boxes only change with the projection or the extent
+	if (workspace.BoundsVersion != m_BoundsVersion)
+	{
+		size_t boundsBytes = LightClusters::CLUSTER_COUNT * sizeof(LightClusters::Bounds);
+		Buffer::Reserve(workspace.BoundsSrc, boundsBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostMemory, Buffer::Mapped);
+		Buffer::Reserve(workspace.Bounds, boundsBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		Buffer::CopyFromHost(commandBuffer, workspace.BoundsSrc, workspace.Bounds, boundsBytes, m_Clusters.getBounds().data());
+		workspace.BoundsVersion = m_BoundsVersion;
+	}
+
+	// light shapes change with the camera and every light
+	const std::vector<LightClusters::Shape>& shapes = m_Clusters.getShapes();
+	size_t shapeBytes = std::max<size_t>(shapes.size(), 1) * sizeof(LightClusters::Shape);
+	if (Buffer::Reserve(workspace.ShapesSrc, shapeBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, hostMemory, Buffer::Mapped))
+	{
+		workspace.Shapes.Destroy();
+		workspace.Shapes = Buffer(workspace.ShapesSrc.getSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		NE_INFO("Reallocated light shapes to {} bytes", workspace.Shapes.getSize());
+	}
+
+	if (!shapes.empty())
+		Buffer::CopyFromHost(commandBuffer, workspace.ShapesSrc, workspace.Shapes, shapes.size() * sizeof(LightClusters::Shape), shapes.data());
+
+	// the lists themselves only ever live on the gpu
+	size_t clusterBytes = sizeof(ClusterHeader) + LightClusters::CLUSTER_COUNT * sizeof(LightClusters::Cluster);
+	size_t indexBytes = m_IndexCapacity * sizeof(uint32_t);
+	constexpr VkBufferUsageFlags listUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	Buffer::Reserve(workspace.Clusters, clusterBytes, listUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (Buffer::Reserve(workspace.Indices, indexBytes, listUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+		NE_INFO("Reallocated light indices to {} bytes", workspace.Indices.getSize());
+	workspace.IndexCapacity = (uint32_t)(workspace.Indices.getSize() / sizeof(uint32_t));
+
+	Buffer::Reserve(workspace.Stats, 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	memset(workspace.Stats.data(), 0, 2 * sizeof(uint32_t));
+
+	if (m_Validate)
+	{
+		Buffer::Reserve(workspace.ClustersReadback, workspace.Clusters.getSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory, Buffer::Mapped);
+		Buffer::Reserve(workspace.IndicesReadback, workspace.Indices.getSize(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostMemory, Buffer::Mapped);
+	}
+
+	// unchanged bindings are skipped by the layout cache
+	VkDescriptorBufferInfo boundsInfo = workspace.Bounds.GetDescriptorInfo();
+	VkDescriptorBufferInfo shapesInfo = workspace.Shapes.GetDescriptorInfo();
+	VkDescriptorBufferInfo clustersInfo = workspace.Clusters.GetDescriptorInfo();
+	VkDescriptorBufferInfo indicesInfo = workspace.Indices.GetDescriptorInfo();
+	VkDescriptorBufferInfo statsInfo = workspace.Stats.GetDescriptorInfo();
+
+	DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+		.BindBuffer(0, &boundsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(1, &shapesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(2, &clustersInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(3, &indicesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(4, &statsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.Write(workspace.set0_Clustering);
+
+	DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &renderer->m_DescriptorAllocator)
+		.BindBuffer(Renderer::StorageBuffers::LightClusters, &clustersInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.BindBuffer(Renderer::StorageBuffers::LightIndices, &indicesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.Write(renderer->workspaces[CURR_FRAME].set1_StorageBuffers);
+
+	m_Push.tileSize = m_Clusters.getTileSize();
+	m_Push.depthSlicing = m_Clusters.getDepthSlicing();
+	m_Push.pointCount = m_Clusters.getNumPoint();
+	m_Push.spotCount = m_Clusters.getNumSpot();
+	m_Push.indexCapacity = workspace.IndexCapacity;
+
+	// the reference: the cpu assignment of the same boxes and shapes
+	workspace.HasReference = m_Validate;
+	if (m_Validate)
+	{
+		m_Clusters.Assign();
+		workspace.ReferenceClusters = m_Clusters.getClusters();
+		workspace.ReferenceIndices = m_Clusters.getIndices();
+	}
+
+	workspace.Recorded = true;
+}
+
+void ClusteringPipeline::Validate()
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	const uint8_t* readback = static_cast<const uint8_t*>(workspace.ClustersReadback.data());
+	const LightClusters::Cluster* clusters = reinterpret_cast<const LightClusters::Cluster*>(readback + sizeof(ClusterHeader));
+	const uint32_t* indices = static_cast<const uint32_t*>(workspace.IndicesReadback.data());
+
+	// the gpu allocates its lists in whatever order the clusters finish, so compare them cluster by cluster
+	uint32_t mismatches = 0;
+	for (uint32_t i = 0; i < LightClusters::CLUSTER_COUNT; ++i)
+	{
+		const LightClusters::Cluster& gpu = clusters[i];
+		const LightClusters::Cluster& cpu = workspace.ReferenceClusters[i];
+
+		if (gpu.counts != cpu.counts || !std::equal(indices + gpu.offset, indices + gpu.offset + gpu.size(), workspace.ReferenceIndices.begin() + cpu.offset))
+			mismatches++;
+	}
+
+	if (mismatches > 0)
+		NE_WARN("Light clusters: {} of {} clusters differ from the cpu", mismatches, LightClusters::CLUSTER_COUNT);
+
+	m_NumMismatches = mismatches;
+	m_NumValidated++;
+}
+
+void ClusteringPipeline::Render(const Scene* scene, const CommandBuffer& commandBuffer)
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	// box and shape copies have to land before the assignment reads them
+	VkMemoryBarrier uploadBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+
+	// one thread per cluster
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &workspace.set0_Clustering, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &m_Push);
+	vkCmdDispatch(commandBuffer, (LightClusters::CLUSTER_COUNT + CLUSTERING_GROUP_SIZE - 1) / CLUSTERING_GROUP_SIZE, 1, 1);
+
+	// the lit pass reads the lists, the host the statistics
+	VkMemoryBarrier assignBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 1, &assignBarrier, 0, nullptr, 0, nullptr);
+
+	if (workspace.HasReference)
+	{
+		Buffer::CopyBuffer(commandBuffer, workspace.Clusters.getBuffer(), workspace.ClustersReadback.getBuffer(), workspace.Clusters.getSize());
+		Buffer::CopyBuffer(commandBuffer, workspace.Indices.getBuffer(), workspace.IndicesReadback.getBuffer(), workspace.Indices.getSize());
+
+		VkMemoryBarrier readbackBarrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+void ClusteringPipeline::OnUIRender()
+{
+	uint32_t numLights = m_Clusters.getNumPoint() + m_Clusters.getNumSpot();
+	ImGui::Text("Light Clusters: %u lights (%u point, %u spot) in %u clusters", numLights, m_Clusters.getNumPoint(), m_Clusters.getNumSpot(), LightClusters::CLUSTER_COUNT);
+	ImGui::Text("Cluster Lists: %u indices, %.1f lights per cluster, at most %u", m_NumIndices,
+		(float)m_NumIndices / LightClusters::CLUSTER_COUNT, m_MaxClusterLights);
+	ImGui::Checkbox("Validate Light Clusters", &m_Validate);
+	if (m_NumValidated > 0)
+		ImGui::Text("Validated %u frames, %u clusters differ from the cpu in the last one", m_NumValidated, m_NumMismatches);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "VulkanPipeline.hpp"
+#include "backend/buffers/Buffer.hpp"
+#include "backend/descriptor/DescriptorBuilder.hpp"
+#include "renderer/lighting/LightClusters.hpp"
+
+#include "glm/glm.hpp"
+
+/**
+ * Clustered forward lighting: assigns the point and spot lights to the clusters of LightClusters in one compute
+ * dispatch, before the lit pass. The lit shaders then only loop over their cluster's lights, read through
+ * set 1 bindings 8 and 9. The cluster boxes and light shapes are built on the cpu every frame and uploaded.
+ * With validation on, the gpu's lists are read back once the frame retires and compared against the cpu
+ * assignment of the same boxes and shapes.
+ */
+class ClusteringPipeline : public VulkanPipeline
+{
+public:
+	~ClusteringPipeline();
+
+	// size of the framebuffer the lit pass draws to
+	void Rebuild(glm::uvec2 extent);
+
+	void CreatePipelineLayouts() override;
+
+	void CreatePipeline() override;
+
+	// uploads this frame's boxes and light shapes, and points the renderer's storage buffers at the clusters
+	void Prepare(const Scene* scene, const CommandBuffer& commandBuffer);
+
+	// records the assignment, must run outside of a render pass
+	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
+
+	void OnUIRender();
+
+private:
+	// compares what the gpu assigned in this workspace against the cpu reference taken when it was recorded
+	void Validate();
+
+	// leads the clusters buffer, matches host.glsl
+	struct ClusterHeader
+	{
+		glm::uvec2 tileSize;
+		glm::vec2 depthSlicing;
+	};
+
+	struct Push
+	{
+		glm::uvec2 tileSize;
+		glm::vec2 depthSlicing;
+		uint32_t pointCount;
+		uint32_t spotCount;
+		uint32_t indexCapacity;
+	}m_Push;
+
+	struct Workspace
+	{
+		Buffer BoundsSrc; //host coherent; mapped
+		Buffer Bounds; //device-local
+		uint32_t BoundsVersion = 0; // of the boxes in Bounds
+
+		Buffer ShapesSrc; //host coherent; mapped
+		Buffer Shapes; //device-local
+
+		Buffer Clusters; // ClusterHeader, then a LightClusters::Cluster per cluster; device-local
+		Buffer Indices; // device-local
+		Buffer Stats; // indices asked for, most lights in one cluster; mapped
+		uint32_t IndexCapacity = 0;
+
+		// validation readback of Clusters and Indices; mapped
+		Buffer ClustersReadback;
+		Buffer IndicesReadback;
+
+		VkDescriptorSet set0_Clustering = VK_NULL_HANDLE;
+
+		// what was recorded into this workspace, for the readback
+		std::vector<LightClusters::Cluster> ReferenceClusters;
+		std::vector<uint32_t> ReferenceIndices;
+		bool HasReference = false; // validation was on when it was recorded
+		bool Recorded = false;
+	};
+	std::vector<Workspace> workspaces;
+
+	LightClusters			m_Clusters;
+	uint32_t				m_BoundsVersion = 0; // bumped whenever the boxes are rebuilt
+	glm::uvec2				m_Extent{ 1 };
+	uint32_t				m_IndexCapacity = LightClusters::CLUSTER_COUNT * 32; // of every workspace, grows when the gpu asks for more
+
+	VkDescriptorSetLayout	set0_ClusteringLayout = VK_NULL_HANDLE;
+
+	VkPipeline				m_Pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout		m_PipelineLayout = VK_NULL_HANDLE;
+
+	DescriptorAllocator		m_DescriptorAllocator;
+
+	// statistics, of the last frame that retired
+	uint32_t				m_NumIndices = 0;
+	uint32_t				m_MaxClusterLights = 0;
+
+	// validation
+	bool					m_Validate = false;
+	uint32_t				m_NumMismatches = 0;
+	uint32_t				m_NumValidated = 0;
+};
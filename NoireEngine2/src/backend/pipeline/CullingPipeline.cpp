@@ -0,0 +1,435 @@
+#include "CullingPipeline.hpp"
+
+#include "backend/shader/VulkanShader.h"
+#include "backend/VulkanContext.hpp"
+#include "renderer/Renderer.hpp"
+#include "renderer/scene/Scene.hpp"
+#include "renderer/components/CameraComponent.hpp"
+#include "Application.hpp"
+
+#include "imgui/imgui.h"
+
+#include <algorithm>
+#include <array>
+
+#define CULLING_GROUP_SIZE 64
+
+CullingPipeline::~CullingPipeline()
+{
+	for (Workspace& workspace : workspaces)
+	{
+		workspace.BoundsSrc.Destroy();
+		workspace.Bounds.Destroy();
+		workspace.CandidateCommands.Destroy();
+		workspace.CommandBatches.Destroy();
+		workspace.CulledInstances.Destroy();
+		workspace.CulledCommands.Destroy();
+		workspace.DrawCounts.Destroy();
+		workspace.Uniform.Destroy();
+	}
+	workspaces.clear();
+
+	m_Visibility.Destroy();
+
+	m_DescriptorAllocator.Cleanup(); // destroy pool and sets
+
+	if (m_PipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(VulkanContext::GetDevice(), m_PipelineLayout, nullptr);
+		m_PipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (m_CullPipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(VulkanContext::GetDevice(), m_CullPipeline, nullptr);
+		m_CullPipeline = VK_NULL_HANDLE;
+	}
+
+	if (m_CompactPipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(VulkanContext::GetDevice(), m_CompactPipeline, nullptr);
+		m_CompactPipeline = VK_NULL_HANDLE;
+	}
+}
+
+void CullingPipeline::CreatePipelineLayouts()
+{
+	m_Validate = Application::GetSpecification().ValidateGPUCulling;
+	m_Occlusion = Application::GetSpecification().Culling == ApplicationSpecification::Culling::Occlusion;
+
+	workspaces.resize(VulkanContext::Get()->getFramesInFlight());
+
+	for (Workspace& workspace : workspaces)
+	{
+		DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // bounds
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // candidate slots
+			.AddBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // candidate commands
+			.AddBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // command templates
+			.AddBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // command batches
+			.AddBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // culled instances
+			.AddBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // culled commands
+			.AddBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // draw counts
+			.AddBinding(8, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // frustum and camera
+			.AddBinding(9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT) // depth pyramid
+			.AddBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT) // visibility
+			.Build(workspace.set0_Culling, set0_CullingLayout);
+	}
+
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push) };
+	VkPipelineLayoutCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &set0_CullingLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstant,
+	};
+
+	VulkanContext::VK(vkCreatePipelineLayout(VulkanContext::GetDevice(), &createInfo, nullptr, &m_PipelineLayout), "[vulkan] Error: cannot create culling pipeline layout");
+}
+
+void CullingPipeline::CreatePipeline()
+{
+	VulkanShader cullShader("../spv/shaders/culling/cull.comp.spv", VulkanShader::ShaderStage::Compute);
+	VulkanShader compactShader("../spv/shaders/culling/compact.comp.spv", VulkanShader::ShaderStage::Compute);
+
+	std::array<VkComputePipelineCreateInfo, 2> createInfos{};
+	createInfos[0] = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO, .stage = cullShader.shaderStage(), .layout = m_PipelineLayout };
+	createInfos[1] = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO, .stage = compactShader.shaderStage(), .layout = m_PipelineLayout };
+
+	std::array<VkPipeline, 2> pipelines{};
+	VulkanContext::VK(vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(),
+		(uint32_t)createInfos.size(), createInfos.data(), nullptr, pipelines.data()), "[vulkan] Error: cannot create culling pipelines");
+
+	m_CullPipeline = pipelines[0];
+	m_CompactPipeline = pipelines[1];
+}
+
+void CullingPipeline::UploadBounds(const InstanceRegistry& registry, const CommandBuffer& commandBuffer)
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	// every workspace has to pick up this frame's changes, not only the one being recorded
+	for (Workspace& w : workspaces)
+		w.PendingBounds.Merge(registry.getDirtyTransforms());
+
+	size_t needed_bytes = std::max<size_t>(registry.capacity(), 1) * sizeof(Bounds);
+	if (Buffer::Reserve(workspace.BoundsSrc, needed_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Buffer::Mapped))
+	{
+		workspace.Bounds.Destroy();
+		workspace.Bounds = Buffer(workspace.BoundsSrc.getSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		// the new device buffer is empty, so every slot has to go up again
+		workspace.PendingBounds.AddAll(registry.capacity());
+
+		NE_INFO("Reallocated culling bounds to {} bytes", workspace.Bounds.getSize());
+	}
+
+	const CullingBounds& bounds = registry.getBounds();
+	Renderer::UploadPendingSlots(commandBuffer, workspace.BoundsSrc, workspace.Bounds, workspace.PendingBounds, sizeof(Bounds),
+		[&bounds](uint32_t slot, void* out) {
+			Bounds gpuBounds{
+				.center = glm::vec4(bounds.centerX[slot], bounds.centerY[slot], bounds.centerZ[slot], bounds.radius[slot]),
+				.extent = glm::vec4(bounds.extentX[slot], bounds.extentY[slot], bounds.extentZ[slot], 0),
+			};
+			memcpy(out, &gpuBounds, sizeof(Bounds));
+		}
+	);
+}
+
+void CullingPipeline::Prepare(const Scene* scene, const CommandBuffer& commandBuffer)
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+	Renderer* renderer = Renderer::Instance;
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
+
+	// this workspace's fence has been waited on, so what it last culled is complete
+	if (workspace.Recorded)
+	{
+		const uint32_t* drawCounts = static_cast<const uint32_t*>(workspace.DrawCounts.data());
+		m_NumDrawnFirst = drawCounts[0];
+		m_NumDrawnOcclusion = drawCounts[1];
+		m_NumFrustumCulled = drawCounts[2];
+		m_NumOccluded = drawCounts[3];
+		m_NumVisible = m_NumDrawnFirst + m_NumDrawnOcclusion;
+		if (m_Validate && workspace.HasReference)
+			Validate();
+	}
+
+	UploadBounds(registry, commandBuffer);
+
+	// shared by the frames in flight, so they have to be done with the old one. starts with nothing visible,
+	// the occlusion phase then draws everything once
+	size_t visibilityBytes = std::max<size_t>(registry.capacity(), 1) * sizeof(uint32_t);
+	if (m_Visibility.getBuffer() == VK_NULL_HANDLE || m_Visibility.getSize() < visibilityBytes)
+	{
+		VulkanContext::Get()->WaitIdle();
+		Buffer::Reserve(m_Visibility, visibilityBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Buffer::Unmapped);
+		vkCmdFillBuffer(commandBuffer, m_Visibility.getBuffer(), 0, VK_WHOLE_SIZE, 0);
+	}
+
+	const std::vector<uint32_t>& candidateCommands = renderer->m_CandidateCommands;
+	const std::vector<glm::uvec2>& commandBatches = renderer->m_CommandBatches;
+	m_NumCandidates = (uint32_t)candidateCommands.size();
+
+	workspace.BatchFirstCommands.clear();
+	for (const auto& workflowBatches : renderer->m_IndirectBatches)
+	{
+		for (const Renderer::IndirectBatch& batch : workflowBatches)
+		{
+			assert(batch.batchIndex == workspace.BatchFirstCommands.size());
+			workspace.BatchFirstCommands.push_back(batch.firstCommand);
+		}
+	}
+
+	// the occlusion phase gets its own copy of every command, instance range and count
+	uint32_t numPhases = m_Occlusion ? 2 : 1;
+	uint32_t numBatches = (uint32_t)workspace.BatchFirstCommands.size();
+	uint32_t numCommands = (uint32_t)commandBatches.size();
+	workspace.NumCommands = numCommands;
+
+	constexpr VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	size_t candidateBytes = std::max<size_t>(candidateCommands.size(), 1) * sizeof(uint32_t);
+	size_t commandCount = std::max<size_t>(numCommands * numPhases, 1);
+	size_t countBytes = (COUNT_HEADER + numBatches * numPhases) * sizeof(uint32_t);
+
+	Buffer::Reserve(workspace.CandidateCommands, candidateBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	Buffer::Reserve(workspace.CommandBatches, commandCount * sizeof(glm::uvec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	Buffer::Reserve(workspace.CulledInstances, candidateBytes * numPhases, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	Buffer::Reserve(workspace.CulledCommands, commandCount * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	Buffer::Reserve(workspace.DrawCounts, countBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	Buffer::Reserve(workspace.Uniform, sizeof(CullingUniform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostMemory, Buffer::Mapped);
+
+	glm::uvec2* batches = static_cast<glm::uvec2*>(workspace.CommandBatches.data());
+	memcpy(workspace.CandidateCommands.data(), candidateCommands.data(), candidateCommands.size() * sizeof(uint32_t));
+	memcpy(batches, commandBatches.data(), numCommands * sizeof(glm::uvec2));
+	memset(workspace.DrawCounts.data(), 0, countBytes);
+
+	if (m_Occlusion)
+	{
+		Buffer* indirectBuffer = VulkanContext::Get()->getIndirectBuffer();
+		assert(2 * numCommands * sizeof(VkDrawIndexedIndirectCommand) <= indirectBuffer->getSize());
+
+		VkDrawIndexedIndirectCommand* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffer->data());
+		for (uint32_t i = 0; i < numCommands; ++i)
+		{
+			commands[numCommands + i] = commands[i];
+			commands[numCommands + i].firstInstance += m_NumCandidates;
+			batches[numCommands + i] = commandBatches[i] + glm::uvec2(numBatches, numCommands);
+		}
+	}
+
+	// unchanged bindings are skipped by the layout cache
+	VkDescriptorBufferInfo boundsInfo = workspace.Bounds.GetDescriptorInfo();
+	VkDescriptorBufferInfo candidatesInfo = renderer->workspaces[CURR_FRAME].DrawInstances.GetDescriptorInfo();
+	VkDescriptorBufferInfo candidateCommandsInfo = workspace.CandidateCommands.GetDescriptorInfo();
+	VkDescriptorBufferInfo commandsInfo = VulkanContext::Get()->getIndirectBuffer()->GetDescriptorInfo();
+	VkDescriptorBufferInfo commandBatchesInfo = workspace.CommandBatches.GetDescriptorInfo();
+	VkDescriptorBufferInfo culledInstancesInfo = workspace.CulledInstances.GetDescriptorInfo();
+	VkDescriptorBufferInfo culledCommandsInfo = workspace.CulledCommands.GetDescriptorInfo();
+	VkDescriptorBufferInfo drawCountsInfo = workspace.DrawCounts.GetDescriptorInfo();
+	VkDescriptorBufferInfo uniformInfo = workspace.Uniform.GetDescriptorInfo();
+	VkDescriptorImageInfo pyramidInfo = renderer->s_HiZPipeline->GetPyramidDescriptorInfo();
+	VkDescriptorBufferInfo visibilityInfo = m_Visibility.GetDescriptorInfo();
+
+	DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+		.BindBuffer(0, &boundsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(1, &candidatesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(2, &candidateCommandsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(3, &commandsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(4, &commandBatchesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(5, &culledInstancesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(6, &culledCommandsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(7, &drawCountsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(8, &uniformInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindImage(9, &pyramidInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindBuffer(10, &visibilityInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.Write(workspace.set0_Culling);
+
+	// same frustum the cpu culler would use
+	const CameraComponent* cullingCam = scene->GetCullingCam();
+	const Frustum& frustum = cullingCam->camera()->getViewFrustum();
+
+	CullingUniform uniform{};
+	for (int i = 0; i < 6; ++i)
+	{
+		const auto& plane = frustum.getPlanes()[i];
+		uniform.planes[i] = glm::vec4(plane[0], plane[1], plane[2], plane[3]);
+	}
+
+	// the pyramid holds what the render camera saw, it says nothing about another camera's view
+	const CameraComponent* renderCam = scene->GetRenderCam();
+	uniform.viewProj = renderCam->camera()->getWorldToClipMatrix();
+	uniform.depthSize = glm::vec2(renderer->s_HiZPipeline->getDepthSize());
+	uniform.occlusion = (m_Occlusion && cullingCam == renderCam) ? 1 : 0;
+	memcpy(workspace.Uniform.data(), &uniform, sizeof(CullingUniform));
+
+	m_Push.candidateCount = m_NumCandidates;
+	m_Push.commandCount = numCommands;
+
+	// the reference: cpu culling of the same bounds, limited to the candidates
+	workspace.ReferenceVisible.clear();
+	workspace.HasReference = m_Validate;
+	if (m_Validate)
+	{
+		m_ReferenceCuller.Cull(frustum, registry.getBounds(), m_ReferenceScratch);
+
+		m_GPUVisible.assign(renderer->m_DrawOrder.begin(), renderer->m_DrawOrder.end());
+		std::sort(m_GPUVisible.begin(), m_GPUVisible.end());
+		std::set_intersection(m_ReferenceScratch.begin(), m_ReferenceScratch.end(), m_GPUVisible.begin(), m_GPUVisible.end(),
+			std::back_inserter(workspace.ReferenceVisible));
+	}
+
+	workspace.Recorded = true;
+}
+
+void CullingPipeline::Validate()
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	const uint32_t* drawCounts = static_cast<const uint32_t*>(workspace.DrawCounts.data());
+	const VkDrawIndexedIndirectCommand* culledCommands = static_cast<const VkDrawIndexedIndirectCommand*>(workspace.CulledCommands.data());
+	const uint32_t* culledInstances = static_cast<const uint32_t*>(workspace.CulledInstances.data());
+
+	// walk the draws exactly like vkCmdDrawIndexedIndirectCount did, phase by phase
+	uint32_t numBatches = (uint32_t)workspace.BatchFirstCommands.size();
+	uint32_t numPhases = m_Occlusion ? 2 : 1;
+
+	m_GPUVisible.clear();
+	for (uint32_t phase = 0; phase < numPhases; ++phase)
+	{
+		for (uint32_t batch = 0; batch < numBatches; ++batch)
+		{
+			uint32_t firstCommand = phase * workspace.NumCommands + workspace.BatchFirstCommands[batch];
+			for (uint32_t i = 0; i < drawCounts[COUNT_HEADER + phase * numBatches + batch]; ++i)
+			{
+				const VkDrawIndexedIndirectCommand& command = culledCommands[firstCommand + i];
+				for (uint32_t instance = 0; instance < command.instanceCount; ++instance)
+					m_GPUVisible.push_back(culledInstances[command.firstInstance + instance]);
+			}
+		}
+	}
+	std::sort(m_GPUVisible.begin(), m_GPUVisible.end());
+
+	// slots only one side saw, also catches duplicates. occlusion may hide what the cpu keeps, never the other way around
+	uint32_t mismatches = 0;
+	auto gpu = m_GPUVisible.begin();
+	auto cpu = workspace.ReferenceVisible.begin();
+	while (gpu != m_GPUVisible.end() || cpu != workspace.ReferenceVisible.end())
+	{
+		if (cpu == workspace.ReferenceVisible.end() || (gpu != m_GPUVisible.end() && *gpu < *cpu))
+			++gpu, ++mismatches;
+		else if (gpu == m_GPUVisible.end() || *cpu < *gpu)
+			++cpu, mismatches += m_Occlusion ? 0u : 1u;
+		else
+			++gpu, ++cpu;
+	}
+
+	uint32_t numVisible = drawCounts[0] + drawCounts[1];
+	if (mismatches > 0 || m_GPUVisible.size() != numVisible)
+		NE_WARN("GPU culling: {} visible ({} counted), {} on the cpu, {} slots differ", m_GPUVisible.size(), numVisible, workspace.ReferenceVisible.size(), mismatches);
+
+	// only log what changed, a still camera gives the same counts every frame
+	if (m_NumValidated == 0 || m_NumMismatches != mismatches || m_LoggedCounts != glm::uvec4(drawCounts[0], drawCounts[1], drawCounts[2], drawCounts[3]))
+	{
+		m_LoggedCounts = glm::uvec4(drawCounts[0], drawCounts[1], drawCounts[2], drawCounts[3]);
+		NE_INFO("GPU culling: {} candidates, {} drawn ({} + {}), {} frustum culled, {} occluded",
+			m_NumCandidates, numVisible, drawCounts[0], drawCounts[1], drawCounts[2], drawCounts[3]);
+	}
+
+	m_NumMismatches = mismatches;
+	m_NumValidated++;
+}
+
+void CullingPipeline::Render(const Scene* scene, const CommandBuffer& commandBuffer)
+{
+	// bounds copies and a cleared visibility buffer have to land before the cull touches them
+	VkMemoryBarrier uploadBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+
+	Dispatch(commandBuffer, m_Occlusion ? Phase::LastVisible : Phase::All);
+}
+
+void CullingPipeline::RenderOcclusionPhase(const CommandBuffer& commandBuffer)
+{
+	assert(m_Occlusion);
+
+	// the pyramid build already waited for the first phase's draws, and made the pyramid visible
+	Dispatch(commandBuffer, Phase::Occlusion);
+}
+
+void CullingPipeline::Dispatch(const CommandBuffer& commandBuffer, Phase phase)
+{
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	m_Push.phase = (uint32_t)phase;
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &workspace.set0_Culling, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &m_Push);
+
+	// one thread per candidate, appends visible slots to their command
+	if (m_Push.candidateCount > 0)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline);
+		vkCmdDispatch(commandBuffer, (m_Push.candidateCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+	}
+
+	VkMemoryBarrier cullBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+	// one thread per command, packs the non-empty ones to the front of their batch
+	if (m_Push.commandCount > 0)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CompactPipeline);
+		vkCmdDispatch(commandBuffer, (m_Push.commandCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+	}
+
+	// the draws read the commands and counts, the vertex shaders the slots, the host reads it all back later
+	VkMemoryBarrier drawBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void CullingPipeline::DrawBatch(VkCommandBuffer commandBuffer, uint32_t firstCommand, uint32_t commandCount, uint32_t batchIndex, bool occlusionPhase) const
+{
+	const Workspace& workspace = workspaces[CURR_FRAME];
+
+	// the occlusion phase's commands and counts follow the first phase's
+	if (occlusionPhase)
+	{
+		firstCommand += workspace.NumCommands;
+		batchIndex += (uint32_t)workspace.BatchFirstCommands.size();
+	}
+
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	vkCmdDrawIndexedIndirectCount(commandBuffer,
+		workspace.CulledCommands.getBuffer(), firstCommand * stride,
+		workspace.DrawCounts.getBuffer(), (COUNT_HEADER + batchIndex) * sizeof(uint32_t),
+		commandCount, stride);
+}
+
+VkDescriptorBufferInfo CullingPipeline::getCulledInstancesInfo()
+{
+	return workspaces[CURR_FRAME].CulledInstances.GetDescriptorInfo();
+}
+
+void CullingPipeline::OnUIRender()
+{
+	ImGui::Text("GPU Culling: %u / %u visible, %u frustum culled", m_NumVisible, m_NumCandidates, m_NumFrustumCulled);
+	if (m_Occlusion)
+		ImGui::Text("Occlusion: %u occluded, drawn %u last visible + %u newly visible", m_NumOccluded, m_NumDrawnFirst, m_NumDrawnOcclusion);
+	ImGui::Checkbox("Validate GPU Culling", &m_Validate);
+	if (m_NumValidated > 0)
+		ImGui::Text("Validated %u frames, %u slots differ from the cpu in the last one", m_NumValidated, m_NumMismatches);
+}
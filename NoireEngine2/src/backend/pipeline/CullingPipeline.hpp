@@ -0,0 +1,148 @@
+#pragma once
+
+#include "VulkanPipeline.hpp"
+#include "backend/buffers/Buffer.hpp"
+#include "backend/descriptor/DescriptorBuilder.hpp"
+#include "renderer/culling/FrustumCuller.hpp"
+#include "renderer/object/InstanceRegistry.hpp"
+
+#include "glm/glm.hpp"
+
+/**
+ * GPU frustum culling and draw compaction, used with --culling gpu.
+ * The cpu still sorts every alive opaque instance into instanced command templates (with zero instances).
+ * The cull pass tests each candidate's world box, kept in a persistent bounds buffer, and appends the visible
+ * slots to its command. The compact pass then packs the commands that kept any instance to the front of
+ * their batch and counts them, for vkCmdDrawIndexedIndirectCount.
+ * With --culling occlusion the scene is drawn in two phases. The first draws what passed the last occlusion
+ * test, the HiZPipeline then reduces its depth into a pyramid, and the second tests every candidate against
+ * it and draws the ones the first phase missed. Each phase has its own copy of the command templates.
+ * With validation on, the gpu's visible set is read back once the frame retires and compared against
+ * the cpu FrustumCuller over the same bounds and frustum; occlusion may only drop instances from it.
+ */
+class CullingPipeline : public VulkanPipeline
+{
+public:
+	~CullingPipeline();
+
+	void CreatePipelineLayouts() override;
+
+	void CreatePipeline() override;
+
+	// uploads bounds and this frame's candidates, after the renderer wrote its command templates
+	void Prepare(const Scene* scene, const CommandBuffer& commandBuffer);
+
+	// records the cull and compact dispatches of the first phase, must run outside of a render pass
+	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
+
+	// records the second phase against the freshly built depth pyramid, occlusion culling only
+	void RenderOcclusionPhase(const CommandBuffer& commandBuffer);
+
+	// draws the compacted commands of one batch, of the first or the occlusion phase
+	void DrawBatch(VkCommandBuffer commandBuffer, uint32_t firstCommand, uint32_t commandCount, uint32_t batchIndex, bool occlusionPhase) const;
+
+	void OnUIRender();
+
+	// the vertex shaders' instance slots, laid out like the candidates
+	VkDescriptorBufferInfo getCulledInstancesInfo();
+
+	// visible instances of the last frame that retired in this workspace
+	inline uint32_t getNumVisible() const { return m_NumVisible; }
+
+	inline bool isOcclusionCulling() const { return m_Occlusion; }
+
+private:
+	// what a dispatch culls, matches culling.glsl
+	enum class Phase : uint32_t
+	{
+		All, // frustum only
+		LastVisible, // what passed the last occlusion test
+		Occlusion, // everything against the depth pyramid
+	};
+
+	// leading uints of the draw counts: instances drawn by each phase, frustum culled, occluded
+	static constexpr uint32_t COUNT_HEADER = 4;
+
+	void Dispatch(const CommandBuffer& commandBuffer, Phase phase);
+
+	void UploadBounds(const InstanceRegistry& registry, const CommandBuffer& commandBuffer);
+
+	// compares what the gpu drew in this workspace against the cpu reference taken when it was recorded
+	void Validate();
+
+	struct Bounds
+	{
+		glm::vec4 center;
+		glm::vec4 extent;
+	};
+
+	// std140
+	struct CullingUniform
+	{
+		glm::mat4 viewProj;
+		glm::vec4 planes[6];
+		glm::vec2 depthSize;
+		uint32_t occlusion;
+		uint32_t pad;
+	};
+
+	struct Push
+	{
+		uint32_t candidateCount;
+		uint32_t commandCount; // of one phase
+		uint32_t phase;
+	}m_Push;
+
+	struct Workspace
+	{
+		Buffer BoundsSrc; //host coherent; mapped
+		Buffer Bounds; //device-local
+		DirtySlotSet PendingBounds;
+
+		Buffer CandidateCommands; // command of every candidate; mapped
+		Buffer CommandBatches; // (batch, first command of the batch) of every command; mapped
+		Buffer CulledInstances; // visible slots, at their command's firstInstance; mapped for validation
+		Buffer CulledCommands; // compacted commands; mapped for validation
+		Buffer DrawCounts; // COUNT_HEADER statistics, then the commands of each batch of each phase; mapped
+		Buffer Uniform; // CullingUniform; mapped
+
+		VkDescriptorSet set0_Culling = VK_NULL_HANDLE;
+
+		// what was recorded into this workspace, for the readback
+		std::vector<uint32_t> BatchFirstCommands; // of the first phase
+		uint32_t NumCommands = 0; // of one phase
+		std::vector<uint32_t> ReferenceVisible; // cpu culled candidates, sorted
+		bool HasReference = false; // validation was on when it was recorded
+		bool Recorded = false;
+	};
+	std::vector<Workspace> workspaces;
+
+	Buffer					m_Visibility; // per slot, passed the last occlusion test; shared by every workspace
+
+	VkDescriptorSetLayout	set0_CullingLayout = VK_NULL_HANDLE;
+
+	VkPipeline				m_CullPipeline = VK_NULL_HANDLE;
+	VkPipeline				m_CompactPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout		m_PipelineLayout = VK_NULL_HANDLE;
+
+	DescriptorAllocator		m_DescriptorAllocator;
+
+	bool					m_Occlusion = false;
+
+	// statistics, of the last frame that retired
+	uint32_t				m_NumDrawnFirst = 0;
+	uint32_t				m_NumDrawnOcclusion = 0;
+	uint32_t				m_NumFrustumCulled = 0;
+	uint32_t				m_NumOccluded = 0;
+
+	// validation
+	bool					m_Validate = false;
+	FrustumCuller			m_ReferenceCuller;
+	std::vector<uint32_t>	m_ReferenceScratch;
+	std::vector<uint32_t>	m_GPUVisible;
+	uint32_t				m_NumVisible = 0;
+	uint32_t				m_NumCandidates = 0;
+	uint32_t				m_NumMismatches = 0;
+	uint32_t				m_NumValidated = 0;
+	glm::uvec4				m_LoggedCounts{ 0 }; // header of the last logged draw counts
+};
@@ -44,16 +44,20 @@ GizmosPipeline::~GizmosPipeline()
 	}
 }
 
-void GizmosPipeline::CreatePipeline()
+void GizmosPipeline::CreatePipelineLayouts()
 {
 	workspaces.resize(VulkanContext::Get()->getFramesInFlight());
 
 	CreateLinesDescriptors();
 	CreateLinesPipelineLayout();
-	CreateLinesGraphicsPipeline();
 
 	CreateOutlineDescriptors();
 	CreateOutlinePipelineLayout();
+}
+
+void GizmosPipeline::CreatePipeline()
+{
+	CreateLinesGraphicsPipeline();
 	CreateOutlineGraphicsPipeline();
 }
 
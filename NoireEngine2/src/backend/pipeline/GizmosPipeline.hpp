@@ -15,6 +15,8 @@ class GizmosPipeline : public VulkanPipeline
 public:
 	~GizmosPipeline();
 
+	void CreatePipelineLayouts() override;
+
 	void CreatePipeline() override;
 
 	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
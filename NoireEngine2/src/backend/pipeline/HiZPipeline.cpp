@@ -0,0 +1,144 @@
+#include "HiZPipeline.hpp"
+
+#include "backend/shader/VulkanShader.h"
+#include "backend/VulkanContext.hpp"
+
+#include <algorithm>
+#include <array>
+
+HiZPipeline::~HiZPipeline()
+{
+	m_Pyramid.reset();
+	m_Counter.Destroy();
+
+	m_DescriptorAllocator.Cleanup(); // destroy pool and sets
+
+	if (m_PipelineLayout != VK_NULL_HANDLE) {
+		vkDestroyPipelineLayout(VulkanContext::GetDevice(), m_PipelineLayout, nullptr);
+		m_PipelineLayout = VK_NULL_HANDLE;
+	}
+
+	if (m_Pipeline != VK_NULL_HANDLE) {
+		vkDestroyPipeline(VulkanContext::GetDevice(), m_Pipeline, nullptr);
+		m_Pipeline = VK_NULL_HANDLE;
+	}
+}
+
+void HiZPipeline::Rebuild(ImageDepth* depth)
+{
+	m_Depth = depth;
+	m_Pyramid = std::make_unique<DepthPyramid>(depth->getSize());
+
+	if (m_Counter.getBuffer() == VK_NULL_HANDLE)
+		m_Counter = Buffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	WriteDescriptors(descriptorsCreated);
+	descriptorsCreated = true;
+
+	glm::uvec2 groups = m_Pyramid->getSize() / DepthPyramid::TILE_SIZE;
+	m_Push.depthSize = depth->getSize();
+	m_Push.levelCount = m_Pyramid->getMipLevels();
+	m_Push.groupCount = groups.x * groups.y;
+}
+
+void HiZPipeline::WriteDescriptors(bool update)
+{
+	VkDescriptorImageInfo depthInfo{
+		.sampler = m_Depth->getSampler(),
+		.imageView = m_Depth->getView(),
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	};
+
+	// levels past the top repeat it, the shader never touches them
+	std::array<VkDescriptorImageInfo, DepthPyramid::MAX_LEVELS> levelInfos;
+	for (uint32_t level = 0; level < DepthPyramid::MAX_LEVELS; ++level)
+		levelInfos[level] = m_Pyramid->GetLevelDescriptorInfo(std::min(level, m_Pyramid->getMipLevels() - 1));
+
+	VkDescriptorBufferInfo counterInfo = m_Counter.GetDescriptorInfo();
+
+	DescriptorBuilder builder = DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+		.BindImage(0, &depthInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		.BindImage(1, levelInfos.data(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, DepthPyramid::MAX_LEVELS)
+		.BindBuffer(2, &counterInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+
+	if (update)
+		builder.Write(set0_HiZ);
+	else
+		builder.Build(set0_HiZ, set0_HiZLayout);
+}
+
+void HiZPipeline::CreatePipelineLayouts()
+{
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push) };
+	VkPipelineLayoutCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &set0_HiZLayout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &pushConstant,
+	};
+
+	VulkanContext::VK(vkCreatePipelineLayout(VulkanContext::GetDevice(), &createInfo, nullptr, &m_PipelineLayout), "[vulkan] Error: cannot create hi-z pipeline layout");
+}
+
+void HiZPipeline::CreatePipeline()
+{
+	VulkanShader shader("../spv/shaders/culling/hiz.comp.spv", VulkanShader::ShaderStage::Compute);
+
+	VkComputePipelineCreateInfo createInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = shader.shaderStage(),
+		.layout = m_PipelineLayout
+	};
+
+	VulkanContext::VK(vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(),
+		1, &createInfo, nullptr, &m_Pipeline), "[vulkan] Error: cannot create hi-z pipeline");
+}
+
+void HiZPipeline::Render(const Scene* scene, const CommandBuffer& commandBuffer)
+{
+	VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (Image::HasStencil(m_Depth->getFormat()))
+		depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	// depth writes of the first pass have to land before they are read
+	Image::InsertImageMemoryBarrier(commandBuffer, m_Depth->getImage(),
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		depthAspect, 1, 0, 1, 0);
+
+	vkCmdFillBuffer(commandBuffer, m_Counter.getBuffer(), 0, sizeof(uint32_t), 0);
+
+	// the cleared counter, and the last frame's culling done reading the pyramid
+	VkMemoryBarrier clearBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &set0_HiZ, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Push), &m_Push);
+
+	glm::uvec2 groups = m_Pyramid->getSize() / DepthPyramid::TILE_SIZE;
+	vkCmdDispatch(commandBuffer, groups.x, groups.y, 1);
+
+	// back to an attachment for the second pass
+	Image::InsertImageMemoryBarrier(commandBuffer, m_Depth->getImage(),
+		VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		depthAspect, 1, 0, 1, 0);
+
+	// the occlusion cull samples the pyramid
+	VkMemoryBarrier pyramidBarrier{
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+	};
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &pyramidBarrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "VulkanPipeline.hpp"
+#include "backend/buffers/Buffer.hpp"
+#include "backend/descriptor/DescriptorBuilder.hpp"
+#include "backend/images/DepthPyramid.hpp"
+#include "backend/images/ImageDepth.hpp"
+
+/**
+ * Builds the depth pyramid of the main depth buffer in a single compute dispatch, for occlusion culling.
+ * Runs between the two geometry passes of --culling occlusion, after the first one wrote depth.
+ */
+class HiZPipeline : public VulkanPipeline
+{
+public:
+	~HiZPipeline();
+
+	// recreates the pyramid for the depth buffer, which must outlive it
+	void Rebuild(ImageDepth* depth);
+
+	void CreatePipelineLayouts() override;
+
+	void CreatePipeline() override;
+
+	// records the build, must run outside of a render pass. leaves the depth buffer as an attachment again
+	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
+
+	// the whole pyramid, through its sampler
+	VkDescriptorImageInfo GetPyramidDescriptorInfo() const { return m_Pyramid->GetDescriptorInfo(); }
+
+	// size of the depth buffer, mip 0 of the pyramid is padded past it
+	glm::uvec2 getDepthSize() const { return m_Depth->getSize(); }
+
+private:
+	void WriteDescriptors(bool update);
+
+	struct Push
+	{
+		glm::uvec2 depthSize;
+		uint32_t levelCount;
+		uint32_t groupCount;
+	}m_Push;
+
+	ImageDepth*						m_Depth = nullptr; // just a handle, owned by the renderer
+	std::unique_ptr<DepthPyramid>	m_Pyramid;
+	Buffer							m_Counter; // groups done, zeroed before every build
+
+	VkDescriptorSet			set0_HiZ = VK_NULL_HANDLE;
+	VkDescriptorSetLayout	set0_HiZLayout = VK_NULL_HANDLE;
+	bool					descriptorsCreated = false;
+
+	VkPipeline				m_Pipeline = VK_NULL_HANDLE;
+	VkPipelineLayout		m_PipelineLayout = VK_NULL_HANDLE;
+
+	DescriptorAllocator		m_DescriptorAllocator;
+};
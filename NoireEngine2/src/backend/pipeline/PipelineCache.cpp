@@ -0,0 +1,152 @@
+#include "PipelineCache.hpp"
+
+#include "backend/VulkanContext.hpp"
+#include "core/resources/Files.hpp"
+
+#include <fstream>
+#include <cstring>
+
+namespace {
+	constexpr uint32_t FILE_MAGIC = 0x4350454E; // "NEPC"
+	constexpr uint32_t FILE_VERSION = 1;
+
+	// precedes the driver data in the file
+	struct FileHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	dataSize;
+		uint64_t	checksum; // of the driver data
+	};
+
+	// FNV-1a, enough to catch truncated and corrupted files
+	uint64_t Checksum(const std::byte* data, size_t size)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; ++i) {
+			hash ^= (uint64_t)data[i];
+			hash *= 0x100000001b3ull;
+		}
+		return hash;
+	}
+}
+
+PipelineCache::PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties) :
+	m_Device(device), m_Properties(properties), m_Path(Files::CacheDirectory() / "pipeline_cache.bin")
+{
+	std::vector<std::byte> initialData = Load();
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = initialData.size(),
+		.pInitialData = initialData.empty() ? nullptr : initialData.data(),
+	};
+
+	// drivers may still reject data they wrote themselves, start cold then
+	if (vkCreatePipelineCache(m_Device, &pipelineCacheCreateInfo, nullptr, &m_PipelineCache) != VK_SUCCESS && !initialData.empty()) {
+		NE_WARN("[vulkan] Driver rejected the pipeline cache at {}, starting cold", m_Path.string());
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData = nullptr;
+		initialData.clear();
+		VulkanContext::VK(vkCreatePipelineCache(m_Device, &pipelineCacheCreateInfo, nullptr, &m_PipelineCache), "[vulkan] Error: cannot create pipeline cache");
+	}
+
+	m_LoadedBytes = initialData.size();
+	if (IsWarm())
+		NE_INFO("Loaded pipeline cache ({} KB) from {}", m_LoadedBytes / 1024, m_Path.string());
+	else
+		NE_INFO("No usable pipeline cache at {}, every pipeline is compiled", m_Path.string());
+}
+
+PipelineCache::~PipelineCache()
+{
+	vkDestroyPipelineCache(m_Device, m_PipelineCache, nullptr);
+}
+
+std::vector<std::byte> PipelineCache::Load() const
+{
+	std::ifstream file(m_Path, std::ios::binary);
+	if (!file)
+		return {};
+
+	FileHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != FILE_MAGIC || header.version != FILE_VERSION) {
+		NE_WARN("Ignoring pipeline cache {}: unknown format", m_Path.string());
+		return {};
+	}
+
+	// the header is not trusted until the checksum matches, never allocate more than the file holds
+	std::error_code ec;
+	uintmax_t fileSize = std::filesystem::file_size(m_Path, ec);
+	if (ec || fileSize < sizeof(header) || header.dataSize != fileSize - sizeof(header)) {
+		NE_WARN("Ignoring pipeline cache {}: size mismatch", m_Path.string());
+		return {};
+	}
+
+	std::vector<std::byte> data(header.dataSize);
+	if (!file.read(reinterpret_cast<char*>(data.data()), data.size()) || Checksum(data.data(), data.size()) != header.checksum) {
+		NE_WARN("Ignoring pipeline cache {}: checksum mismatch", m_Path.string());
+		return {};
+	}
+
+	if (!IsCompatible(data)) {
+		NE_INFO("Ignoring pipeline cache {}: written by another device or driver", m_Path.string());
+		return {};
+	}
+
+	return data;
+}
+
+bool PipelineCache::IsCompatible(const std::vector<std::byte>& data) const
+{
+	VkPipelineCacheHeaderVersionOne header;
+	if (data.size() < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	return header.headerSize >= sizeof(header)
+		&& header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& header.vendorID == m_Properties.vendorID
+		&& header.deviceID == m_Properties.deviceID
+		&& std::memcmp(header.pipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void PipelineCache::Save() const
+{
+	size_t size = 0;
+	if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+		return;
+
+	std::vector<std::byte> data(size);
+	if (vkGetPipelineCacheData(m_Device, m_PipelineCache, &size, data.data()) != VK_SUCCESS)
+		return;
+	data.resize(size);
+
+	FileHeader header{
+		.magic = FILE_MAGIC,
+		.version = FILE_VERSION,
+		.dataSize = data.size(),
+		.checksum = Checksum(data.data(), data.size())
+	};
+
+	// write next to the old file and swap it in, so a crash mid-write never leaves a half written cache
+	std::filesystem::path temporary = m_Path;
+	temporary += ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!file) {
+			NE_WARN("Could not write pipeline cache to {}", temporary.string());
+			return;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temporary, m_Path, ec);
+	if (ec)
+		NE_WARN("Could not replace pipeline cache {}: {}", m_Path.string(), ec.message());
+	else
+		NE_INFO("Saved pipeline cache ({} KB) to {}", data.size() / 1024, m_Path.string());
+}
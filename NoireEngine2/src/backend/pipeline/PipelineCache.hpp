@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <vector>
+
+/**
+ * VkPipelineCache that persists across runs, in the user cache directory.
+ * The file is only fed back to the driver if its checksum matches and its VkPipelineCacheHeaderVersionOne
+ * names this vendor, device and pipeline cache UUID. Anything else starts an empty (cold) cache.
+ * Creating pipelines against it from several threads is safe, the driver synchronizes the cache.
+ */
+class PipelineCache
+{
+public:
+	PipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties);
+
+	~PipelineCache();
+
+	// writes the driver's current cache data to disk
+	void Save() const;
+
+	inline operator const VkPipelineCache& () const { return m_PipelineCache; }
+
+	// true if the cache was seeded from a valid file at startup
+	inline bool IsWarm() const { return m_LoadedBytes > 0; }
+	inline size_t getLoadedBytes() const { return m_LoadedBytes; }
+
+private:
+	// returns the driver data inside the file, or nothing if the file is missing, corrupt or made by another device
+	std::vector<std::byte> Load() const;
+
+	bool IsCompatible(const std::vector<std::byte>& data) const;
+
+	VkDevice					m_Device;
+	VkPhysicalDeviceProperties	m_Properties;
+	std::filesystem::path		m_Path;
+
+	VkPipelineCache				m_PipelineCache = VK_NULL_HANDLE;
+	size_t						m_LoadedBytes = 0;
+};
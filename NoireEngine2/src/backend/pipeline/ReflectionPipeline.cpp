@@ -29,10 +29,33 @@ ReflectionPipeline::~ReflectionPipeline()
 	}
 }
 
+void ReflectionPipeline::CreatePipelineLayouts()
+{
+	// Push constant: we want to be able to update constants used by the shaders
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
+									 0, sizeof(PushConstantRay) };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstant;
+
+	std::array< VkDescriptorSetLayout, 6 > layouts{
+		Renderer::Instance->set0_WorldLayout,
+		Renderer::Instance->set1_StorageBuffersLayout,
+		Renderer::Instance->set2_TexturesLayout,
+		Renderer::Instance->set3_IBLLayout,
+		Renderer::Instance->set4_ShadowMapLayout,
+		Renderer::Instance->set5_RayTracingLayout
+	};
+
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
+	VulkanContext::VK(vkCreatePipelineLayout(VulkanContext::GetDevice(), &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout));
+}
+
 void ReflectionPipeline::CreatePipeline()
 {
 	CreateRayTracingPipeline();
-	CreateShaderBindingTables();
 }
 
 void ReflectionPipeline::Render(const Scene* scene, const CommandBuffer& commandBuffer)
@@ -150,28 +173,6 @@ void ReflectionPipeline::CreateRayTracingPipeline()
 		m_RTShaderGroups.push_back(group);
 	}
 
-	// Push constant: we want to be able to update constants used by the shaders
-	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR,
-									 0, sizeof(PushConstantRay) };
-
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstant;
-
-	std::array< VkDescriptorSetLayout, 6 > layouts{
-		Renderer::Instance->set0_WorldLayout,
-		Renderer::Instance->set1_StorageBuffersLayout,
-		Renderer::Instance->set2_TexturesLayout,
-		Renderer::Instance->set3_IBLLayout,
-		Renderer::Instance->set4_ShadowMapLayout,
-		Renderer::Instance->set5_RayTracingLayout
-	};
-
-	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-	pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
-	vkCreatePipelineLayout(VulkanContext::GetDevice(), &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout);
-
-
 	// Assemble the shader stages and recursion depth info into the ray tracing pipeline
 	VkRayTracingPipelineCreateInfoKHR rayPipelineInfo{ VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR };
 	rayPipelineInfo.stageCount = static_cast<uint32_t>(stages.size());  // Stages are shaders
@@ -183,7 +184,7 @@ void ReflectionPipeline::CreateRayTracingPipeline()
 	rayPipelineInfo.maxPipelineRayRecursionDepth = 10;  // Ray depth
 	rayPipelineInfo.layout = m_PipelineLayout;
 
-	RaytracingContext::vkCreateRayTracingPipelinesKHR(VulkanContext::GetDevice(), {}, {}, 1, &rayPipelineInfo, nullptr, &m_Pipeline);
+	RaytracingContext::vkCreateRayTracingPipelinesKHR(VulkanContext::GetDevice(), {}, VulkanContext::Get()->getPipelineCache(), 1, &rayPipelineInfo, nullptr, &m_Pipeline);
 
 	NE_DEBUG("Built rtx pipeline", Logger::CYAN, Logger::BOLD);
 }
@@ -14,16 +14,31 @@
 #include "renderer/materials/Material.hpp"
 #include "renderer/object/Mesh.hpp"
 
+#include "imgui/imgui.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
 //#include "glm/gtc/matrix_transform.hpp"
 
+// the largest tile a point or spot light face, and a cascade, can get in the atlas
 #if defined(__ANDROID__)
 #define SHADOWMAP_DIM 512
 #define CASCADED_SHADOWMAP_DIM 1024
+#define SHADOW_ATLAS_DIM 4096
+#define SHADOW_ATLAS_MIN_TILE 64
 #else
 #define SHADOWMAP_DIM 1024
 #define CASCADED_SHADOWMAP_DIM 2048
+#define SHADOW_ATLAS_DIM 8192
+#define SHADOW_ATLAS_MIN_TILE 128
 #endif
 
+// casters pack the face they are drawn in above their instance slot, see shadowmapping.glsl
+#define SHADOW_FACE_SHIFT 29
+#define SHADOW_SLOT_MASK ((1u << SHADOW_FACE_SHIFT) - 1)
+
 static std::array< VkClearValue, 1 > clear_values{
 	VkClearValue{.depthStencil{.depth = 1.0f, .stencil = 0 } },
 };
@@ -32,46 +47,19 @@ ShadowPipeline::~ShadowPipeline()
 {
 	for (Workspace& workspace : workspaces)
 	{
-		// Wait for thread first
-		workspace.threadPool->Wait();
-
 		workspace.LightSpaces.Destroy();
 		workspace.LightSpaces_Src.Destroy();
+		workspace.ShadowInstances.Destroy();
+		workspace.ShadowCommands.Destroy();
+		workspace.ShadowRects.Destroy();
 
-		workspace.secondaryCommandBuffers.clear();
+		workspace.threadCommandBuffers.clear();
 	}
 	workspaces.clear();
 
-	for (int i = 0; i < m_ShadowMapPasses.size(); i++)
-	{
-		if (m_ShadowMapPasses[i].frameBuffer != VK_NULL_HANDLE) {
-			vkDestroyFramebuffer(VulkanContext::GetDevice(), m_ShadowMapPasses[i].frameBuffer, nullptr);
-			m_ShadowMapPasses[i].frameBuffer = VK_NULL_HANDLE;
-		}
-	}
-
-	for (int i = 0; i < m_CascadePasses.size(); i++)
-	{
-		for (int j = 0; j < SHADOW_MAP_CASCADE_COUNT; ++j) 
-		{
-			auto& frameBuf = m_CascadePasses[i].cascades[j].frameBuffer;
-			if (frameBuf != VK_NULL_HANDLE) {
-				vkDestroyFramebuffer(VulkanContext::GetDevice(), frameBuf, nullptr);
-				frameBuf = VK_NULL_HANDLE;
-			}
-		}
-	}
-
-	for (int i = 0; i < m_OmniPasses.size(); i++)
-	{
-		for (int j = 0; j < OMNI_SHADOWMAPS_COUNT; ++j)
-		{
-			auto& frameBuf = m_OmniPasses[i].cubefaces[j].frameBuffer;
-			if (frameBuf != VK_NULL_HANDLE) {
-				vkDestroyFramebuffer(VulkanContext::GetDevice(), frameBuf, nullptr);
-				frameBuf = VK_NULL_HANDLE;
-			}
-		}
+	if (m_AtlasFrameBuffer != VK_NULL_HANDLE) {
+		vkDestroyFramebuffer(VulkanContext::GetDevice(), m_AtlasFrameBuffer, nullptr);
+		m_AtlasFrameBuffer = VK_NULL_HANDLE;
 	}
 
 	if (m_ShadowMapRenderPass != VK_NULL_HANDLE) {
@@ -100,11 +88,11 @@ void ShadowPipeline::CreateRenderPass()
 	VkAttachmentDescription attachmentDescription{};
 	attachmentDescription.format = VK_FORMAT_D16_UNORM;
 	attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
-	attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;							// Clear depth at beginning of the render pass
+	attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;							// Keep the tiles that are not drawn this frame, each drawn tile clears itself
 	attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;						// We will read from depth, so it's important to store the depth attachment results
 	attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;					// We don't care about initial layout of the attachment
+	attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;	// The atlas is always left for shader reads
 	attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;// Attachment will be transitioned to shader read at render pass end
 
 	VkAttachmentReference depthReference = {};
@@ -122,9 +110,9 @@ void ShadowPipeline::CreateRenderPass()
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
 	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	dependencies[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 	dependencies[1].srcSubpass = 0;
@@ -151,17 +139,32 @@ void ShadowPipeline::CreateRenderPass()
 		"[Vulkan] Create Render pass failed"
 	);
 
-	uint32_t numShadowCasters[3] = { 0 };
-	for (auto shadowLight : shadowLights)
-		numShadowCasters[shadowLight->type]++;
+	// the lit passes always sample the atlas, so a scene without shadows still gets a tiny one
+	uint32_t atlasDim = shadowLights.empty() ? SHADOW_ATLAS_MIN_TILE : SHADOW_ATLAS_DIM;
+	m_Atlas = std::make_unique<ImageDepth>(glm::uvec2{ atlasDim, atlasDim }, VK_FORMAT_D16_UNORM);
+
+	// tiles are cleared when they are drawn, and nothing outside of them is ever sampled
+	m_Atlas->TransitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT);
+	m_AtlasAllocator.Reset(atlasDim, SHADOW_ATLAS_MIN_TILE);
+
+	VkImageView view = m_Atlas->getView();
+	VkFramebufferCreateInfo create_info
+	{
+		.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+		.renderPass = m_ShadowMapRenderPass,
+		.attachmentCount = 1,
+		.pAttachments = &view,
+		.width = atlasDim,
+		.height = atlasDim,
+		.layers = 1,
+	};
 
-	m_CascadePasses.resize(numShadowCasters[0]);
-	m_OmniPasses.resize(numShadowCasters[1]);
-	m_ShadowMapPasses.resize(numShadowCasters[2]);
+	VulkanContext::VK(
+		vkCreateFramebuffer(VulkanContext::GetDevice(), &create_info, nullptr, &m_AtlasFrameBuffer),
+		"[vulkan] Creating frame buffer failed"
+	);
 
-	Cascade_CreateRenderPasses(numShadowCasters[0]);
-	Omni_CreateRenderPasses(numShadowCasters[1]);
-	ShadowMap_CreateRenderPasses(numShadowCasters[2]);
+	NE_INFO("Created a {}x{} shadow atlas", atlasDim, atlasDim);
 }
 
 void ShadowPipeline::Rebuild()
@@ -169,12 +172,21 @@ void ShadowPipeline::Rebuild()
 	// TODO: do this shit bruh, but maybe not needed?
 }
 
-void ShadowPipeline::CreatePipeline()
+void ShadowPipeline::CreatePipelineLayouts()
 {
+	// routing a face to its viewport from the vertex shader needs both, otherwise every face is a job of its own
+	const LogicalDevice* device = VulkanContext::Get()->getLogicalDevice();
+	bool omniPass = device->getEnabledFeatures().multiViewport && device->IsExtensionEnabled(VK_EXT_SHADER_VIEWPORT_INDEX_LAYER_EXTENSION_NAME);
+	m_NumViewports = omniPass ? OMNI_SHADOWMAPS_COUNT : 1;
+
 	CreateDescriptors();
 	CreatePipelineLayout();
+	PrepareShadowJobs();
+}
+
+void ShadowPipeline::CreatePipeline()
+{
 	CreateGraphicsPipeline();
-	PrepareShadowRenderThreads();
 }
 
 void ShadowPipeline::Prepare(const Scene* scene, const CommandBuffer& commandBuffer)
@@ -265,144 +277,401 @@ void ShadowPipeline::Prepare(const Scene* scene, const CommandBuffer& commandBuf
 
 	if (offset > 0)
 		Buffer::CopyBuffer(commandBuffer, workspace.LightSpaces_Src.getBuffer(), workspace.LightSpaces.getBuffer(), offset);
+
+	// one atlas rect per shadow map, written once the tiles are placed
+	uint32_t numMaps = (uint32_t)(needed_bytes / sizeof(glm::mat4));
+	constexpr VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (Buffer::Reserve(workspace.ShadowRects, std::max(numMaps, 1u) * sizeof(glm::vec4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped))
+	{
+		VkDescriptorBufferInfo rectsInfo = workspace.ShadowRects.GetDescriptorInfo();
+		DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_Allocator)
+			.BindBuffer(Renderer::StorageBuffers::ShadowRects, &rectsInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+			.Write(Renderer::Instance->workspaces[CURR_FRAME].set1_StorageBuffers);
+	}
 }
 
 void ShadowPipeline::Render(const Scene* scene, const CommandBuffer& primaryCmdBuffer)
 {
 	const auto& shadowLights = SceneManager::Get()->getScene()->getShadowInstances();
 
-	// Inheritance info for the secondary command buffers
-	VkCommandBufferInheritanceInfo inheritanceInfo{};
-	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
-	inheritanceInfo.renderPass = m_ShadowMapRenderPass;
-
 	// the following is a fucking messy indexing pile garbage, but its elegant in the way that it requires
-	// no extra storage buffers, no extra pipelines, layouts, or descriptorsets.
+	// no extra pipelines, layouts, or descriptorsets.
 	// everything is done on a single pipeline
 
 	Workspace& workspace = workspaces[CURR_FRAME];
 
-	// record into secondary command buffers in a separate thread
-	uint32_t passIndices[3] = {0}; // which pass are we executing
-	int lightspaceId = 0; // offset of the lightspace matrix in the shader storage buffer
-	// render each shadow map
+	// gather the jobs, with their lightspaces in the same order as the lightspace buffer.
+	// jobs are reused across frames so their caster lists keep their memory
+	uint32_t numJobs = 0;
+	uint32_t numLightspaces = 0;
+	m_TileWanted.clear();
+	m_TileImportance.clear();
+	auto addJob = [this, &workspace, &numJobs, &numLightspaces](Light* light, uint32_t face, uint32_t numFaces, uint32_t mapIndex, uint32_t planeMask, const glm::vec4& sphere, float wanted, float importance) {
+		if (numJobs == workspace.shadowJobs.size())
+			workspace.shadowJobs.emplace_back();
+
+		ShadowJob& job = workspace.shadowJobs[numJobs++];
+		job.light = light;
+		job.lightspaceId = numLightspaces; // offset of the lightspace matrix in the shader storage buffer, and its tile in the atlas
+		job.lightType = light->type;
+		job.face = face;
+		job.numFaces = numFaces;
+		job.mapIndex = mapIndex;
+
+		job.lightspace = light->m_Lightspaces[face];
+		for (uint32_t i = 0; i < numFaces; ++i)
+			job.frustums[i].Update(light->m_Lightspaces[face + i], glm::mat4(1));
+		job.planeMask = planeMask;
+		job.sphere = sphere;
+
+		numLightspaces += numFaces;
+		m_TileWanted.insert(m_TileWanted.end(), numFaces, wanted);
+		m_TileImportance.insert(m_TileImportance.end(), numFaces, importance);
+	};
+
+	// plane 4 is the near plane. cascades pancake everything in front of it, so they cull without it
+	constexpr uint32_t allPlanes = 0x3F;
+	constexpr uint32_t pancakedPlanes = allPlanes & ~(1u << 4);
+
+	// the lit passes find shadow maps directional lights first, then point, then spot lights, see Renderer::Prepare
+	uint32_t mapIndices[3] = { 0 };
+	for (const Light* light : shadowLights)
+	{
+		if (light->type == 0)
+			mapIndices[1] += SHADOW_MAP_CASCADE_COUNT;
+		else if (light->type == 1)
+			mapIndices[2] += OMNI_SHADOWMAPS_COUNT;
+	}
+	mapIndices[2] += mapIndices[1];
+
+	// point and spot light tiles are sized by how much of the screen their limit sphere can cover
+	const Camera* camera = VIEW_CAM;
+	glm::vec3 eye = glm::inverse(camera->getViewMatrix())[3];
+	float focalLength = 1.0f / std::tan(camera->fieldOfView * 0.5f);
+
 	for (int lightIndex = 0; lightIndex < shadowLights.size(); ++lightIndex)
 	{
-		uint32_t type = shadowLights[lightIndex]->type;
+		Light* light = shadowLights[lightIndex];
+		uint32_t type = light->type;
+
+		// nothing past the limit is lit, so nothing past it can cast a visible shadow
+		glm::vec3 position(light->m_Position);
+		glm::vec4 limitSphere(position, light->m_Limit);
+
+		// fraction of the screen's height, lights that cannot light anything on screen get the smallest tile
+		float coverage = 0;
+		if (type != 0 && camera->getViewFrustum().SphereInFrustum(position, light->m_Limit))
+		{
+			float distance = glm::distance(eye, position);
+			coverage = distance > light->m_Limit ? std::min(light->m_Limit / distance * focalLength, 1.0f) : 1.0f;
+		}
+
 		switch (type) 
 		{
 		case 0:
+			// cascades always cover the whole screen, they are the last to shrink
 			for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOW_MAP_CASCADE_COUNT; ++cascadeIndex)
-			{
-				inheritanceInfo.framebuffer = m_CascadePasses[passIndices[type]].cascades[cascadeIndex].frameBuffer;
-
-				workspace.threadPool->threads[lightspaceId]->AddJob([=] {
-					T_RenderShadows(lightspaceId, inheritanceInfo, scene, type, CASCADED_SHADOWMAP_DIM, CASCADED_SHADOWMAP_DIM);
-				});
-
-				lightspaceId++;
-			}
+				addJob(light, cascadeIndex, 1, mapIndices[type]++, pancakedPlanes, glm::vec4(0), CASCADED_SHADOWMAP_DIM, 2.0f);
 			break;
 		case 1:
-			for (uint32_t faceIndex = 0; faceIndex < OMNI_SHADOWMAPS_COUNT; ++faceIndex)
+			// every face in one pass, each caster is drawn once and routed to the faces it is seen in
+			if (m_NumViewports >= OMNI_SHADOWMAPS_COUNT)
 			{
-				inheritanceInfo.framebuffer = m_OmniPasses[passIndices[type]].cubefaces[faceIndex].frameBuffer;
-
-				workspace.threadPool->threads[lightspaceId]->AddJob([=] {
-					T_RenderShadows(lightspaceId, inheritanceInfo, scene, type, SHADOWMAP_DIM, SHADOWMAP_DIM);
-				});
-				lightspaceId++;
+				addJob(light, 0, OMNI_SHADOWMAPS_COUNT, mapIndices[type], allPlanes, limitSphere, coverage * SHADOWMAP_DIM, coverage);
+				mapIndices[type] += OMNI_SHADOWMAPS_COUNT;
+				break;
 			}
+			for (uint32_t faceIndex = 0; faceIndex < OMNI_SHADOWMAPS_COUNT; ++faceIndex)
+				addJob(light, faceIndex, 1, mapIndices[type]++, allPlanes, limitSphere, coverage * SHADOWMAP_DIM, coverage);
 			break;
 		case 2:
-			inheritanceInfo.framebuffer = m_ShadowMapPasses[passIndices[type]].frameBuffer;
-
-			workspace.threadPool->threads[lightspaceId]->AddJob([=] {
-				T_RenderShadows(lightspaceId, inheritanceInfo, scene, type, SHADOWMAP_DIM, SHADOWMAP_DIM);
-			});
-			lightspaceId++;
+			addJob(light, 0, 1, mapIndices[type]++, allPlanes, limitSphere, coverage * SHADOWMAP_DIM, coverage);
 			break;
 		}
-		passIndices[type]++;
 	}
+	workspace.shadowJobs.resize(numJobs);
 
-	// join threads
-	workspace.threadPool->Wait();
-
-	for (int i = 0; i < 3; i++)
-		passIndices[i] = 0;
-	lightspaceId = 0;
-
-	auto RenderShadowPass = [&](VkFramebuffer frameBuffer, int lid, uint32_t dims)
+	// what changed in the scene this frame, for the shadow cache
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
+	m_SceneChanged = !registry.getDirtyTransforms().Empty() || !registry.getDirtyDescriptions().Empty() || registry.getVersion() != m_RegistryVersion;
+	m_RegistryVersion = registry.getVersion();
+	if (m_SceneChanged)
 	{
-		BeginRenderPass(primaryCmdBuffer, frameBuffer, dims, dims);
-		vkCmdExecuteCommands(primaryCmdBuffer, 1, &workspace.secondaryCommandBuffers[lightspaceId]->getCommandBuffer());
-		vkCmdEndRenderPass(primaryCmdBuffer);
-		lightspaceId++;
-	};
+		m_ChangedSlots.assign(registry.capacity(), 0);
+		for (uint32_t slot : registry.getDirtyTransforms().slots())
+			m_ChangedSlots[slot] = 1;
+		for (uint32_t slot : registry.getDirtyDescriptions().slots())
+			m_ChangedSlots[slot] = 1;
+	}
 
-	// render each shadow map in the main thread by calling a bunch of executes
-	// on the primary command buffer
-	for (int lightIndex = 0; lightIndex < shadowLights.size(); ++lightIndex)
+	// lightspaces only move around when shadow casting lights are added or removed, which starts over anyway
+	if (m_Cache.size() != numLightspaces)
+		m_Cache.assign(numLightspaces, CachedLightspace{});
+
+	// place every tile in the atlas, the depth cached in a tile that moved is gone
+	m_AtlasAllocator.Update(m_TileWanted, m_TileImportance);
+	const std::vector<ShadowAtlas::Tile>& tiles = m_AtlasAllocator.getTiles();
+	glm::vec4* rects = reinterpret_cast<glm::vec4*>(workspace.ShadowRects.data());
+	float texelSize = 1.0f / m_AtlasAllocator.getDim();
+	for (ShadowJob& job : workspace.shadowJobs)
 	{
-		uint32_t type = shadowLights[lightIndex]->type;
-		switch (type)
+		for (uint32_t i = 0; i < job.numFaces; ++i)
 		{
-		case 0:
-			for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOW_MAP_CASCADE_COUNT; ++cascadeIndex)
-				RenderShadowPass(m_CascadePasses[passIndices[type]].cascades[cascadeIndex].frameBuffer, lightspaceId, CASCADED_SHADOWMAP_DIM);
-			break;
-		case 1:
-			for (uint32_t faceIndex = 0; faceIndex < OMNI_SHADOWMAPS_COUNT; ++faceIndex)
-				RenderShadowPass(m_OmniPasses[passIndices[type]].cubefaces[faceIndex].frameBuffer, lightspaceId, SHADOWMAP_DIM);
-			break;
-		case 2:
-			RenderShadowPass(m_ShadowMapPasses[passIndices[type]].frameBuffer, lightspaceId, SHADOWMAP_DIM);
-			break;
+			job.tiles[i] = tiles[job.lightspaceId + i];
+			if (m_AtlasAllocator.WasMoved(job.lightspaceId + i))
+				m_Cache[job.lightspaceId].valid = false;
+
+			rects[job.mapIndex + i] = glm::vec4(job.tiles[i].x, job.tiles[i].y, job.tiles[i].size, 0) * texelSize;
 		}
-		passIndices[type]++;
+
+		// cascades snap to the texels of the tile they got, from the next time they are fit
+		if (job.lightType == 0)
+			job.light->m_CascadeResolution[job.face] = job.tiles[0].size;
+	}
+
+	// cull the casters of each job on the job system
+	JobCounter counter;
+	ShadowJob* jobs = workspace.shadowJobs.data();
+	JobSystem::Get()->Dispatch(counter, numJobs, 1, [this, scene, jobs](uint32_t i) {
+		T_CullShadowCasters(jobs[i], scene);
+	});
+	JobSystem::Get()->Wait(counter);
+
+	// lay the draw lists out back to back
+	uint32_t numInstances = 0;
+	uint32_t numCommands = 0;
+	m_NumNodesVisited = 0;
+	m_NumLightspacesRendered = 0;
+	m_NumJobsRendered = 0;
+	for (ShadowJob& job : workspace.shadowJobs)
+	{
+		if (!job.dirty)
+			continue;
+
+		m_NumLightspacesRendered += job.numFaces;
+		m_NumJobsRendered++;
+		job.firstInstance = numInstances;
+		job.firstCommand = numCommands;
+		numInstances += (uint32_t)job.casters.size();
+		numCommands += job.numCommands;
+		m_NumNodesVisited += job.nodesVisited;
+	}
+
+	constexpr VkMemoryPropertyFlags hostMemory = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	Buffer::Reserve(workspace.ShadowCommands, std::max(numCommands, 1u) * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, hostMemory, Buffer::Mapped);
+	if (Buffer::Reserve(workspace.ShadowInstances, std::max(numInstances, 1u) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostMemory, Buffer::Mapped))
+	{
+		VkDescriptorBufferInfo instancesInfo = workspace.ShadowInstances.GetDescriptorInfo();
+		DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_Allocator)
+			.BindBuffer(1, &instancesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.Write(workspace.set0_Lightspaces);
+
+		NE_INFO("Reallocated shadow instances to {} bytes", workspace.ShadowInstances.getSize());
 	}
+
+	// record each job into a secondary command buffer on the job system
+	std::fill(workspace.threadCommandBufferCursors.begin(), workspace.threadCommandBufferCursors.end(), 0);
+
+	JobSystem::Get()->Dispatch(counter, numJobs, 1, [this, scene, jobs](uint32_t i) {
+		T_RenderShadows(jobs[i], scene);
+	});
+	JobSystem::Get()->Wait(counter);
+
+	// render every shadow map in one pass over the atlas, by executing each job's commands
+	// on the primary command buffer. clean tiles are not touched at all, they keep their depth
+	m_Executes.clear();
+	for (const ShadowJob& job : workspace.shadowJobs)
+	{
+		if (!job.dirty)
+			continue;
+
+		m_Executes.push_back(job.recorded->getCommandBuffer());
+		Renderer::NumDrawCalls += job.drawCalls;
+	}
+
+	if (!m_Executes.empty())
+	{
+		BeginRenderPass(primaryCmdBuffer);
+		vkCmdExecuteCommands(primaryCmdBuffer, (uint32_t)m_Executes.size(), m_Executes.data());
+		vkCmdEndRenderPass(primaryCmdBuffer);
+	}
+	Renderer::NumCommandBuffers += m_NumJobsRendered;
+
+	// every lightspace used to draw what the camera sees
+	uint32_t numVisible = 0;
+	for (int workflowIndex = 0; workflowIndex < N_OPAQUE_MATERIALS; ++workflowIndex)
+		numVisible += (uint32_t)scene->getVisibleInstances()[workflowIndex].size();
+
+	m_NumLightspaces = numLightspaces;
+	m_NumCastersDrawn = numInstances;
+	m_NumCastersUnculled = numVisible * numLightspaces;
 }
 
-void ShadowPipeline::PrepareShadowRenderThreads()
+void ShadowPipeline::OnUIRender()
 {
-	uint32_t threads = 0;
+	ImGui::Text("Shadow Casters: %u drawn in %u lightspaces, %u without culling", m_NumCastersDrawn, m_NumLightspaces, m_NumCastersUnculled);
+	ImGui::Text("Shadow Culling: %u tree nodes visited", m_NumNodesVisited);
+	ImGui::Text("Shadow Maps: %u / %u rendered in %u command buffers", m_NumLightspacesRendered, m_NumLightspaces, m_NumJobsRendered);
+	ImGui::Text("Shadow Atlas: %ux%u, %.1f%% used, %u repacks", m_AtlasAllocator.getDim(), m_AtlasAllocator.getDim(),
+		100.0f * m_AtlasAllocator.getTexelsUsed() / std::max((float)m_AtlasAllocator.getDim() * m_AtlasAllocator.getDim(), 1.0f), m_AtlasAllocator.getNumRepacks());
+	ImGui::Checkbox("Cache Shadow Maps", &CacheShadowMaps);
+	ImGui::Checkbox("Fit Cascade Splits", &Light::FitCascadeSplits);
+}
+
+void ShadowPipeline::PrepareShadowJobs()
+{
+	uint32_t lightspaces = 0;
 	const auto& shadowLights = SceneManager::Get()->getScene()->getShadowInstances();
 	for (int lightIndex = 0; lightIndex < shadowLights.size(); ++lightIndex)
 	{
 		switch (shadowLights[lightIndex]->type)
 		{
 		case 0:
-			threads += SHADOW_MAP_CASCADE_COUNT;
+			lightspaces += SHADOW_MAP_CASCADE_COUNT;
 			break;
 		case 1:
-			threads += OMNI_SHADOWMAPS_COUNT;
+			lightspaces += OMNI_SHADOWMAPS_COUNT;
 			break;
 		case 2:
-			threads++;
+			lightspaces++;
 			break;
 		}
 	}
 
+	uint32_t threadCount = JobSystem::Get()->getThreadCount();
 	for (auto& workspace : workspaces)
 	{
-		workspace.threadPool = std::make_unique<ThreadPool>();
-		workspace.threadPool->SetThreadCount(threads);
-		workspace.secondaryCommandBuffers.resize(threads);
+		workspace.shadowJobs.reserve(lightspaces);
+		workspace.threadCommandBuffers.resize(threadCount);
+		workspace.threadCommandBufferCursors.resize(threadCount);
+	}
+	// command buffers are allocated lazily on the thread that records them
+	NE_INFO("Found {} shadow lightspaces, recording on {} job threads with {} viewports each.", lightspaces, threadCount, m_NumViewports);
+}
+
+void ShadowPipeline::T_CullShadowCasters(ShadowJob& job, const Scene* scene)
+{
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
+	CachedLightspace& cache = m_Cache[job.lightspaceId];
+
+	// nothing in the scene changed and the lightspace did not move, so neither did its casters
+	job.casters.clear();
+	job.numCommands = 0;
+	job.nodesVisited = 0;
+	job.dirty = true;
+
+	// no room left in the atlas, the lit passes leave it unshadowed
+	auto hasTile = [](const ShadowAtlas::Tile& tile) { return tile.size > 0; };
+	if (std::none_of(job.tiles.begin(), job.tiles.begin() + job.numFaces, hasTile))
+	{
+		job.dirty = false;
+		return;
+	}
+	if (CacheShadowMaps && cache.valid && !m_SceneChanged && cache.lightspace == job.lightspace)
+	{
+		job.dirty = false;
+		return;
+	}
+
+	glm::vec3 center(job.sphere);
+	float radiusSq = job.sphere.w * job.sphere.w;
+
+	auto addCaster = [&](const BVH::Node& leaf) {
+		if (!registry.IsAlive(leaf.slot))
+			return;
+
+		const ObjectInstance& instance = registry[leaf.slot];
+		if ((uint32_t)instance.material->getWorkflow() >= N_OPAQUE_MATERIALS)
+			return;
+
+		if (job.sphere.w > 0)
+		{
+			glm::vec3 toBox = glm::clamp(center, leaf.bounds.min, leaf.bounds.max) - center;
+			if (glm::dot(toBox, toBox) > radiusSq)
+				return;
+		}
+
+		// a single face was already culled by the query, faces of a point light are tested here
+		uint32_t faces = 1;
+		if (job.numFaces > 1)
+		{
+			faces = 0;
+			for (uint32_t i = 0; i < job.numFaces; ++i)
+			{
+				if (job.tiles[i].size > 0 && job.frustums[i].CubeInFrustum(leaf.bounds.min, leaf.bounds.max))
+					faces |= 1u << i;
+			}
+		}
+
+		// materials do not matter to a depth only pass, only the mesh splits a run
+		assert(leaf.slot <= SHADOW_SLOT_MASK);
+		uint64_t mesh = ((uint64_t)(instance.mesh->getVertexInput()->getID() & 0xFF) << 56)
+			| ((uint64_t)(instance.mesh->getID() & 0xFFFFFF) << 32);
+		for (; faces != 0; faces &= faces - 1)
+			job.casters.push_back(mesh | (uint64_t)std::countr_zero(faces) << SHADOW_FACE_SHIFT | leaf.slot);
+	};
+
+	// all faces of a point light together see the limit sphere
+	if (job.numFaces > 1)
+		scene->getBVH().QuerySphere(center, job.sphere.w, job.nodesVisited, addCaster);
+	else
+		scene->getBVH().QueryFrustum(job.frustums[0], job.planeMask, job.nodesVisited, addCaster);
+	std::sort(job.casters.begin(), job.casters.end());
+
+	// the map only has to be rendered again if the lightspace moved, a caster entered or left it,
+	// or one of its casters moved or changed while staying inside
+	if (CacheShadowMaps && cache.valid && cache.lightspace == job.lightspace && cache.casters == job.casters)
+	{
+		auto changed = [this](uint64_t caster) { return m_ChangedSlots[(uint32_t)caster & SHADOW_SLOT_MASK] != 0; };
+		job.dirty = std::any_of(job.casters.begin(), job.casters.end(), changed);
+	}
+
+	cache.lightspace = job.lightspace;
+	cache.casters = job.casters;
+	cache.valid = true;
+
+	if (!job.dirty)
+	{
+		job.casters.clear();
+		return;
+	}
+
+	// ids that do not fit only cost batching, runs are split on the actual mesh
+	job.numCommands = 0;
+	const Mesh* previousMesh = nullptr;
+	for (uint64_t caster : job.casters)
+	{
+		const Mesh* mesh = registry[(uint32_t)caster & SHADOW_SLOT_MASK].mesh;
+		if (mesh != previousMesh)
+		{
+			job.numCommands++;
+			previousMesh = mesh;
+		}
 	}
-	// initialization will be done on separate threads
-	NE_INFO("Found {} shadow threads.", threads);
 }
 
-void ShadowPipeline::T_RenderShadows(uint32_t tid, VkCommandBufferInheritanceInfo inheritance, const Scene* scene, uint32_t lightType, uint32_t width, uint32_t height)
+void ShadowPipeline::T_RenderShadows(ShadowJob& job, const Scene* scene)
 {
+	if (!job.dirty)
+		return;
+
 	Workspace& workspace = workspaces[CURR_FRAME];
 
-	// allocate if not created -- this must be alloacted in a different thread
-	if (!workspace.secondaryCommandBuffers[tid])
-		workspace.secondaryCommandBuffers[tid] = std::make_unique<CommandBuffer>(false, VK_QUEUE_GRAPHICS_BIT, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+	// take the next secondary command buffer owned by this thread, allocating from this thread's pool if needed
+	uint32_t threadIndex = JobSystem::GetThreadIndex();
+	auto& commandBuffers = workspace.threadCommandBuffers[threadIndex];
+	uint32_t& cursor = workspace.threadCommandBufferCursors[threadIndex];
+	if (cursor == commandBuffers.size())
+		commandBuffers.emplace_back(std::make_unique<CommandBuffer>(false, VK_QUEUE_GRAPHICS_BIT, VK_COMMAND_BUFFER_LEVEL_SECONDARY));
+
+	CommandBuffer& cmdBuf = *commandBuffers[cursor++];
+	job.recorded = &cmdBuf;
+	job.drawCalls = 0;
 
-	CommandBuffer& cmdBuf = *workspace.secondaryCommandBuffers[tid].get();
+	VkCommandBufferInheritanceInfo inheritance{};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = m_ShadowMapRenderPass;
+	inheritance.framebuffer = m_AtlasFrameBuffer;
 
 	cmdBuf.Begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance);
 	{
@@ -424,79 +693,82 @@ void ShadowPipeline::T_RenderShadows(uint32_t tid, VkCommandBufferInheritanceInf
 		// bind pipeline
 		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ShadowMapPipeline);
 
-		SetViewports(cmdBuf, width, height);
+		SetViewports(cmdBuf, job);
+
+		// the pass keeps the whole atlas, so each tile clears itself
+		VkClearAttachment clearDepth{
+			.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT,
+			.clearValue = clear_values[0],
+		};
+		std::array<VkClearRect, OMNI_SHADOWMAPS_COUNT> clearRects;
+		uint32_t numClearRects = 0;
+		for (uint32_t i = 0; i < job.numFaces; ++i)
+		{
+			const ShadowAtlas::Tile& tile = job.tiles[i];
+			if (tile.size == 0)
+				continue;
 
-		const auto& allInstances = scene->getObjectInstances();
-		const auto& indirectBatches = Renderer::Instance->getIndirectBatches();
+			clearRects[numClearRects++] = VkClearRect{
+				.rect{
+					.offset = {.x = (int32_t)tile.x, .y = (int32_t)tile.y},
+					.extent = {.width = tile.size, .height = tile.size},
+				},
+				.baseArrayLayer = 0,
+				.layerCount = 1,
+			};
+		}
+		vkCmdClearAttachments(cmdBuf, 1, &clearDepth, numClearRects, clearRects.data());
 
-		Push push{ .lightspaceID = (int)tid };
+		// cascades are orthographic, everything else keeps its depth
+		Push push{ .lightspaceID = (int)job.lightspaceId, .pancake = job.lightType == 0 ? 1 : 0 };
 		vkCmdPushConstants(cmdBuf, m_ShadowMapPassPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Push), &push);
 
-		//draw all instances in relation to a certain material:
-		uint32_t offsetIndex = 0;
-		VertexInput* previouslyBindedVertex = nullptr;
+		// this job's range of the draw lists, nothing else writes to it
+		const InstanceRegistry& registry = scene->getInstanceRegistry();
+		uint32_t* instances = (uint32_t*)workspace.ShadowInstances.data() + job.firstInstance;
+		VkDrawIndexedIndirectCommand* commands = (VkDrawIndexedIndirectCommand*)workspace.ShadowCommands.data() + job.firstCommand;
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
 
-		for (int workflowIndex = 0; workflowIndex < N_OPAQUE_MATERIALS; ++workflowIndex)
+		uint32_t numCasters = (uint32_t)job.casters.size();
+		for (uint32_t i = 0; i < numCasters; ++i)
+			instances[i] = (uint32_t)job.casters[i];
+
+		// one instanced command per run of one mesh, over every face it is seen in
+		VertexInput* previouslyBindedVertex = nullptr;
+		uint32_t commandIndex = 0;
+		uint32_t runStart = 0;
+		for (uint32_t i = 1; i <= numCasters; ++i)
 		{
-			const auto& workflowInstances = allInstances[workflowIndex];
-			if (workflowInstances.empty())
+			Mesh* mesh = registry[instances[runStart] & SHADOW_SLOT_MASK].mesh;
+			if (i < numCasters && registry[instances[i] & SHADOW_SLOT_MASK].mesh == mesh)
 				continue;
 
-			uint32_t instanceCount = (uint32_t)workflowInstances.size();
+			commands[commandIndex] = VkDrawIndexedIndirectCommand{
+				.indexCount = mesh->getIndexCount(),
+				.instanceCount = i - runStart,
+				.firstIndex = 0,
+				.vertexOffset = 0,
+				.firstInstance = job.firstInstance + runStart,
+			};
 
-			// draw each batch
-			for (const Renderer::IndirectBatch& draw : indirectBatches[workflowIndex])
-			{
-				VertexInput* vertexInputPtr = draw.mesh->getVertexInput();
-				if (vertexInputPtr != previouslyBindedVertex) {
-					vertexInputPtr->Bind(*workspace.secondaryCommandBuffers[tid].get());
-					previouslyBindedVertex = vertexInputPtr;
-				}
+			VertexInput* vertexInputPtr = mesh->getVertexInput();
+			if (vertexInputPtr != previouslyBindedVertex) {
+				vertexInputPtr->Bind(cmdBuf);
+				previouslyBindedVertex = vertexInputPtr;
+			}
 
-				draw.mesh->Bind(*workspace.secondaryCommandBuffers[tid].get());
+			mesh->Bind(cmdBuf);
 
-				constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
-				VkDeviceSize offset = (draw.firstInstanceIndex + offsetIndex) * stride;
+			vkCmdDrawIndexedIndirect(cmdBuf, workspace.ShadowCommands.getBuffer(), (job.firstCommand + commandIndex) * stride, 1, stride);
+			job.drawCalls++;
 
-				vkCmdDrawIndexedIndirect(cmdBuf, VulkanContext::Get()->getIndirectBuffer()->getBuffer(), offset, draw.count, stride);
-				Renderer::NumDrawCalls++;
-			}
-			offsetIndex += instanceCount;
+			commandIndex++;
+			runStart = i;
 		}
 	}
 	cmdBuf.End();
 }
 
-void ShadowPipeline::ShadowMap_CreateRenderPasses(uint32_t numPasses)
-{
-	// create frame buffers and image views for naive shadowpass (spotlights)
-	for (uint32_t i = 0; i < numPasses; ++i)
-	{
-		m_ShadowMapPasses[i].width = SHADOWMAP_DIM;
-		m_ShadowMapPasses[i].height = SHADOWMAP_DIM;
-
-		m_ShadowMapPasses[i].depthAttachment = std::make_unique<ImageDepth>(glm::uvec2{ SHADOWMAP_DIM, SHADOWMAP_DIM }, VK_FORMAT_D16_UNORM);
-
-		VkImageView view = m_ShadowMapPasses[i].depthAttachment->getView();
-
-		VkFramebufferCreateInfo create_info
-		{
-			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-			.renderPass = m_ShadowMapRenderPass,
-			.attachmentCount = 1,
-			.pAttachments = &view,
-			.width = m_ShadowMapPasses[i].width,
-			.height = m_ShadowMapPasses[i].height,
-			.layers = 1,
-		};
-
-		VulkanContext::VK(
-			vkCreateFramebuffer(VulkanContext::GetDevice(), &create_info, nullptr, &m_ShadowMapPasses[i].frameBuffer),
-			"[vulkan] Creating frame buffer failed"
-		);
-	}
-}
-
 void ShadowPipeline::CreateDescriptors()
 {
 	workspaces.resize(VulkanContext::Get()->getFramesInFlight());
@@ -504,7 +776,8 @@ void ShadowPipeline::CreateDescriptors()
 	for (Workspace& workspace : workspaces)
 	{
 		DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_Allocator)
-			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+			.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // lightspaces
+			.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // caster slots in draw order
 			.Build(workspace.set0_Lightspaces, set0_LightspacesLayout);
 	}
 }
@@ -542,109 +815,58 @@ void ShadowPipeline::CreateGraphicsPipeline()
 		VK_DYNAMIC_STATE_VERTEX_INPUT_EXT
 	};
 
+	// only the one pass point light variant writes gl_ViewportIndex
+	const char* vertexShader = m_NumViewports > 1 ? "../spv/shaders/shadow/shadowmapping_omni.vert.spv" : "../spv/shaders/shadow/shadowmapping.vert.spv";
+
 	VulkanGraphicsPipelineBuilder::Start()
 		.SetDynamicStates(dynamic_states)
 		.SetInputAssembly(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
 		.SetRasterization(VK_POLYGON_MODE_FILL, VK_CULL_MODE_FRONT_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE)
-		.Build("../spv/shaders/shadow/shadowmapping.vert.spv", "../spv/shaders/shadow/shadowmapping.frag.spv", &m_ShadowMapPipeline, m_ShadowMapPassPipelineLayout, m_ShadowMapRenderPass);
+		.SetViewport(m_NumViewports, m_NumViewports)
+		.Build(vertexShader, "../spv/shaders/shadow/shadowmapping.frag.spv", &m_ShadowMapPipeline, m_ShadowMapPassPipelineLayout, m_ShadowMapRenderPass);
 }
 
-void ShadowPipeline::SetViewports(const CommandBuffer& commandBuffer, uint32_t width, uint32_t height)
+void ShadowPipeline::SetViewports(const CommandBuffer& commandBuffer, const ShadowJob& job)
 {
-	VkRect2D scissor{
-		.offset = {.x = 0, .y = 0},
-		.extent = {.width = width, .height = height},
-	};
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-	VkViewport viewport{
-		.x = 0.0f,
-		.y = 0.0f,
-		.width = float(width),
-		.height = float(height),
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f,
-	};
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	// viewports past the job's faces, or of faces that got no tile, draw nothing but still have to be valid
+	auto hasTile = [](const ShadowAtlas::Tile& tile) { return tile.size > 0; };
+	const ShadowAtlas::Tile& fallback = *std::find_if(job.tiles.begin(), job.tiles.begin() + job.numFaces, hasTile);
+
+	std::array<VkRect2D, OMNI_SHADOWMAPS_COUNT> scissors;
+	std::array<VkViewport, OMNI_SHADOWMAPS_COUNT> viewports;
+	for (uint32_t i = 0; i < m_NumViewports; ++i)
+	{
+		const ShadowAtlas::Tile& tile = i < job.numFaces && job.tiles[i].size > 0 ? job.tiles[i] : fallback;
+
+		scissors[i] = VkRect2D{
+			.offset = {.x = (int32_t)tile.x, .y = (int32_t)tile.y},
+			.extent = {.width = tile.size, .height = tile.size},
+		};
+
+		viewports[i] = VkViewport{
+			.x = float(tile.x),
+			.y = float(tile.y),
+			.width = float(tile.size),
+			.height = float(tile.size),
+			.minDepth = 0.0f,
+			.maxDepth = 1.0f,
+		};
+	}
+	vkCmdSetScissor(commandBuffer, 0, m_NumViewports, scissors.data());
+	vkCmdSetViewport(commandBuffer, 0, m_NumViewports, viewports.data());
 }
 
-void ShadowPipeline::BeginRenderPass(const CommandBuffer& commandBuffer, VkFramebuffer frameBuffer, uint32_t width, uint32_t height)
+void ShadowPipeline::BeginRenderPass(const CommandBuffer& commandBuffer)
 {
 	VkRenderPassBeginInfo begin_info{
 		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
 		.renderPass = m_ShadowMapRenderPass,
-		.framebuffer = frameBuffer,
+		.framebuffer = m_AtlasFrameBuffer,
 		.renderArea{
 			.offset = {.x = 0, .y = 0},
-			.extent = {.width = width, .height = height},
+			.extent = {.width = m_AtlasAllocator.getDim(), .height = m_AtlasAllocator.getDim()},
 		},
-		.clearValueCount = 1,
-		.pClearValues = clear_values.data(),
 	};
 
 	vkCmdBeginRenderPass(commandBuffer, &begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 }
-
-void ShadowPipeline::Cascade_CreateRenderPasses(uint32_t numPasses)
-{
-	// create cascade passes
-	for (uint32_t i = 0; i < numPasses; ++i)
-	{
-		m_CascadePasses[i].width = CASCADED_SHADOWMAP_DIM;
-		m_CascadePasses[i].height = CASCADED_SHADOWMAP_DIM;
-
-		for (uint32_t cascadeIndex = 0; cascadeIndex < SHADOW_MAP_CASCADE_COUNT; cascadeIndex++) 
-		{
-
-			m_CascadePasses[i].cascades[cascadeIndex].depthAttachment = std::make_unique<ImageDepth>(glm::uvec2{ CASCADED_SHADOWMAP_DIM, CASCADED_SHADOWMAP_DIM }, VK_FORMAT_D16_UNORM);
-			VkImageView view = m_CascadePasses[i].cascades[cascadeIndex].depthAttachment->getView();
-
-			VkFramebufferCreateInfo create_info
-			{
-				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-				.renderPass = m_ShadowMapRenderPass,
-				.attachmentCount = 1,
-				.pAttachments = &view,
-				.width = m_CascadePasses[i].width,
-				.height = m_CascadePasses[i].height,
-				.layers = 1,
-			};
-
-			VulkanContext::VK(
-				vkCreateFramebuffer(VulkanContext::GetDevice(), &create_info, nullptr, &m_CascadePasses[i].cascades[cascadeIndex].frameBuffer),
-				"[vulkan] Creating frame buffer failed"
-			);
-		}
-	}
-}
-
-void ShadowPipeline::Omni_CreateRenderPasses(uint32_t numPasses)
-{
-	// create cascade passes
-	for (uint32_t i = 0; i < numPasses; ++i)
-	{
-		m_OmniPasses[i].width = SHADOWMAP_DIM;
-		m_OmniPasses[i].height = SHADOWMAP_DIM;
-		for (uint32_t faceIndex = 0; faceIndex < OMNI_SHADOWMAPS_COUNT; faceIndex++) {
-
-			m_OmniPasses[i].cubefaces[faceIndex].depthAttachment = std::make_unique<ImageDepth>(glm::uvec2{ SHADOWMAP_DIM, SHADOWMAP_DIM }, VK_FORMAT_D16_UNORM);
-			VkImageView view = m_OmniPasses[i].cubefaces[faceIndex].depthAttachment->getView();
-
-			VkFramebufferCreateInfo create_info
-			{
-				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-				.renderPass = m_ShadowMapRenderPass,
-				.attachmentCount = 1,
-				.pAttachments = &view,
-				.width = m_OmniPasses[i].width,
-				.height = m_OmniPasses[i].height,
-				.layers = 1,
-			};
-
-			VulkanContext::VK(
-				vkCreateFramebuffer(VulkanContext::GetDevice(), &create_info, nullptr, &m_OmniPasses[i].cubefaces[faceIndex].frameBuffer),
-				"[vulkan] Creating frame buffer failed"
-			);
-		}
-	}
-}
\ No newline at end of file
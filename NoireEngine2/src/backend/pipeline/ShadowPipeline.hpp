@@ -2,14 +2,17 @@
 
 #include "VulkanPipeline.hpp"
 #include "math/Math.hpp"
-#include "utils/ThreadPool.hpp"
+#include "core/jobs/JobSystem.hpp"
+#include "renderer/Frustum.hpp"
 #include <array>
 
 #include "backend/images/ImageDepth.hpp"
 #include "backend/buffers/Buffer.hpp"
 #include "backend/descriptor/DescriptorBuilder.hpp"
+#include "renderer/lighting/ShadowAtlas.hpp"
 
 class Renderer;
+class Light;
 
 #define SHADOW_MAP_CASCADE_COUNT 4
 #define OMNI_SHADOWMAPS_COUNT 6
@@ -19,11 +22,13 @@ class ShadowPipeline : public VulkanPipeline
 public:
 	~ShadowPipeline();
 
-	// creates as many render passes as there are shadow casters in the scene
+	// creates the shadow atlas and the render pass every shadow map is drawn in
 	void CreateRenderPass() override;
 
 	void Rebuild() override;
 
+	void CreatePipelineLayouts() override;
+
 	void CreatePipeline() override;
 
 	void Prepare(const Scene* scene, const CommandBuffer& commandBuffer);
@@ -31,99 +36,129 @@ public:
 	// run a series of render passes on each shadow caster
 	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
 
-	// naive shadowmap pass, used for spotlights
-	struct ShadowMapPass 
-	{
-		uint32_t width, height;
-		VkFramebuffer frameBuffer;
-		std::unique_ptr<ImageDepth> depthAttachment;
-	};
-	const std::vector<ShadowMapPass>& getShadowPasses() const { return m_ShadowMapPasses; }
-
-	// Contains all resources required for a single shadow map cascade
-	struct Cascade
-	{
-		VkFramebuffer frameBuffer;
-		std::unique_ptr<ImageDepth> depthAttachment;
-	};
-
-	// a cascade pass has multiple cascades
-	struct CascadePass
-	{
-		uint32_t width, height;
-		std::array<Cascade, SHADOW_MAP_CASCADE_COUNT> cascades;
-	};
-	const std::vector<CascadePass>& getCascadePasses() const { return m_CascadePasses; }
-	
-	// omni-directional shadowmap passes for point lights
-	struct OmniCubeface
-	{
-		VkFramebuffer frameBuffer;
-		std::unique_ptr<ImageDepth> depthAttachment;
-	};
+	void OnUIRender();
 
-	// a cascade pass has multiple cascades
-	struct OmniPass
-	{
-		uint32_t width, height;
-		std::array<OmniCubeface, OMNI_SHADOWMAPS_COUNT> cubefaces;
-	};
-	const std::vector<OmniPass>& getOmniPasses() const { return m_OmniPasses; }
+	// every shadow map is a tile of this atlas, the lit passes find them through the shadow rects
+	const ImageDepth* getAtlas() const { return m_Atlas.get(); }
 
 	// to be used in gizmos UI
 	static inline uint32_t PCFSamples = 32;
 	static inline uint32_t PCSSOccluderSamples = 8;
 
+	// only re-render shadow maps whose lightspace or casters changed
+	static inline bool CacheShadowMaps = true;
+
 private:
+	// lightspaces culled and recorded together on the job system: a cascade, a spot light, or all faces of a point light
+	struct ShadowJob
+	{
+		Light* light;
+		uint32_t lightspaceId, lightType; // lightspaceId: of the first face, faces and their tiles follow it
+		uint32_t face; // which of its light's lightspaces comes first
+		uint32_t numFaces;
+		uint32_t mapIndex; // where the lit passes look for the first face's rect: directional, then point, then spot lights
+		std::array<ShadowAtlas::Tile, OMNI_SHADOWMAPS_COUNT> tiles; // size 0 if it did not fit in the atlas, nothing is drawn then
+
+		// what the faces can see: their frustum planes in planeMask, and for point and spot lights, the limit sphere
+		glm::mat4 lightspace; // of the first face, point light faces all move with it
+		std::array<Frustum, OMNI_SHADOWMAPS_COUNT> frustums;
+		uint32_t planeMask;
+		glm::vec4 sphere; // w: radius, 0 if not tested
+
+		// written by the cull, sorted so each run of one mesh is a single instanced command over every face
+		std::vector<uint64_t> casters; // mesh in the high bits, face and instance slot in the low 32, once per face it is seen in
+		uint32_t numCommands = 0;
+		uint32_t nodesVisited = 0;
+		bool dirty = true; // false if its shadow map still holds this frame's depth
+
+		// assigned on the main thread once every lightspace is culled
+		uint32_t firstInstance = 0, firstCommand = 0;
+
+		// written by the recording
+		CommandBuffer* recorded = nullptr;
+		uint32_t drawCalls = 0;
+	};
+
 	// Global pipeline variables ////////////////////////////////////////////
 	struct Workspace
 	{
 		Buffer LightSpaces_Src;
 		Buffer LightSpaces;
 
+		// every lightspace's draw list, back to back
+		Buffer ShadowInstances; // instance slot per drawn caster; host coherent, mapped
+		Buffer ShadowCommands; // host coherent, mapped
+
+		Buffer ShadowRects; // atlas rect of every shadow map, by map index; host coherent, mapped
+
 		VkDescriptorSet set0_Lightspaces;
 
 		// Multi-threading ////////////////////////////////////////////
-		std::unique_ptr<ThreadPool> threadPool;
-		std::vector<std::unique_ptr<CommandBuffer>> secondaryCommandBuffers;
+		std::vector<ShadowJob> shadowJobs; // one per cascade, spot light and point light, refilled every frame
+
+		// command pools are per thread, so every job thread owns its own secondary command buffers
+		std::vector<std::vector<std::unique_ptr<CommandBuffer>>> threadCommandBuffers;
+		std::vector<uint32_t> threadCommandBufferCursors;
 	};
 
 	std::vector<Workspace> workspaces;
 
+	// what each job's shadow maps were last rendered with. The maps are shared by every workspace,
+	// so this is indexed by the job's first lightspace, not by workspace
+	struct CachedLightspace
+	{
+		glm::mat4 lightspace;
+		std::vector<uint64_t> casters;
+		bool valid = false;
+	};
+	std::vector<CachedLightspace> m_Cache;
+	std::vector<uint8_t> m_ChangedSlots; // instance slots moved or edited this frame
+	bool m_SceneChanged = true; // whether any instance moved, changed, or was added or removed this frame
+	uint32_t m_RegistryVersion = ~0u;
+
 	VkDescriptorSetLayout set0_LightspacesLayout;
 	DescriptorAllocator m_Allocator;
 
 	void CreateDescriptors();
 	void CreatePipelineLayout();
 	void CreateGraphicsPipeline();
-	void SetViewports(const CommandBuffer& commandBuffer, uint32_t width, uint32_t height);
-	void BeginRenderPass(const CommandBuffer& commandBuffer, VkFramebuffer frameBuffer, uint32_t width, uint32_t height);
+	void SetViewports(const CommandBuffer& commandBuffer, const ShadowJob& job);
+	void BeginRenderPass(const CommandBuffer& commandBuffer);
 
 	VkPipelineLayout	m_ShadowMapPassPipelineLayout = VK_NULL_HANDLE;
 	VkRenderPass		m_ShadowMapRenderPass = VK_NULL_HANDLE;
 	VkPipeline			m_ShadowMapPipeline = VK_NULL_HANDLE;
 
+	// one viewport per point light face, so a caster is drawn once for all the faces it is seen in.
+	// without multiViewport or VK_EXT_shader_viewport_index_layer, each face is a job of its own
+	uint32_t m_NumViewports = 1;
+
 	struct Push 
 	{
 		int lightspaceID;
+		int pancake;
 	};
 
 	// Multi-threading ////////////////////////////////////////////
-	void PrepareShadowRenderThreads();
-	void T_RenderShadows(uint32_t tid, VkCommandBufferInheritanceInfo inheritanceInfo, const Scene* scene, uint32_t lightType, uint32_t width, uint32_t height);
-
-	// Shadow Mapping Naive ////////////////////////////////////////////
-	std::vector<ShadowMapPass> m_ShadowMapPasses;
-	void ShadowMap_CreateRenderPasses(uint32_t numPasses);
-
-	// Shadow cascading ////////////////////////////////////////////
-	// cascades will push SHADOW_MAP_CASCADE_COUNT lightspace matrices into the lightspace buffer, instead of 1
-	std::vector<CascadePass> m_CascadePasses;
-	void Cascade_CreateRenderPasses(uint32_t numPasses);
-
-	// Omni-directional point light shadowmapping ////////////////////////////////////////////
-	// pushes 6 faces in a single pass
-	std::vector<OmniPass> m_OmniPasses;
-	void Omni_CreateRenderPasses(uint32_t numPasses);
+	void PrepareShadowJobs();
+	void T_CullShadowCasters(ShadowJob& job, const Scene* scene);
+	void T_RenderShadows(ShadowJob& job, const Scene* scene);
+
+	// Shadow atlas ////////////////////////////////////////////
+	// one depth image for every shadow map, so its memory stays the same however many lights cast shadows.
+	// tiles are sized each frame by how much of the screen their light can cover
+	std::unique_ptr<ImageDepth> m_Atlas;
+	VkFramebuffer m_AtlasFrameBuffer = VK_NULL_HANDLE;
+	ShadowAtlas m_AtlasAllocator;
+	std::vector<float> m_TileWanted, m_TileImportance; // per lightspace, refilled every frame
+	std::vector<VkCommandBuffer> m_Executes;
+
+	// statistics of the last frame
+	uint32_t m_NumLightspaces = 0;
+	uint32_t m_NumLightspacesRendered = 0;
+	uint32_t m_NumJobsRendered = 0; // a secondary command buffer each
+	uint32_t m_NumCastersDrawn = 0;
+	uint32_t m_NumCastersUnculled = 0; // opaque instances times lightspaces, what was drawn before the casters were culled
+	uint32_t m_NumNodesVisited = 0;
 };
 
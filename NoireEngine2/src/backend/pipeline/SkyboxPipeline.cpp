@@ -80,12 +80,16 @@ SkyboxPipeline::~SkyboxPipeline()
 	}
 }
 
-void SkyboxPipeline::CreatePipeline()
+void SkyboxPipeline::CreatePipelineLayouts()
 {
 	workspaces.resize(VulkanContext::Get()->getFramesInFlight());
 	CreateDescriptors();
 	CreateVertexBuffer();
 	CreatePipelineLayout();
+}
+
+void SkyboxPipeline::CreatePipeline()
+{
 	CreateGraphicsPipeline();
 }
 
@@ -222,5 +226,5 @@ void SkyboxPipeline::CreateVertexBuffer()
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
 	);
 
-	Buffer::TransferToBufferIdle(skyboxVertices, SKYBOX_SIZE_BYTES, m_VertexBuffer.getBuffer());
+	VulkanContext::Get()->getStagingRing()->Upload(skyboxVertices, SKYBOX_SIZE_BYTES, m_VertexBuffer.getBuffer());
 }
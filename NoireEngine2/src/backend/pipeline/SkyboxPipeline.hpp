@@ -12,6 +12,8 @@ class SkyboxPipeline : public VulkanPipeline
 {
 public:
 	~SkyboxPipeline();
+	void CreatePipelineLayouts() override;
+
 	void CreatePipeline() override;
 
 	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
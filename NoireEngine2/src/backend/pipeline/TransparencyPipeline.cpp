@@ -29,10 +29,33 @@ TransparencyPipeline::~TransparencyPipeline()
 	}
 }
 
+void TransparencyPipeline::CreatePipelineLayouts()
+{
+	// Push constant: we want to be able to update constants used by the shaders
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
+									 0, sizeof(PushConstantRay) };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstant;
+
+	std::array< VkDescriptorSetLayout, 6 > layouts{
+		Renderer::Instance->set0_WorldLayout,
+		Renderer::Instance->set1_StorageBuffersLayout,
+		Renderer::Instance->set2_TexturesLayout,
+		Renderer::Instance->set3_IBLLayout,
+		Renderer::Instance->set4_ShadowMapLayout,
+		Renderer::Instance->set5_RayTracingLayout
+	};
+
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
+	VulkanContext::VK(vkCreatePipelineLayout(VulkanContext::GetDevice(), &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout));
+}
+
 void TransparencyPipeline::CreatePipeline()
 {
 	CreateRayTracingPipeline();
-	CreateShaderBindingTables();
 }
 
 void TransparencyPipeline::Render(const Scene* scene, const CommandBuffer& commandBuffer)
@@ -159,28 +182,6 @@ void TransparencyPipeline::CreateRayTracingPipeline()
 		m_RTShaderGroups.push_back(group);
 	}
 
-	// Push constant: we want to be able to update constants used by the shaders
-	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR,
-									 0, sizeof(PushConstantRay) };
-
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
-	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstant;
-
-	std::array< VkDescriptorSetLayout, 6 > layouts{
-		Renderer::Instance->set0_WorldLayout,
-		Renderer::Instance->set1_StorageBuffersLayout,
-		Renderer::Instance->set2_TexturesLayout,
-		Renderer::Instance->set3_IBLLayout,
-		Renderer::Instance->set4_ShadowMapLayout,
-		Renderer::Instance->set5_RayTracingLayout
-	};
-
-	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(layouts.size());
-	pipelineLayoutCreateInfo.pSetLayouts = layouts.data();
-	vkCreatePipelineLayout(VulkanContext::GetDevice(), &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout);
-
-
 	// Assemble the shader stages and recursion depth info into the ray tracing pipeline
 	VkRayTracingPipelineCreateInfoKHR rayPipelineInfo{ VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR };
 	rayPipelineInfo.stageCount = static_cast<uint32_t>(stages.size());  // Stages are shaders
@@ -192,7 +193,7 @@ void TransparencyPipeline::CreateRayTracingPipeline()
 	rayPipelineInfo.maxPipelineRayRecursionDepth = 10;  // Ray depth
 	rayPipelineInfo.layout = m_PipelineLayout;
 
-	RaytracingContext::vkCreateRayTracingPipelinesKHR(VulkanContext::GetDevice(), {}, {}, 1, &rayPipelineInfo, nullptr, &m_Pipeline);
+	RaytracingContext::vkCreateRayTracingPipelinesKHR(VulkanContext::GetDevice(), {}, VulkanContext::Get()->getPipelineCache(), 1, &rayPipelineInfo, nullptr, &m_Pipeline);
 
 	NE_DEBUG("Built rtx pipeline", Logger::CYAN, Logger::BOLD);
 }
@@ -14,8 +14,13 @@ class TransparencyPipeline : public VulkanPipeline
 public:
 	~TransparencyPipeline();
 
+	void CreatePipelineLayouts() override;
+
 	void CreatePipeline() override;
 
+	// allocates and fills the SBT, on the main thread once CreatePipeline has finished
+	void CreateShaderBindingTables();
+
 	void Render(const Scene* scene, const CommandBuffer& commandBuffer) override;
 
 	void Prepare(const Scene* scene, const CommandBuffer& commandBuffer);
@@ -44,7 +49,6 @@ private:
 
 private:
 	void CreateRayTracingPipeline();
-	void CreateShaderBindingTables();
 
 	std::vector<VkAccelerationStructureInstanceKHR> m_TlasBuildStructs;
 };
\ No newline at end of file
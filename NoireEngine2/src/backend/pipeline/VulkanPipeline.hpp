@@ -20,6 +20,11 @@ public:
 
 	virtual void Rebuild() {}
 
+	// descriptors, buffers and pipeline layouts. Always called on the main thread, before CreatePipeline,
+	// since the descriptor allocator, layout cache and staging ring are not thread safe
+	virtual void CreatePipelineLayouts() {}
+
+	// compiles the pipelines against the layouts made above, may run on a worker thread
 	virtual void CreatePipeline() {}
 	
 	virtual void Update(const Scene* scene) {}
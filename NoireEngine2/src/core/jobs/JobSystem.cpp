@@ -0,0 +1,180 @@
+#include "JobSystem.hpp"
+
+#include "utils/Logger.hpp"
+
+#include <cassert>
+
+static thread_local uint32_t s_ThreadIndex = 0;
+
+bool JobQueue::Push(Job* job)
+{
+	int64_t b = m_Bottom.load(std::memory_order_relaxed);
+	int64_t t = m_Top.load(std::memory_order_acquire);
+	if (b - t >= NE_JOB_QUEUE_CAPACITY)
+		return false;
+
+	m_Jobs[b & MASK].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Bottom.store(b + 1, std::memory_order_relaxed);
+	return true;
+}
+
+Job* JobQueue::Pop()
+{
+	int64_t b = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = m_Top.load(std::memory_order_relaxed);
+
+	if (t > b)
+	{
+		// empty
+		m_Bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[b & MASK].load(std::memory_order_relaxed);
+	if (t == b)
+	{
+		// last job, race against stealers
+		if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_Bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* JobQueue::Steal()
+{
+	int64_t t = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = m_Bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	Job* job = m_Jobs[t & MASK].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+	return job;
+}
+
+JobSystem::JobSystem()
+{
+	uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	uint32_t workerCount = hardwareThreads - 1;
+
+	m_PerThread.resize(workerCount + 1);
+	for (auto& perThread : m_PerThread)
+	{
+		perThread = std::make_unique<PerThread>();
+		perThread->jobs = std::make_unique<Job[]>(NE_JOB_QUEUE_CAPACITY);
+	}
+
+	s_ThreadIndex = 0;
+	m_Threads.reserve(workerCount);
+	for (uint32_t i = 1; i <= workerCount; ++i)
+		m_Threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+
+	NE_INFO("Job system started with {} worker threads.", workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	m_Running.store(false, std::memory_order_release);
+	m_PendingJobs.fetch_add(1, std::memory_order_release);
+	m_PendingJobs.notify_all();
+
+	for (auto& thread : m_Threads)
+	{
+		if (thread.joinable())
+			thread.join();
+	}
+}
+
+uint32_t JobSystem::GetThreadIndex()
+{
+	return s_ThreadIndex;
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	uint32_t threadIndex = GetThreadIndex();
+	while (counter.IsBusy())
+	{
+		if (!RunPendingJob(threadIndex))
+			std::this_thread::yield();
+	}
+}
+
+Job* JobSystem::AllocateJob()
+{
+	PerThread& perThread = *m_PerThread[GetThreadIndex()];
+	Job* job = &perThread.jobs[perThread.nextJob++ & (NE_JOB_QUEUE_CAPACITY - 1)];
+
+	// the ring wrapped around onto a job still in flight, help out until it's done
+	while (!job->finished.load(std::memory_order_acquire))
+	{
+		if (!RunPendingJob(GetThreadIndex()))
+			std::this_thread::yield();
+	}
+
+	return job;
+}
+
+void JobSystem::Submit(JobCounter& counter, Job* job, uint32_t begin, uint32_t end)
+{
+	job->counter = &counter;
+	job->begin = begin;
+	job->end = end;
+	job->finished.store(false, std::memory_order_relaxed);
+
+	counter.value.fetch_add(1, std::memory_order_relaxed);
+	m_PendingJobs.fetch_add(1, std::memory_order_release);
+
+	// a thread never has more jobs in flight than its ring holds, so this can't fail
+	bool pushed = m_PerThread[GetThreadIndex()]->queue.Push(job);
+	assert(pushed);
+	(void)pushed;
+
+	m_PendingJobs.notify_one();
+}
+
+bool JobSystem::RunPendingJob(uint32_t threadIndex)
+{
+	Job* job = m_PerThread[threadIndex]->queue.Pop();
+
+	for (size_t i = 1; job == nullptr && i < m_PerThread.size(); ++i)
+	{
+		size_t victim = (threadIndex + i) % m_PerThread.size();
+		job = m_PerThread[victim]->queue.Steal();
+	}
+
+	if (!job)
+		return false;
+
+	m_PendingJobs.fetch_sub(1, std::memory_order_relaxed);
+	Run(job);
+	return true;
+}
+
+void JobSystem::Run(Job* job)
+{
+	job->invoke(job->storage, job->begin, job->end);
+
+	// the counter may live on the waiting thread's stack, don't touch it after the decrement
+	JobCounter* counter = job->counter;
+	job->finished.store(true, std::memory_order_release);
+	counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::WorkerLoop(uint32_t threadIndex)
+{
+	s_ThreadIndex = threadIndex;
+
+	while (m_Running.load(std::memory_order_acquire))
+	{
+		if (!RunPendingJob(threadIndex))
+			m_PendingJobs.wait(0, std::memory_order_acquire);
+	}
+}
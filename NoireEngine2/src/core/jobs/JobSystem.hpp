@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include <new>
+
+#include "core/resources/Module.hpp"
+
+#define NE_JOB_STORAGE_SIZE 64
+#define NE_JOB_QUEUE_CAPACITY 4096 // must be a power of two
+
+/**
+ * Counts the number of unfinished jobs of a submission. Every Execute/Dispatch increments it
+ * by the number of jobs it spawns, and each job decrements it once it is done.
+ * Use JobSystem::Wait(counter) as a fence instead of joining threads.
+ */
+struct JobCounter
+{
+	std::atomic<uint32_t> value{ 0 };
+
+	inline bool IsBusy() const { return value.load(std::memory_order_acquire) > 0; }
+};
+
+/**
+ * A single unit of work. The callable is copied into a fixed small buffer, so no job ever
+ * allocates on the heap. Callables larger than NE_JOB_STORAGE_SIZE are rejected at compile time.
+ */
+struct alignas(64) Job
+{
+	using InvokeFn = void(*)(const void* storage, uint32_t begin, uint32_t end);
+
+	InvokeFn					invoke = nullptr;
+	JobCounter*					counter = nullptr;
+	uint32_t					begin = 0, end = 0; // [begin, end) index range for dispatched jobs
+	std::atomic<bool>			finished{ true };
+	alignas(16) std::byte		storage[NE_JOB_STORAGE_SIZE];
+};
+
+/**
+ * Fixed-size Chase-Lev work-stealing deque. The owning thread pushes and pops at the bottom,
+ * any other thread steals from the top. No locks are taken on either path.
+ */
+class JobQueue
+{
+public:
+	// owner only. Returns false if the queue is full
+	bool Push(Job* job);
+
+	// owner only
+	Job* Pop();
+
+	// any thread
+	Job* Steal();
+
+	inline bool Empty() const { return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr int64_t MASK = NE_JOB_QUEUE_CAPACITY - 1;
+
+	alignas(64) std::atomic<int64_t>	m_Top{ 0 };
+	alignas(64) std::atomic<int64_t>	m_Bottom{ 0 };
+	alignas(64) std::atomic<Job*>		m_Jobs[NE_JOB_QUEUE_CAPACITY];
+};
+
+/**
+ * Engine-wide job system. Spawns (hardware threads - 1) workers once, and lets the main thread
+ * join in while it waits. Each thread owns a work-stealing queue and a ring of preallocated jobs.
+ *
+ * Usage:
+ *		JobCounter counter;
+ *		JobSystem::Get()->Dispatch(counter, count, 1, [=](uint32_t i) { ... });
+ *		JobSystem::Get()->Wait(counter);
+ */
+class JobSystem : public Module::Registrar<JobSystem>
+{
+	inline static const bool Registered = Register(UpdateStage::Never, DestroyStage::Post);
+
+public:
+	JobSystem();
+
+	virtual ~JobSystem();
+
+	// runs fn() once on any thread
+	template<typename F>
+	void Execute(JobCounter& counter, F&& fn)
+	{
+		Job* job = AllocateJob();
+		StoreCallable(job, [fn](uint32_t, uint32_t) { fn(); });
+		Submit(counter, job, 0, 1);
+	}
+
+	// runs fn(i) for every i in [0, count), splitting the range into jobs of groupSize indices
+	template<typename F>
+	void Dispatch(JobCounter& counter, uint32_t count, uint32_t groupSize, F&& fn)
+	{
+		if (count == 0)
+			return;
+
+		groupSize = groupSize == 0 ? 1 : groupSize;
+		for (uint32_t begin = 0; begin < count; begin += groupSize)
+		{
+			Job* job = AllocateJob();
+			StoreCallable(job, [fn](uint32_t b, uint32_t e) {
+				for (uint32_t i = b; i < e; ++i)
+					fn(i);
+			});
+			Submit(counter, job, begin, std::min(begin + groupSize, count));
+		}
+	}
+
+	// blocks until the counter reaches zero, executing pending jobs in the meantime
+	void Wait(const JobCounter& counter);
+
+	// number of threads that can execute jobs, including the main thread
+	inline uint32_t getThreadCount() const { return (uint32_t)m_Threads.size() + 1; }
+
+	// 0 for the main thread, [1, getThreadCount()) for workers
+	static uint32_t GetThreadIndex();
+
+private:
+	template<typename F>
+	static void StoreCallable(Job* job, F&& fn)
+	{
+		using TCallable = std::decay_t<F>;
+		static_assert(sizeof(TCallable) <= NE_JOB_STORAGE_SIZE, "Job callable is too large, capture less or capture by pointer.");
+		static_assert(alignof(TCallable) <= 16, "Job callable is over-aligned.");
+		static_assert(std::is_trivially_destructible_v<TCallable>, "Job callables must be trivially destructible.");
+
+		new (job->storage) TCallable(std::forward<F>(fn));
+		job->invoke = [](const void* storage, uint32_t begin, uint32_t end) {
+			(*static_cast<const TCallable*>(storage))(begin, end);
+		};
+	}
+
+	Job* AllocateJob();
+	void Submit(JobCounter& counter, Job* job, uint32_t begin, uint32_t end);
+
+	// finds one job from the own queue or steals one, and runs it. Returns false if no job is found
+	bool RunPendingJob(uint32_t threadIndex);
+	void Run(Job* job);
+
+	void WorkerLoop(uint32_t threadIndex);
+
+	struct PerThread
+	{
+		JobQueue						queue;
+		std::unique_ptr<Job[]>			jobs;
+		uint32_t						nextJob = 0;
+	};
+
+	std::vector<std::unique_ptr<PerThread>>		m_PerThread; // index 0 is the main thread
+	std::vector<std::thread>					m_Threads;
+
+	std::atomic<bool>							m_Running{ true };
+	std::atomic<uint32_t>						m_PendingJobs{ 0 }; // idle workers sleep on this
+};
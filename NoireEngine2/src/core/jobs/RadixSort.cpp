@@ -0,0 +1,98 @@
+#include "RadixSort.hpp"
+
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+	// runs fn(chunk) for every chunk, on the calling thread if there is only one
+	template<typename F>
+	void ForEachChunk(uint32_t numChunks, F&& fn)
+	{
+		if (numChunks == 1)
+		{
+			fn(0);
+			return;
+		}
+
+		JobCounter counter;
+		JobSystem::Get()->Dispatch(counter, numChunks, 1, fn);
+		JobSystem::Get()->Wait(counter);
+	}
+}
+
+void RadixSorter::Sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values)
+{
+	assert(keys.size() == values.size());
+	m_NumPasses = 0;
+
+	uint32_t count = (uint32_t)keys.size();
+	if (count < 2)
+		return;
+
+	// bits that are not the same in every key, bytes without any of them need no pass
+	uint64_t differing = 0;
+	for (uint64_t key : keys)
+		differing |= key ^ keys[0];
+
+	if (differing == 0)
+		return;
+
+	m_KeysScratch.resize(count);
+	m_ValuesScratch.resize(count);
+
+	uint32_t numChunks = (count + SORT_CHUNK - 1) / SORT_CHUNK;
+	m_ChunkHistograms.resize(numChunks);
+
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		if (((differing >> shift) & 0xFF) == 0)
+			continue;
+
+		const uint64_t* srcKeys = keys.data();
+		const uint32_t* srcValues = values.data();
+		uint64_t* dstKeys = m_KeysScratch.data();
+		uint32_t* dstValues = m_ValuesScratch.data();
+		Histogram* histograms = m_ChunkHistograms.data();
+
+		// count each chunk's digits
+		ForEachChunk(numChunks, [=](uint32_t chunk) {
+			Histogram& histogram = histograms[chunk];
+			histogram.fill(0);
+
+			uint32_t end = std::min((chunk + 1) * SORT_CHUNK, count);
+			for (uint32_t i = chunk * SORT_CHUNK; i < end; ++i)
+				histogram[(srcKeys[i] >> shift) & 0xFF]++;
+		});
+
+		// where each chunk starts writing each digit: after all smaller digits, and after earlier chunks' equal digits
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < 256; ++digit)
+		{
+			for (uint32_t chunk = 0; chunk < numChunks; ++chunk)
+			{
+				uint32_t digitCount = histograms[chunk][digit];
+				histograms[chunk][digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		// scatter in order, which keeps the sort stable
+		ForEachChunk(numChunks, [=](uint32_t chunk) {
+			Histogram& offsets = histograms[chunk];
+
+			uint32_t end = std::min((chunk + 1) * SORT_CHUNK, count);
+			for (uint32_t i = chunk * SORT_CHUNK; i < end; ++i)
+			{
+				uint32_t dst = offsets[(srcKeys[i] >> shift) & 0xFF]++;
+				dstKeys[dst] = srcKeys[i];
+				dstValues[dst] = srcValues[i];
+			}
+		});
+
+		keys.swap(m_KeysScratch);
+		values.swap(m_ValuesScratch);
+		m_NumPasses++;
+	}
+}
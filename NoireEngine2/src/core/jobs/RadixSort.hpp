@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+/**
+ * Stable LSD radix sort of 64 bit keys carrying a 32 bit value, one byte per pass.
+ * Passes over a byte that is the same in every key are skipped, so keys that only use a few bits
+ * are cheap. Inputs above one chunk are histogrammed and scattered on the job system, chunk by chunk.
+ * Keeps its scratch buffers between calls, sort into the same instance every frame.
+ */
+class RadixSorter
+{
+public:
+	static constexpr uint32_t SORT_CHUNK = 16384; // keys per job
+
+	// sorts keys ascending and reorders values along with them
+	void Sort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values);
+
+	// number of byte passes the last sort needed
+	inline uint32_t getNumPasses() const { return m_NumPasses; }
+
+private:
+	using Histogram = std::array<uint32_t, 256>;
+
+	std::vector<uint64_t>	m_KeysScratch;
+	std::vector<uint32_t>	m_ValuesScratch;
+	std::vector<Histogram>	m_ChunkHistograms; // per chunk, of the current pass, turned into scatter offsets in place
+	uint32_t				m_NumPasses = 0;
+};
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <filesystem>
 #include <cassert>
+#include <cstdlib>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -98,3 +99,32 @@ bool Files::Exists(const std::string& path)
 {
 	return std::filesystem::exists(path);
 }
+
+
+std::filesystem::path Files::CacheDirectory()
+{
+	std::filesystem::path base;
+#if defined(_WIN32)
+	PWSTR localAppData = nullptr;
+	if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData)))
+		base = localAppData;
+	CoTaskMemFree(localAppData);
+#elif defined(__APPLE__)
+	if (const char* home = std::getenv("HOME"))
+		base = std::filesystem::path(home) / "Library" / "Caches";
+#else
+	if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+		base = xdg;
+	else if (const char* home = std::getenv("HOME"))
+		base = std::filesystem::path(home) / ".cache";
+#endif
+
+	// fall back to next to the executable
+	if (base.empty())
+		base = GetExecutableFile();
+
+	std::filesystem::path dir = base / "NoireEngine2";
+	std::error_code ec;
+	std::filesystem::create_directories(dir, ec);
+	return dir;
+}
\ No newline at end of file
@@ -10,5 +10,8 @@ public:
 	static std::string Path(const std::string& suffix, bool assert=true);
 	static std::string Path(const char* suffix, bool assert=true);
 	static bool Exists(const std::string& path);
+
+	// per user directory for data that can be regenerated (e.g. the pipeline cache), created if missing
+	static std::filesystem::path CacheDirectory();
 };
 
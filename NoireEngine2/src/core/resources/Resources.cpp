@@ -1,52 +1,134 @@
 #include "Resources.hpp"
 
+#include "utils/Logger.hpp"
+
+#include <chrono>
 #include <iostream>
 
-std::shared_ptr<Resource> Resources::Find(const std::type_index& typeIndex, const Node& node) const 
+// adds the time between construction and destruction to the lookup stats
+struct LookupTimer
 {
-	if (resources.find(typeIndex) == resources.end())
-		return nullptr;
+	std::atomic<uint32_t>& count;
+	std::atomic<uint64_t>& nanoseconds;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
-	for (const auto& [key, resource] : resources.at(typeIndex)) {
-		if (key == node)
-			return resource;
+	~LookupTimer()
+	{
+		auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+		count.fetch_add(1, std::memory_order_relaxed);
+		nanoseconds.fetch_add(elapsed.count(), std::memory_order_relaxed);
 	}
+};
+
+std::shared_ptr<Resource> Resources::Find(const std::type_index& typeIndex, const Node& node) const
+{
+	LookupTimer timer{ m_NumLookups, m_LookupNanoseconds };
+
+	TypeCache* cache = GetCache(typeIndex);
+	if (!cache)
+		return nullptr;
 
-	return nullptr;
+	Key key{ node, node.Hash() };
+
+	std::shared_lock lock(cache->mutex);
+	auto it = cache->index.find(key);
+	return it == cache->index.end() ? nullptr : it->second;
 }
 
-void Resources::Add(const Node& node, const std::shared_ptr<Resource>& resource)
+std::shared_ptr<Resource> Resources::Add(const Node& node, const std::shared_ptr<Resource>& resource)
 {
-	std::type_index tid = resource->getTypeIndex();
-	if (Find(tid, node))
-		return;
+	LookupTimer timer{ m_NumLookups, m_LookupNanoseconds };
+
+	TypeCache& cache = GetOrCreateCache(resource->getTypeIndex());
+	Key key{ node, node.Hash() };
+
+	std::unique_lock lock(cache.mutex);
+	auto [it, inserted] = cache.index.try_emplace(std::move(key), resource);
+	if (!inserted)
+		return it->second;
 
-	resources[tid].emplace(node, resource);
-	resourceIDs[tid].emplace_back(resource);
+	cache.list.emplace_back(resource);
+	resource->ID = (uint32_t)cache.list.size() - 1;
 
-	resource->ID = (uint32_t)resourceIDs[tid].size() - 1;
+	return resource;
 }
 
 void Resources::Remove(const std::shared_ptr<Resource>& resource) 
 {
-	std::type_index tid = resource->getTypeIndex();
+	TypeCache* cache = GetCache(resource->getTypeIndex());
+	if (!cache)
+		return;
 
-	ResourceMap& node_rsc_map = resources[tid];
-	std::erase_if(node_rsc_map, [&](const auto& pair) {
+	std::unique_lock lock(cache->mutex);
+	std::erase_if(cache->index, [&](const auto& pair) {
 		return pair.second == resource;
 	});
+	std::erase(cache->list, resource);
+
+	ReindexIDs(*cache);
+}
 
-	if (node_rsc_map.empty())
-		resources.erase(tid);
+void Resources::BenchmarkLookups() const
+{
+	std::shared_lock cachesLock(m_CachesMutex);
+
+	for (const auto& [typeIndex, cache] : m_Caches)
+	{
+		std::shared_lock lock(cache->mutex);
+		if (cache->index.empty())
+			continue;
+
+		size_t hits = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const auto& [key, resource] : cache->index)
+		{
+			Key query{ key.node, key.node.Hash() };
+			hits += cache->index.count(query);
+		}
+		auto hashed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (const auto& [key, resource] : cache->index)
+		{
+			for (const auto& [other, otherResource] : cache->index)
+			{
+				if (other.node == key.node)
+				{
+					hits++;
+					break;
+				}
+			}
+		}
+		auto linear = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		NE_INFO("Resource lookup benchmark [{}]: {} keys, hashed {:.3f}ms, linear {:.3f}ms ({} hits)", 
+			typeIndex.name(), cache->index.size(), hashed, linear, hits);
+	}
+}
+
+Resources::TypeCache* Resources::GetCache(const std::type_index& typeIndex) const
+{
+	std::shared_lock lock(m_CachesMutex);
+	auto it = m_Caches.find(typeIndex);
+	return it == m_Caches.end() ? nullptr : it->second.get();
+}
+
+Resources::TypeCache& Resources::GetOrCreateCache(const std::type_index& typeIndex)
+{
+	if (TypeCache* cache = GetCache(typeIndex))
+		return *cache;
 
-	ReindexIDs(tid);
+	std::unique_lock lock(m_CachesMutex);
+	auto& cache = m_Caches[typeIndex];
+	if (!cache)
+		cache = std::make_unique<TypeCache>();
+	return *cache;
 }
 
-void Resources::ReindexIDs(std::type_index tid)
+void Resources::ReindexIDs(TypeCache& cache)
 {
-	ResourceList& ids = resourceIDs.at(tid);
-	for (auto i = 0; i < ids.size(); i++)
+	for (uint32_t i = 0; i < cache.list.size(); i++)
 	{
-		ids[i]->ID = i;
+		cache.list[i]->ID = i;
 	}
 }
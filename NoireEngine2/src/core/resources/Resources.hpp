@@ -4,10 +4,17 @@
 #include "nodes/Node.hpp"
 #include "core/resources/Module.hpp"
 
+#include <unordered_map>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
 /**
-  * @brief Module used for managing resources. 
+  * @brief Module used for managing resources.
   * Resources are held alive as long as they are in use,
   * A existing resource is queried by node value.
+  * Each type has its own hash index and lock, so loaders on different threads can share the cache.
 */
 class Resources : public Module::Registrar<Resources>
 {
@@ -21,53 +28,71 @@ public:
 	void Update() {}
 
 public:
-	using ResourceMap = std::map<Node, std::shared_ptr<Resource>>;
 	using ResourceList = std::vector<std::shared_ptr<Resource>>;
 
 	std::shared_ptr<Resource> Find(const std::type_index& typeIndex, const Node& node) const;
 
 	// given a node, find a pointer to the node
 	template<typename T>
-	std::shared_ptr<T> Find(const Node& node) const 
+	std::shared_ptr<T> Find(const Node& node) const
 	{
-		if (resources.find(typeid(T)) == resources.end())
-			return nullptr;
-
-		for (const auto& [key, resource] : resources.at(typeid(T))) {
-			if (key == node)
-				return std::dynamic_pointer_cast<T>(resource);
-		}
-
-		return nullptr;
+		return std::dynamic_pointer_cast<T>(Find(typeid(T), node));
 	}
 
-	// find all resources of type T
+	// find all resources of type T, a copy taken under the lock so loaders on other threads can keep adding
 	template<typename T>
-	const ResourceList& FindAllOfType() const {
-		return resourceIDs.at(typeid(T));
+	ResourceList FindAllOfType() const {
+		TypeCache* cache = GetCache(typeid(T));
+		if (!cache)
+			return {};
+
+		std::shared_lock lock(cache->mutex);
+		return cache->list;
 	}
 
-	// add a resource
-	void Add(const Node& node, const std::shared_ptr<Resource>& resource);
+	// add a resource. If an equal node was added first (e.g. by another thread), the cached one is kept and returned
+	std::shared_ptr<Resource> Add(const Node& node, const std::shared_ptr<Resource>& resource);
 
 	void Remove(const std::shared_ptr<Resource>& resource);
 
+	// lookups done through Find and Add so far, and the time spent in them
+	inline uint32_t getNumLookups() const { return m_NumLookups.load(std::memory_order_relaxed); }
+	inline float getLookupTime() const { return m_LookupNanoseconds.load(std::memory_order_relaxed) / 1e6f; }
+
+	// replays every cached key against the hash index and against a linear scan of deep Node compares (the old lookup)
+	void BenchmarkLookups() const;
+
 private:
-	template<typename T>
-	void ReindexIDs() 
+	// the hash is computed once when the key is made, the index never hashes a stored node again
+	struct Key
 	{
-		ResourceList& ids = FindAllOfType<T>();
-		for (auto i = 0; i < ids.size(); i++)
-		{
-			ids[i]->ID = i;
-		}
-	}
+		Node node;
+		std::size_t hash;
+
+		bool operator==(const Key& rhs) const { return hash == rhs.hash && node == rhs.node; }
+	};
+
+	struct KeyHash
+	{
+		std::size_t operator()(const Key& key) const { return key.hash; }
+	};
+
+	struct TypeCache
+	{
+		mutable std::shared_mutex									mutex;
+		std::unordered_map<Key, std::shared_ptr<Resource>, KeyHash>	index;
+		ResourceList												list; // by ID
+	};
+
+	TypeCache* GetCache(const std::type_index& typeIndex) const;
+	TypeCache& GetOrCreateCache(const std::type_index& typeIndex);
 
-	void ReindexIDs(std::type_index tid);
+	void ReindexIDs(TypeCache& cache);
 
-	// map of type index to resources
-	std::unordered_map<std::type_index, ResourceMap> resources;
+	// the outer map only grows, caches are never moved once created
+	mutable std::shared_mutex											m_CachesMutex;
+	std::unordered_map<std::type_index, std::unique_ptr<TypeCache>>	m_Caches;
 
-	// map of ID to resources
-	std::unordered_map<std::type_index, ResourceList> resourceIDs;
+	mutable std::atomic<uint32_t>	m_NumLookups{ 0 };
+	mutable std::atomic<uint64_t>	m_LookupNanoseconds{ 0 };
 };
@@ -207,6 +207,23 @@ bool Node::operator<(const Node &rhs) const {
 	return std::tie(value, properties) < std::tie(rhs.value, rhs.properties);
 }
 
+static inline void HashCombine(std::size_t &seed, std::size_t hash) {
+	seed ^= hash + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+
+std::size_t Node::Hash() const {
+	// type is left out on purpose, operator== ignores it too
+	std::size_t seed = std::hash<NodeValue>{}(value);
+	HashCombine(seed, properties.size());
+
+	for (const auto &[name, property] : properties) {
+		HashCombine(seed, std::hash<std::string>{}(name));
+		HashCombine(seed, property.Hash());
+	}
+
+	return seed;
+}
+
 // glm operators
 const Node& operator>>(const Node& node, glm::vec3& v) {
 	node["x"].Get(v.x);
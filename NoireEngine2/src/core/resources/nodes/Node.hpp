@@ -84,6 +84,11 @@ public:
 	bool operator!=(const Node &rhs) const;
 	bool operator<(const Node &rhs) const;
 
+	/**
+	 * Hashes the value and every property recursively. Nodes that compare equal hash equal.
+	 */
+	std::size_t Hash() const;
+
 	const NodeProperties &GetProperties() const { return properties; }
 	NodeProperties &GetProperties() { return properties; }
 
@@ -99,6 +104,15 @@ protected:
 	NodeType type = NodeType::Object;
 };
 
+template<>
+struct std::hash<Node>
+{
+	std::size_t operator()(const Node& node) const
+	{
+		return node.Hash();
+	}
+};
+
 #include "Node.inl"
 #include "NodeConstView.inl"
 #include "NodeView.inl"
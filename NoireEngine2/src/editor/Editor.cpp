@@ -3,6 +3,7 @@
 #include "Application.hpp"
 #include "renderer/scene/SceneManager.hpp"
 #include "renderer/Renderer.hpp"
+#include "core/Time.hpp"
 #include "imguizmo/ImGuizmo.h"
 
 Editor* Editor::g_Editor = nullptr;
@@ -275,7 +276,8 @@ void Editor::ShowStats()
     if (ImGui::Begin("Settings Overlay", &m_EditorInfo.show_settings, window_flags))
     {
         // fps
-        ImGui::Text("FPS: %d", Application::GetFPS());
+        ImGui::Text("FPS: %d (%.2fms)", Application::GetFPS(), Time::DeltaTime * 1000.0f);
+        ImGui::Text("Draw Calls: %I64u, Command Buffers: %I64u", Renderer::NumDrawCalls, Renderer::NumCommandBuffers);
         ImGui::Separator(); // -----------------------------------------------------
 
         // specified physical device
@@ -290,6 +292,10 @@ void Editor::ShowStats()
             ImGui::Text("Culling Mode: none");
         else if (cullMode == ApplicationSpecification::Culling::Frustum)
             ImGui::Text("Culling Mode: frustum");
+        else if (cullMode == ApplicationSpecification::Culling::GPU)
+            ImGui::Text("Culling Mode: gpu");
+        else if (cullMode == ApplicationSpecification::Culling::Occlusion)
+            ImGui::Text("Culling Mode: occlusion");
         ImGui::Separator(); // -----------------------------------------------------
 
         // camera mode
@@ -1,25 +1,20 @@
 #include "AABB.hpp"
 
-void AABB::Update(const glm::mat4& model)
+AABB AABB::Transform(const glm::mat4& model) const
 {
-    // Get the 8 corners of the local AABB
-    std::array<glm::vec3, 8> corners = {
-        glm::vec3(originMin.x, originMin.y, originMin.z),
-        glm::vec3(originMax.x, originMin.y, originMin.z),
-        glm::vec3(originMin.x, originMax.y, originMin.z),
-        glm::vec3(originMax.x, originMax.y, originMin.z),
-        glm::vec3(originMin.x, originMin.y, originMax.z),
-        glm::vec3(originMax.x, originMin.y, originMax.z),
-        glm::vec3(originMin.x, originMax.y, originMax.z),
-        glm::vec3(originMax.x, originMax.y, originMax.z),
-    };
+    glm::vec3 localCenter = center();
+    glm::vec3 localExtent = extent();
 
-    // Transform all corners
-    min = glm::vec3(FLT_MAX);
-    max = glm::vec3(-FLT_MAX);
-    for (const auto& corner : corners) {
-        glm::vec3 transformedCorner = glm::vec3(model * glm::vec4(corner, 1.0f));
-        min = glm::min(min, transformedCorner);
-        max = glm::max(max, transformedCorner);
-    }
-}
\ No newline at end of file
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(localCenter, 1.0f));
+    glm::vec3 worldExtent = glm::abs(glm::vec3(model[0])) * localExtent.x
+        + glm::abs(glm::vec3(model[1])) * localExtent.y
+        + glm::abs(glm::vec3(model[2])) * localExtent.z;
+
+    return AABB(worldCenter - worldExtent, worldCenter + worldExtent);
+}
+
+BoundingSphere BoundingSphere::Transform(const glm::mat4& model) const
+{
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return { glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale };
+}
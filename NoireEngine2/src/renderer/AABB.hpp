@@ -6,8 +6,22 @@
 struct AABB 
 {
     AABB() = default;
+    AABB(const glm::vec3& min_, const glm::vec3& max_) : min(min_), max(max_) {}
 
-    glm::vec3 min, max, originMin, originMax;
+    glm::vec3 min, max;
 
-    void Update(const glm::mat4& model);
-};
\ No newline at end of file
+    inline glm::vec3 center() const { return (min + max) * 0.5f; }
+    inline glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    // bounds of this box after a transform, using |M| * extent instead of transforming all 8 corners
+    AABB Transform(const glm::mat4& model) const;
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center;
+    float radius;
+
+    // conservative under non-uniform scale: the radius grows by the largest axis scale
+    BoundingSphere Transform(const glm::mat4& model) const;
+};
@@ -40,6 +40,11 @@ public:
      */
     bool CubeInFrustum(const glm::vec3& min, const glm::vec3& max) const;
 
+    /**
+     * Gets the normalized planes, as (nx, ny, nz, d). A point is inside if dot(n, p) + d > 0 for all six.
+     */
+    inline const std::array<std::array<float, 4>, 6>& getPlanes() const { return frustum; }
+
 private:
     void NormalizePlane(int32_t side);
 private:
@@ -13,6 +13,7 @@
 #include "core/Timer.hpp"
 #include "utils/Logger.hpp"
 #include "core/resources/Files.hpp"
+#include "core/jobs/JobSystem.hpp"
 
 #include "renderer/materials/Material.hpp"
 #include "renderer/object/Mesh.hpp"
@@ -62,6 +63,7 @@ Renderer::Renderer()
 	Instance = this;
 
 	s_OffscreenPass = std::make_unique<Renderpass>();
+	s_OffscreenLoadPass = std::make_unique<Renderpass>();
 	s_CompositionPass = std::make_unique<Renderpass>();
 
 	// initialize a bunch of pipelines
@@ -70,6 +72,13 @@ Renderer::Renderer()
 	s_SkyboxPipeline = std::make_unique<SkyboxPipeline>();
 	s_ShadowPipeline = std::make_unique<ShadowPipeline>();
 	s_BloomPipeline = std::make_unique<BloomPipeline>();
+	s_CullingPipeline = std::make_unique<CullingPipeline>();
+	s_HiZPipeline = std::make_unique<HiZPipeline>();
+	s_ClusteringPipeline = std::make_unique<ClusteringPipeline>();
+
+	// occlusion culling runs on top of gpu culling
+	m_OcclusionCulling = Application::GetSpecification().Culling == ApplicationSpecification::Culling::Occlusion;
+	m_GPUCulling = m_OcclusionCulling || Application::GetSpecification().Culling == ApplicationSpecification::Culling::GPU;
 }
 
 Renderer::~Renderer()
@@ -93,6 +102,8 @@ Renderer::~Renderer()
 
 		workspace.ObjectDescriptions.Destroy();
 		workspace.ObjectDescriptionsSrc.Destroy();
+
+		workspace.DrawInstances.Destroy();
 	}
 
 	workspaces.clear();
@@ -153,6 +164,13 @@ void Renderer::CreateRenderPass()
 		{.depthStencil = { 1.0f, 0 } }               // Clear depth to 1.0, stencil to 0
 	});
 
+	// same attachments, kept from the first occlusion phase
+	s_OffscreenLoadPass->CreateRenderPass(
+		{ G_BUFFER_COLOR_FORMAT , G_BUFFER_POSNORM_FORMAT, G_BUFFER_EMISSION_FORMAT },
+		VK_FORMAT_D32_SFLOAT_S8_UINT,
+		1, false, false, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL
+	);
+
 	// present to the swapchain
 	s_CompositionPass->CreateRenderPass(
 		{ VulkanContext::Get()->getSurface(0)->getFormat().format },
@@ -239,11 +257,72 @@ void Renderer::OnUIRender()
 		// num objects drawn
 		ImGui::Text("Objects Drawn: %I64u", ObjectsDrawn);
 		ImGui::Text("Vertices Drawn: %I64u", VerticesDrawn);
-		ImGui::Text("Indirect Indexed Draw Calls: %I64u", NumDrawCalls);
+		ImGui::Text("Indirect Indexed Draw Calls: %I64u (%I64u instanced commands)", NumDrawCalls, NumDrawCommands);
+		ImGui::Text("Command Buffers: %I64u", NumCommandBuffers);
+		ImGui::Text("Lit Pass State Changes: %I64u pipelines, %I64u vertex inputs, %I64u meshes", PipelineBinds, VertexInputBinds, MeshBinds);
+		ImGui::Text("Draw Sort: %I64u keys in %u radix passes", m_SortKeys.size(), m_DrawSorter.getNumPasses());
+		if (m_GPUCulling)
+			s_CullingPipeline->OnUIRender();
+		s_ClusteringPipeline->OnUIRender();
+		s_ShadowPipeline->OnUIRender();
+		ImGui::Separator(); // -----------------------------------------------------
+
+		const TransformHierarchy& hierarchy = SceneManager::Get()->getScene()->getTransformHierarchy();
+		ImGui::Text("Transforms Updated: %u / %u", hierarchy.getNumUpdated(), (uint32_t)hierarchy.size());
+		ImGui::Text("Transforms Uploaded: %I64u in %I64u regions", TransformsUploaded, TransformUploadRegions);
+		ImGui::Separator(); // -----------------------------------------------------
+
+		Scene* scene = SceneManager::Get()->getScene();
+		FrustumCuller& culler = scene->GetFrustumCuller();
+
+		bool useBVH = culler.getMethod() == FrustumCuller::Method::BVH;
+		if (ImGui::Checkbox("BVH Culling", &useBVH))
+			culler.setMethod(useBVH ? FrustumCuller::Method::BVH : FrustumCuller::Method::Linear);
+
+		if (useBVH)
+			ImGui::Text("Culling (BVH): %u visible, %u nodes visited in %.3fms", culler.getNumVisible(), culler.getNumTested(), culler.getLastCullTime());
+		else
+			ImGui::Text("Culling (%s): %u / %u visible in %.3fms", FrustumCuller::KernelToString(culler.getKernel()), 
+				culler.getNumVisible(), culler.getNumTested(), culler.getLastCullTime());
+
+		const BVH& bvh = scene->getBVH();
+		ImGui::Text("BVH: %u leaves, %u nodes, height %u", bvh.getNumLeaves(), bvh.getNumNodes(), bvh.getHeight());
+
+		if (ImGui::Button("Benchmark Culling"))
+			culler.Benchmark(scene->GetCullingCam()->camera()->getViewFrustum(), scene->getInstanceRegistry().getBounds(), bvh);
+
+		if (culler.getReferenceBenchmarkResult() > 0)
+		{
+			ImGui::BulletText("CubeInFrustum: %.3f boxes/ns", culler.getReferenceBenchmarkResult());
+			ImGui::BulletText("BVH: %.3f boxes/ns", culler.getBVHBenchmarkResult());
+			for (int k = 0; k < (int)FrustumCuller::Kernel::Count; ++k)
+			{
+				if (culler.getBenchmarkResult((FrustumCuller::Kernel)k) > 0)
+					ImGui::BulletText("%s: %.3f boxes/ns", FrustumCuller::KernelToString((FrustumCuller::Kernel)k), culler.getBenchmarkResult((FrustumCuller::Kernel)k));
+			}
+		}
+		ImGui::Separator(); // -----------------------------------------------------
+
+		const StagingRing* ring = VulkanContext::Get()->getStagingRing();
+		ImGui::Text("Staging Ring: %.1f / %.1f MB used, %u batches in flight, %u stalls", 
+			ring->getUsed() / (1024.0f * 1024.0f), ring->getSize() / (1024.0f * 1024.0f), ring->getNumInFlight(), ring->getNumStalls());
+		ImGui::Text("Staged: %I64u copies, %.1f MB in %I64u batches", ring->getNumCopies(), ring->getBytesUploaded() / (1024.0f * 1024.0f), ring->getNumBatches());
+		ImGui::Separator(); // -----------------------------------------------------
+
+		const DescriptorLayoutCache* layoutCache = VulkanContext::Get()->getDescriptorLayoutCache();
+		ImGui::Text("Descriptor Set Layouts: %u for %u requests, %u redundant writes skipped", 
+			layoutCache->getNumLayouts(), layoutCache->getNumLayoutRequests(), layoutCache->getNumSkippedWrites());
 		ImGui::Separator(); // -----------------------------------------------------
 
 		ImGui::BulletText("Application Update Time: %.3fms", Application::ApplicationUpdateTime);
 		ImGui::BulletText("Application Render Time: %.3fms", Application::ApplicationRenderTime);
+		ImGui::BulletText("Startup Time: %.1fms (%s pipeline cache)", Application::StartupTime,
+			VulkanContext::Get()->getPipelineCache().IsWarm() ? "warm" : "cold");
+	}
+
+	if (ImGui::CollapsingHeader("Device Memory", &showMenu))
+	{
+		VulkanContext::Get()->getMemoryAllocator()->OnUIRender();
 	}
 
 	if (ImGui::CollapsingHeader("Post Processing", &showPostProcessing))
@@ -392,7 +471,7 @@ void Renderer::CreatePostPipeline()
 		.Build("../spv/shaders/passthrough.vert.spv", "../spv/shaders/post.frag.spv", &m_PostPipeline, m_PostPipelineLayout, s_CompositionPass->renderpass);
 }
 
-void Renderer::CreateComputeAOPipeline()
+void Renderer::CreateComputeAOPipelineLayout()
 {
 	std::vector<VkDescriptorSetLayout> layouts{
 		set0_WorldLayout,
@@ -411,14 +490,17 @@ void Renderer::CreateComputeAOPipeline()
 	};
 
 	vkCreatePipelineLayout(VulkanContext::GetDevice(), &plCreateInfo, nullptr, &m_RaytracedAOComputePipelineLayout);
+}
 
+void Renderer::CreateComputeAOPipeline()
+{
 	VulkanShader compAOShader("../spv/shaders/raytracing/ao.comp.spv", VulkanShader::ShaderStage::Compute);
 
 	VkComputePipelineCreateInfo cpCreateInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
 	cpCreateInfo.layout = m_RaytracedAOComputePipelineLayout;
 	cpCreateInfo.stage = compAOShader.shaderStage();
 
-	vkCreateComputePipelines(VulkanContext::GetDevice(), {}, 1, &cpCreateInfo, nullptr, &m_RaytracedAOComputePipeline);
+	vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(), 1, &cpCreateInfo, nullptr, &m_RaytracedAOComputePipeline);
 }
 
 void Renderer::CreateDescriptors()
@@ -500,6 +582,10 @@ void Renderer::CreateStorageBufferDescriptors()
 			.AddBinding(StorageBuffers::Materials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR) // material instances
 			.AddBinding(StorageBuffers::Objects, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR) // object descriptions
 			.BindBuffer(StorageBuffers::MousePicking, &MousePickingInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // mouse picking
+			.AddBinding(StorageBuffers::Instances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT) // slots in draw order
+			.AddBinding(StorageBuffers::LightClusters, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // light clusters
+			.AddBinding(StorageBuffers::LightIndices, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // clustered light lists
+			.AddBinding(StorageBuffers::ShadowRects, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) // shadow atlas tiles
 			.Build(workspace.set1_StorageBuffers, set1_StorageBuffersLayout);
 	}
 }
@@ -574,89 +660,16 @@ void Renderer::CreateIBLDescriptors()
 		.Build(set3_IBL, set3_IBLLayout);
 }
 
-// create set 4: shadow mapping with descriptor indexing
+// create set 4: the shadow atlas, every shadow map is a tile of it
 void Renderer::CreateShadowDescriptors()
 {
-	const auto& shadowPasses = s_ShadowPipeline->getShadowPasses();
-	const auto& cascadePasses = s_ShadowPipeline->getCascadePasses();
-	const auto& omniPasses = s_ShadowPipeline->getOmniPasses();
-
-	NE_DEBUG(std::format("Found {} shadow maps.", shadowPasses.size()), Logger::CYAN, Logger::BOLD);
-	NE_DEBUG(std::format("Found {} cascaded shadow maps.", cascadePasses.size()), Logger::CYAN, Logger::BOLD);
-	NE_DEBUG(std::format("Found {} omnidirectional shadow maps.", omniPasses.size()), Logger::CYAN, Logger::BOLD);
-
-	std::vector<VkDescriptorBindingFlagsEXT> descriptorBindingFlags = {
-		VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT,
-	};
-	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT setLayoutBindingFlags{
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
-		.bindingCount = 1,
-		.pBindingFlags = descriptorBindingFlags.data()
-	};
-
-	// total number of descriptors across all shadow passes
-	uint32_t combinedShadowDescriptorsCount = static_cast<uint32_t>(
-		shadowPasses.size() +
-		cascadePasses.size() * SHADOW_MAP_CASCADE_COUNT +
-		omniPasses.size() * OMNI_SHADOWMAPS_COUNT);
-
-	// combine all shadow passes
-	std::vector<uint32_t> variableDesciptorCounts = {
-		combinedShadowDescriptorsCount
-	};
-
-	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableDescriptorInfoAI =
-	{
-		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT,
-		.descriptorSetCount = static_cast<uint32_t>(variableDesciptorCounts.size()),
-		.pDescriptorCounts = variableDesciptorCounts.data(),
-	};
-
-	// grab all texture information
-	std::vector<VkDescriptorImageInfo> shadowDescriptors;
-
-	// push cascades first, since directional light is always first
-	for (uint32_t i = 0; i < cascadePasses.size(); ++i)
-	{
-		for (int cascadeIndex = 0; cascadeIndex < SHADOW_MAP_CASCADE_COUNT; ++cascadeIndex) {
-			auto& depth = cascadePasses[i].cascades[cascadeIndex].depthAttachment;
-			shadowDescriptors.emplace_back(depth->getSampler(), depth->getView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-		}
-	}
-
-	// omni point light shadowpasses here
-	for (uint32_t i = 0; i < omniPasses.size(); ++i)
-	{
-		for (int faceIndex = 0; faceIndex < OMNI_SHADOWMAPS_COUNT; ++faceIndex) {
-			auto& depth = omniPasses[i].cubefaces[faceIndex].depthAttachment;
-			shadowDescriptors.emplace_back(depth->getSampler(), depth->getView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-		}
-	}
-
-	// push spotlight shadowpasses here
-	for (uint32_t i = 0; i < shadowPasses.size(); ++i)
-	{
-		auto& depth = shadowPasses[i].depthAttachment;
-		shadowDescriptors.emplace_back(depth->getSampler(), depth->getView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
-	}
-
-	// actually build the descriptor set now
-	DescriptorBuilder builder = DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator);
-
-	if (combinedShadowDescriptorsCount > 0)
-		builder.BindImage(0, shadowDescriptors.data(), VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-			VK_SHADER_STAGE_FRAGMENT_BIT, combinedShadowDescriptorsCount);
-	else
-		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT);
+	const ImageDepth* atlas = s_ShadowPipeline->getAtlas();
+	NE_DEBUG(std::format("Found a {}x{} shadow atlas.", atlas->getExtent().width, atlas->getExtent().height), Logger::CYAN, Logger::BOLD);
 
-	builder.Build(set4_ShadowMap, set4_ShadowMapLayout, &setLayoutBindingFlags,
-#if (defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_METAL_EXT))
-		// SRS - increase the per-stage descriptor samplers limit on macOS (maxPerStageDescriptorUpdateAfterBindSamplers > maxPerStageDescriptorSamplers)
-		VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT
-#else
-		0 /*VkDescriptorSetLayoutCreateFlags*/
-#endif
-		, &variableDescriptorInfoAI);
+	VkDescriptorImageInfo atlasInfo{ atlas->getSampler(), atlas->getView(), VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+	DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+		.BindImage(0, &atlasInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		.Build(set4_ShadowMap, set4_ShadowMapLayout);
 }
 
 void Renderer::CreateRayTracingImages()
@@ -768,6 +781,13 @@ void Renderer::Rebuild()
 		hdrImages.push_back(workspace.GBufferEmission.get());
 	s_BloomPipeline->Rebuild(hdrImages);
 
+	// the culling descriptors always point at a pyramid, even when only the frustum is culled
+	if (m_GPUCulling)
+		s_HiZPipeline->Rebuild(s_MainDepth.get());
+
+	// clusters tile the lit pass' framebuffer
+	s_ClusteringPipeline->Rebuild(s_MainDepth->getSize());
+
 	if (createdDescriptors)
 		AddUIViewportImages();
 
@@ -791,29 +811,56 @@ void Renderer::Create()
 	// this relies on shadow pipeline's depth attachment and ray tracing's acceleration structures
 	CreateDescriptors();
 	
+	// every layout has to exist before any pipeline is compiled against it
 	CreateMaterialPipelineLayout();
-	CreateMaterialPipelines();
-
 	CreatePostPipelineLayout();
-	CreatePostPipeline();
+	CreateComputeAOPipelineLayout();
 
-	CreateComputeAOPipeline();
-	
 	// the following pipelines rely on Renderer's descriptor sets
-	s_ShadowPipeline->CreatePipeline();
-
-	s_GizmosPipeline->CreatePipeline();
+	s_ShadowPipeline->CreatePipelineLayouts();
+	s_GizmosPipeline->CreatePipelineLayouts();
+	s_SkyboxPipeline->CreatePipelineLayouts();
+	s_BloomPipeline->CreatePipelineLayouts();
+	s_CullingPipeline->CreatePipelineLayouts();
+	s_ClusteringPipeline->CreatePipelineLayouts();
+	if (m_GPUCulling)
+		s_HiZPipeline->CreatePipelineLayouts();
+#ifdef _NE_USE_RTX
+	s_ReflectionPipeline->CreatePipelineLayouts();
+	s_TransparencyPipeline->CreatePipelineLayouts();
+#endif
 
-	s_SkyboxPipeline->CreatePipeline();
+	// then compile them all at once, each job only writes its own pipeline handles
+	Timer timer;
+	JobCounter counter;
+	JobSystem* jobs = JobSystem::Get();
+
+	jobs->Execute(counter, [this]() { CreateMaterialPipelines(); });
+	jobs->Execute(counter, [this]() { CreatePostPipeline(); });
+	jobs->Execute(counter, [this]() { CreateComputeAOPipeline(); });
+	jobs->Execute(counter, [this]() { s_ShadowPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_GizmosPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_SkyboxPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_BloomPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_CullingPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_ClusteringPipeline->CreatePipeline(); });
+	if (m_OcclusionCulling)
+		jobs->Execute(counter, [this]() { s_HiZPipeline->CreatePipeline(); });
+#ifdef _NE_USE_RTX
+	jobs->Execute(counter, [this]() { s_ReflectionPipeline->CreatePipeline(); });
+	jobs->Execute(counter, [this]() { s_TransparencyPipeline->CreatePipeline(); });
+#endif
 
+	// imgui keeps global state, initialize it here while the workers compile
 	s_UIPipeline->CreatePipeline();
 
-	s_BloomPipeline->CreatePipeline();
+	jobs->Wait(counter);
+	NE_INFO("Compiled pipelines in {:.1f}ms on {} threads", timer.GetElapsed(true), jobs->getThreadCount());
 
 #ifdef _NE_USE_RTX
-	s_ReflectionPipeline->CreatePipeline();
-
-	s_TransparencyPipeline->CreatePipeline();
+	// the binding tables are buffers filled from the compiled pipelines' shader group handles
+	s_ReflectionPipeline->CreateShaderBindingTables();
+	s_TransparencyPipeline->CreateShaderBindingTables();
 
 	AddUIViewportImages();
 #endif
@@ -831,6 +878,8 @@ void Renderer::Render(const CommandBuffer& commandBuffer)
 
 		s_ShadowPipeline->Prepare(scene, commandBuffer);
 
+		s_ClusteringPipeline->Prepare(scene, commandBuffer);
+
 		if (UseGizmos)
 			s_GizmosPipeline->Prepare(scene, commandBuffer);
 		
@@ -846,6 +895,14 @@ void Renderer::Render(const CommandBuffer& commandBuffer)
 	//memory barrier to make sure copies complete before rendering happens:
 	InsertPipelineMemoryBarrier(commandBuffer);
 
+	// cull and compact this frame's draws, every pass below draws the result.
+	// with occlusion culling, that is what was visible last frame
+	if (m_GPUCulling)
+		s_CullingPipeline->Render(scene, commandBuffer);
+
+	// assign lights to clusters for the lit pass
+	s_ClusteringPipeline->Render(scene, commandBuffer);
+
 	// render objects
 	{
 		// draw rtx
@@ -862,11 +919,36 @@ void Renderer::Render(const CommandBuffer& commandBuffer)
 			DrawScene(scene, commandBuffer);
 
 			// draw skybox
-			if (DrawSkybox)
+			if (DrawSkybox && !m_OcclusionCulling)
 				s_SkyboxPipeline->Render(scene, commandBuffer);
 		}
 		s_OffscreenPass->End(commandBuffer);
 
+		// test everything against the depth drawn so far, then draw what the first phase missed
+		if (m_OcclusionCulling)
+		{
+			s_HiZPipeline->Render(scene, commandBuffer);
+			s_CullingPipeline->RenderOcclusionPhase(commandBuffer);
+
+			// the g-buffer writes of the first phase have to land before the second one loads them
+			VkMemoryBarrier attachmentBarrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			};
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				0, 1, &attachmentBarrier, 0, nullptr, 0, nullptr);
+
+			s_OffscreenLoadPass->Begin(commandBuffer, m_OffscreenFrameBuffers[CURR_FRAME]);
+			{
+				DrawScene(scene, commandBuffer, true);
+
+				if (DrawSkybox)
+					s_SkyboxPipeline->Render(scene, commandBuffer);
+			}
+			s_OffscreenLoadPass->End(commandBuffer);
+		}
+
 #ifdef _NE_USE_RTX
 		RunRTXTransparency(scene, commandBuffer);
 #endif
@@ -931,7 +1013,7 @@ void Renderer::Prepare(const Scene* scene, const CommandBuffer& commandBuffer)
 	PrepareLights(scene, commandBuffer);
 	PrepareMaterialInstances(commandBuffer);
 	PrepareObjectDescriptions(scene, commandBuffer);
-	PrepareIndirectDrawBuffer(scene);
+	PrepareIndirectDrawBuffer(scene, commandBuffer);
 }
 
 void Renderer::PrepareSceneUniform(const Scene* scene, const CommandBuffer& commandBuffer)
@@ -944,11 +1026,13 @@ void Renderer::PrepareTransforms(const Scene* scene, const CommandBuffer& comman
 {
 	Workspace& workspace = workspaces[CURR_FRAME];
 
-	const auto& sceneObjectInstances = scene->getObjectInstances();
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
+
+	// every workspace has to pick up this frame's changes, not only the one being recorded
+	for (Workspace& w : workspaces)
+		w.PendingTransforms.Merge(registry.getDirtyTransforms());
 
-	size_t needed_bytes = 0;
-	for (int i = 0; i < sceneObjectInstances.size(); ++i)
-		needed_bytes += sceneObjectInstances[i].size() * sizeof(ObjectInstance::TransformUniform);
+	size_t needed_bytes = registry.capacity() * sizeof(ObjectInstance::TransformUniform);
 
 	// resize as neccesary
 	if (workspace.TransformsSrc.getBuffer() == VK_NULL_HANDLE
@@ -983,26 +1067,22 @@ void Renderer::PrepareTransforms(const Scene* scene, const CommandBuffer& comman
 			.BindBuffer(0, &Transforms_info, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
 			.Write(workspace.set1_StorageBuffers);
 
+		// the new device buffer is empty, so every slot has to go up again
+		workspace.PendingTransforms.AddAll(registry.capacity());
+
 		NE_INFO("Reallocated transform to {} bytes", new_bytes);
 	}
 
 	assert(workspace.TransformsSrc.getSize() == workspace.Transforms.getSize());
 	assert(workspace.TransformsSrc.getSize() >= needed_bytes);
 
-	{ //copy transforms into Transforms_src:
-		ObjectInstance::TransformUniform* start = reinterpret_cast<ObjectInstance::TransformUniform*>(workspace.TransformsSrc.data());
-		ObjectInstance::TransformUniform* out = start;
-
-		for (int i = 0; i < sceneObjectInstances.size(); ++i) {
-			for (auto& inst : sceneObjectInstances[i]) {
-				*out = inst.m_TransformUniform;
-				++out;
-			}
+	TransformsUploaded = workspace.PendingTransforms.size();
+	TransformUploadRegions = UploadPendingSlots(commandBuffer, workspace.TransformsSrc, workspace.Transforms, workspace.PendingTransforms, 
+		sizeof(ObjectInstance::TransformUniform),
+		[&registry](uint32_t slot, void* out) {
+			memcpy(out, &registry[slot].m_TransformUniform, sizeof(ObjectInstance::TransformUniform));
 		}
-
-		size_t regionSize = reinterpret_cast<char*>(out) - reinterpret_cast<char*>(start);
-		Buffer::CopyBuffer(commandBuffer, workspace.TransformsSrc.getBuffer(), workspace.Transforms.getBuffer(), regionSize);
-	}
+	);
 }
 
 void Renderer::PrepareLights(const Scene* scene, const CommandBuffer& commandBuffer)
@@ -1078,20 +1158,38 @@ void Renderer::PrepareLights(const Scene* scene, const CommandBuffer& commandBuf
 	PointLightUniform* pointIt = pointStart;
 	SpotLightUniform* spotIt = spotStart;
 
+	// shadow maps are laid out directional, point, then spot lights, each in scene order.
+	// the clustered loops skip lights, so every light carries where its own maps start
+	std::array<uint32_t, 3> shadowBases = { 0 };
+	for (int i = 0; i < lightInstances.size(); ++i)
+	{
+		if (lightInstances[i]->type == 0/*Light::Type::Directional*/)
+			shadowBases[1] += lightInstances[i]->GetLightUniformAs<DirectionalLightUniform>()->shadowOffset;
+		else if (lightInstances[i]->type == 1/*Light::Type::Point*/)
+			shadowBases[2] += lightInstances[i]->GetLightUniformAs<PointLightUniform>()->shadowOffset;
+	}
+	shadowBases[2] += shadowBases[1];
+
 	for (int i = 0; i < lightInstances.size(); ++i)
 	{
 		switch (lightInstances[i]->type)
 		{
 		case 0/*Light::Type::Directional*/:
 			memcpy(directionalIt, lightInstances[i]->GetLightUniformAs<DirectionalLightUniform>(), sizeof(DirectionalLightUniform));
+			directionalIt->shadowBase = shadowBases[0];
+			shadowBases[0] += directionalIt->shadowOffset;
 			directionalIt++;
 			break;
 		case 1/*Light::Type::Point*/:
 			memcpy(pointIt, lightInstances[i]->GetLightUniformAs<PointLightUniform>(), sizeof(PointLightUniform));
+			pointIt->shadowBase = shadowBases[1];
+			shadowBases[1] += pointIt->shadowOffset;
 			pointIt++;
 			break;
 		case 2/*Light::Type::Spot*/:
 			memcpy(spotIt, lightInstances[i]->GetLightUniformAs<SpotLightUniform>(), sizeof(SpotLightUniform));
+			spotIt->shadowBase = shadowBases[2];
+			shadowBases[2] += spotIt->shadowOffset;
 			spotIt++;
 			break;
 		}
@@ -1111,11 +1209,19 @@ void Renderer::PrepareObjectDescriptions(const Scene* scene, const CommandBuffer
 {
 	Workspace& workspace = workspaces[CURR_FRAME];
 
-	const auto& sceneObjectInstances = scene->getObjectInstances();
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
 
-	size_t needed_bytes = 0;
-	for (int i = 0; i < sceneObjectInstances.size(); ++i)
-		needed_bytes += sceneObjectInstances[i].size() * sizeof(ObjectDescription);
+	for (Workspace& w : workspaces)
+	{
+		w.PendingDescriptions.Merge(registry.getDirtyDescriptions());
+
+		// descriptions embed the material offsets
+		if (m_MaterialOffsetsChanged)
+			w.PendingDescriptions.AddAll(registry.capacity());
+	}
+	m_MaterialOffsetsChanged = false;
+
+	size_t needed_bytes = registry.capacity() * sizeof(ObjectDescription);
 
 	// resize as neccesary
 	if (workspace.ObjectDescriptionsSrc.getBuffer() == VK_NULL_HANDLE
@@ -1145,36 +1251,35 @@ void Renderer::PrepareObjectDescriptions(const Scene* scene, const CommandBuffer
 			.BindBuffer(StorageBuffers::Objects, &objBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
 			.Write(workspace.set1_StorageBuffers);
 
+		workspace.PendingDescriptions.AddAll(registry.capacity());
+
 		NE_INFO("Reallocated object descriptions to {} bytes", new_bytes);
 	}
 
 	assert(workspace.ObjectDescriptionsSrc.getSize() == workspace.ObjectDescriptions.getSize());
 	assert(workspace.ObjectDescriptionsSrc.getSize() >= needed_bytes);
 
-	{
-		ObjectDescription* start = reinterpret_cast<ObjectDescription*>(workspace.ObjectDescriptionsSrc.data());
-		ObjectDescription* out = start;
-
-		for (int i = 0; i < sceneObjectInstances.size(); ++i) 
-		{
-			for (auto& inst : sceneObjectInstances[i]) 
+	UploadPendingSlots(commandBuffer, workspace.ObjectDescriptionsSrc, workspace.ObjectDescriptions, workspace.PendingDescriptions,
+		sizeof(ObjectDescription),
+		[&registry](uint32_t slot, void* out) {
+			if (!registry.IsAlive(slot))
 			{
-				ObjectDescription description
-				{
-					.vertexAddress = inst.mesh->getVertexBufferAddress(),
-					.indexAddress = inst.mesh->getIndexBufferAddress(),
-					.materialOffset = (uint32_t)inst.material->materialInstanceBufferOffset,
-					.materialWorkflow = (uint32_t)inst.material->getWorkflow(),
-					.entityID = inst.entityID
-				};
-				*out = description;
-				++out;
+				memset(out, 0, sizeof(ObjectDescription));
+				return;
 			}
-		}
 
-		size_t regionSize = reinterpret_cast<char*>(out) - reinterpret_cast<char*>(start);
-		Buffer::CopyBuffer(commandBuffer, workspace.ObjectDescriptionsSrc.getBuffer(), workspace.ObjectDescriptions.getBuffer(), regionSize);
-	}
+			const ObjectInstance& inst = registry[slot];
+			ObjectDescription description
+			{
+				.vertexAddress = inst.mesh->getVertexBufferAddress(),
+				.indexAddress = inst.mesh->getIndexBufferAddress(),
+				.materialOffset = (uint32_t)inst.material->materialInstanceBufferOffset,
+				.materialWorkflow = (uint32_t)inst.material->getWorkflow(),
+				.entityID = inst.entityID
+			};
+			memcpy(out, &description, sizeof(ObjectDescription));
+		}
+	);
 }
 
 void Renderer::PrepareMaterialInstances(const CommandBuffer& commandBuffer)
@@ -1241,7 +1346,9 @@ void Renderer::PrepareMaterialInstances(const CommandBuffer& commandBuffer)
 	for (const auto& resource : materialInstances)
 	{
 		std::shared_ptr<Material> mat = std::dynamic_pointer_cast<Material>(resource);
-		mat->materialInstanceBufferOffset = CALCULATE_OFFSET(start, out) / sizeof(float);
+		size_t offset = CALCULATE_OFFSET(start, out) / sizeof(float);
+		m_MaterialOffsetsChanged |= mat->materialInstanceBufferOffset != offset;
+		mat->materialInstanceBufferOffset = offset;
 		switch (mat->getWorkflow())
 		{
 		case Material::Workflow::Lambertian:
@@ -1257,73 +1364,165 @@ void Renderer::PrepareMaterialInstances(const CommandBuffer& commandBuffer)
 	Buffer::CopyBuffer(commandBuffer, workspace.MaterialInstancesSrc.getBuffer(), workspace.MaterialInstances.getBuffer(), neededBytes);
 }
 
-void Renderer::CompactDraws(const std::vector<ObjectInstance>& objects, uint32_t workflowIndex)
+// draw order of an opaque instance, most significant first: workflow (pipeline) 2 bits, vertex input 6, mesh 16, material 16, depth 24.
+// Rebinding state costs more than overdraw, so depth only orders the instances of one batch front to back.
+// Ids that do not fit only cost batching, runs are still split on the actual mesh and material
+static uint64_t MakeSortKey(uint32_t workflowIndex, const ObjectInstance& instance, float squaredDepth)
 {
-	std::vector<IndirectBatch>& draws = m_IndirectBatches[workflowIndex];
-	draws.emplace_back(objects[0].mesh, objects[0].material, 0, 1);
+	// non-negative floats order like their bits, keep the top 24 below the sign
+	uint32_t depthBits;
+	memcpy(&depthBits, &squaredDepth, sizeof(float));
+
+	return ((uint64_t)(workflowIndex & 0x3) << 62)
+		| ((uint64_t)(instance.mesh->getVertexInput()->getID() & 0x3F) << 56)
+		| ((uint64_t)(instance.mesh->getID() & 0xFFFF) << 40)
+		| ((uint64_t)(instance.material->getID() & 0xFFFF) << 24)
+		| (uint64_t)(depthBits >> 7);
+}
+
+void Renderer::CompactDraws(const uint32_t* slots, uint32_t count, const InstanceRegistry& registry, uint32_t workflowIndex, uint32_t& commandIndex, uint32_t& instanceIndex)
+{
+	VkDrawIndexedIndirectCommand* drawCommands = (VkDrawIndexedIndirectCommand*)VulkanContext::Get()->getIndirectBuffer()->data();
+	std::vector<IndirectBatch>& batches = m_IndirectBatches[workflowIndex];
 
-	for (uint32_t i = 1; i < objects.size(); i++)
+	// the slots are laid out in draw order, so each run of equal objects is one contiguous range of gl_InstanceIndex
+	uint32_t* drawInstances = (uint32_t*)workspaces[CURR_FRAME].DrawInstances.data();
+	memcpy(drawInstances + instanceIndex, slots, count * sizeof(uint32_t));
+
+	uint32_t runStart = 0;
+	for (uint32_t i = 1; i <= count; i++)
 	{
-		//compare the mesh and material with the end of the vector of draws
-		bool sameMesh = objects[i].mesh == draws.back().mesh;
-		bool sameMaterial = objects[i].material == draws.back().material;
+		const ObjectInstance& first = registry[slots[runStart]];
+		if (i < count && registry[slots[i]].mesh == first.mesh && registry[slots[i]].material == first.material)
+			continue;
+
+		// one command instances the whole run, with gpu culling the cull pass counts its instances instead
+		uint32_t runLength = i - runStart;
+		drawCommands[commandIndex] = VkDrawIndexedIndirectCommand{
+			.indexCount = first.mesh->getIndexCount(),
+			.instanceCount = m_GPUCulling ? 0 : runLength,
+			.firstIndex = 0,
+			.vertexOffset = 0,
+			.firstInstance = instanceIndex + runStart,
+		};
 
-		if (sameMesh && sameMaterial)
-			draws.back().count++;
+		// runs of the same mesh with different materials still share one draw call
+		if (!batches.empty() && batches.back().mesh == first.mesh)
+			batches.back().commandCount++;
 		else
-			draws.emplace_back(objects[i].mesh, objects[i].material, i, 1);
+			batches.emplace_back(first.mesh, commandIndex, 1, m_NumBatches++);
+
+		if (m_GPUCulling)
+		{
+			m_CandidateCommands.insert(m_CandidateCommands.end(), runLength, commandIndex);
+			m_CommandBatches.emplace_back(batches.back().batchIndex, batches.back().firstCommand);
+		}
+
+		VerticesDrawn += (size_t)first.mesh->getVertexCount() * runLength;
+		commandIndex++;
+		runStart = i;
 	}
+
+	instanceIndex += count;
 }
 
-void Renderer::PrepareIndirectDrawBuffer(const Scene* scene)
+void Renderer::PrepareIndirectDrawBuffer(const Scene* scene, const CommandBuffer& commandBuffer)
 {
-	const auto& allInstances = scene->getObjectInstances();
+	Workspace& workspace = workspaces[CURR_FRAME];
+
+	const auto& allInstances = scene->getVisibleInstances();
+	const InstanceRegistry& registry = scene->getInstanceRegistry();
 	m_IndirectBatches.resize(N_OPAQUE_MATERIALS);
 
 	ObjectsDrawn = 0;
 	NumDrawCalls = 0;
+	NumDrawCommands = 0;
+	NumCommandBuffers = 1; // the frame's primary, shadow passes add their secondaries
 	VerticesDrawn = 0;
+	PipelineBinds = VertexInputBinds = MeshBinds = 0;
 
-	VkDrawIndexedIndirectCommand* drawCommands = (VkDrawIndexedIndirectCommand*)VulkanContext::Get()->getIndirectBuffer()->data();
+	size_t numInstances = 0;
+	for (int workflowIndex = 0; workflowIndex < N_OPAQUE_MATERIALS; ++workflowIndex)
+		numInstances += allInstances[workflowIndex].size();
+
+	// resize as neccesary
+	size_t needed_bytes = std::max<size_t>(numInstances, 1) * sizeof(uint32_t);
+	if (workspace.DrawInstances.getBuffer() == VK_NULL_HANDLE
+		|| workspace.DrawInstances.getSize() < needed_bytes)
+	{
+		size_t new_bytes = ((needed_bytes + 4096) / 4096) * 4096;
+
+		workspace.DrawInstances.Destroy();
+		workspace.DrawInstances = Buffer(
+			new_bytes,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			Buffer::Mapped
+		);
+
+		NE_INFO("Reallocated draw instances to {} bytes", new_bytes);
+	}
+
+	// key every visible opaque instance and sort them all at once, the workflow in the top bits keeps them apart
+	const Scene::SceneUniform* sceneUniform = static_cast<const Scene::SceneUniform*>(scene->getSceneUniformPtr());
+	glm::vec3 cameraPosition(sceneUniform->cameraPosition.x, sceneUniform->cameraPosition.y, sceneUniform->cameraPosition.z);
+
+	m_SortKeys.clear();
+	m_DrawOrder.clear();
+	for (int workflowIndex = 0; workflowIndex < N_OPAQUE_MATERIALS; ++workflowIndex)
+	{
+		for (uint32_t slot : allInstances[workflowIndex])
+		{
+			glm::vec3 toCamera = registry.getWorldSphere(slot).center - cameraPosition;
+			m_SortKeys.push_back(MakeSortKey(workflowIndex, registry[slot], glm::dot(toCamera, toCamera)));
+			m_DrawOrder.push_back(slot);
+		}
+	}
+	m_DrawSorter.Sort(m_SortKeys, m_DrawOrder);
 
 	//draw all instances in relation to a certain material:
+	uint32_t commandIndex = 0;
 	uint32_t instanceIndex = 0;
+	m_NumBatches = 0;
+	m_CandidateCommands.clear();
+	m_CommandBatches.clear();
 
 	for (int workflowIndex = 0; workflowIndex < N_OPAQUE_MATERIALS; ++workflowIndex)
 	{
-		const auto& workflowInstances = allInstances[workflowIndex];
-		if (workflowInstances.empty())
-			continue;
-
-		// make draws into compact batches
 		m_IndirectBatches[workflowIndex].clear();
-		CompactDraws(workflowInstances, workflowIndex);
 
-		// encode the draw data of each object into the indirect draw buffer
-		uint32_t instanceCount = (uint32_t)workflowInstances.size();
-		for (uint32_t i = 0; i < instanceCount; i++)
-		{
-			drawCommands[instanceIndex].indexCount = workflowInstances[i].mesh->getIndexCount();
-			drawCommands[instanceIndex].instanceCount = 1;
-			drawCommands[instanceIndex].firstIndex = 0;
-			drawCommands[instanceIndex].vertexOffset = 0;
-			drawCommands[instanceIndex].firstInstance = instanceIndex;
-			instanceIndex++;
-
-			VerticesDrawn += workflowInstances[i].mesh->getVertexCount();
-		}
+		uint32_t workflowCount = (uint32_t)allInstances[workflowIndex].size();
+		if (workflowCount == 0)
+			continue;
+
+		CompactDraws(m_DrawOrder.data() + instanceIndex, workflowCount, registry, workflowIndex, commandIndex, instanceIndex);
 	}
 	ObjectsDrawn = instanceIndex;
+	NumDrawCommands = commandIndex;
+
+	// the vertex shaders read the slots the cull pass wrote, laid out like the candidates
+	VkDescriptorBufferInfo instancesInfo = workspace.DrawInstances.GetDescriptorInfo();
+	if (m_GPUCulling)
+	{
+		s_CullingPipeline->Prepare(scene, commandBuffer);
+		instancesInfo = s_CullingPipeline->getCulledInstancesInfo();
+		ObjectsDrawn = s_CullingPipeline->getNumVisible();
+	}
+
+	// unchanged bindings are skipped by the layout cache
+	DescriptorBuilder::Start(VulkanContext::Get()->getDescriptorLayoutCache(), &m_DescriptorAllocator)
+		.BindBuffer(StorageBuffers::Instances, &instancesInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		.Write(workspace.set1_StorageBuffers);
 }
 
-void Renderer::DrawScene(const Scene* scene, const CommandBuffer& commandBuffer)
+void Renderer::DrawScene(const Scene* scene, const CommandBuffer& commandBuffer, bool occlusionPhase)
 {
 	Workspace& workspace = workspaces[CURR_FRAME];
-	const auto& allInstances = scene->getObjectInstances();
+	const auto& allInstances = scene->getVisibleInstances();
 
 	//draw all instances in relation to a certain material:
-	uint32_t offsetIndex = 0; 
 	VertexInput* previouslyBindedVertex = nullptr;
+	Mesh* previouslyBindedMesh = nullptr;
 
 	// bind descriptor sets
 	std::vector<VkDescriptorSet> descriptor_sets{
@@ -1354,30 +1553,45 @@ void Renderer::DrawScene(const Scene* scene, const CommandBuffer& commandBuffer)
 
 		// bind pipeline
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_MaterialPipelines[workflowIndex]);
-
-		uint32_t instanceCount = (uint32_t)workflowInstances.size();
+		PipelineBinds++;
 
 		// draw each batch
-		for (IndirectBatch& draw : m_IndirectBatches[workflowIndex])
+		for (const IndirectBatch& draw : m_IndirectBatches[workflowIndex])
 		{
 			VertexInput* vertexInputPtr = draw.mesh->getVertexInput();
 			if (vertexInputPtr != previouslyBindedVertex) {
 				vertexInputPtr->Bind(commandBuffer);
 				previouslyBindedVertex = vertexInputPtr;
+				VertexInputBinds++;
 			}
 
-			draw.mesh->Bind(commandBuffer);
-
-			constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
-			VkDeviceSize offset = (draw.firstInstanceIndex + offsetIndex) * stride;
+			// batches are split by mesh, only a new workflow can repeat one
+			if (draw.mesh != previouslyBindedMesh) {
+				draw.mesh->Bind(commandBuffer);
+				previouslyBindedMesh = draw.mesh;
+				MeshBinds++;
+			}
 
-			vkCmdDrawIndexedIndirect(commandBuffer, VulkanContext::Get()->getIndirectBuffer()->getBuffer(), offset, draw.count, stride);
+			DrawIndirectBatch(commandBuffer, draw, occlusionPhase);
 			NumDrawCalls++;
 		}
-		offsetIndex += instanceCount;
 	}
 }
 
+void Renderer::DrawIndirectBatch(VkCommandBuffer commandBuffer, const IndirectBatch& draw, bool occlusionPhase) const
+{
+	if (m_GPUCulling)
+	{
+		s_CullingPipeline->DrawBatch(commandBuffer, draw.firstCommand, draw.commandCount, draw.batchIndex, occlusionPhase);
+		return;
+	}
+
+	constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize offset = draw.firstCommand * stride;
+
+	vkCmdDrawIndexedIndirect(commandBuffer, VulkanContext::Get()->getIndirectBuffer()->getBuffer(), offset, draw.commandCount, stride);
+}
+
 void Renderer::RunAOCompute(const Scene* scene, const CommandBuffer& commandBuffer)
 {
 	m_AOIsDirty |= scene->isSceneDirty;
@@ -1464,7 +1678,7 @@ void Renderer::RunRTXReflection(const Scene* scene, const CommandBuffer& command
 
 void Renderer::RunRTXTransparency(const Scene* scene, const CommandBuffer& commandBuffer)
 {
-	if (scene->getObjectInstances()[2].empty())
+	if (scene->getVisibleInstances()[2].empty())
 		return;
 
 	// Adding a barrier to be sure the fragment shader has finished color g buffer before running it
@@ -3,7 +3,8 @@
 #include "backend/pipeline/VulkanPipeline.hpp"
 #include "backend/buffers/Buffer.hpp"
 #include "backend/images/Image2D.hpp"
-#include "renderer/object/ObjectInstance.hpp"
+#include "renderer/object/InstanceRegistry.hpp"
+#include "core/jobs/RadixSort.hpp"
 #include "backend/descriptor/DescriptorBuilder.hpp"
 #include "backend/renderpass/Renderpass.hpp"
 
@@ -16,11 +17,13 @@
 #include "backend/pipeline/UIPipeline.hpp"
 #include "backend/pipeline/BloomPipeline.hpp"
 #include "backend/pipeline/TransparencyPipeline.hpp"
+#include "backend/pipeline/CullingPipeline.hpp"
+#include "backend/pipeline/HiZPipeline.hpp"
+#include "backend/pipeline/ClusteringPipeline.hpp"
 
 #include <type_traits>
 #include "glm/glm.hpp"
 
-#include "utils/ThreadPool.hpp"
 #include "utils/UUID.hpp"
 
 #define _NE_USE_RTX
@@ -35,7 +38,9 @@ public:
 	~Renderer();
 
 	// UI statistics
-	inline static size_t ObjectsDrawn, VerticesDrawn, NumDrawCalls;
+	inline static size_t ObjectsDrawn, VerticesDrawn, NumDrawCalls, NumDrawCommands, NumCommandBuffers;
+	inline static size_t PipelineBinds, VertexInputBinds, MeshBinds; // state changes of the lit pass
+	inline static size_t TransformsUploaded, TransformUploadRegions;
 	inline static bool UseGizmos = true;
 	inline static bool DrawSkybox = true;
 
@@ -52,17 +57,46 @@ public:
 	
 	UUID QueryMouseHoveredEntity() const;
 
-	// for draw indirect
+	// for draw indirect: a run of indirect commands that share a mesh, drawn with one call.
+	// Each command instances every visible object with one mesh and material
 	struct IndirectBatch
 	{
 		Mesh* mesh;
-		Material* material;
-		uint32_t firstInstanceIndex;
-		uint32_t count;
+		uint32_t firstCommand; // into the indirect buffer
+		uint32_t commandCount;
+		uint32_t batchIndex; // across all workflows, for the gpu draw counts
 	};
 
 	const std::vector<std::vector<IndirectBatch>>& getIndirectBatches() const { return m_IndirectBatches; }
 
+	// records the draw of one batch, from the cpu commands or the gpu culled ones of the given phase
+	void DrawIndirectBatch(VkCommandBuffer commandBuffer, const IndirectBatch& draw, bool occlusionPhase = false) const;
+
+	// writes every pending slot into the mapped host buffer, then records a single copy with one region per contiguous run of slots
+	template<typename TWrite>
+	static uint32_t UploadPendingSlots(const CommandBuffer& commandBuffer, const Buffer& src, const Buffer& dst, DirtySlotSet& pending, size_t stride, TWrite&& write)
+	{
+		static std::vector<std::pair<uint32_t, uint32_t>> ranges;
+		static std::vector<VkBufferCopy> regions;
+
+		pending.BuildRanges(ranges);
+		regions.clear();
+
+		for (const auto& [begin, end] : ranges)
+		{
+			for (uint32_t slot = begin; slot < end; ++slot)
+				write(slot, PTR_ADD(src.data(), slot * stride));
+
+			VkDeviceSize offset = begin * stride;
+			regions.emplace_back(offset, offset, (end - begin) * stride);
+		}
+
+		Buffer::CopyBufferRegions(commandBuffer, src.getBuffer(), dst.getBuffer(), (uint32_t)regions.size(), regions.data());
+		pending.Clear();
+
+		return (uint32_t)regions.size();
+	}
+
 	void OnUIRender();
 	VkRenderPass GetUIRenderPass() { return s_UIPipeline->GetRenderPass(); }
 
@@ -76,6 +110,7 @@ private:
 	void CreatePostPipelineLayout();
 	void CreatePostPipeline();
 
+	void CreateComputeAOPipelineLayout();
 	void CreateComputeAOPipeline();
 
 	// descriptor management
@@ -99,6 +134,7 @@ private:
 	void PrepareLights(const Scene* scene, const CommandBuffer& commandBuffer);
 	void PrepareMaterialInstances(const CommandBuffer& commandBuffer);
 	void PrepareObjectDescriptions(const Scene* scene, const CommandBuffer& commandBuffer);
+	bool m_MaterialOffsetsChanged = true;
 
 	struct ObjectDescription
 	{
@@ -110,10 +146,23 @@ private:
 	};
 
 	// drawing
-	void DrawScene(const Scene* scene, const CommandBuffer& commandBuffer);
-	void CompactDraws(const std::vector<ObjectInstance>& objects, uint32_t workflowIndex);
-	void PrepareIndirectDrawBuffer(const Scene* scene);
+	void DrawScene(const Scene* scene, const CommandBuffer& commandBuffer, bool occlusionPhase = false);
+	// slots must be sorted by mesh and material. Writes one instanced command per run and advances both cursors
+	void CompactDraws(const uint32_t* slots, uint32_t count, const InstanceRegistry& registry, uint32_t workflowIndex, uint32_t& commandIndex, uint32_t& instanceIndex);
+	void PrepareIndirectDrawBuffer(const Scene* scene, const CommandBuffer& commandBuffer);
 	std::vector<std::vector<IndirectBatch>> m_IndirectBatches;
+	uint32_t m_NumBatches = 0;
+	std::vector<uint64_t> m_SortKeys; // one per visible opaque instance, see MakeSortKey
+	std::vector<uint32_t> m_DrawOrder; // visible opaque slots, sorted by their keys
+	RadixSorter m_DrawSorter;
+
+	// gpu culling: templates with no instances, the compute passes fill and compact them
+	bool m_GPUCulling = false;
+	std::vector<uint32_t> m_CandidateCommands; // command of every drawn slot
+	std::vector<glm::uvec2> m_CommandBatches; // (batch, first command of the batch) of every command
+
+	// occlusion culling: the lit pass is split around the depth pyramid build
+	bool m_OcclusionCulling = false;
 
 	// dispatch ray queries from compute shader
 	void RunAOCompute(const Scene* scene, const CommandBuffer& commandBuffer);
@@ -156,8 +205,15 @@ private:
 		Buffer ObjectDescriptionsSrc;
 		Buffer ObjectDescriptions;
 
+		// instance slot of every drawn instance, indexed by gl_InstanceIndex
+		Buffer DrawInstances; //host coherent; mapped
+
 		// all storage buffers are binded to this
 		VkDescriptorSet set1_StorageBuffers = VK_NULL_HANDLE; //references Transforms and lights
+
+		// instance slots that still have to be copied into this workspace's device buffers
+		DirtySlotSet PendingTransforms;
+		DirtySlotSet PendingDescriptions;
 	};
 
 	std::vector<Workspace> workspaces;
@@ -178,7 +234,11 @@ private:
 		SpotLights,
 		Materials,
 		Objects,
-		MousePicking
+		MousePicking,
+		Instances,
+		LightClusters,
+		LightIndices,
+		ShadowRects
 	END_BINDING();
 
 	START_BINDING(IBL)
@@ -218,6 +278,7 @@ private:
 
 	// render pass management
 	std::unique_ptr<Renderpass> s_OffscreenPass;
+	std::unique_ptr<Renderpass> s_OffscreenLoadPass; // continues the offscreen pass, for the occlusion phase
 	std::unique_ptr<Renderpass> s_CompositionPass;
 
 	// frame buffers
@@ -274,6 +335,8 @@ private:
 	friend class UIPipeline;
 	friend class BloomPipeline;
 	friend class TransparencyPipeline;
+	friend class CullingPipeline;
+	friend class ClusteringPipeline;
 
 private:
 	std::unique_ptr<GizmosPipeline>					s_GizmosPipeline;
@@ -283,5 +346,8 @@ private:
 	std::unique_ptr<UIPipeline>						s_UIPipeline;
 	std::unique_ptr<BloomPipeline>					s_BloomPipeline;
 	std::unique_ptr<TransparencyPipeline>			s_TransparencyPipeline;
+	std::unique_ptr<CullingPipeline>				s_CullingPipeline;
+	std::unique_ptr<HiZPipeline>					s_HiZPipeline;
+	std::unique_ptr<ClusteringPipeline>				s_ClusteringPipeline;
 };
 
@@ -1,6 +1,8 @@
 #include "Animation.hpp"
 #include "utils/Logger.hpp"
 #include <iostream>
+#include <cstring>
+#include <format>
 
 Animation::Animation(const std::string& name, const std::string& filename) :
 	m_Name(name), m_Filename(filename)
@@ -24,7 +26,8 @@ std::shared_ptr<Animation> Animation::Create(const Node& node)
 	}
 
 	auto result = std::make_shared<Animation>();
-	Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+	if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+		return std::dynamic_pointer_cast<Animation>(cached);
 	node >> *result;
 	result->Load();
 	return result;
@@ -38,7 +41,7 @@ void Animation::Load(const Scene::TValueMap& obj)
 {
 	try {
 		// channels
-		const auto& channel = obj.at("channel").as_string().value();
+		const std::string channel(obj.at("channel").as_string().value());
 		if (channel == "rotation")
 			m_Channels.set((uint8_t)Channel::Rotation);
 		else if (channel == "translation") // TODO: verify this is translation and not position
@@ -49,7 +52,7 @@ void Animation::Load(const Scene::TValueMap& obj)
 			NE_WARN("Did not find this channel: " + channel);
 
 		// interporlation
-		const auto& lerp = obj.at("interpolation").as_string().value();
+		const std::string lerp(obj.at("interpolation").as_string().value());
 		if (lerp == "SLERP")
 			m_InterpolationMode = Interpolation::Slerp;
 		else if (lerp == "LERP")
@@ -61,61 +64,28 @@ void Animation::Load(const Scene::TValueMap& obj)
 
 		// times
 		keyframes.clear();
-		const auto& times = obj.at("times").as_array().value();
-		const auto& values = obj.at("values").as_array().value();
+		std::span<const float> times = obj.at("times").as_float_span().value();
+		std::span<const float> values = obj.at("values").as_float_span().value();
 
-		if (m_Channels.test((uint8_t)Channel::Rotation))
-		{
-			for (uint32_t i = 0; i < times.size(); ++i)
-			{
-				float ts = times[i].as_float();
-
-				duration = std::max(duration, ts);
+		size_t width = m_Channels.test((uint8_t)Channel::Rotation) ? 4 : 3;
+		if (values.size() < times.size() * width)
+			throw std::runtime_error(std::format("Expected {} values for {} keyframes, found {}", times.size() * width, times.size(), values.size()));
 
-				glm::quat rot;
-				rot.x = values[i * 4].as_float();
-				rot.y = values[i * 4 + 1].as_float();
-				rot.z = values[i * 4 + 2].as_float();
-				rot.w = values[i * 4 + 3].as_float();
-
-				keyframes.emplace_back(ts, rot);
-			}
-		}
-		if (m_Channels.test((uint8_t)Channel::Position))
+		// values are packed floats, copy each keyframe's vector straight out of them
+		keyframes.resize(times.size());
+		for (size_t i = 0; i < times.size(); ++i)
 		{
-			for (uint32_t i = 0; i < times.size(); ++i)
-			{
-				float ts = times[i].as_float();
-
-				duration = std::max(duration, ts);
-
-				glm::vec3 v;
-				v.x = values[i * 3].as_float();
-				v.y = values[i * 3 + 1].as_float();
-				v.z = values[i * 3 + 2].as_float();
-
-				keyframes.emplace_back(ts, v);
-			}
-		}
-		if (m_Channels.test((uint8_t)Channel::Scale))
-		{
-			for (uint32_t i = 0; i < times.size(); ++i)
-			{
-				float ts = times[i].as_float();
-
-				duration = std::max(duration, ts);
-
-				glm::vec3 v;
-				v.x = values[i * 3].as_float();
-				v.y = values[i * 3 + 1].as_float();
-				v.z = values[i * 3 + 2].as_float();
-
-				Keyframe kf;
-				kf.timestamp = ts;
-				kf.scale = v;
-
-				keyframes.emplace_back(kf);
-			}
+			Keyframe& kf = keyframes[i];
+			kf.timestamp = times[i];
+			duration = std::max(duration, times[i]);
+
+			const float* v = values.data() + i * width;
+			if (m_Channels.test((uint8_t)Channel::Rotation))
+				kf.rotation = glm::quat(v[3], v[0], v[1], v[2]); // s72 stores xyzw
+			else if (m_Channels.test((uint8_t)Channel::Position))
+				std::memcpy(&kf.position, v, sizeof(glm::vec3));
+			else if (m_Channels.test((uint8_t)Channel::Scale))
+				std::memcpy(&kf.scale, v, sizeof(glm::vec3));
 		}
 	}
 	catch (std::exception & e) {
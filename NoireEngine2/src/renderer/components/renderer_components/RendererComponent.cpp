@@ -5,7 +5,6 @@
 #include "renderer/components/CameraComponent.hpp"
 #include "renderer/object/Mesh.hpp"
 #include "renderer/materials/Material.hpp"
-#include "Application.hpp"
 #include "renderer/Renderer.hpp"
 
 #include "imgui/imgui.h"
@@ -28,42 +27,26 @@ void RendererComponent::Update()
 
 void RendererComponent::Render(const glm::mat4& model)
 {
-	mesh->Update(model);
+	InstanceRegistry& registry = GetScene()->GetInstanceRegistry();
 
-	static auto cullMode = Application::GetSpecification().Culling;
-
-	// frustum culling
-	if (cullMode == ApplicationSpecification::Culling::Frustum) 
+	// only rewrite the instance when the transform actually changed
+	if (entity->transform()->wasDirtyThisFrame)
 	{
-		const Camera* cullCam = GetScene()->GetCullingCam()->camera();
-
-		assert(cullCam && "No active culling camera");
-		if (!cullCam->getViewFrustum().CubeInFrustum(mesh->getAABB().min, mesh->getAABB().max))
-			return;
+		registry.SetTransform(m_InstanceSlot, model);
+		GetScene()->GetBVH().Move(m_BVHProxy, registry.getWorldAABB(m_InstanceSlot));
 	}
 
-	const Camera* renderCam = GetScene()->GetRenderCam()->camera();
-
-	ObjectInstance objectInstance(
-		renderCam->getWorldToClipMatrix() * model,
-		model, // model
-		glm::inverse(model), // normal
-		0, //  first vertex
-		mesh, // mesh pointer
-		material, // material pointer
-		entity->id() // entity ID)
-	);
-
-	GetScene()->GetObjectInstances((uint32_t)material->getWorkflow()).emplace_back(objectInstance);
+	// culling happens for all instances at once in Scene::CullInstances
 
 	if (Renderer::UseGizmos && useGizmos) {
-		gizmos.DrawWireCube1(mesh->getAABB().min, mesh->getAABB().max, Color4_4::Green);
+		AABB bounds = registry.getWorldAABB(m_InstanceSlot);
+		gizmos.DrawWireCube1(bounds.min, bounds.max, Color4_4::Green);
 		GetScene()->PushGizmosInstance(&gizmos);
 	}
 
 	if (Editor::Get()->GetSelectedRendererComponent() == this)
 	{
-		GetScene()->GetSelectedObjectInstances().emplace_back(objectInstance);
+		GetScene()->GetSelectedObjectInstances().emplace_back(registry[m_InstanceSlot]);
 	}
 }
 
@@ -99,25 +82,27 @@ void RendererComponent::Inspect()
 
 void RendererComponent::PrepareAcceleration(const glm::mat4& model)
 {
-	const Camera* renderCam = GetScene()->GetRenderCam()->camera();
-	GetScene()->GetObjectInstances((uint32_t)material->getWorkflow())
-		.emplace_back(
-			renderCam->getWorldToClipMatrix() * model,
-			model, // model
-			glm::inverse(model), // normal
-			0, //  first vertex
-			mesh, // mesh pointer
-			material, // material pointer
-			entity->id() // entity ID
-		);
+	InstanceRegistry& registry = GetScene()->GetInstanceRegistry();
+	registry.SetTransform(m_InstanceSlot, model);
+	GetScene()->GetBVH().Move(m_BVHProxy, registry.getWorldAABB(m_InstanceSlot));
 }
 
 template<>
 void Scene::OnComponentAdded<RendererComponent>(Entity& entity, RendererComponent& component)
 {
+	component.m_InstanceSlot = m_InstanceRegistry.Allocate(component.mesh, component.material, entity.id());
+	component.m_BVHProxy = m_BVH.Insert(m_InstanceRegistry.getWorldAABB(component.m_InstanceSlot), component.m_InstanceSlot, entity.id());
+
+	// the slot starts out as identity, force the world matrix to be resolved and written next frame
+	entity.transform()->isDirty = true;
 }
 
 template<>
 void Scene::OnComponentRemoved<RendererComponent>(Entity& entity, RendererComponent& component)
 {
+	m_BVH.Remove(component.m_BVHProxy);
+	component.m_BVHProxy = BVH::NULL_NODE;
+
+	m_InstanceRegistry.Free(component.m_InstanceSlot);
+	component.m_InstanceSlot = InstanceRegistry::INVALID_SLOT;
 }
\ No newline at end of file
@@ -24,7 +24,13 @@ public:
 	Material* material = nullptr;
 	GizmosInstance gizmos;
 
+	// slot in the scene's instance registry
+	inline uint32_t getInstanceSlot() const { return m_InstanceSlot; }
+
 private:
-	friend class Entity;
+	friend class Scene;
 	void PrepareAcceleration(const glm::mat4& model);
+
+	uint32_t m_InstanceSlot = ~0u;
+	uint32_t m_BVHProxy = ~0u;
 };
@@ -0,0 +1,455 @@
+#include "BVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// rebuild once this fraction of the leaves was inserted or removed incrementally
+static constexpr float REBUILD_CHANGE_RATIO = 0.25f;
+
+static constexpr uint32_t SAH_BINS = 12;
+
+static inline AABB Union(const AABB& a, const AABB& b)
+{
+	return AABB(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+static inline float SurfaceArea(const AABB& a)
+{
+	glm::vec3 d = a.max - a.min;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static inline AABB EmptyAABB()
+{
+	return AABB(glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+uint32_t BVH::Insert(const AABB& bounds, uint32_t slot, uint64_t entityID)
+{
+	uint32_t leaf = AllocateNode();
+	Node& node = m_Nodes[leaf];
+	node.bounds = bounds;
+	node.slot = slot;
+	node.entityID = entityID;
+
+	InsertLeaf(leaf);
+	m_NumLeaves++;
+	m_ChangesSinceBuild++;
+
+	return leaf;
+}
+
+void BVH::Remove(uint32_t proxy)
+{
+	assert(proxy < m_Nodes.size() && m_Nodes[proxy].IsLeaf());
+
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_NumLeaves--;
+	m_ChangesSinceBuild++;
+
+	// a pending refit of this leaf would walk a stale parent chain
+	std::erase(m_Moved, proxy);
+}
+
+void BVH::Move(uint32_t proxy, const AABB& bounds)
+{
+	m_Nodes[proxy].bounds = bounds;
+	m_Moved.emplace_back(proxy);
+}
+
+void BVH::Refit()
+{
+	if (m_ChangesSinceBuild > 0 && m_ChangesSinceBuild >= uint32_t(m_NumLeaves * REBUILD_CHANGE_RATIO))
+	{
+		Rebuild();
+		return;
+	}
+
+	for (uint32_t leaf : m_Moved)
+		RefitAncestors(m_Nodes[leaf].parent);
+	m_Moved.clear();
+}
+
+void BVH::Rebuild()
+{
+	std::vector<uint32_t> leaves;
+	leaves.reserve(m_NumLeaves);
+
+	// keep the leaves, free every internal node
+	for (uint32_t i = 0; i < m_Nodes.size(); ++i)
+	{
+		if (m_Nodes[i].IsFree())
+			continue;
+
+		if (m_Nodes[i].IsLeaf())
+			leaves.emplace_back(i);
+		else
+			FreeNode(i);
+	}
+
+	m_Root = leaves.empty() ? NULL_NODE : BuildRecursive(leaves.data(), (uint32_t)leaves.size());
+	if (m_Root != NULL_NODE)
+		m_Nodes[m_Root].parent = NULL_NODE;
+
+	m_Moved.clear();
+	m_ChangesSinceBuild = 0;
+}
+
+uint32_t BVH::getHeight() const
+{
+	uint32_t height = 0;
+	for (uint32_t i = 0; i < m_Nodes.size(); ++i)
+	{
+		if (m_Nodes[i].IsFree() || !m_Nodes[i].IsLeaf())
+			continue;
+
+		uint32_t depth = 0;
+		for (uint32_t n = i; n != m_Root; n = m_Nodes[n].parent)
+			depth++;
+		height = std::max(height, depth);
+	}
+	return height;
+}
+
+uint32_t BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& outDistance) const
+{
+	m_NodesVisited = 0;
+	uint32_t closest = NULL_NODE;
+	outDistance = maxDistance;
+
+	if (m_Root == NULL_NODE)
+		return closest;
+
+	glm::vec3 invDir = 1.0f / direction;
+
+	// slab test, returns the entry distance or FLT_MAX on a miss
+	auto intersect = [&](const AABB& bounds) {
+		glm::vec3 t0 = (bounds.min - origin) * invDir;
+		glm::vec3 t1 = (bounds.max - origin) * invDir;
+		glm::vec3 tmin = glm::min(t0, t1), tmax = glm::max(t0, t1);
+
+		float enter = std::max(std::max(tmin.x, tmin.y), std::max(tmin.z, 0.0f));
+		float exit = std::min(std::min(tmax.x, tmax.y), tmax.z);
+		return enter <= exit && enter < outDistance ? enter : FLT_MAX;
+	};
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(m_Root);
+
+	while (!stack.empty())
+	{
+		const Node& n = m_Nodes[stack.back()];
+		stack.pop_back();
+		m_NodesVisited++;
+
+		float t = intersect(n.bounds);
+		if (t == FLT_MAX)
+			continue;
+
+		if (n.IsLeaf())
+		{
+			outDistance = t;
+			closest = uint32_t(&n - m_Nodes.data());
+			continue;
+		}
+
+		// visit the nearer child first so farther subtrees get rejected by outDistance
+		float tl = intersect(m_Nodes[n.left].bounds);
+		float tr = intersect(m_Nodes[n.right].bounds);
+		if (tl < tr)
+		{
+			if (tr != FLT_MAX) stack.push_back(n.right);
+			stack.push_back(n.left);
+		}
+		else
+		{
+			if (tl != FLT_MAX) stack.push_back(n.left);
+			if (tr != FLT_MAX) stack.push_back(n.right);
+		}
+	}
+
+	return closest;
+}
+
+uint32_t BVH::AllocateNode()
+{
+	uint32_t node;
+	if (m_FreeList != NULL_NODE)
+	{
+		node = m_FreeList;
+		m_FreeList = m_Nodes[node].left;
+		m_NumFree--;
+	}
+	else
+	{
+		node = (uint32_t)m_Nodes.size();
+		m_Nodes.emplace_back();
+	}
+
+	m_Nodes[node] = Node{};
+	return node;
+}
+
+void BVH::FreeNode(uint32_t node)
+{
+	m_Nodes[node] = Node{};
+	m_Nodes[node].parent = FREE_NODE;
+	m_Nodes[node].left = m_FreeList;
+	m_FreeList = node;
+	m_NumFree++;
+}
+
+void BVH::InsertLeaf(uint32_t leaf)
+{
+	if (m_Root == NULL_NODE)
+	{
+		m_Root = leaf;
+		m_Nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// walk down picking the child with the lower SAH cost increase, until a leaf is cheaper to pair with
+	const AABB leafBounds = m_Nodes[leaf].bounds;
+	uint32_t sibling = m_Root;
+	while (!m_Nodes[sibling].IsLeaf())
+	{
+		const Node& node = m_Nodes[sibling];
+
+		float area = SurfaceArea(node.bounds);
+		float combinedArea = SurfaceArea(Union(node.bounds, leafBounds));
+
+		// cost of making a new parent for this node and the leaf
+		float cost = 2.0f * combinedArea;
+
+		// minimum cost of pushing the leaf further down
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		auto descendCost = [&](uint32_t child) {
+			const AABB& childBounds = m_Nodes[child].bounds;
+			float newArea = SurfaceArea(Union(childBounds, leafBounds));
+			if (m_Nodes[child].IsLeaf())
+				return newArea + inheritanceCost;
+			return (newArea - SurfaceArea(childBounds)) + inheritanceCost;
+		};
+
+		float costLeft = descendCost(node.left);
+		float costRight = descendCost(node.right);
+
+		if (cost < costLeft && cost < costRight)
+			break;
+
+		sibling = costLeft < costRight ? node.left : node.right;
+	}
+
+	uint32_t oldParent = m_Nodes[sibling].parent;
+	uint32_t newParent = AllocateNode();
+
+	Node& parent = m_Nodes[newParent];
+	parent.parent = oldParent;
+	parent.bounds = Union(leafBounds, m_Nodes[sibling].bounds);
+	parent.left = sibling;
+	parent.right = leaf;
+
+	m_Nodes[sibling].parent = newParent;
+	m_Nodes[leaf].parent = newParent;
+
+	if (oldParent == NULL_NODE)
+	{
+		m_Root = newParent;
+		return;
+	}
+
+	if (m_Nodes[oldParent].left == sibling)
+		m_Nodes[oldParent].left = newParent;
+	else
+		m_Nodes[oldParent].right = newParent;
+
+	RefitAncestors(oldParent);
+}
+
+void BVH::RemoveLeaf(uint32_t leaf)
+{
+	if (leaf == m_Root)
+	{
+		m_Root = NULL_NODE;
+		return;
+	}
+
+	uint32_t parent = m_Nodes[leaf].parent;
+	uint32_t grandParent = m_Nodes[parent].parent;
+	uint32_t sibling = m_Nodes[parent].left == leaf ? m_Nodes[parent].right : m_Nodes[parent].left;
+
+	// the sibling takes the place of the parent
+	m_Nodes[sibling].parent = grandParent;
+	FreeNode(parent);
+
+	if (grandParent == NULL_NODE)
+	{
+		m_Root = sibling;
+		return;
+	}
+
+	if (m_Nodes[grandParent].left == parent)
+		m_Nodes[grandParent].left = sibling;
+	else
+		m_Nodes[grandParent].right = sibling;
+
+	RefitAncestors(grandParent);
+}
+
+void BVH::RefitAncestors(uint32_t node)
+{
+	while (node != NULL_NODE)
+	{
+		Node& n = m_Nodes[node];
+		AABB bounds = Union(m_Nodes[n.left].bounds, m_Nodes[n.right].bounds);
+
+		// moves shared by several leaves stop at the first ancestor that is already up to date
+		if (bounds.min == n.bounds.min && bounds.max == n.bounds.max)
+			break;
+
+		n.bounds = bounds;
+		node = n.parent;
+	}
+}
+
+uint32_t BVH::BuildRecursive(uint32_t* leaves, uint32_t count)
+{
+	if (count == 1)
+		return leaves[0];
+
+	AABB bounds = EmptyAABB(), centroidBounds = EmptyAABB();
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const AABB& b = m_Nodes[leaves[i]].bounds;
+		bounds = Union(bounds, b);
+
+		glm::vec3 c = b.center();
+		centroidBounds = Union(centroidBounds, AABB(c, c));
+	}
+
+	// binned SAH over all three axes
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	glm::vec3 centroidExtent = centroidBounds.max - centroidBounds.min;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (centroidExtent[axis] <= 0.0f)
+			continue;
+
+		AABB binBounds[SAH_BINS];
+		uint32_t binCounts[SAH_BINS] = {};
+		std::fill(std::begin(binBounds), std::end(binBounds), EmptyAABB());
+
+		float scale = SAH_BINS / centroidExtent[axis];
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const AABB& b = m_Nodes[leaves[i]].bounds;
+			uint32_t bin = std::min(SAH_BINS - 1, uint32_t((b.center()[axis] - centroidBounds.min[axis]) * scale));
+			binCounts[bin]++;
+			binBounds[bin] = Union(binBounds[bin], b);
+		}
+
+		// sweep from the right to get the cost of every suffix, then from the left
+		float rightArea[SAH_BINS];
+		uint32_t rightCount[SAH_BINS];
+		AABB accum = EmptyAABB();
+		uint32_t accumCount = 0;
+		for (int i = SAH_BINS - 1; i > 0; --i)
+		{
+			accum = Union(accum, binBounds[i]);
+			accumCount += binCounts[i];
+			rightArea[i] = accumCount ? SurfaceArea(accum) : 0.0f;
+			rightCount[i] = accumCount;
+		}
+
+		accum = EmptyAABB();
+		accumCount = 0;
+		for (uint32_t i = 0; i < SAH_BINS - 1; ++i)
+		{
+			accum = Union(accum, binBounds[i]);
+			accumCount += binCounts[i];
+			if (accumCount == 0 || rightCount[i + 1] == 0)
+				continue;
+
+			float cost = SurfaceArea(accum) * accumCount + rightArea[i + 1] * rightCount[i + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	uint32_t mid;
+	if (bestAxis < 0)
+	{
+		// all centroids coincide, split in half
+		mid = count / 2;
+	}
+	else
+	{
+		float scale = SAH_BINS / centroidExtent[bestAxis];
+		uint32_t* split = std::partition(leaves, leaves + count, [&](uint32_t leaf) {
+			float c = m_Nodes[leaf].bounds.center()[bestAxis];
+			return std::min(SAH_BINS - 1, uint32_t((c - centroidBounds.min[bestAxis]) * scale)) <= bestSplit;
+		});
+		mid = uint32_t(split - leaves);
+	}
+
+	uint32_t left = BuildRecursive(leaves, mid);
+	uint32_t right = BuildRecursive(leaves + mid, count - mid);
+
+	uint32_t node = AllocateNode();
+	Node& n = m_Nodes[node];
+	n.bounds = bounds;
+	n.left = left;
+	n.right = right;
+	m_Nodes[left].parent = node;
+	m_Nodes[right].parent = node;
+
+	return node;
+}
+
+bool BVH::ClassifyFrustum(const Frustum& frustum, const AABB& bounds, uint32_t& planeMask)
+{
+	const auto& planes = frustum.getPlanes();
+	glm::vec3 center = bounds.center();
+	glm::vec3 extent = bounds.extent();
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		if (!(planeMask & (1u << i)))
+			continue;
+
+		glm::vec3 normal(planes[i][0], planes[i][1], planes[i][2]);
+		float dist = glm::dot(normal, center) + planes[i][3];
+		float radius = glm::dot(glm::abs(normal), extent);
+
+		if (dist + radius <= 0.0f)
+			return false;
+
+		// every corner is in front of this plane, children don't need to test it again
+		if (dist - radius > 0.0f)
+			planeMask &= ~(1u << i);
+	}
+
+	return true;
+}
+
+bool BVH::Overlaps(const AABB& a, const AABB& b)
+{
+	return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+}
+
+bool BVH::Overlaps(const AABB& a, const glm::vec3& center, float radius)
+{
+	glm::vec3 closest = glm::clamp(center, a.min, a.max);
+	glm::vec3 d = closest - center;
+	return glm::dot(d, d) <= radius * radius;
+}
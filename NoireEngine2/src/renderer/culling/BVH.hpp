@@ -0,0 +1,203 @@
+#pragma once
+
+#include "renderer/AABB.hpp"
+#include "renderer/Frustum.hpp"
+
+#include <vector>
+#include <cfloat>
+
+/**
+ * Dynamic bounding volume hierarchy over world space boxes, one leaf per renderable.
+ * Leaves are inserted and removed incrementally, moved leaves are refit in one pass,
+ * and the whole tree can be rebuilt top-down with a binned SAH when it degrades.
+ * Leaf indices (proxies) stay valid across rebuilds, only internal nodes are recreated.
+ */
+class BVH
+{
+public:
+	static constexpr uint32_t NULL_NODE = ~0u;
+	static constexpr uint32_t FREE_NODE = ~0u - 1; // parent of nodes on the free list
+
+	struct Node
+	{
+		AABB		bounds;
+		uint32_t	parent = NULL_NODE;
+		uint32_t	left = NULL_NODE; // also the free list link
+		uint32_t	right = NULL_NODE; // NULL_NODE for leaves
+
+		// leaves only
+		uint32_t	slot = 0;
+		uint64_t	entityID = 0;
+
+		inline bool IsLeaf() const { return right == NULL_NODE; }
+		inline bool IsFree() const { return parent == FREE_NODE; }
+	};
+
+	// returns the proxy of the new leaf
+	uint32_t Insert(const AABB& bounds, uint32_t slot, uint64_t entityID);
+
+	void Remove(uint32_t proxy);
+
+	// updates the leaf box, ancestors are fixed up by the next Refit()
+	void Move(uint32_t proxy, const AABB& bounds);
+
+	// refits the ancestors of every moved leaf, and rebuilds if too many inserts/removes happened since the last build
+	void Refit();
+
+	// discards all internal nodes and builds them again with a binned SAH
+	void Rebuild();
+
+	inline const Node& getNode(uint32_t proxy) const { return m_Nodes[proxy]; }
+	inline uint32_t getNumLeaves() const { return m_NumLeaves; }
+	inline uint32_t getNumNodes() const { return (uint32_t)m_Nodes.size() - m_NumFree; }
+	uint32_t getHeight() const;
+
+	// nodes visited by the last query
+	inline uint32_t getNodesVisited() const { return m_NodesVisited; }
+
+	// calls fn(const Node& leaf) for every leaf whose box is not fully outside the frustum
+	template<typename F>
+	void QueryFrustum(const Frustum& frustum, F&& fn) const;
+
+	// same, but only tests the planes in planeMask and counts into nodesVisited, so several threads can query at once
+	template<typename F>
+	void QueryFrustum(const Frustum& frustum, uint32_t planeMask, uint32_t& nodesVisited, F&& fn) const;
+
+	// calls fn(const Node& leaf) for every leaf whose box overlaps the sphere
+	template<typename F>
+	void QuerySphere(const glm::vec3& center, float radius, F&& fn) const;
+
+	// same, but counts into nodesVisited, so several threads can query at once
+	template<typename F>
+	void QuerySphere(const glm::vec3& center, float radius, uint32_t& nodesVisited, F&& fn) const;
+
+	// calls fn(const Node& leaf) for every leaf whose box overlaps bounds
+	template<typename F>
+	void QueryAABB(const AABB& bounds, F&& fn) const;
+
+	// closest leaf whose box is hit by the ray, or NULL_NODE. outDistance is the entry distance
+	uint32_t Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& outDistance) const;
+
+private:
+	uint32_t AllocateNode();
+	void FreeNode(uint32_t node);
+
+	void InsertLeaf(uint32_t leaf);
+	void RemoveLeaf(uint32_t leaf);
+	void RefitAncestors(uint32_t node);
+
+	uint32_t BuildRecursive(uint32_t* leaves, uint32_t count);
+
+	// false if the box is outside one of the planes in planeMask. Clears the bits of planes the box is fully in front of
+	static bool ClassifyFrustum(const Frustum& frustum, const AABB& bounds, uint32_t& planeMask);
+
+	static bool Overlaps(const AABB& a, const AABB& b);
+	static bool Overlaps(const AABB& a, const glm::vec3& center, float radius);
+
+	// generic traversal, descends into every node for which overlaps(bounds) is true
+	template<typename F, typename TOverlap>
+	void Query(F& fn, TOverlap&& overlaps, uint32_t& nodesVisited) const;
+
+private:
+	std::vector<Node>		m_Nodes;
+	uint32_t				m_Root = NULL_NODE;
+	uint32_t				m_FreeList = NULL_NODE;
+	uint32_t				m_NumFree = 0;
+	uint32_t				m_NumLeaves = 0;
+
+	std::vector<uint32_t>	m_Moved;
+	uint32_t				m_ChangesSinceBuild = 0;
+
+	mutable uint32_t		m_NodesVisited = 0;
+};
+
+template<typename F>
+void BVH::QueryFrustum(const Frustum& frustum, F&& fn) const
+{
+	QueryFrustum(frustum, 0x3F, m_NodesVisited, fn);
+}
+
+template<typename F>
+void BVH::QueryFrustum(const Frustum& frustum, uint32_t planeMask, uint32_t& nodesVisited, F&& fn) const
+{
+	nodesVisited = 0;
+	if (m_Root == NULL_NODE)
+		return;
+
+	// each entry carries the planes its parent was not fully in front of yet.
+	// once the mask is empty the whole subtree is inside and no more planes are tested
+	struct Entry { uint32_t node, planeMask; };
+	std::vector<Entry> stack;
+	stack.reserve(64);
+	stack.push_back({ m_Root, planeMask });
+
+	while (!stack.empty())
+	{
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		const Node& n = m_Nodes[entry.node];
+		nodesVisited++;
+
+		if (entry.planeMask != 0 && !ClassifyFrustum(frustum, n.bounds, entry.planeMask))
+			continue;
+
+		if (n.IsLeaf())
+		{
+			fn(n);
+			continue;
+		}
+
+		stack.push_back({ n.left, entry.planeMask });
+		stack.push_back({ n.right, entry.planeMask });
+	}
+}
+
+template<typename F, typename TOverlap>
+void BVH::Query(F& fn, TOverlap&& overlaps, uint32_t& nodesVisited) const
+{
+	nodesVisited = 0;
+	if (m_Root == NULL_NODE)
+		return;
+
+	std::vector<uint32_t> stack;
+	stack.reserve(64);
+	stack.push_back(m_Root);
+
+	while (!stack.empty())
+	{
+		const Node& n = m_Nodes[stack.back()];
+		stack.pop_back();
+		nodesVisited++;
+
+		if (!overlaps(n.bounds))
+			continue;
+
+		if (n.IsLeaf())
+		{
+			fn(n);
+			continue;
+		}
+
+		stack.push_back(n.left);
+		stack.push_back(n.right);
+	}
+}
+
+template<typename F>
+void BVH::QuerySphere(const glm::vec3& center, float radius, F&& fn) const
+{
+	Query(fn, [&](const AABB& bounds) { return Overlaps(bounds, center, radius); }, m_NodesVisited);
+}
+
+template<typename F>
+void BVH::QuerySphere(const glm::vec3& center, float radius, uint32_t& nodesVisited, F&& fn) const
+{
+	Query(fn, [&](const AABB& bounds) { return Overlaps(bounds, center, radius); }, nodesVisited);
+}
+
+template<typename F>
+void BVH::QueryAABB(const AABB& query, F&& fn) const
+{
+	Query(fn, [&](const AABB& bounds) { return Overlaps(bounds, query); }, m_NodesVisited);
+}
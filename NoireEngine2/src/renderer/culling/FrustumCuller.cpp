@@ -0,0 +1,405 @@
+#include "FrustumCuller.hpp"
+
+#include "core/jobs/JobSystem.hpp"
+#include "core/Timer.hpp"
+#include "utils/Logger.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+	#define NE_CULLING_X86
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+// msvc allows any intrinsic in any function, gcc and clang need the target enabled per function
+#if defined(_MSC_VER) && !defined(__clang__)
+	#define NE_TARGET(x)
+#else
+	#define NE_TARGET(x) __attribute__((target(x)))
+#endif
+
+// boxes per job. Multiple of CullingBounds::CULLING_BATCH, so every chunk starts on a full batch
+static constexpr uint32_t CULLING_CHUNK = 1024;
+
+void CullingBounds::Resize(uint32_t count)
+{
+	uint32_t padded = (count + CULLING_BATCH - 1) / CULLING_BATCH * CULLING_BATCH;
+	if (padded <= size())
+		return;
+
+	centerX.resize(padded, 0.0f);
+	centerY.resize(padded, 0.0f);
+	centerZ.resize(padded, 0.0f);
+	extentX.resize(padded, -FLT_MAX);
+	extentY.resize(padded, -FLT_MAX);
+	extentZ.resize(padded, -FLT_MAX);
+	radius.resize(padded, -FLT_MAX);
+}
+
+void CullingBounds::Set(uint32_t slot, const glm::vec3& center, const glm::vec3& extent, float sphereRadius)
+{
+	centerX[slot] = center.x;
+	centerY[slot] = center.y;
+	centerZ[slot] = center.z;
+	extentX[slot] = extent.x;
+	extentY[slot] = extent.y;
+	extentZ[slot] = extent.z;
+	radius[slot] = sphereRadius;
+}
+
+void CullingBounds::SetEmpty(uint32_t slot)
+{
+	Set(slot, glm::vec3(0), glm::vec3(-FLT_MAX), -FLT_MAX);
+}
+
+// planes split into per-component arrays, with the absolute normal precomputed for the extent projection
+struct CullingPlanes
+{
+	float nx[6], ny[6], nz[6], d[6];
+	float ax[6], ay[6], az[6];
+
+	CullingPlanes(const Frustum& frustum)
+	{
+		const auto& planes = frustum.getPlanes();
+		for (int i = 0; i < 6; ++i)
+		{
+			nx[i] = planes[i][0]; ny[i] = planes[i][1]; nz[i] = planes[i][2]; d[i] = planes[i][3];
+			ax[i] = std::abs(nx[i]); ay[i] = std::abs(ny[i]); az[i] = std::abs(nz[i]);
+		}
+	}
+};
+
+// culls the boxes in [begin, end), writing visible slots to out. Returns the number written.
+// a box is outside if its farthest point along a plane normal is still behind it:
+// dot(n, c) + d + dot(|n|, e) <= 0, the same result as testing all 8 corners.
+using CullKernel = uint32_t(*)(const CullingPlanes&, const CullingBounds&, uint32_t begin, uint32_t end, uint32_t* out);
+
+static uint32_t CullScalar(const CullingPlanes& p, const CullingBounds& b, uint32_t begin, uint32_t end, uint32_t* out)
+{
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		bool visible = true;
+		for (int j = 0; j < 6 && visible; ++j)
+		{
+			float dist = p.nx[j] * b.centerX[i] + p.ny[j] * b.centerY[i] + p.nz[j] * b.centerZ[i] + p.d[j];
+			float radius = p.ax[j] * b.extentX[i] + p.ay[j] * b.extentY[i] + p.az[j] * b.extentZ[i];
+			visible = dist + radius > 0.0f;
+		}
+
+		if (visible)
+			out[count++] = i;
+	}
+	return count;
+}
+
+// appends the set bits of a lane mask as slot indices
+static inline uint32_t WriteMask(uint32_t mask, uint32_t base, uint32_t* out)
+{
+	uint32_t count = 0;
+	while (mask)
+	{
+		out[count++] = base + std::countr_zero(mask);
+		mask &= mask - 1;
+	}
+	return count;
+}
+
+#ifdef NE_CULLING_X86
+
+static uint32_t CullSSE(const CullingPlanes& p, const CullingBounds& b, uint32_t begin, uint32_t end, uint32_t* out)
+{
+	uint32_t count = 0;
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&b.centerX[i]), cy = _mm_loadu_ps(&b.centerY[i]), cz = _mm_loadu_ps(&b.centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&b.extentX[i]), ey = _mm_loadu_ps(&b.extentY[i]), ez = _mm_loadu_ps(&b.extentZ[i]);
+
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int j = 0; j < 6; ++j)
+		{
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nx[j]), cx), _mm_mul_ps(_mm_set1_ps(p.ny[j]), cy)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.nz[j]), cz), _mm_set1_ps(p.d[j])));
+			__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.ax[j]), ex), _mm_mul_ps(_mm_set1_ps(p.ay[j]), ey)),
+				_mm_mul_ps(_mm_set1_ps(p.az[j]), ez));
+			visible = _mm_and_ps(visible, _mm_cmpgt_ps(_mm_add_ps(dist, radius), zero));
+		}
+
+		count += WriteMask((uint32_t)_mm_movemask_ps(visible), i, out + count);
+	}
+	return count;
+}
+
+NE_TARGET("avx2")
+static uint32_t CullAVX2(const CullingPlanes& p, const CullingBounds& b, uint32_t begin, uint32_t end, uint32_t* out)
+{
+	uint32_t count = 0;
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&b.centerX[i]), cy = _mm256_loadu_ps(&b.centerY[i]), cz = _mm256_loadu_ps(&b.centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&b.extentX[i]), ey = _mm256_loadu_ps(&b.extentY[i]), ez = _mm256_loadu_ps(&b.extentZ[i]);
+
+		__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int j = 0; j < 6; ++j)
+		{
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.nx[j]), cx), _mm256_mul_ps(_mm256_set1_ps(p.ny[j]), cy)),
+				_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.nz[j]), cz), _mm256_set1_ps(p.d[j])));
+			__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(p.ax[j]), ex), _mm256_mul_ps(_mm256_set1_ps(p.ay[j]), ey)),
+				_mm256_mul_ps(_mm256_set1_ps(p.az[j]), ez));
+			visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_GT_OQ));
+		}
+
+		count += WriteMask((uint32_t)_mm256_movemask_ps(visible), i, out + count);
+	}
+	return count;
+}
+
+NE_TARGET("avx512f")
+static uint32_t CullAVX512(const CullingPlanes& p, const CullingBounds& b, uint32_t begin, uint32_t end, uint32_t* out)
+{
+	uint32_t count = 0;
+	const __m512 zero = _mm512_setzero_ps();
+
+	for (uint32_t i = begin; i < end; i += 16)
+	{
+		__m512 cx = _mm512_loadu_ps(&b.centerX[i]), cy = _mm512_loadu_ps(&b.centerY[i]), cz = _mm512_loadu_ps(&b.centerZ[i]);
+		__m512 ex = _mm512_loadu_ps(&b.extentX[i]), ey = _mm512_loadu_ps(&b.extentY[i]), ez = _mm512_loadu_ps(&b.extentZ[i]);
+
+		__mmask16 visible = 0xFFFF;
+		for (int j = 0; j < 6; ++j)
+		{
+			__m512 dist = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(p.nx[j]), cx), _mm512_mul_ps(_mm512_set1_ps(p.ny[j]), cy)),
+				_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(p.nz[j]), cz), _mm512_set1_ps(p.d[j])));
+			__m512 radius = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(p.ax[j]), ex), _mm512_mul_ps(_mm512_set1_ps(p.ay[j]), ey)),
+				_mm512_mul_ps(_mm512_set1_ps(p.az[j]), ez));
+			visible = _mm512_mask_cmp_ps_mask(visible, _mm512_add_ps(dist, radius), zero, _CMP_GT_OQ);
+		}
+
+		count += WriteMask((uint32_t)visible, i, out + count);
+	}
+	return count;
+}
+
+#endif
+
+static CullKernel GetKernel(FrustumCuller::Kernel kernel)
+{
+	switch (kernel)
+	{
+#ifdef NE_CULLING_X86
+	case FrustumCuller::Kernel::SSE: return CullSSE;
+	case FrustumCuller::Kernel::AVX2: return CullAVX2;
+	case FrustumCuller::Kernel::AVX512: return CullAVX512;
+#endif
+	default: return CullScalar;
+	}
+}
+
+FrustumCuller::FrustumCuller() :
+	m_Kernel(DetectKernel())
+{
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, const CullingBounds& bounds, std::vector<uint32_t>& outVisible)
+{
+	Timer timer;
+
+	const CullingPlanes planes(frustum);
+	const CullKernel kernel = GetKernel(m_Kernel);
+	const uint32_t count = bounds.size();
+
+	outVisible.resize(count);
+
+	uint32_t numVisible;
+	if (count <= CULLING_CHUNK)
+	{
+		numVisible = kernel(planes, bounds, 0, count, outVisible.data());
+	}
+	else
+	{
+		// every chunk writes into its own range of the output, then the ranges are packed together
+		uint32_t numChunks = (count + CULLING_CHUNK - 1) / CULLING_CHUNK;
+		m_ChunkCounts.resize(numChunks);
+
+		const CullingPlanes* planesPtr = &planes;
+		const CullingBounds* boundsPtr = &bounds;
+		uint32_t* out = outVisible.data();
+		uint32_t* chunkCounts = m_ChunkCounts.data();
+
+		JobCounter counter;
+		JobSystem::Get()->Dispatch(counter, numChunks, 1, [=](uint32_t chunk) {
+			uint32_t begin = chunk * CULLING_CHUNK;
+			uint32_t end = std::min(begin + CULLING_CHUNK, count);
+			chunkCounts[chunk] = kernel(*planesPtr, *boundsPtr, begin, end, out + begin);
+		});
+		JobSystem::Get()->Wait(counter);
+
+		numVisible = m_ChunkCounts[0];
+		for (uint32_t chunk = 1; chunk < numChunks; ++chunk)
+		{
+			memmove(out + numVisible, out + chunk * CULLING_CHUNK, m_ChunkCounts[chunk] * sizeof(uint32_t));
+			numVisible += m_ChunkCounts[chunk];
+		}
+	}
+
+	outVisible.resize(numVisible);
+
+	m_NumTested = count;
+	m_NumVisible = numVisible;
+	m_LastCullTime = timer.GetElapsed(false);
+}
+
+void FrustumCuller::Cull(const Frustum& frustum, const BVH& bvh, std::vector<uint32_t>& outVisible)
+{
+	Timer timer;
+
+	outVisible.clear();
+	bvh.QueryFrustum(frustum, [&outVisible](const BVH::Node& leaf) {
+		outVisible.emplace_back(leaf.slot);
+	});
+
+	// tree order is spatial, slot order keeps meshes that were loaded together adjacent for batching
+	std::sort(outVisible.begin(), outVisible.end());
+
+	m_NumTested = bvh.getNodesVisited();
+	m_NumVisible = (uint32_t)outVisible.size();
+	m_LastCullTime = timer.GetElapsed(false);
+}
+
+void FrustumCuller::Benchmark(const Frustum& frustum, const CullingBounds& bounds, const BVH& bvh, uint32_t iterations)
+{
+	const CullingPlanes planes(frustum);
+	const uint32_t count = bounds.size();
+	if (count == 0)
+		return;
+
+	std::vector<uint32_t> out(count);
+	const double totalBoxes = double(count) * iterations;
+
+	// the old path: min/max per box, all 8 corners against every plane
+	{
+		uint32_t visible = 0;
+		Timer timer;
+		for (uint32_t it = 0; it < iterations; ++it)
+		{
+			visible = 0;
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+				glm::vec3 extent(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+				if (frustum.CubeInFrustum(center - extent, center + extent))
+					out[visible++] = i;
+			}
+		}
+		m_ReferenceBenchmarkResult = float(totalBoxes / (timer.GetElapsed(false) * 1e6));
+		NE_INFO("Culling benchmark [CubeInFrustum]: {:.3f} boxes/ns, {} visible", m_ReferenceBenchmarkResult, visible);
+	}
+
+	for (int k = 0; k < (int)Kernel::Count; ++k)
+	{
+		m_BenchmarkResults[k] = 0;
+		if (k > (int)m_Kernel)
+			continue;
+
+		const CullKernel kernel = GetKernel((Kernel)k);
+		uint32_t visible = 0;
+
+		Timer timer;
+		for (uint32_t it = 0; it < iterations; ++it)
+			visible = kernel(planes, bounds, 0, count, out.data());
+
+		m_BenchmarkResults[k] = float(totalBoxes / (timer.GetElapsed(false) * 1e6));
+		NE_INFO("Culling benchmark [{}]: {:.3f} boxes/ns, {} visible", KernelToString((Kernel)k), m_BenchmarkResults[k], visible);
+	}
+
+	// counted per leaf, so it stays comparable even though most of the tree is never touched
+	{
+		uint32_t visible = 0;
+		Timer timer;
+		for (uint32_t it = 0; it < iterations; ++it)
+		{
+			visible = 0;
+			bvh.QueryFrustum(frustum, [&](const BVH::Node& leaf) { out[visible++] = leaf.slot; });
+		}
+		m_BVHBenchmarkResult = float(double(bvh.getNumLeaves()) * iterations / (timer.GetElapsed(false) * 1e6));
+		NE_INFO("Culling benchmark [BVH]: {:.3f} boxes/ns, {} visible, {} nodes visited", m_BVHBenchmarkResult, visible, bvh.getNodesVisited());
+	}
+}
+
+FrustumCuller::Kernel FrustumCuller::DetectKernel()
+{
+#ifdef NE_CULLING_X86
+	auto cpuid = [](uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+		__cpuidex(reinterpret_cast<int*>(regs), (int)leaf, (int)subleaf);
+#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	};
+
+	auto xgetbv = []() -> uint64_t {
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		uint32_t eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((uint64_t)edx << 32) | eax;
+#endif
+	};
+
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	uint32_t maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	bool osxsave = regs[2] & (1u << 27);
+	bool avx = regs[2] & (1u << 28);
+
+	// the os has to save the wide registers on context switch, not just the cpu support them
+	uint64_t xcr0 = osxsave ? xgetbv() : 0;
+	bool osAVX = (xcr0 & 0x6) == 0x6;
+	bool osAVX512 = (xcr0 & 0xE6) == 0xE6;
+
+	if (maxLeaf >= 7 && avx && osAVX)
+	{
+		cpuid(7, 0, regs);
+		bool avx2 = regs[1] & (1u << 5);
+		bool avx512f = regs[1] & (1u << 16);
+
+		if (avx512f && osAVX512)
+			return Kernel::AVX512;
+		if (avx2)
+			return Kernel::AVX2;
+	}
+
+	// sse is always there on x64
+	return Kernel::SSE;
+#else
+	return Kernel::Scalar;
+#endif
+}
+
+const char* FrustumCuller::KernelToString(Kernel kernel)
+{
+	switch (kernel)
+	{
+	case Kernel::Scalar: return "Scalar";
+	case Kernel::SSE: return "SSE";
+	case Kernel::AVX2: return "AVX2";
+	case Kernel::AVX512: return "AVX-512";
+	default: return "Unknown";
+	}
+}
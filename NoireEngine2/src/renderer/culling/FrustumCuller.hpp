@@ -0,0 +1,87 @@
+#pragma once
+
+#include "renderer/Frustum.hpp"
+#include "BVH.hpp"
+
+#include <vector>
+
+/**
+ * World space bounds of every instance slot, as structure of arrays. Each slot has a box (center/extent)
+ * and a bounding sphere sharing the same center.
+ * Sizes are padded to a multiple of CULLING_BATCH so SIMD kernels can always load full lanes,
+ * padding and freed slots hold an empty box that never passes a plane test.
+ */
+struct CullingBounds
+{
+	static constexpr uint32_t CULLING_BATCH = 16;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+
+	// grows the arrays to hold at least count slots, new slots are empty
+	void Resize(uint32_t count);
+
+	void Set(uint32_t slot, const glm::vec3& center, const glm::vec3& extent, float sphereRadius);
+
+	void SetEmpty(uint32_t slot);
+
+	inline uint32_t size() const { return (uint32_t)centerX.size(); }
+};
+
+/**
+ * Tests packed world bounds against the six frustum planes, 4/8/16 boxes at a time depending on
+ * what the cpu supports. Large scenes are split into chunks and culled in parallel on the job system.
+ */
+class FrustumCuller
+{
+public:
+	enum class Kernel { Scalar, SSE, AVX2, AVX512, Count };
+
+	// Linear tests every slot with the SIMD kernels, BVH walks the scene tree and skips whole subtrees
+	enum class Method { Linear, BVH };
+
+	FrustumCuller();
+
+	// writes the slots of every visible box in ascending order
+	void Cull(const Frustum& frustum, const CullingBounds& bounds, std::vector<uint32_t>& outVisible);
+
+	// same output as the linear path, but only visits the nodes of the tree that intersect the frustum
+	void Cull(const Frustum& frustum, const BVH& bvh, std::vector<uint32_t>& outVisible);
+
+	// times every supported kernel and the bvh against the 8 corner Frustum::CubeInFrustum path, and logs boxes/ns
+	void Benchmark(const Frustum& frustum, const CullingBounds& bounds, const BVH& bvh, uint32_t iterations = 64);
+
+	// the best kernel supported by this cpu and os
+	static Kernel DetectKernel();
+
+	static const char* KernelToString(Kernel kernel);
+
+	inline Kernel getKernel() const { return m_Kernel; }
+
+	inline Method getMethod() const { return m_Method; }
+	inline void setMethod(Method method) { m_Method = method; }
+	inline float getLastCullTime() const { return m_LastCullTime; }
+	// boxes for the linear path, tree nodes for the bvh
+	inline uint32_t getNumTested() const { return m_NumTested; }
+	inline uint32_t getNumVisible() const { return m_NumVisible; }
+
+	// boxes per nanosecond of the last benchmark, 0 if a kernel was not run
+	inline float getBenchmarkResult(Kernel kernel) const { return m_BenchmarkResults[(int)kernel]; }
+	inline float getReferenceBenchmarkResult() const { return m_ReferenceBenchmarkResult; }
+	inline float getBVHBenchmarkResult() const { return m_BVHBenchmarkResult; }
+
+private:
+	Kernel		m_Kernel;
+	Method		m_Method = Method::BVH;
+
+	float		m_LastCullTime = 0; // ms
+	uint32_t	m_NumTested = 0;
+	uint32_t	m_NumVisible = 0;
+
+	float		m_BenchmarkResults[(int)Kernel::Count] = {};
+	float		m_ReferenceBenchmarkResult = 0;
+	float		m_BVHBenchmarkResult = 0;
+
+	std::vector<uint32_t> m_ChunkCounts;
+};
@@ -5,6 +5,8 @@
 #include "renderer/scene/SceneManager.hpp"
 #include "imgui/imgui.h"
 
+#include <cfloat>
+
 Light::Light(Type type_) :
 	type((uint32_t)type_)
 {
@@ -52,16 +54,19 @@ void Light::Update()
 	isDirty |= transform->wasDirtyThisFrame;
 	isDirty |= VIEW_CAM->wasDirtyThisFrame;
 
-	if (!isDirty)
-		return;
-
 	m_Direction = glm::vec4(dir, 0);
 	m_Position = glm::vec4(pos, 0);
 
+	// cascades also follow the depth of the scene under them, so they are refit every frame.
+	// the uniform is only rewritten when one of them actually changed
+	if (type == (uint32_t)Type::Directional && m_UseShadows)
+		isDirty |= UpdateDirectionalLightCascades();
+
+	if (!isDirty)
+		return;
+
 	if (type == (uint32_t)Type::Directional)
 	{
-		if(m_UseShadows)
-			UpdateDirectionalLightCascades();
 		UpdateDirectionalLightUniform();
 	}
 	else if (type == (uint32_t)Type::Point)
@@ -207,9 +212,10 @@ void Light::Inspect()
 	ImGui::PopID();
 }
 
-void Light::UpdateDirectionalLightCascades()
+bool Light::UpdateDirectionalLightCascades()
 {
 	Camera* camera = VIEW_CAM;
+	const Scene* scene = GetScene();
 
 	float cascadeSplits[SHADOW_MAP_CASCADE_COUNT];
 
@@ -221,7 +227,35 @@ void Light::UpdateDirectionalLightCascades()
 	float minZ = nearClip;
 	float maxZ = nearClip + clipRange;
 
-	float range = clipRange;
+	// sample distribution: only split the depths that held anything last frame. the range is
+	// rounded out in quarter octaves, so it does not move the splits every time the view changes a little
+	if (FitCascadeSplits)
+	{
+		const InstanceRegistry& registry = scene->getInstanceRegistry();
+		const glm::mat4& view = camera->getViewMatrix();
+		glm::vec3 viewDepth = glm::abs(glm::vec3(view[0][2], view[1][2], view[2][2]));
+
+		float visibleMin = FLT_MAX, visibleMax = -FLT_MAX;
+		for (const std::vector<uint32_t>& slots : scene->getVisibleInstances())
+		{
+			for (uint32_t slot : slots)
+			{
+				AABB bounds = registry.getWorldAABB(slot);
+				float depth = -(view * glm::vec4(bounds.center(), 1.0f)).z;
+				float extent = glm::dot(bounds.extent(), viewDepth);
+				visibleMin = std::min(visibleMin, depth - extent);
+				visibleMax = std::max(visibleMax, depth + extent);
+			}
+		}
+
+		if (visibleMin < visibleMax)
+		{
+			minZ = std::clamp(nearClip * std::exp2(std::floor(std::log2(std::max(visibleMin, nearClip) / nearClip) * 4.0f) / 4.0f), nearClip, farClip);
+			maxZ = std::clamp(nearClip * std::exp2(std::ceil(std::log2(std::max(visibleMax, nearClip) / nearClip) * 4.0f) / 4.0f), minZ, farClip);
+		}
+	}
+
+	float range = maxZ - minZ;
 	float ratio = maxZ / minZ;
 
 	// Calculate split depths based on view camera frustum
@@ -235,6 +269,13 @@ void Light::UpdateDirectionalLightCascades()
 	}
 
 	glm::mat4 invCam = inverse(camera->getWorldToClipMatrix());
+	glm::mat4 invView = inverse(camera->getViewMatrix());
+	glm::vec3 eye(invView[3]);
+	glm::vec3 forward = -glm::normalize(glm::vec3(invView[2]));
+	glm::vec3 lightDir = glm::normalize(glm::vec3(m_Direction));
+
+	std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> lightspaces;
+	glm::vec4 splitDepths;
 
 	// Calculate orthographic projection matrix for each cascade
 	float lastSplitDist = 0.0;
@@ -265,33 +306,105 @@ void Light::UpdateDirectionalLightCascades()
 			frustumCorners[j] = frustumCorners[j] + (dist * lastSplitDist);
 		}
 
-		// Get frustum center
 		glm::vec3 frustumCenter = glm::vec3(0.0f);
-		for (uint32_t j = 0; j < 8; j++) {
-			frustumCenter += frustumCorners[j];
-		}
-		frustumCenter /= 8.0f;
-
 		float radius = 0.0f;
-		for (uint32_t j = 0; j < 8; j++) {
-			float distance = glm::length(frustumCorners[j] - frustumCenter);
-			radius = glm::max(radius, distance);
+		if (camera->orthographic)
+		{
+			// Get frustum center
+			for (uint32_t j = 0; j < 8; j++) {
+				frustumCenter += frustumCorners[j];
+			}
+			frustumCenter /= 8.0f;
+
+			for (uint32_t j = 0; j < 8; j++) {
+				float distance = glm::length(frustumCorners[j] - frustumCenter);
+				radius = glm::max(radius, distance);
+			}
+		}
+		else
+		{
+			// the smallest sphere around the slice. it only depends on the slice's depths and the field of view,
+			// so its size does not change as the camera turns, and it is smaller than the one around the corners' center
+			float sliceNear = nearClip + lastSplitDist * clipRange;
+			float sliceFar = nearClip + splitDist * clipRange;
+			float k = glm::length(frustumCorners[4] - (eye + forward * sliceFar)) / sliceFar; // corner distance from the axis per unit of depth
+			float k2 = k * k;
+
+			float centerDepth = sliceFar;
+			radius = sliceFar * k;
+			if (k2 < (sliceFar - sliceNear) / (sliceFar + sliceNear))
+			{
+				centerDepth = 0.5f * (sliceFar + sliceNear) * (1.0f + k2);
+				radius = std::sqrt((centerDepth - sliceNear) * (centerDepth - sliceNear) + sliceNear * sliceNear * k2);
+			}
+			frustumCenter = eye + forward * centerDepth;
 		}
 		radius = std::ceil(radius * 16.0f) / 16.0f;
 
 		glm::vec3 maxExtents = glm::vec3(radius);
 		glm::vec3 minExtents = -maxExtents;
 
-		glm::mat4 lightViewMatrix = Mat4::LookAt(frustumCenter - glm::vec3(m_Direction) * -minExtents.z, frustumCenter, GetTransform()->Up());
-		glm::mat4 lightOrthoMatrix = glm::ortho(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, -1000.0f, maxExtents.z - minExtents.z);
+		// depth only spans the cascade's sphere. casters between it and the light are pancaked onto
+		// the near plane by the shadow pass, which keeps all of the depth precision for the receivers
+		glm::vec3 lightEye = frustumCenter - lightDir * -minExtents.z;
+		glm::mat4 lightViewMatrix = Mat4::LookAt(lightEye, frustumCenter, GetTransform()->Up());
+		float depthNear = 0.0f;
+		float depthFar = maxExtents.z - minExtents.z;
+
+		// tighten the depth range to the scene inside the sphere's box, rounded out in 1/64ths of it and padded
+		// by one more, since the tree still holds last frame's bounds. nothing in front of it needs depth, it is pancaked
+		{
+			glm::mat4 sphereBox = glm::orthoRH_ZO(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, depthNear, depthFar) * lightViewMatrix;
+			Frustum boxFrustum;
+			boxFrustum.Update(sphereBox, glm::mat4(1));
+
+			float sceneNear = FLT_MAX, sceneFar = -FLT_MAX;
+			uint32_t nodesVisited = 0;
+			glm::vec3 absDir = glm::abs(lightDir);
+			scene->getBVH().QueryFrustum(boxFrustum, 0x3F, nodesVisited, [&](const BVH::Node& leaf) {
+				float depth = glm::dot(leaf.bounds.center() - lightEye, lightDir);
+				float extent = glm::dot(leaf.bounds.extent(), absDir);
+				sceneNear = std::min(sceneNear, depth - extent);
+				sceneFar = std::max(sceneFar, depth + extent);
+			});
+
+			if (sceneNear <= sceneFar)
+			{
+				float step = (depthFar - depthNear) / 64.0f;
+				float fullFar = depthFar;
+				depthNear = std::clamp((std::floor(sceneNear / step) - 1.0f) * step, 0.0f, fullFar - step);
+				depthFar = std::clamp((std::ceil(sceneFar / step) + 1.0f) * step, depthNear + step, fullFar);
+			}
+		}
+
+		glm::mat4 lightOrthoMatrix = glm::orthoRH_ZO(minExtents.x, maxExtents.x, minExtents.y, maxExtents.y, depthNear, depthFar);
 		lightOrthoMatrix[1][1] *= -1;
 
+		// snap the projection to whole texels of the cascade's tile. the sphere keeps its size and the light
+		// its direction, so the texels land on the same world positions as the camera moves, and do not shimmer
+		if (m_CascadeResolution[i] > 0)
+		{
+			float texels = (float)m_CascadeResolution[i];
+			glm::vec2 origin = glm::vec2(lightOrthoMatrix * lightViewMatrix * glm::vec4(0, 0, 0, 1)) * (texels * 0.5f);
+			glm::vec2 offset = (glm::round(origin) - origin) * (2.0f / texels);
+			lightOrthoMatrix[3][0] += offset.x;
+			lightOrthoMatrix[3][1] += offset.y;
+		}
+
 		// Store split distance and matrix in cascade
-		m_CascadeSplitDepths[i] = (nearClip + splitDist * clipRange) * -1.0f;
-		m_Lightspaces[i] = lightOrthoMatrix * lightViewMatrix;
+		splitDepths[i] = (nearClip + splitDist * clipRange) * -1.0f;
+		lightspaces[i] = lightOrthoMatrix * lightViewMatrix;
 
 		lastSplitDist = cascadeSplits[i];
 	}
+
+	bool changed = splitDepths != m_CascadeSplitDepths;
+	for (uint32_t i = 0; i < SHADOW_MAP_CASCADE_COUNT; i++)
+		changed |= lightspaces[i] != m_Lightspaces[i];
+
+	m_CascadeSplitDepths = splitDepths;
+	std::copy(lightspaces.begin(), lightspaces.end(), m_Lightspaces.begin());
+	return changed;
 }
 
 void Light::UpdatePointLightLightSpaces(uint32_t faceIndex)
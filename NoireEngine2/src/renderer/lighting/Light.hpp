@@ -23,8 +23,9 @@ struct alignas(16) DirectionalLightUniform
 	float intensity;
 	uint32_t shadowOffset;
 	float shadowStrength;
+	uint32_t shadowBase; // first of its shadow maps, set by the renderer
 };
-static_assert(sizeof(DirectionalLightUniform) == 64 * 4 + 16 * 4);
+static_assert(sizeof(DirectionalLightUniform) == 64 * 4 + 16 * 5);
 
 struct alignas(16) PointLightUniform
 {
@@ -36,6 +37,7 @@ struct alignas(16) PointLightUniform
 	float limit;
 	uint32_t shadowOffset;
 	float shadowStrength;
+	uint32_t shadowBase; // first of its shadow maps, set by the renderer
 };
 static_assert(sizeof(PointLightUniform) == 64 * 6 + 16 * 2 + 16 * 2);
 
@@ -53,8 +55,9 @@ struct alignas(16) SpotLightUniform
 	uint32_t shadowOffset;
 	float shadowStrength;
 	float nearClip;
+	uint32_t shadowBase; // first of its shadow maps, set by the renderer
 };
-static_assert(sizeof(SpotLightUniform) == 64 + 16 * 3 + 16 * 2);
+static_assert(sizeof(SpotLightUniform) == 64 + 16 * 3 + 16 * 3);
 
 class Light : public Component
 {
@@ -99,11 +102,16 @@ public:
 	std::array<glm::mat4, MAX_LIGHTSPACES> m_Lightspaces; /*depthMVP*/
 	float m_ShadowAttenuation = 1;
 	glm::vec4 m_CascadeSplitDepths;
+	std::array<uint32_t, SHADOW_MAP_CASCADE_COUNT> m_CascadeResolution = {}; // texels of each cascade's atlas tile, set by the shadow pipeline. 0 until placed
+
+	// fit the cascade splits to the depth range of what was visible last frame, instead of the camera's whole range
+	static inline bool FitCascadeSplits = false;
 
 	bool isDirty = true;
 
 private:
-	void UpdateDirectionalLightCascades();
+	// refits the cascades to the camera and the scene under them, returns true if any of them changed
+	bool UpdateDirectionalLightCascades();
 	void UpdatePointLightLightSpaces(uint32_t faceIndex);
 
 	void UpdateDirectionalLightUniform();
@@ -0,0 +1,218 @@
+#include "LightClusters.hpp"
+
+#include "Light.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include "glm/gtc/constants.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// slices are grown by this much of their depth, a fragment whose log lands on the other side of
+// a boundary is still inside the box of the cluster it picks
+#define CLUSTER_SLICE_PADDING 0.001f
+
+bool LightClusters::BuildBounds(const glm::mat4& projection, float nearClip, float farClip, uint32_t width, uint32_t height)
+{
+	glm::uvec2 extent(width, height);
+	if (!m_Bounds.empty() && projection == m_Projection && nearClip == m_NearClip && farClip == m_FarClip && extent == m_Extent)
+		return false;
+
+	m_Projection = projection;
+	m_NearClip = nearClip;
+	m_FarClip = farClip;
+	m_Extent = extent;
+
+	m_TileSize = glm::uvec2((width + CLUSTERS_X - 1) / CLUSTERS_X, (height + CLUSTERS_Y - 1) / CLUSTERS_Y);
+	m_TileSize = glm::max(m_TileSize, glm::uvec2(1));
+
+	float depthRange = std::log(farClip / nearClip);
+	m_DepthSlicing = glm::vec2(CLUSTERS_Z / depthRange, -(float)CLUSTERS_Z * std::log(nearClip) / depthRange);
+
+	// the view space line through every tile corner, from the near to the far plane
+	glm::mat4 inverseProjection = glm::inverse(projection);
+	auto unproject = [&inverseProjection](float x, float y, float z) {
+		glm::vec4 p = inverseProjection * glm::vec4(x, y, z, 1);
+		return glm::vec3(p) / p.w;
+	};
+
+	std::vector<std::pair<glm::vec3, glm::vec3>> lines((CLUSTERS_X + 1) * (CLUSTERS_Y + 1));
+	for (uint32_t y = 0; y <= CLUSTERS_Y; ++y)
+	{
+		for (uint32_t x = 0; x <= CLUSTERS_X; ++x)
+		{
+			float ndcX = (float)(x * m_TileSize.x) / width * 2 - 1;
+			float ndcY = (float)(y * m_TileSize.y) / height * 2 - 1;
+			lines[y * (CLUSTERS_X + 1) + x] = { unproject(ndcX, ndcY, 0), unproject(ndcX, ndcY, 1) };
+		}
+	}
+
+	// point of a line at a view depth, works for orthographic projections too
+	auto atDepth = [](const std::pair<glm::vec3, glm::vec3>& line, float depth) {
+		float t = (depth + line.first.z) / (line.first.z - line.second.z);
+		return glm::mix(line.first, line.second, t);
+	};
+
+	m_Bounds.resize(CLUSTER_COUNT);
+	for (uint32_t z = 0; z < CLUSTERS_Z; ++z)
+	{
+		float sliceNear = nearClip * std::pow(farClip / nearClip, (float)z / CLUSTERS_Z) * (1 - CLUSTER_SLICE_PADDING);
+		float sliceFar = nearClip * std::pow(farClip / nearClip, (float)(z + 1) / CLUSTERS_Z) * (1 + CLUSTER_SLICE_PADDING);
+
+		for (uint32_t y = 0; y < CLUSTERS_Y; ++y)
+		{
+			for (uint32_t x = 0; x < CLUSTERS_X; ++x)
+			{
+				glm::vec3 min(std::numeric_limits<float>::max());
+				glm::vec3 max(std::numeric_limits<float>::lowest());
+
+				for (uint32_t corner = 0; corner < 4; ++corner)
+				{
+					const auto& line = lines[(y + corner / 2) * (CLUSTERS_X + 1) + x + corner % 2];
+					for (float depth : { sliceNear, sliceFar })
+					{
+						glm::vec3 p = atDepth(line, depth);
+						min = glm::min(min, p);
+						max = glm::max(max, p);
+					}
+				}
+
+				glm::vec3 extent = (max - min) * 0.5f;
+				Bounds& bounds = m_Bounds[x + CLUSTERS_X * (y + CLUSTERS_Y * z)];
+				bounds.center = glm::vec4((min + max) * 0.5f, glm::length(extent));
+				bounds.extent = glm::vec4(extent, 0);
+			}
+		}
+	}
+
+	return true;
+}
+
+void LightClusters::BuildShapes(const std::vector<Light*>& lights, const glm::mat4& view)
+{
+	m_Shapes.clear();
+
+	for (Light* light : lights)
+	{
+		if (light->type != (uint32_t)Light::Type::Point)
+			continue;
+
+		const PointLightUniform* uniform = light->GetLightUniformAs<PointLightUniform>();
+		m_Shapes.push_back(Shape{
+			.position = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(uniform->position), 1)), uniform->limit),
+			.direction = glm::vec4(0),
+			.cone = glm::vec4(0),
+		});
+	}
+	m_NumPoint = (uint32_t)m_Shapes.size();
+
+	for (Light* light : lights)
+	{
+		if (light->type != (uint32_t)Light::Type::Spot)
+			continue;
+
+		// cones wider than a half space are only tested as spheres
+		const SpotLightUniform* uniform = light->GetLightUniformAs<SpotLightUniform>();
+		float halfAngle = glm::radians(uniform->fov) * 0.5f;
+		bool testCone = halfAngle < glm::half_pi<float>();
+
+		m_Shapes.push_back(Shape{
+			.position = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(uniform->position), 1)), uniform->limit),
+			.direction = glm::vec4(glm::normalize(glm::mat3(view) * glm::vec3(uniform->direction)), 0),
+			.cone = glm::vec4(std::cos(halfAngle), std::sin(halfAngle), testCone ? 1 : 0, 0),
+		});
+	}
+	m_NumSpot = (uint32_t)m_Shapes.size() - m_NumPoint;
+}
+
+bool LightClusters::Intersects(const Shape& shape, const Bounds& bounds)
+{
+	// every expression is spelled out in the shader's order, so neither side may reassociate or fuse it
+
+	// squared distance from the light to the box
+	float dx = std::max(std::abs(shape.position.x - bounds.center.x) - bounds.extent.x, 0.0f);
+	float dy = std::max(std::abs(shape.position.y - bounds.center.y) - bounds.extent.y, 0.0f);
+	float dz = std::max(std::abs(shape.position.z - bounds.center.z) - bounds.extent.z, 0.0f);
+	float distanceSq = dx * dx + dy * dy + dz * dz;
+	float limitSq = shape.position.w * shape.position.w;
+	if (distanceSq > limitSq)
+		return false;
+
+	if (shape.cone.z == 0)
+		return true;
+
+	// the cone against the box's bounding sphere: the sphere is outside if
+	// cos * sqrt(lengthSq - along^2) - along * sin > radius, compared squared to stay away from the root
+	float vx = bounds.center.x - shape.position.x;
+	float vy = bounds.center.y - shape.position.y;
+	float vz = bounds.center.z - shape.position.z;
+	float lengthSq = vx * vx + vy * vy + vz * vz;
+	float along = vx * shape.direction.x + vy * shape.direction.y + vz * shape.direction.z;
+
+	float radius = bounds.center.w;
+	if (along < -radius)
+		return false; // behind the apex
+
+	float side = radius + along * shape.cone.y;
+	if (side < 0)
+		return false;
+
+	float perpendicularSq = std::max(lengthSq - along * along, 0.0f);
+	float closestSq = shape.cone.x * shape.cone.x * perpendicularSq;
+	float sideSq = side * side;
+	return closestSq <= sideSq;
+}
+
+void LightClusters::Assign()
+{
+	m_Clusters.resize(CLUSTER_COUNT);
+
+	// each slice lists its clusters' lights on its own, then the lists are joined in cluster order
+	m_SliceIndices.resize(CLUSTERS_Z);
+
+	JobCounter counter;
+	JobSystem::Get()->Dispatch(counter, CLUSTERS_Z, 1, [this](uint32_t z) {
+		std::vector<uint32_t>& indices = m_SliceIndices[z];
+		indices.clear();
+
+		for (uint32_t cluster = z * CLUSTERS_X * CLUSTERS_Y; cluster < (z + 1) * CLUSTERS_X * CLUSTERS_Y; ++cluster)
+		{
+			const Bounds& bounds = m_Bounds[cluster];
+			uint32_t offset = (uint32_t)indices.size();
+
+			uint32_t numPoint = 0;
+			for (uint32_t i = 0; i < m_NumPoint && numPoint < MAX_CLUSTER_LIGHTS; ++i)
+			{
+				if (Intersects(m_Shapes[i], bounds))
+				{
+					indices.push_back(i);
+					numPoint++;
+				}
+			}
+
+			uint32_t numSpot = 0;
+			for (uint32_t i = 0; i < m_NumSpot && numSpot < MAX_CLUSTER_LIGHTS; ++i)
+			{
+				if (Intersects(m_Shapes[m_NumPoint + i], bounds))
+				{
+					indices.push_back(i);
+					numSpot++;
+				}
+			}
+
+			m_Clusters[cluster] = Cluster{ offset, numPoint | (numSpot << 16) };
+		}
+	});
+	JobSystem::Get()->Wait(counter);
+
+	m_Indices.clear();
+	for (uint32_t z = 0; z < CLUSTERS_Z; ++z)
+	{
+		uint32_t sliceOffset = (uint32_t)m_Indices.size();
+		for (uint32_t cluster = z * CLUSTERS_X * CLUSTERS_Y; cluster < (z + 1) * CLUSTERS_X * CLUSTERS_Y; ++cluster)
+			m_Clusters[cluster].offset += sliceOffset;
+
+		m_Indices.insert(m_Indices.end(), m_SliceIndices[z].begin(), m_SliceIndices[z].end());
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <vector>
+#include <cstdint>
+
+class Light;
+
+/**
+ * Clustered light assignment for the forward lighting loops.
+ * The view frustum is split into a grid of clusters: CLUSTERS_X x CLUSTERS_Y screen tiles, and CLUSTERS_Z slices
+ * spaced logarithmically in view depth. Every cluster lists the point and spot lights that can reach its view
+ * space box, so a fragment only shades the lights of its own cluster, next to every directional light.
+ * The ClusteringPipeline assigns the lights on the gpu, this is the cpu reference it is validated against.
+ * Both test the same boxes and light shapes, built here, with nothing but adds, multiplies and compares,
+ * so they produce the same lists, bit for bit.
+ */
+class LightClusters
+{
+public:
+	static constexpr uint32_t CLUSTERS_X = 16;
+	static constexpr uint32_t CLUSTERS_Y = 9;
+	static constexpr uint32_t CLUSTERS_Z = 24;
+	static constexpr uint32_t CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	static constexpr uint32_t MAX_CLUSTER_LIGHTS = 0xFFFF; // of each type, the counts are packed into 16 bits
+
+	// view space box of a cluster, std430
+	struct Bounds
+	{
+		glm::vec4 center; // w: radius of the bounding sphere
+		glm::vec4 extent;
+	};
+
+	// what the tests need of a point or spot light, in view space, std430
+	struct Shape
+	{
+		glm::vec4 position; // w: limit, nothing beyond it is lit
+		glm::vec4 direction;
+		glm::vec4 cone; // cosine and sine of the half angle; z: 1 if the cone is tested
+	};
+
+	// where a cluster's list starts, and how many lights of each type it holds, matches clusters.glsl
+	struct Cluster
+	{
+		uint32_t offset;
+		uint32_t counts; // point lights in the low 16 bits, spot lights in the high ones
+
+		inline uint32_t getNumPoint() const { return counts & 0xFFFF; }
+		inline uint32_t getNumSpot() const { return counts >> 16; }
+		inline uint32_t size() const { return getNumPoint() + getNumSpot(); }
+	};
+
+	// rebuilds the boxes when the projection, depth range or extent changed, returns true if it did
+	bool BuildBounds(const glm::mat4& projection, float nearClip, float farClip, uint32_t width, uint32_t height);
+
+	// shapes of the point lights, then the spot lights, in the order they are uploaded in
+	void BuildShapes(const std::vector<Light*>& lights, const glm::mat4& view);
+
+	// assigns the shapes to every cluster they reach, into one compact index list
+	void Assign();
+
+	// whether a light can reach a cluster, the same test as lightclusters.comp
+	static bool Intersects(const Shape& shape, const Bounds& bounds);
+
+	inline const std::vector<Bounds>& getBounds() const { return m_Bounds; }
+	inline const std::vector<Shape>& getShapes() const { return m_Shapes; }
+	inline const std::vector<Cluster>& getClusters() const { return m_Clusters; }
+	inline const std::vector<uint32_t>& getIndices() const { return m_Indices; }
+
+	inline uint32_t getNumPoint() const { return m_NumPoint; }
+	inline uint32_t getNumSpot() const { return m_NumSpot; }
+
+	// pixels covered by one cluster
+	inline glm::uvec2 getTileSize() const { return m_TileSize; }
+
+	// slice = log(view depth) * x + y
+	inline glm::vec2 getDepthSlicing() const { return m_DepthSlicing; }
+
+private:
+	std::vector<Bounds>		m_Bounds;
+	std::vector<Shape>		m_Shapes;
+	std::vector<Cluster>	m_Clusters;
+	std::vector<uint32_t>	m_Indices; // per cluster, its point lights then its spot lights, by index within their type
+	std::vector<std::vector<uint32_t>> m_SliceIndices; // scratch, of every depth slice
+
+	uint32_t				m_NumPoint = 0;
+	uint32_t				m_NumSpot = 0;
+
+	// what the boxes were built for
+	glm::mat4				m_Projection{ 0 };
+	float					m_NearClip = 0;
+	float					m_FarClip = 0;
+	glm::uvec2				m_Extent{ 0 };
+
+	glm::uvec2				m_TileSize{ 1 };
+	glm::vec2				m_DepthSlicing{ 0 };
+};
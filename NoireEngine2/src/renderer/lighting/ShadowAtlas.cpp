@@ -0,0 +1,210 @@
+#include "ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+// a tile shrinks once it wants less than this much of its size, instead of half of it
+#define SHADOW_ATLAS_SHRINK 0.375f
+
+static inline uint32_t Pack(uint32_t x, uint32_t y) { return x << 16 | y; }
+
+void ShadowAtlas::Reset(uint32_t dim, uint32_t minTile)
+{
+	m_Dim = dim;
+	m_MinTile = std::min(minTile, dim);
+	m_NumLevels = std::countr_zero(m_Dim) - std::countr_zero(m_MinTile) + 1;
+
+	m_Tiles.clear();
+	m_Moved.clear();
+	Clear();
+}
+
+bool ShadowAtlas::Update(const std::vector<float>& wanted, const std::vector<float>& importance)
+{
+	uint32_t numTiles = (uint32_t)wanted.size();
+	for (uint32_t i = numTiles; i < m_Tiles.size(); ++i)
+	{
+		if (m_Tiles[i].size > 0)
+			Free(m_Tiles[i].x, m_Tiles[i].y, LevelOf(m_Tiles[i].size));
+	}
+	m_Tiles.resize(numTiles);
+	m_Moved.assign(numTiles, 0);
+
+	// sizes this frame, with hysteresis against last frame's
+	std::vector<uint32_t> sizes(numTiles);
+	uint64_t texels = 0;
+	for (uint32_t i = 0; i < numTiles; ++i)
+	{
+		uint32_t size = std::bit_ceil((uint32_t)std::max(std::ceil(wanted[i]), 1.0f));
+		size = std::clamp(size, m_MinTile, m_Dim);
+
+		uint32_t current = m_Tiles[i].size;
+		if (size < current && wanted[i] > current * SHADOW_ATLAS_SHRINK)
+			size = current;
+
+		sizes[i] = size;
+		texels += (uint64_t)size * size;
+	}
+
+	// over budget: halve the least important tiles first, and drop them once none can be halved anymore
+	uint64_t budget = (uint64_t)m_Dim * m_Dim;
+	if (texels > budget)
+	{
+		std::vector<uint32_t> order(numTiles);
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&importance](uint32_t a, uint32_t b) { return importance[a] < importance[b]; });
+
+		bool halved = true;
+		while (texels > budget && halved)
+		{
+			halved = false;
+			for (uint32_t i : order)
+			{
+				if (texels <= budget)
+					break;
+				if (sizes[i] <= m_MinTile)
+					continue;
+
+				texels -= (uint64_t)sizes[i] * sizes[i] * 3 / 4;
+				sizes[i] /= 2;
+				halved = true;
+			}
+		}
+
+		for (uint32_t i : order)
+		{
+			if (texels <= budget)
+				break;
+			texels -= (uint64_t)sizes[i] * sizes[i];
+			sizes[i] = 0;
+		}
+	}
+
+	// free every tile that changed size first, so their space can be reused right away
+	std::vector<uint32_t> changed;
+	for (uint32_t i = 0; i < numTiles; ++i)
+	{
+		Tile& tile = m_Tiles[i];
+		if (tile.size == sizes[i])
+			continue;
+
+		if (tile.size > 0)
+			Free(tile.x, tile.y, LevelOf(tile.size));
+
+		tile.size = sizes[i];
+		changed.push_back(i);
+		m_Moved[i] = 1;
+	}
+
+	// then place them largest first. if the free space is too fragmented, place everything again:
+	// power of two tiles placed largest first always fit when their area does
+	auto largestFirst = [&sizes](uint32_t a, uint32_t b) { return sizes[a] > sizes[b] || (sizes[a] == sizes[b] && a < b); };
+	std::sort(changed.begin(), changed.end(), largestFirst);
+
+	bool fits = true;
+	for (uint32_t i : changed)
+	{
+		if (m_Tiles[i].size > 0 && !Allocate(m_Tiles[i]))
+		{
+			fits = false;
+			break;
+		}
+	}
+
+	if (!fits)
+	{
+		Clear();
+		changed.resize(numTiles);
+		std::iota(changed.begin(), changed.end(), 0);
+		std::sort(changed.begin(), changed.end(), largestFirst);
+
+		for (uint32_t i : changed)
+		{
+			Tile previous = m_Tiles[i];
+			m_Tiles[i].size = sizes[i];
+			if (sizes[i] > 0)
+				Allocate(m_Tiles[i]);
+			m_Moved[i] |= previous == m_Tiles[i] ? 0 : 1;
+		}
+		m_NumRepacks++;
+	}
+
+	m_TexelsUsed = (uint32_t)texels;
+	return std::any_of(m_Moved.begin(), m_Moved.end(), [](uint8_t moved) { return moved != 0; });
+}
+
+uint32_t ShadowAtlas::LevelOf(uint32_t size) const
+{
+	return std::countr_zero(m_Dim) - std::countr_zero(size);
+}
+
+bool ShadowAtlas::Allocate(Tile& tile)
+{
+	uint32_t level = LevelOf(tile.size);
+
+	// the smallest free block that holds the tile
+	int32_t from = (int32_t)level;
+	while (from >= 0 && m_FreeBlocks[from].empty())
+		from--;
+	if (from < 0)
+		return false;
+
+	uint32_t block = m_FreeBlocks[from].back();
+	m_FreeBlocks[from].pop_back();
+	uint32_t x = block >> 16, y = block & 0xFFFF;
+
+	// split it down to the tile's size, keeping the first quadrant and freeing the other three
+	for (uint32_t l = (uint32_t)from + 1; l <= level; ++l)
+	{
+		uint32_t half = m_Dim >> l;
+		m_FreeBlocks[l].push_back(Pack(x + half, y));
+		m_FreeBlocks[l].push_back(Pack(x, y + half));
+		m_FreeBlocks[l].push_back(Pack(x + half, y + half));
+	}
+
+	tile.x = x;
+	tile.y = y;
+	return true;
+}
+
+void ShadowAtlas::Free(uint32_t x, uint32_t y, uint32_t level)
+{
+	// merge with the three other quadrants of the parent once they are all free
+	while (level > 0)
+	{
+		uint32_t size = m_Dim >> level;
+		uint32_t parentX = x & ~(2 * size - 1), parentY = y & ~(2 * size - 1);
+
+		std::vector<uint32_t>& blocks = m_FreeBlocks[level];
+		uint32_t buddies[3];
+		uint32_t numBuddies = 0;
+		for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+		{
+			uint32_t buddy = Pack(parentX + (quadrant & 1) * size, parentY + (quadrant >> 1) * size);
+			if (buddy != Pack(x, y))
+				buddies[numBuddies++] = buddy;
+		}
+
+		bool allFree = std::all_of(buddies, buddies + 3, [&blocks](uint32_t buddy) {
+			return std::find(blocks.begin(), blocks.end(), buddy) != blocks.end();
+		});
+		if (!allFree)
+			break;
+
+		std::erase_if(blocks, [&buddies](uint32_t block) { return std::find(buddies, buddies + 3, block) != buddies + 3; });
+		x = parentX;
+		y = parentY;
+		level--;
+	}
+
+	m_FreeBlocks[level].push_back(Pack(x, y));
+}
+
+void ShadowAtlas::Clear()
+{
+	m_FreeBlocks.assign(m_NumLevels, {});
+	if (m_NumLevels > 0)
+		m_FreeBlocks[0].push_back(Pack(0, 0));
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Places every shadow map of the scene in one fixed size depth atlas, so shadow memory is a budget that does not
+ * grow with the number of lights. Tiles are power of two squares handed out by a buddy allocator over a quadtree:
+ * a tile that keeps its size keeps its place too, along with whatever depth is cached in it.
+ * Each frame, every tile asks for a size. Tiles grow as soon as they need to, but only shrink once they are well
+ * below their size, so a light near a boundary does not flip between two sizes. When the tiles do not fit, the
+ * least important ones are halved first.
+ */
+class ShadowAtlas
+{
+public:
+	struct Tile
+	{
+		uint32_t x = 0, y = 0, size = 0; // in texels, size is 0 if there was no room left
+
+		inline bool operator==(const Tile& other) const { return x == other.x && y == other.y && size == other.size; }
+	};
+
+	// starts over with an empty atlas of dim x dim texels, no tile is ever smaller than minTile
+	void Reset(uint32_t dim, uint32_t minTile);
+
+	// wanted: texels a tile would like along one side. importance: which tiles shrink first when over budget.
+	// returns true if any tile moved, see WasMoved
+	bool Update(const std::vector<float>& wanted, const std::vector<float>& importance);
+
+	inline const std::vector<Tile>& getTiles() const { return m_Tiles; }
+	inline bool WasMoved(uint32_t tile) const { return m_Moved[tile] != 0; }
+
+	inline uint32_t getDim() const { return m_Dim; }
+	inline uint32_t getTexelsUsed() const { return m_TexelsUsed; }
+	inline uint32_t getNumRepacks() const { return m_NumRepacks; }
+
+private:
+	uint32_t m_Dim = 0;
+	uint32_t m_MinTile = 0;
+	uint32_t m_NumLevels = 0; // level 0 is the whole atlas, every level below halves the tile size
+
+	std::vector<Tile> m_Tiles;
+	std::vector<uint8_t> m_Moved;
+	std::vector<std::vector<uint32_t>> m_FreeBlocks; // per level, packed as x << 16 | y
+	uint32_t m_TexelsUsed = 0;
+	uint32_t m_NumRepacks = 0; // times the allocator was too fragmented and everything was placed again
+
+	uint32_t LevelOf(uint32_t size) const;
+	bool Allocate(Tile& tile);
+	void Free(uint32_t x, uint32_t y, uint32_t level);
+	void Clear();
+};
@@ -60,7 +60,8 @@ private:
 		}
 
 		auto result = std::make_shared<T>();
-		Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+		if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+			return std::dynamic_pointer_cast<Material>(cached);
 		node >> *result;
 		result->Load();
 		return result;
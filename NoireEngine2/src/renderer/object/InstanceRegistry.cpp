@@ -0,0 +1,145 @@
+#include "InstanceRegistry.hpp"
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+void DirtySlotSet::Add(uint32_t slot)
+{
+	if (slot >= m_Contains.size())
+		m_Contains.resize(std::max<size_t>(slot + 1, m_Contains.size() * 2), 0);
+
+	if (m_Contains[slot])
+		return;
+
+	m_Contains[slot] = 1;
+	m_Slots.emplace_back(slot);
+}
+
+void DirtySlotSet::AddAll(uint32_t count)
+{
+	for (uint32_t slot = 0; slot < count; ++slot)
+		Add(slot);
+}
+
+void DirtySlotSet::Merge(const DirtySlotSet& other)
+{
+	for (uint32_t slot : other.m_Slots)
+		Add(slot);
+}
+
+void DirtySlotSet::Clear()
+{
+	for (uint32_t slot : m_Slots)
+		m_Contains[slot] = 0;
+	m_Slots.clear();
+}
+
+void DirtySlotSet::BuildRanges(std::vector<std::pair<uint32_t, uint32_t>>& outRanges)
+{
+	outRanges.clear();
+	if (m_Slots.empty())
+		return;
+
+	std::sort(m_Slots.begin(), m_Slots.end());
+
+	uint32_t begin = m_Slots[0], end = m_Slots[0] + 1;
+	for (size_t i = 1; i < m_Slots.size(); ++i)
+	{
+		if (m_Slots[i] == end)
+		{
+			end++;
+			continue;
+		}
+
+		outRanges.emplace_back(begin, end);
+		begin = m_Slots[i];
+		end = begin + 1;
+	}
+	outRanges.emplace_back(begin, end);
+}
+
+uint32_t InstanceRegistry::Allocate(Mesh* mesh, Material* material, uint64_t entityID)
+{
+	uint32_t slot;
+	if (!m_FreeSlots.empty())
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)m_Instances.size();
+		m_Instances.emplace_back();
+		m_Alive.emplace_back(0);
+	}
+
+	ObjectInstance& instance = m_Instances[slot];
+	instance.m_TransformUniform = { Mat4::Identity, Mat4::Identity };
+	instance.mesh = mesh;
+	instance.material = material;
+	instance.entityID = entityID;
+	m_Alive[slot] = 1;
+
+	m_Bounds.Resize(capacity());
+	UpdateBounds(slot);
+
+	m_DirtyTransforms.Add(slot);
+	m_DirtyDescriptions.Add(slot);
+	m_Version++;
+
+	return slot;
+}
+
+void InstanceRegistry::Free(uint32_t slot)
+{
+	assert(slot < m_Instances.size() && m_Alive[slot] && "Freeing an invalid instance slot");
+
+	m_Alive[slot] = 0;
+	m_Instances[slot].mesh = nullptr;
+	m_Instances[slot].material = nullptr;
+	m_Bounds.SetEmpty(slot);
+	m_FreeSlots.emplace_back(slot);
+	m_Version++;
+}
+
+void InstanceRegistry::SetTransform(uint32_t slot, const glm::mat4& model)
+{
+	ObjectInstance::TransformUniform& uniform = m_Instances[slot].m_TransformUniform;
+	uniform.modelMatrix = model;
+	uniform.modelMatrix_Normal = glm::inverse(model);
+	UpdateBounds(slot);
+
+	m_DirtyTransforms.Add(slot);
+}
+
+AABB InstanceRegistry::getWorldAABB(uint32_t slot) const
+{
+	glm::vec3 center(m_Bounds.centerX[slot], m_Bounds.centerY[slot], m_Bounds.centerZ[slot]);
+	glm::vec3 extent(m_Bounds.extentX[slot], m_Bounds.extentY[slot], m_Bounds.extentZ[slot]);
+	return AABB(center - extent, center + extent);
+}
+
+BoundingSphere InstanceRegistry::getWorldSphere(uint32_t slot) const
+{
+	return { glm::vec3(m_Bounds.centerX[slot], m_Bounds.centerY[slot], m_Bounds.centerZ[slot]), m_Bounds.radius[slot] };
+}
+
+void InstanceRegistry::UpdateBounds(uint32_t slot)
+{
+	const ObjectInstance& instance = m_Instances[slot];
+	const glm::mat4& model = instance.m_TransformUniform.modelMatrix;
+
+	// the mesh is shared between instances, so it only holds object space bounds
+	AABB box = instance.mesh->getLocalAABB().Transform(model);
+	BoundingSphere sphere = instance.mesh->getLocalSphere().Transform(model);
+
+	m_Bounds.Set(slot, box.center(), box.extent(), sphere.radius);
+}
+
+void InstanceRegistry::BeginFrame()
+{
+	m_DirtyTransforms.Clear();
+	m_DirtyDescriptions.Clear();
+}
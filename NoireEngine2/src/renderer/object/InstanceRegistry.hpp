@@ -0,0 +1,89 @@
+#pragma once
+
+#include "ObjectInstance.hpp"
+#include "renderer/culling/FrustumCuller.hpp"
+#include "renderer/AABB.hpp"
+
+#include <vector>
+#include <utility>
+
+/**
+ * A deduplicated set of slot indices. Used to remember which slots still have to be uploaded.
+ */
+class DirtySlotSet
+{
+public:
+	void Add(uint32_t slot);
+
+	// adds every slot in [0, count)
+	void AddAll(uint32_t count);
+
+	void Merge(const DirtySlotSet& other);
+
+	void Clear();
+
+	inline bool Empty() const { return m_Slots.empty(); }
+	inline size_t size() const { return m_Slots.size(); }
+	inline const std::vector<uint32_t>& slots() const { return m_Slots; }
+
+	// sorts the slots and merges neighbours into [begin, end) ranges
+	void BuildRanges(std::vector<std::pair<uint32_t, uint32_t>>& outRanges);
+
+private:
+	std::vector<uint32_t>	m_Slots;
+	std::vector<uint8_t>	m_Contains;
+};
+
+/**
+ * Persistent storage for every renderable in the scene. A slot is allocated when a RendererComponent
+ * is added and freed when it is removed, and the slot index is also the index into the GPU transform
+ * and object description buffers. Only slots that changed are marked dirty for upload.
+ */
+class InstanceRegistry
+{
+public:
+	static constexpr uint32_t INVALID_SLOT = ~0u;
+
+	uint32_t Allocate(Mesh* mesh, Material* material, uint64_t entityID);
+
+	void Free(uint32_t slot);
+
+	// sets the model matrix, and recomputes the normal matrix and world bounds once
+	void SetTransform(uint32_t slot, const glm::mat4& model);
+
+	// clears the dirty sets of the previous frame
+	void BeginFrame();
+
+	inline const ObjectInstance& operator[](uint32_t slot) const { return m_Instances[slot]; }
+	inline bool IsAlive(uint32_t slot) const { return m_Alive[slot]; }
+
+	// world space bounds of every slot, for culling
+	inline const CullingBounds& getBounds() const { return m_Bounds; }
+	AABB getWorldAABB(uint32_t slot) const;
+	BoundingSphere getWorldSphere(uint32_t slot) const;
+
+	// high-water mark of slots, GPU buffers must hold at least this many entries
+	inline uint32_t capacity() const { return (uint32_t)m_Instances.size(); }
+	inline uint32_t getNumAlive() const { return capacity() - (uint32_t)m_FreeSlots.size(); }
+
+	// slots whose transform / description changed this frame
+	inline const DirtySlotSet& getDirtyTransforms() const { return m_DirtyTransforms; }
+	inline const DirtySlotSet& getDirtyDescriptions() const { return m_DirtyDescriptions; }
+
+	// bumped whenever a slot is allocated or freed
+	inline uint32_t getVersion() const { return m_Version; }
+
+private:
+	void UpdateBounds(uint32_t slot);
+
+	std::vector<ObjectInstance>	m_Instances;
+	std::vector<uint8_t>		m_Alive;
+	std::vector<uint32_t>		m_FreeSlots;
+
+	CullingBounds				m_Bounds;
+
+	DirtySlotSet				m_DirtyTransforms;
+	DirtySlotSet				m_DirtyDescriptions;
+
+	uint32_t					m_Version = 0;
+};
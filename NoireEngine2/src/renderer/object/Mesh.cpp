@@ -16,6 +16,9 @@
 #include "glm/gtx/extended_min_max.hpp"
 
 #include "backend/RaytracingContext.hpp"
+#include "backend/buffers/StagingRing.hpp"
+#include "backend/VulkanContext.hpp"
+#include "core/jobs/JobSystem.hpp"
 
 Mesh::Mesh(const CreateInfo& createInfo) :
 	m_CreateInfo(createInfo)
@@ -40,7 +43,7 @@ const Mesh::CreateInfo Mesh::Deserialize(const Scene::TValueMap& obj)
 		{
 			attributeMap.at("offset").as_uint32t(),
 			attributeMap.at("stride").as_uint32t(),
-			attributeMap.at("format").as_string().value(),
+			std::string(attributeMap.at("format").as_string().value()),
 		};
 	};
 
@@ -59,12 +62,12 @@ const Mesh::CreateInfo Mesh::Deserialize(const Scene::TValueMap& obj)
 		materialStr = matIt->second.as_string().value();
 
 	return CreateInfo (
-		obj.at("name").as_string().value(),
-		obj.at("topology").as_string().value(),
+		std::string(obj.at("name").as_string().value()),
+		std::string(obj.at("topology").as_string().value()),
 		obj.at("count").as_uint32t(),
 		vertexAttributes,
 		materialStr,
-		attributesMap.at("POSITION").as_object().value().at("src").as_string().value()
+		std::string(attributesMap.at("POSITION").as_object().value().at("src").as_string().value())
 	);
 }
 
@@ -114,12 +117,47 @@ std::shared_ptr<Mesh> Mesh::Create(const Node& node)
 	}
 
 	auto result = std::make_shared<Mesh>();
-	Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+	if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+		return std::dynamic_pointer_cast<Mesh>(cached);
 	node >> *result;
 	result->Load();
 	return result;
 }
 
+void Mesh::CreateAll(const std::vector<CreateInfo>& createInfos)
+{
+	std::vector<Mesh*> pending;
+	for (const auto& createInfo : createInfos)
+	{
+		Mesh temp(createInfo);
+		Node node;
+		node << temp;
+		if (Resources::Get()->Find<Mesh>(node))
+			continue;
+
+		auto result = std::make_shared<Mesh>();
+		// a mesh listed twice is only loaded once
+		if (Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)) != result)
+			continue;
+		node >> *result;
+		result->m_Vertex = VertexInput::Create(result->m_CreateInfo.attributes).get();
+		pending.emplace_back(result.get());
+	}
+
+	JobCounter counter;
+	Mesh** meshes = pending.data();
+	JobSystem::Get()->Dispatch(counter, (uint32_t)pending.size(), 1, [meshes](uint32_t i) {
+		meshes[i]->LoadGeometry();
+	});
+	JobSystem::Get()->Wait(counter);
+
+	// the geometry is staged into the ring as it goes and submitted as one batch, without waiting on it
+	StagingRing* ring = VulkanContext::Get()->getStagingRing();
+	for (Mesh* mesh : pending)
+		mesh->Upload(*ring);
+	ring->Flush();
+}
+
 void Mesh::Load()
 {
 	NE_INFO("Instantiated mesh from {}", m_CreateInfo.src);
@@ -127,6 +165,15 @@ void Mesh::Load()
 	// create vertex input
 	m_Vertex = VertexInput::Create(m_CreateInfo.attributes).get();
 
+	LoadGeometry();
+
+	StagingRing* ring = VulkanContext::Get()->getStagingRing();
+	Upload(*ring);
+	ring->Flush();
+}
+
+void Mesh::LoadGeometry()
+{
 	// load all bytes from binary
 	const auto& path = SceneManager::Get()->getScene()->getRootPath().parent_path() / m_CreateInfo.src;
 	std::vector<std::byte> bytes = Files::ReadAbsolute(path.string());
@@ -139,16 +186,32 @@ void Mesh::Load()
 	TransformToIndexedMesh(vertices, m_CreateInfo.count);
 }
 
-void Mesh::CreateAABB(const std::vector<Vertex>& vertices)
+void Mesh::Upload(StagingRing& ring)
 {
-	m_AABB.originMin = glm::vec3(FLT_MAX);
-	m_AABB.originMax = glm::vec3(-FLT_MAX);
+	CreateVertexBuffer(ring);
+	CreateIndexBuffer(ring);
+
+	// the ring holds its own copy now
+	m_StagedVertices = {};
+	m_StagedIndices = {};
+}
+
+void Mesh::CreateBounds(const std::vector<Vertex>& vertices)
+{
+	m_LocalAABB.min = glm::vec3(FLT_MAX);
+	m_LocalAABB.max = glm::vec3(-FLT_MAX);
 
 	for (uint32_t i = 0; i < vertices.size(); ++i)
 	{
-		m_AABB.originMin = glm::min(m_AABB.originMin, vertices[i].position);
-		m_AABB.originMax = glm::max(m_AABB.originMax, vertices[i].position);
+		m_LocalAABB.min = glm::min(m_LocalAABB.min, vertices[i].position);
+		m_LocalAABB.max = glm::max(m_LocalAABB.max, vertices[i].position);
 	}
+
+	// centered on the box, radius is the farthest vertex. Tighter than half the box diagonal
+	m_LocalSphere.center = m_LocalAABB.center();
+	m_LocalSphere.radius = 0;
+	for (uint32_t i = 0; i < vertices.size(); ++i)
+		m_LocalSphere.radius = glm::max(m_LocalSphere.radius, glm::distance(m_LocalSphere.center, vertices[i].position));
 }
 
 void Mesh::TransformToIndexedMesh(Vertex* vertices, uint32_t count)
@@ -157,10 +220,12 @@ void Mesh::TransformToIndexedMesh(Vertex* vertices, uint32_t count)
 
 	std::unordered_map<Vertex, uint32_t> vertexToIndexMap;
 	
-	std::vector<uint32_t> indices;
+	std::vector<uint32_t>& indices = m_StagedIndices;
+	indices.clear();
 	indices.reserve(m_CreateInfo.count);
 
-	std::vector<Vertex> uniqueVertices;
+	std::vector<Vertex>& uniqueVertices = m_StagedVertices;
+	uniqueVertices.clear();
 	uniqueVertices.reserve(m_CreateInfo.count / 3);
 
 	for (uint32_t i = 0; i < count; ++i)
@@ -182,15 +247,13 @@ void Mesh::TransformToIndexedMesh(Vertex* vertices, uint32_t count)
 	numVertices = (uint32_t)uniqueVertices.size();
 	numIndices = (uint32_t)indices.size();
 
-	CreateAABB(uniqueVertices);
-	CreateVertexBuffer(uniqueVertices);
-	CreateIndexBuffer(indices);
+	CreateBounds(uniqueVertices);
 
 	NE_INFO("Loading as indexed mesh took {}ms", timer.GetElapsed(true));
 }
 
 
-void Mesh::CreateVertexBuffer(std::vector<Vertex>& vertices)
+void Mesh::CreateVertexBuffer(StagingRing& ring)
 {
 	VkBufferUsageFlags accelerationStructureFlags =
 #ifdef _NE_USE_RTX
@@ -201,6 +264,8 @@ void Mesh::CreateVertexBuffer(std::vector<Vertex>& vertices)
 		0;
 #endif
 
+	const std::vector<Vertex>& vertices = m_StagedVertices;
+
 	m_VertexBuffer.buffer = Buffer(
 		vertices.size() * 48,
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | accelerationStructureFlags,
@@ -208,12 +273,12 @@ void Mesh::CreateVertexBuffer(std::vector<Vertex>& vertices)
 		Buffer::Unmapped
 	);
 
-	Buffer::TransferToBufferIdle(vertices.data(), vertices.size() * 48, m_VertexBuffer.buffer.getBuffer());
+	ring.Upload(vertices.data(), vertices.size() * 48, m_VertexBuffer.buffer.getBuffer());
 
 	m_VertexBuffer.deviceAddress = m_VertexBuffer.buffer.GetBufferDeviceAddress();
 }
 
-void Mesh::CreateIndexBuffer(std::vector<uint32_t>& indices)
+void Mesh::CreateIndexBuffer(StagingRing& ring)
 {
 	VkBufferUsageFlags accelerationStructureFlags =
 #ifdef _NE_USE_RTX
@@ -224,6 +289,8 @@ void Mesh::CreateIndexBuffer(std::vector<uint32_t>& indices)
 		0;
 #endif
 
+	const std::vector<uint32_t>& indices = m_StagedIndices;
+
 	m_IndexBuffer.buffer = Buffer(
 		indices.size() * 4,
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | accelerationStructureFlags,
@@ -231,16 +298,11 @@ void Mesh::CreateIndexBuffer(std::vector<uint32_t>& indices)
 		Buffer::Unmapped
 	);
 
-	Buffer::TransferToBufferIdle(indices.data(), indices.size() * 4, m_IndexBuffer.buffer.getBuffer());
+	ring.Upload(indices.data(), indices.size() * 4, m_IndexBuffer.buffer.getBuffer());
 
 	m_IndexBuffer.deviceAddress = m_IndexBuffer.buffer.GetBufferDeviceAddress();
 }
 
-void Mesh::Update(const glm::mat4& model)
-{
-	m_AABB.Update(model);
-}
-
 void Mesh::Bind(const CommandBuffer& commandBuffer)
 {
 	std::array< VkBuffer, 1 > vertex_buffers{ m_VertexBuffer.buffer.getBuffer() };
@@ -6,6 +6,8 @@
 #include "renderer/scene/Scene.hpp"
 #include "renderer/AABB.hpp"
 
+class StagingRing;
+
 class Mesh : public Resource
 {
 public:
@@ -62,6 +64,10 @@ public: // loading and initialization
 	static std::shared_ptr<Mesh> Create(const CreateInfo& createInfo);
 	static std::shared_ptr<Mesh> Create(const Node& node);
 
+	// creates every mesh that is not cached yet. Files are read and indexed on the job system,
+	// and all vertex and index buffers are uploaded in one submission
+	static void CreateAll(const std::vector<CreateInfo>& createInfos);
+
 	// loads the mesh from create info
 	void Load();
 
@@ -72,8 +78,6 @@ public: // loading and initialization
 	friend Node& operator<<(Node& node, const CreateInfo& info);
 
 public:
-	void Update(const glm::mat4& model);
-
 	virtual std::type_index getTypeIndex() const { return typeid(Mesh); }
 
 	inline const Buffer& getVertexBuffer() const { return m_VertexBuffer.buffer; }
@@ -90,20 +94,28 @@ public:
 
 	inline VertexInput* getVertexInput() { return m_Vertex; }
 
-	inline const AABB& getAABB() const { return m_AABB; }
+	// object space bounds, shared by every instance of this mesh. World bounds live on the instance
+	inline const AABB& getLocalAABB() const { return m_LocalAABB; }
+	inline const BoundingSphere& getLocalSphere() const { return m_LocalSphere; }
 
 	inline const CreateInfo& getInfo() const { return m_CreateInfo; }
 
 	void Bind(const CommandBuffer& commandBuffer);
 
 private:
-	void CreateAABB(const std::vector<Vertex>& vertices);
+	void CreateBounds(const std::vector<Vertex>& vertices);
+
+	// cpu side of loading, safe to run on any thread: reads the file, indexes it and computes bounds
+	void LoadGeometry();
+
+	// creates the device buffers, stages the loaded geometry into the ring and releases it
+	void Upload(StagingRing& ring);
 
 	void TransformToIndexedMesh(Vertex* vertices, uint32_t count);
 
-	void CreateVertexBuffer(std::vector<Vertex>& vertices);
+	void CreateVertexBuffer(StagingRing& ring);
 
-	void CreateIndexBuffer(std::vector<uint32_t>& indices);
+	void CreateIndexBuffer(StagingRing& ring);
 
 private:
 	AddressedBuffer					m_VertexBuffer;
@@ -112,5 +124,10 @@ private:
 	uint32_t						numIndices;
 	VertexInput*					m_Vertex;
 	CreateInfo						m_CreateInfo;
-	AABB							m_AABB;
+	AABB							m_LocalAABB;
+	BoundingSphere					m_LocalSphere;
+
+	// indexed geometry between LoadGeometry() and the upload
+	std::vector<Vertex>				m_StagedVertices;
+	std::vector<uint32_t>			m_StagedIndices;
 };
\ No newline at end of file
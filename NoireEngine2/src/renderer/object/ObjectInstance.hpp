@@ -8,24 +8,24 @@ class CommandBuffer;
 
 struct ObjectInstance
 {
+	// clip space is computed in the shader from the scene's view projection,
+	// so this only changes when the object itself moves
 	struct TransformUniform 
 	{
-		glm::mat4 modelToClip;
 		glm::mat4 modelMatrix;
 		glm::mat4 modelMatrix_Normal;
 	}m_TransformUniform;
-	static_assert(sizeof(TransformUniform) == 64 * 3, "Transform Uniform is the expected size.");
+	static_assert(sizeof(TransformUniform) == 64 * 2, "Transform Uniform is the expected size.");
 
 	uint32_t firstVertex = 0;
 
-	Mesh* mesh;
-	Material* material;
-	uint64_t entityID;
+	Mesh* mesh = nullptr;
+	Material* material = nullptr;
+	uint64_t entityID = 0;
 
 	ObjectInstance() = default;
 
 	ObjectInstance(
-		const glm::mat4& modelToClip,
 		const glm::mat4& model,
 		const glm::mat4& normal,
 		uint32_t vertexIndex,
@@ -33,7 +33,7 @@ struct ObjectInstance
 		Material* materialPtr,
 		uint64_t eid
 	) : 
-		m_TransformUniform{ modelToClip, model, normal },
+		m_TransformUniform{ model, normal },
 		firstVertex(vertexIndex),
 		mesh(meshPtr),
 		material(materialPtr),
@@ -1,6 +1,5 @@
 #include "Entity.hpp"
 
-#include "TransformMatrixStack.hpp"
 #include "Scene.hpp"
 #include "renderer/object/ObjectInstance.hpp"
 
@@ -18,15 +17,15 @@ void Entity::SetParent(Entity* newParent)
 {
 	m_Parent = newParent;
 	s_Transform->SetParent(newParent->transform());
+
+	if (m_Scene)
+		m_Scene->MarkHierarchyDirty();
 }
 
 void Entity::Update()
 {
 	if (s_Transform) 
-	{
-		s_Transform->Update();
 		m_Scene->isSceneDirty |= s_Transform->wasDirtyThisFrame;
-	}
 
 	// update components
 	for (auto& component : m_Components)
@@ -40,46 +39,3 @@ void Entity::Update()
 		child->Update();
 	}
 }
-
-void Entity::RenderPass(TransformMatrixStack& matrixStack)
-{
-	matrixStack.Push();
-	{
-		matrixStack.Multiply(s_Transform->GetLocal());
-
-		// render self
-		const glm::mat4& model = matrixStack.Peek();
-		for (auto& component : m_Components)
-		{
-			component->Render(model);
-		}
-
-		// render children first
-		for (auto& child : m_Children)
-		{
-			child->RenderPass(matrixStack);
-		}
-	}
-	matrixStack.Pop();
-}
-
-void Entity::PrepareAcceleration(TransformMatrixStack& matrixStack)
-{
-	matrixStack.Push();
-	{
-		matrixStack.Multiply(std::move(s_Transform->GetLocal()));
-
-		// render self
-		const glm::mat4& model = matrixStack.Peek();
-		RendererComponent* renderer = GetComponent<RendererComponent>();
-		if (renderer)
-			renderer->PrepareAcceleration(model);
-
-		// render children first
-		for (auto& child : m_Children)
-		{
-			child->PrepareAcceleration(matrixStack);
-		}
-	}
-	matrixStack.Pop();
-}
@@ -15,8 +15,6 @@
 						m_Children.back()->SetParent(this);\
 						return m_Children.back().get();\
 
-class TransformMatrixStack;
-
 class Entity
 {
 public:
@@ -86,12 +84,9 @@ public:
 
 	void SetParent(Entity* newParent);
 
-	// dfs the scene graph and update components
+	// dfs the scene graph and update components. Transforms are updated by the scene's TransformHierarchy
 	void Update();
 
-	// stores transforms in a matrix stack, and push transform matrices in a reverse order
-	void RenderPass(TransformMatrixStack& matrixStack);
-
 public:
 	inline Entity* parent()												{ return m_Parent; }
 	inline Transform* transform()										{ return s_Transform.get(); }
@@ -105,9 +100,6 @@ public:
 
 private:
 	friend class Scene;
-	void PrepareAcceleration(TransformMatrixStack& matrixStack);
-
-private:
 
 	std::unique_ptr<Transform>				s_Transform;
 	Entity*									m_Parent = nullptr;
@@ -2,11 +2,14 @@
 #include "core/Time.hpp"
 #include "Entity.hpp"
 #include "core/resources/Files.hpp"
+#include "core/resources/Resources.hpp"
+#include "core/jobs/JobSystem.hpp"
 #include "utils/Enumerate.hpp"
 #include "utils/Logger.hpp"
 #include "SceneManager.hpp"
 #include "renderer/object/Mesh.hpp"
 #include "core/Bitmap.hpp"
+#include "Application.hpp"
 
 #include <iostream>
 #include <unordered_map>
@@ -28,8 +31,16 @@ void Scene::Load(const std::string& path)
 	InstantiateCoreScripts();
 	UpdateSceneInfo();
 
-	m_ObjectInstances.resize(N_TOTAL_MATERIALS);
+	m_VisibleInstances.resize(N_TOTAL_MATERIALS);
 	PrepareAccelerationStructures();
+
+	// everything was inserted one by one while loading, build a proper tree once
+	m_BVH.Rebuild();
+
+	NE_INFO("Resource cache: {} lookups in {}ms", Resources::Get()->getNumLookups(), Resources::Get()->getLookupTime());
+#ifdef NE_BENCHMARK_RESOURCES
+	Resources::Get()->BenchmarkLookups();
+#endif
 }
 
 Scene::~Scene()
@@ -47,6 +58,11 @@ void Scene::Update()
 
 	isSceneDirty = false;
 
+	// the renderer consumed last frame's dirty slots by now
+	m_InstanceRegistry.BeginFrame();
+
+	UpdateTransforms();
+
 	// update entities and components
 	Entity::root().Update();
 
@@ -61,17 +77,88 @@ void Scene::Render()
 		return;
 	}
 
-	for (auto& instances : m_ObjectInstances)
+	for (auto& instances : m_VisibleInstances)
 		instances.clear();
 	m_SelectedObjectInstances.clear();
 	m_GizmosInstances.clear();
-	m_MatrixStack.Clear();
 
-	// push all transforms to pipeline
-	for (auto& child : Entity::root().children()) 
+	// push all transforms to pipeline, world matrices are already resolved
+	const auto& entities = m_TransformHierarchy.entities();
+	for (uint32_t i = 0; i < entities.size(); ++i)
+	{
+		const glm::mat4& model = m_TransformHierarchy.getWorld(i);
+		for (auto& component : entities[i]->components())
+		{
+			component->Render(model);
+		}
+	}
+
+	CullInstances();
+}
+
+void Scene::CullInstances()
+{
+	static auto cullMode = Application::GetSpecification().Culling;
+
+	// leaves moved during the component render walk
+	m_BVH.Refit();
+
+	if (cullMode == ApplicationSpecification::Culling::Frustum)
+	{
+		const Camera* cullCam = GetCullingCam()->camera();
+
+		assert(cullCam && "No active culling camera");
+		if (m_FrustumCuller.getMethod() == FrustumCuller::Method::BVH)
+			m_FrustumCuller.Cull(cullCam->getViewFrustum(), m_BVH, m_CulledSlots);
+		else
+			m_FrustumCuller.Cull(cullCam->getViewFrustum(), m_InstanceRegistry.getBounds(), m_CulledSlots);
+	}
+	else
+	{
+		// with gpu or occlusion culling every alive slot is a candidate, the renderer's compute passes cull them
+		m_CulledSlots.clear();
+		for (uint32_t slot = 0; slot < m_InstanceRegistry.capacity(); ++slot)
+			m_CulledSlots.emplace_back(slot);
+	}
+
+	for (uint32_t slot : m_CulledSlots)
 	{
-		child->RenderPass(m_MatrixStack);
- 	}
+		if (!m_InstanceRegistry.IsAlive(slot))
+			continue;
+
+		const ObjectInstance& instance = m_InstanceRegistry[slot];
+		m_VisibleInstances[(uint32_t)instance.material->getWorkflow()].emplace_back(slot);
+	}
+}
+
+UUID Scene::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance) const
+{
+	float distance;
+	uint32_t hit = m_BVH.Raycast(origin, direction, maxDistance, distance);
+	return hit == BVH::NULL_NODE ? UUID(0) : UUID(m_BVH.getNode(hit).entityID);
+}
+
+void Scene::QueryFrustum(const Frustum& frustum, std::vector<UUID>& outEntities) const
+{
+	m_BVH.QueryFrustum(frustum, [&outEntities](const BVH::Node& leaf) { outEntities.emplace_back(leaf.entityID); });
+}
+
+void Scene::QuerySphere(const glm::vec3& center, float radius, std::vector<UUID>& outEntities) const
+{
+	m_BVH.QuerySphere(center, radius, [&outEntities](const BVH::Node& leaf) { outEntities.emplace_back(leaf.entityID); });
+}
+
+void Scene::QueryAABB(const AABB& bounds, std::vector<UUID>& outEntities) const
+{
+	m_BVH.QueryAABB(bounds, [&outEntities](const BVH::Node& leaf) { outEntities.emplace_back(leaf.entityID); });
+}
+
+void Scene::UpdateTransforms()
+{
+	if (m_TransformHierarchy.IsStructureDirty())
+		m_TransformHierarchy.Rebuild(Entity::root());
+
+	m_TransformHierarchy.Update();
 }
 
 static void LoadTransform(const Scene::TValueMap& obj, glm::vec3& outPosition, glm::quat& outRotation, glm::vec3& outScale)
@@ -272,13 +359,13 @@ static void MakeAnimation(const Scene::TSceneMap& sceneMap)
 			continue;
 		}
 
-		const auto& nodeName = driverObjOpt.value().at("node").as_string().value();
+		const std::string nodeName(driverObjOpt.value().at("node").as_string().value());
 		if (nameToEntityMap.find(nodeName) == nameToEntityMap.end()) {
 			NE_WARN("No entity named" + nodeName + "exists.");
 			continue;
 		}
 
-		const auto& animName = driverObjOpt.value().at("name").as_string().value();
+		const std::string animName(driverObjOpt.value().at("name").as_string().value());
 
 		std::shared_ptr<Animation> anim = Animation::Create(animName, animName);
 		anim->Load(driverObjOpt.value());
@@ -308,7 +395,7 @@ static void MakeEnvironment(Scene* scene, const Scene::TSceneMap& sceneMap)
 		}
 
 		const auto& radiance = environmentObjOpt.value().at("radiance");
-		const auto& name = radiance.as_texPath().value();
+		const std::string name(radiance.as_texPath().value());
 
 		Scene::SkyboxType type = Scene::SkyboxType::HDR;
 		if (auto& radianceObj = radiance.as_object()){
@@ -373,25 +460,83 @@ static Entity* MakeNode(Scene* scene, Scene::TSceneMap& sceneMap, const std::str
 			}
 
 			// At last, the recursive call!
-			MakeNode(scene, sceneMap, childOpt.value(), newEntity);
+			MakeNode(scene, sceneMap, std::string(childOpt.value()), newEntity);
 		}
 	}
 
 	return newEntity;
 }
 
+// paths of every texture referenced by a material, either directly or nested like pbr.albedo.src
+static void CollectTexturePaths(const Scene::TValueMap& obj, const std::filesystem::path& root, std::vector<std::filesystem::path>& outPaths)
+{
+	for (const auto& [key, value] : obj)
+	{
+		if (const auto& texPath = value.as_texPath())
+			outPaths.emplace_back(root / texPath.value());
+		else if (const auto& child = value.as_object())
+			CollectTexturePaths(child.value(), root, outPaths);
+	}
+}
+
+static std::vector<std::filesystem::path> CollectTexturePaths(const Scene::TSceneMap& sceneMap, const std::filesystem::path& root)
+{
+	std::vector<std::filesystem::path> paths;
+
+	auto it = sceneMap.find(SceneNode::Material);
+	if (it == sceneMap.end())
+		return paths;
+
+	for (const auto& [name, value] : it->second)
+	{
+		if (const auto& obj = value.as_object())
+			CollectTexturePaths(obj.value(), root, paths);
+	}
+	return paths;
+}
+
+static std::vector<Mesh::CreateInfo> CollectMeshes(const Scene::TSceneMap& sceneMap)
+{
+	std::vector<Mesh::CreateInfo> createInfos;
+
+	auto it = sceneMap.find(SceneNode::Mesh);
+	if (it == sceneMap.end())
+		return createInfos;
+
+	for (const auto& [name, value] : it->second)
+	{
+		const auto& obj = value.as_object();
+		if (!obj)
+			continue;
+
+		try {
+			createInfos.emplace_back(Mesh::Deserialize(obj.value()));
+		}
+		catch (std::exception& e) {
+			NE_WARN("Skipping mesh {}: {}", name, e.what());
+		}
+	}
+	return createInfos;
+}
+
 void Scene::Deserialize(const std::string& path)
 {
 	sceneRootAbsolutePath = Files::Path(path);
 
 	NE_DEBUG("Loading scene: " + sceneRootAbsolutePath.string(), Logger::CYAN, Logger::BOLD);
 
-	TSceneMap sceneMap; // entire scene map
-
 	std::vector<std::string> roots;
 	bool foundScene = false;
 
+	Timer stageTimer;
 	sejp::value loaded = sejp::load(sceneRootAbsolutePath.string());
+	float parseTime = stageTimer.GetElapsed(true);
+	float fileSizeMB = std::filesystem::file_size(sceneRootAbsolutePath) / (1024.0f * 1024.0f);
+	NE_INFO("Parsed {:.2f}MB in {:.2f}ms ({:.1f}MB/s)", fileSizeMB, parseTime, fileSizeMB / (parseTime / 1000.0f));
+
+	// entire scene map. its values borrow from loaded, so it is declared after it and released first
+	TSceneMap sceneMap;
+
 	auto& arr = loaded.as_array().value();
 
 	// do a first parse of the file, put everything into sceneMap, hashed by name
@@ -407,7 +552,7 @@ void Scene::Deserialize(const std::string& path)
 		auto GET_STR = [&objMap](const char* key) { return objMap.at(key).as_string().value(); };
 
 		try {
-			SceneNode::Type type = SceneNode::ObjectType(GET_STR("type"));
+			SceneNode::Type type = SceneNode::ObjectType(std::string(GET_STR("type")));
 
 			// insert into scene map
 			if (sceneMap.find(type) == sceneMap.end())
@@ -436,10 +581,23 @@ void Scene::Deserialize(const std::string& path)
 		}
 	}
 
+	float indexTime = stageTimer.GetElapsed(true);
+
 	if (sceneMap.find(SceneNode::Node) == sceneMap.end()) 
 		NE_WARN("Scene is empty");
 	else 
 	{
+		// decode every texture and load every mesh on the job system before the graph needs them.
+		// Decoding runs in the background while the meshes are read, indexed and uploaded
+		JobCounter textureCounter;
+		Image2D::Prefetch(CollectTexturePaths(sceneMap, sceneRootAbsolutePath.parent_path()), textureCounter);
+
+		Mesh::CreateAll(CollectMeshes(sceneMap));
+		float meshTime = stageTimer.GetElapsed(true);
+
+		JobSystem::Get()->Wait(textureCounter);
+		float textureTime = stageTimer.GetElapsed(true);
+
 		// traverse all node objects
 		for (const auto& root : roots)
 		{
@@ -448,6 +606,12 @@ void Scene::Deserialize(const std::string& path)
 
 		MakeAnimation(sceneMap);
 		MakeEnvironment(this, sceneMap);
+
+		Image2D::ClearPrefetched();
+		float graphTime = stageTimer.GetElapsed(true);
+
+		NE_INFO("Scene load stages: parse {:.2f}ms, index {:.2f}ms, meshes {:.2f}ms, textures {:.2f}ms (after meshes), graph {:.2f}ms", 
+			parseTime, indexTime, meshTime, textureTime, graphTime);
 	}
 
 	NE_INFO("Finished loading scene");
@@ -485,13 +649,14 @@ void Scene::AddSkybox(const std::string& path, SkyboxType type, bool isDefault)
 
 	// load prefiltered environment maps into the mip levels of the big environment map
 	{
-		m_PrefilteredEnvMap->TransitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
+		// the mip copies go through the staging ring, so the transitions around them are queued there too
+		m_PrefilteredEnvMap->QueueTransitionLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT);
 		for (int i = 1; i < GGX_MIP_LEVELS; i++) {
 			std::string ggxPath = substr + ".ggx-" + std::to_string(i) + ".png";
 			Bitmap bitmap(FormatPath(ggxPath), isHDR); // load a raw bitmap
 			m_PrefilteredEnvMap->SetPixels(bitmap.data.get(), 6, 0, i); // copy bitmap as buffer into image mip level
 		}
-		m_PrefilteredEnvMap->TransitionLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_PrefilteredEnvMap->getLayout(), VK_IMAGE_ASPECT_COLOR_BIT);
+		m_PrefilteredEnvMap->QueueTransitionLayout(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_PrefilteredEnvMap->getLayout(), VK_IMAGE_ASPECT_COLOR_BIT);
 	}
 }
 
@@ -639,11 +804,15 @@ void Scene::UpdateShadowCasters()
 void Scene::PrepareAccelerationStructures()
 {
 	m_GizmosInstances.clear();
-	m_MatrixStack.Clear();
 
-	// push all transforms to pipeline
-	for (auto& child : Entity::root().children())
+	// nothing has been updated yet at load time
+	UpdateTransforms();
+
+	const auto& entities = m_TransformHierarchy.entities();
+	for (uint32_t i = 0; i < entities.size(); ++i)
 	{
-		child->PrepareAcceleration(m_MatrixStack);
+		RendererComponent* renderer = entities[i]->GetComponent<RendererComponent>();
+		if (renderer)
+			renderer->PrepareAcceleration(m_TransformHierarchy.getWorld(i));
 	}
 }
@@ -3,8 +3,8 @@
 #include "utils/Singleton.hpp"
 #include "utils/UUID.hpp"
 
-#include "TransformMatrixStack.hpp"
-#include "renderer/object/ObjectInstance.hpp"
+#include "TransformHierarchy.hpp"
+#include "renderer/object/InstanceRegistry.hpp"
 #include "renderer/gizmos/GizmosInstance.hpp"
 #include "utils/sejp/sejp.hpp"
 #include "SceneNode.hpp"
@@ -32,15 +32,16 @@ class Scene : Singleton
 {
 public:
 	// { name, serialized object map }
-	using TValueMap = std::map<std::string, sejp::value>;
+	using TValueMap = sejp::object;
 
-	// { name, serialized object unordered map }
-	using TValueUMap = std::unordered_map<std::string, sejp::value>;
+	// { name, serialized object unordered map }, names and values are views into the loaded file:
+	// keep the root sejp::value alive for as long as the map
+	using TValueUMap = std::unordered_map<std::string_view, sejp::value>;
 
 	// Maps from object type to serialized object maps
 	using TSceneMap = std::unordered_map<SceneNode::Type, TValueUMap>;
 
-	using TFoundInfo = std::pair<const std::optional<Scene::TValueMap>, const std::string&>;
+	using TFoundInfo = std::pair<const std::optional<Scene::TValueMap>, std::string_view>;
 
 	enum class CameraMode {
 		Scene = 0, // all: sceneCam
@@ -82,10 +83,28 @@ public:
 
 	Entity* FindEntity(UUID);
 
+	// entities were added or reparented, flatten the hierarchy again before the next update
+	void MarkHierarchyDirty() { m_TransformHierarchy.MarkDirty(); }
+
+	inline const TransformHierarchy& getTransformHierarchy() const { return m_TransformHierarchy; }
+
 	//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Rendering and scene uniforms
 
-	std::vector<ObjectInstance>& GetObjectInstances(uint32_t index) { return m_ObjectInstances[index]; }
+	// slots of the instances that survived culling this frame, by material workflow
+	std::vector<uint32_t>& GetVisibleInstances(uint32_t index) { return m_VisibleInstances[index]; }
+
+	InstanceRegistry& GetInstanceRegistry() { return m_InstanceRegistry; }
+
+	FrustumCuller& GetFrustumCuller() { return m_FrustumCuller; }
+
+	BVH& GetBVH() { return m_BVH; }
+
+	// spatial queries over renderables, answered by the bvh at bounding box precision
+	UUID Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance = FLT_MAX) const;
+	void QueryFrustum(const Frustum& frustum, std::vector<UUID>& outEntities) const;
+	void QuerySphere(const glm::vec3& center, float radius, std::vector<UUID>& outEntities) const;
+	void QueryAABB(const AABB& bounds, std::vector<UUID>& outEntities) const;
 
 	std::vector<ObjectInstance>& GetSelectedObjectInstances() { return m_SelectedObjectInstances; }
 
@@ -115,7 +134,10 @@ public:
 
 	inline const void* getSceneUniformPtr() const { return &m_SceneInfo; }
 
-	inline const std::vector<std::vector<ObjectInstance>>& getObjectInstances() const { return m_ObjectInstances; }
+	inline const std::vector<std::vector<uint32_t>>& getVisibleInstances() const { return m_VisibleInstances; }
+	inline const InstanceRegistry& getInstanceRegistry() const { return m_InstanceRegistry; }
+	inline const FrustumCuller& getFrustumCuller() const { return m_FrustumCuller; }
+	inline const BVH& getBVH() const { return m_BVH; }
 	inline const std::vector<ObjectInstance>& getSelectedObjectInstances() const { return m_SelectedObjectInstances; }
 	inline const std::vector<GizmosInstance*>& getGizmosInstances() const { return m_GizmosInstances; }
 
@@ -144,6 +166,8 @@ private:
 	void UpdateSceneInfo();
 	void UpdateShadowCasters();
 	void PrepareAccelerationStructures();
+	void UpdateTransforms();
+	void CullInstances();
 
 private:
 	friend class SceneManager;
@@ -159,12 +183,16 @@ private:
 	CameraComponent* m_DebugCamera = nullptr;
 	Core::SceneNavigationCamera* m_UserNavigationCamera = nullptr;
 
-	TransformMatrixStack m_MatrixStack;
+	TransformHierarchy m_TransformHierarchy;
 
 	// scene uiforms
 	SceneUniform m_SceneInfo;
 
-	std::vector<std::vector<ObjectInstance>> m_ObjectInstances;
+	InstanceRegistry m_InstanceRegistry;
+	std::vector<std::vector<uint32_t>> m_VisibleInstances;
+	BVH m_BVH;
+	FrustumCuller m_FrustumCuller;
+	std::vector<uint32_t> m_CulledSlots;
 	std::vector<ObjectInstance> m_SelectedObjectInstances;
 	std::vector<GizmosInstance*> m_GizmosInstances;
 
@@ -33,7 +33,11 @@ void SceneManager::LoadDefault()
 		//scene->Load("../scenes/LightsLimitTest/LightsLimit1247.s72");
 		scene->Load("../scenes/Reflections/Reflections.s72");
 
-	SetCameraMode(Scene::CameraMode::User);
+	// a camera picked on the command line is looked through, not just culled with
+	if (Application::GetSpecification().CameraName)
+		SetCameraMode(Scene::CameraMode::Scene);
+	else
+		SetCameraMode(Scene::CameraMode::User);
 }
 
 void SceneManager::Update()
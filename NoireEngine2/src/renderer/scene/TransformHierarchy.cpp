@@ -0,0 +1,71 @@
+#include "TransformHierarchy.hpp"
+
+#include "Entity.hpp"
+#include "Transform.hpp"
+
+void TransformHierarchy::Rebuild(Entity& root)
+{
+	m_Entities.clear();
+	m_Parents.clear();
+
+	// m_Entities doubles as the bfs queue
+	for (auto& child : root.children())
+	{
+		m_Entities.emplace_back(child.get());
+		m_Parents.emplace_back(NO_PARENT);
+	}
+
+	for (uint32_t head = 0; head < m_Entities.size(); ++head)
+	{
+		for (auto& child : m_Entities[head]->children())
+		{
+			m_Entities.emplace_back(child.get());
+			m_Parents.emplace_back(head);
+		}
+	}
+
+	size_t n = m_Entities.size();
+	m_Transforms.resize(n);
+	m_Locals.resize(n);
+	m_Worlds.resize(n);
+	m_Dirty.resize(n);
+
+	// indices moved around, so every world matrix has to be resolved again
+	for (size_t i = 0; i < n; ++i)
+	{
+		m_Transforms[i] = m_Entities[i]->transform();
+		m_Transforms[i]->isDirty = true;
+	}
+
+	m_StructureDirty = false;
+}
+
+void TransformHierarchy::Update()
+{
+	const size_t n = m_Transforms.size();
+
+	// pass 1: pull dirty flags and local matrices out of the transforms.
+	// parents are visited first, so Transform::Update sees their flags for this frame
+	for (size_t i = 0; i < n; ++i)
+	{
+		Transform* transform = m_Transforms[i];
+		transform->Update();
+
+		m_Dirty[i] = transform->wasDirtyThisFrame;
+		if (m_Dirty[i])
+			m_Locals[i] = transform->GetLocal();
+	}
+
+	// pass 2: linear over contiguous arrays, parent world is always resolved before its children
+	uint32_t numUpdated = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (!m_Dirty[i])
+			continue;
+
+		uint32_t parent = m_Parents[i];
+		m_Worlds[i] = parent == NO_PARENT ? m_Locals[i] : m_Worlds[parent] * m_Locals[i];
+		numUpdated++;
+	}
+	m_NumUpdated = numUpdated;
+}
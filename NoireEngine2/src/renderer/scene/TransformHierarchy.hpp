@@ -0,0 +1,46 @@
+#pragma once
+
+#include "math/Math.hpp"
+#include <vector>
+
+class Entity;
+class Transform;
+
+/**
+ * Flattened, breadth-first view of the scene graph. Parents always come before their children,
+ * so world matrices are resolved in a single linear pass over contiguous arrays.
+ * Only rebuilt when entities are added or reparented, not every frame.
+ */
+class TransformHierarchy
+{
+public:
+	static constexpr uint32_t NO_PARENT = ~0u;
+
+	// flattens every entity below root in breadth-first order
+	void Rebuild(Entity& root);
+
+	// refreshes local matrices of dirty transforms, then propagates world matrices down dirty subtrees
+	void Update();
+
+	inline void MarkDirty() { m_StructureDirty = true; }
+	inline bool IsStructureDirty() const { return m_StructureDirty; }
+
+	inline size_t size() const { return m_Entities.size(); }
+	inline const std::vector<Entity*>& entities() const { return m_Entities; }
+	inline const glm::mat4& getWorld(uint32_t index) const { return m_Worlds[index]; }
+	inline bool wasDirty(uint32_t index) const { return m_Dirty[index]; }
+
+	// number of world matrices recomputed in the last update
+	inline uint32_t getNumUpdated() const { return m_NumUpdated; }
+
+private:
+	std::vector<Entity*>	m_Entities;
+	std::vector<Transform*>	m_Transforms;
+	std::vector<uint32_t>	m_Parents;
+	std::vector<glm::mat4>	m_Locals;
+	std::vector<glm::mat4>	m_Worlds;
+	std::vector<uint8_t>	m_Dirty;
+
+	uint32_t				m_NumUpdated = 0;
+	bool					m_StructureDirty = true;
+};
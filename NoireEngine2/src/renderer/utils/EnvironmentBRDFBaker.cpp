@@ -78,7 +78,7 @@ void EnvironmentBRDFBaker::Setup()
     pipelineInfo.layout = m_PipelineLayout;
     pipelineInfo.stage = vertModule.shaderStage();
 
-    VulkanContext::VK(vkCreateComputePipelines(VulkanContext::GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline));
+    VulkanContext::VK(vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(), 1, &pipelineInfo, nullptr, &m_Pipeline));
 
     VkFenceCreateInfo fenceInfo{};
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
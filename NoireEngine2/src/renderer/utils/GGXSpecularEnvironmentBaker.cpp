@@ -138,7 +138,7 @@ void GGXSpecularEnvironmentBaker::Prepare()
     pipelineInfo.stage = shader.shaderStage();
     pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
 
-    if (vkCreateComputePipelines(VulkanContext::GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline) != VK_SUCCESS) {
+    if (vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(), 1, &pipelineInfo, nullptr, &m_Pipeline) != VK_SUCCESS) {
         throw std::runtime_error("failed to create compute pipeline!");
     }
 
@@ -103,7 +103,7 @@ void LambertianEnvironmentBaker::Prepare()
     pipelineInfo.stage = vertModule.shaderStage();
     pipelineInfo.stage.pSpecializationInfo = &spec_info;
 
-    if (vkCreateComputePipelines(VulkanContext::GetDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline) != VK_SUCCESS) {
+    if (vkCreateComputePipelines(VulkanContext::GetDevice(), VulkanContext::Get()->getPipelineCache(), 1, &pipelineInfo, nullptr, &m_Pipeline) != VK_SUCCESS) {
         throw std::runtime_error("failed to create compute pipeline!");
     }
 
@@ -90,7 +90,8 @@ std::shared_ptr<VertexInput> VertexInput::Create(const Node& node)
 	}
 
 	auto result = std::make_shared<VertexInput>();
-	Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result));
+	if (auto cached = Resources::Get()->Add(node, std::dynamic_pointer_cast<Resource>(result)); cached != result)
+		return std::dynamic_pointer_cast<VertexInput>(cached);
 	node >> *result;
 	result->Load();
 	return result;
@@ -0,0 +1,81 @@
+// shared by the culling passes, see CullingPipeline
+
+const uint GROUP_SIZE = 64;
+
+// what a dispatch culls, see CullingPipeline::Phase
+const uint PHASE_ALL = 0;          // frustum only
+const uint PHASE_LAST_VISIBLE = 1; // what was visible last frame, before any depth exists
+const uint PHASE_OCCLUSION = 2;    // everything against the depth pyramid of the first pass
+
+// draw counts header: instances drawn by each phase, frustum culled, occluded
+const uint COUNT_HEADER = 4;
+
+struct Bounds
+{
+	vec4 center; // w: sphere radius
+	vec4 extent;
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawCommand
+{
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int  vertexOffset;
+	uint firstInstance;
+};
+
+layout(set=0, binding=0, std430) readonly buffer BoundsBuffer {
+	Bounds BOUNDS[];
+};
+
+layout(set=0, binding=1, std430) readonly buffer Candidates {
+	uint CANDIDATES[];
+};
+
+layout(set=0, binding=2, std430) readonly buffer CandidateCommands {
+	uint CANDIDATE_COMMANDS[];
+};
+
+layout(set=0, binding=3, std430) buffer Commands {
+	DrawCommand COMMANDS[];
+};
+
+// (batch, first command of the batch)
+layout(set=0, binding=4, std430) readonly buffer CommandBatches {
+	uvec2 COMMAND_BATCHES[];
+};
+
+layout(set=0, binding=5, std430) writeonly buffer CulledInstances {
+	uint CULLED_INSTANCES[];
+};
+
+layout(set=0, binding=6, std430) writeonly buffer CulledCommands {
+	DrawCommand CULLED_COMMANDS[];
+};
+
+// [COUNT_HEADER + batch] commands of each batch, the header holds the statistics
+layout(set=0, binding=7, std430) buffer DrawCounts {
+	uint DRAW_COUNTS[];
+};
+
+layout(set=0, binding=8) uniform Culling {
+	mat4 viewProj; // of the camera that wrote the depth pyramid
+	vec4 planes[6]; // (n, d), inside if dot(n, p) + d > 0
+	vec2 depthSize;
+	uint occlusion; // 0 if the pyramid does not match the culling camera
+};
+
+layout(set=0, binding=9) uniform sampler2D HIZ;
+
+// per slot, 1 if it passed the last occlusion test. persists between frames
+layout(set=0, binding=10, std430) buffer Visibility {
+	uint VISIBILITY[];
+};
+
+layout(push_constant) uniform Push {
+	uint candidateCount;
+	uint commandCount; // of one phase, the occlusion phase's commands follow the first phase's
+	uint phase;
+};
@@ -0,0 +1,18 @@
+// clustered lighting grid, see LightClusters
+
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+// a cluster's light counts are packed into 16 bits each
+const uint MAX_CLUSTER_LIGHTS = 0xFFFF;
+
+// cluster of a fragment: its screen tile, and its slice by the log of its view depth
+uint ClusterIndex(vec2 fragCoord, float viewDepth, uvec2 tileSize, vec2 depthSlicing)
+{
+	uvec2 tile = min(uvec2(fragCoord) / tileSize, uvec2(CLUSTERS_X - 1, CLUSTERS_Y - 1));
+	float slice = log(max(viewDepth, 1e-6)) * depthSlicing.x + depthSlicing.y;
+	uint z = uint(clamp(slice, 0.0, float(CLUSTERS_Z - 1)));
+	return tile.x + CLUSTERS_X * (tile.y + CLUSTERS_Y * z);
+}
@@ -52,43 +52,51 @@ float SpotLightRadiance(int i)
 }
 
 #include "shadows.glsl"
+#include "clusters.glsl"
+
+// the fragment's cluster: offset into LIGHT_INDICES, then its point and spot light counts
+uvec3 FragmentCluster()
+{
+	uvec2 cluster = CLUSTERS[ClusterIndex(gl_FragCoord.xy, -inViewPos.z, clusterTileSize, clusterDepthSlicing)];
+	return uvec3(cluster.x, cluster.y & 0xFFFF, cluster.y >> 16);
+}
 
 vec3 DirectLighting()
 {
 	vec3 lightsSum = vec3(0);
-		
-	int shadowMapOffsetId = 0;
 
 	for (int i = 0; i < scene.numLights[0]; ++i)
 	{
 		float radiance = DirLightRadiance(i);
 
 		if (radiance > 0 && DIR_LIGHTS[i].shadowOffset > 0)
-			radiance *= DirLightShadow(i, shadowMapOffsetId);
+			radiance *= DirLightShadow(i, DIR_LIGHTS[i].shadowBase);
 
-		shadowMapOffsetId += DIR_LIGHTS[i].shadowOffset;
 		lightsSum += radiance * vec3(DIR_LIGHTS[i].color);
 	}
 
-	for (int i = 0; i < scene.numLights[1]; ++i)
+	// point and spot lights only from the lists of this fragment's cluster
+	uvec3 cluster = FragmentCluster();
+
+	for (uint k = 0; k < cluster.y; ++k)
 	{
+		int i = int(LIGHT_INDICES[cluster.x + k]);
 		float radiance = PointLightRadiance(i);
 		
 		if (radiance > 0 && POINT_LIGHTS[i].shadowOffset > 0)
-			radiance *= PointLightShadow(i, shadowMapOffsetId);
+			radiance *= PointLightShadow(i, POINT_LIGHTS[i].shadowBase);
 		
-		shadowMapOffsetId += POINT_LIGHTS[i].shadowOffset;
 		lightsSum += radiance * vec3(POINT_LIGHTS[i].color);
 	}
 
-	for (int i = 0; i < scene.numLights[2]; ++i)
+	for (uint k = 0; k < cluster.z; ++k)
 	{
+		int i = int(LIGHT_INDICES[cluster.x + cluster.y + k]);
 		float radiance = SpotLightRadiance(i);
 
 		if (radiance > 0 && SPOT_LIGHTS[i].shadowOffset > 0)
-			radiance *= SpotLightShadow(i, shadowMapOffsetId);
+			radiance *= SpotLightShadow(i, SPOT_LIGHTS[i].shadowBase);
 
-		shadowMapOffsetId += SPOT_LIGHTS[i].shadowOffset;
 		lightsSum += radiance * vec3(SPOT_LIGHTS[i].color);
 	}
 
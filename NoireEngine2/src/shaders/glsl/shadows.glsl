@@ -1,4 +1,4 @@
-// Note: shadows.glsl relies on a descriptor indexed shadowMaps[] array
+// Note: shadows.glsl relies on the shadow atlas and its SHADOW_RECTS
 
 #include "sampling.glsl"
 #include "cubemap.glsl"
@@ -9,24 +9,34 @@ const mat4 biasMat = mat4(
 	0.0, 0.0, 1.0, 0.0,
 	0.5, 0.5, 0.0, 1.0 );
 
+//////////////////////////////////////////////////////////////////////////
+// Samples a shadow map's depth at `uv` within its tile `rect` of the atlas.
+// Clamped half a texel inside the tile, so filtering never reads its neighbours
+float SampleShadowMap(vec4 rect, vec2 uv)
+{
+	vec2 halfTexel = 0.5 / vec2(textureSize(shadowAtlas, 0));
+	vec2 atlasUV = clamp(rect.xy + uv * rect.z, rect.xy + halfTexel, rect.xy + rect.z - halfTexel);
+	return texture(shadowAtlas, atlasUV).r;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Computes PCF for directional light given 
 // `uv` the shadow coords
 // `currentDepth` the actual depth of the fragment without z-test
 // `uvRadius` radius of PCF sampling
-float PCF(vec2 uv, float currentDepth, float uvRadius, int pcfSamples, float bias, int shadowMapIndex){
+float PCF(vec2 uv, float currentDepth, float uvRadius, int pcfSamples, float bias, vec4 rect){
 	float sum = 0;
 	float stp = 64 / pcfSamples;
 	for (int i = 0; i < pcfSamples; i++)
 	{
-		float z = texture(shadowMaps[shadowMapIndex], uv + Poisson64[int(i * stp)] * uvRadius).r;
+		float z = SampleShadowMap(rect, uv + Poisson64[int(i * stp)] * uvRadius);
 		sum += (z < (currentDepth - bias)) ? 0 : 1;
 	}
 	return sum / pcfSamples;
 }
 
 //////////////////////////////////////////////////////////////////////////
-float PCSS(vec2 uv, float currentDepth, float bias, int shadowMapIndex, float lightSize)
+float PCSS(vec2 uv, float currentDepth, float bias, vec4 rect, float lightSize)
 {
 	const float nearClip = 0.1;
 
@@ -37,7 +47,7 @@ float PCSS(vec2 uv, float currentDepth, float bias, int shadowMapIndex, float li
 
 	for (int i = 0; i < scene.occluderSamples; i++)
 	{
-		float z = texture(shadowMaps[shadowMapIndex], uv + Poisson64[int(i * stp)] * searchWidth).r;
+		float z = SampleShadowMap(rect, uv + Poisson64[int(i * stp)] * searchWidth);
 		if (z < (currentDepth - bias))
 		{
 			occluders++;
@@ -54,7 +64,7 @@ float PCSS(vec2 uv, float currentDepth, float bias, int shadowMapIndex, float li
 
 	// percentage-close filtering
 	float uvRadius = penumbraWidth * lightSize * nearClip / currentDepth;
-	return PCF(uv, currentDepth, uvRadius, scene.pcfSamples, bias, shadowMapIndex);
+	return PCF(uv, currentDepth, uvRadius, scene.pcfSamples, bias, rect);
 }
 
 float DirLightShadow(int lightId, int shadowMapId)
@@ -67,7 +77,9 @@ float DirLightShadow(int lightId, int shadowMapId)
 		}
 	}
 
-	int cascadedShadowMapID = shadowMapId + cascadeIndex;
+	vec4 rect = SHADOW_RECTS[shadowMapId + cascadeIndex];
+	if (rect.z == 0)
+		return 1;
 
 	const float shadowBias = EPSILON;
 	vec4 shadowCoord = DIR_LIGHTS[lightId].lightspaces[cascadeIndex] * vec4(inPosition, 1.0);
@@ -79,7 +91,7 @@ float DirLightShadow(int lightId, int shadowMapId)
 		&& shadowCoord.x >= 0.0 && shadowCoord.x <= 1.0
 		&& shadowCoord.y >= 0.0 && shadowCoord.y <= 1.0)
 	{
-		shadow = (1 - PCF(shadowCoord.xy, shadowCoord.z, 0.0005, scene.pcfSamples, 0.0005, cascadedShadowMapID)) * DIR_LIGHTS[lightId].shadowStrength;
+		shadow = (1 - PCF(shadowCoord.xy, shadowCoord.z, 0.0005, scene.pcfSamples, 0.0005, rect)) * DIR_LIGHTS[lightId].shadowStrength;
 	}
 	return 1 - shadow;
 }
@@ -89,7 +101,9 @@ float PointLightShadow(int lightId, int shadowMapId)
 	vec3 lightDir = normalize(inPosition - vec3(POINT_LIGHTS[lightId].position));
 	int face = CartesianToCubeFace(lightDir);
 
-	int omniShadowMapID = shadowMapId + face;
+	vec4 rect = SHADOW_RECTS[shadowMapId + face];
+	if (rect.z == 0)
+		return 1;
 
 	float shadowBias = 0.0005;
 
@@ -103,13 +117,17 @@ float PointLightShadow(int lightId, int shadowMapId)
 		&& shadowCoord.y >= 0.0 && shadowCoord.y <= 1.0)
 	{
 		float lightSize = POINT_LIGHTS[lightId].radius;
-		shadow = (1 - PCSS(shadowCoord.xy, shadowCoord.z, shadowBias, omniShadowMapID, lightSize)) * POINT_LIGHTS[lightId].shadowStrength;
+		shadow = (1 - PCSS(shadowCoord.xy, shadowCoord.z, shadowBias, rect, lightSize)) * POINT_LIGHTS[lightId].shadowStrength;
 	}
 	return 1 - shadow;
 }
 
 float SpotLightShadow(int lightId, int shadowMapId)
 {
+	vec4 rect = SHADOW_RECTS[shadowMapId];
+	if (rect.z == 0)
+		return 1;
+
 	float shadowBias = 0.0005;
 
 	vec4 shadowCoord = SPOT_LIGHTS[lightId].lightspace * vec4(inPosition, 1.0);
@@ -125,7 +143,7 @@ float SpotLightShadow(int lightId, int shadowMapId)
 		&& shadowCoord.y >= 0.0 && shadowCoord.y <= 1.0)
 	{
 		float lightSize = SPOT_LIGHTS[lightId].radius;
-		shadow = (1 - PCSS(shadowCoord.xy, shadowCoord.z, shadowBias, shadowMapId, lightSize)) * SPOT_LIGHTS[lightId].shadowStrength;
+		shadow = (1 - PCSS(shadowCoord.xy, shadowCoord.z, shadowBias, rect, lightSize)) * SPOT_LIGHTS[lightId].shadowStrength;
 	}
 	return 1 - shadow;
 }
\ No newline at end of file
@@ -20,7 +20,6 @@ layout(set=0,binding=0,std430) uniform World {
 ///////////////////////////////////////////////
 struct Transform 
 {
-	mat4 localToClip;
 	mat4 model;
 	mat4 modelNormal;
 };
@@ -29,6 +28,15 @@ layout(set=1, binding=0, std140) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
+///////////////////////////////////////////////
+// Set 1.7: instance slot of each drawn instance.
+// Instanced draws are sorted by mesh and material, so gl_InstanceIndex
+// indexes this, and the slot indexes transforms and objects
+///////////////////////////////////////////////
+layout(set=1, binding=7, std430) readonly buffer Instances {
+	uint INSTANCES[];
+};
+
 ///////////////////////////////////////////////
 // Set 1.1: directional lights
 ///////////////////////////////////////////////
@@ -42,6 +50,7 @@ struct DirLight
 	float intensity;
 	int shadowOffset;
 	float shadowStrength;
+	int shadowBase;
 };
 
 layout(set=1, binding=1, std140) readonly buffer DirLights {
@@ -61,10 +70,10 @@ struct PointLight
 	float limit;
 	int shadowOffset;
 	float shadowStrength;
+	int shadowBase;
 
 	float pad;
 	float pad2;
-	float pad3;
 };
 
 layout(set=1, binding=2, std140) readonly buffer PointLights {
@@ -88,6 +97,7 @@ struct SpotLight
 	int shadowOffset;
 	float shadowStrength;
 	float nearClip;
+	int shadowBase;
 };
 
 layout(set=1, binding=3, std140) readonly buffer SpotLights {
@@ -146,6 +156,33 @@ layout(set=1, binding=5, scalar) readonly buffer Objects {
 	ObjectDesc OBJECTS[];
 };
 
+///////////////////////////////////////////////
+// Set 1.8: light clusters, see glsl/clusters.glsl.
+// Each holds an offset into the index list, then how many point
+// lights (low 16 bits) and spot lights (high 16 bits) follow it
+///////////////////////////////////////////////
+layout(set=1, binding=8, std430) readonly buffer LightClusters {
+	uvec2 clusterTileSize;
+	vec2 clusterDepthSlicing;
+	uvec2 CLUSTERS[];
+};
+
+///////////////////////////////////////////////
+// Set 1.9: light indices of every cluster, within their light type
+///////////////////////////////////////////////
+layout(set=1, binding=9, std430) readonly buffer LightIndices {
+	uint LIGHT_INDICES[];
+};
+
+///////////////////////////////////////////////
+// Set 1.10: where every shadow map sits in the shadow atlas, indexed by
+// a light's shadowBase. xy: corner, z: size, all in atlas uv. z is 0 if
+// the map did not fit this frame
+///////////////////////////////////////////////
+layout(set=1, binding=10, std430) readonly buffer ShadowRects {
+	vec4 SHADOW_RECTS[];
+};
+
 ///////////////////////////////////////////////
 // Set 2: Descriptor indexed textures
 ///////////////////////////////////////////////
@@ -160,9 +197,9 @@ layout (set = 3, binding = 2) uniform sampler2D specularBRDF;
 layout (set = 3, binding = 3) uniform samplerCube prefilterEnvMap;
 
 ///////////////////////////////////////////////
-// Set 4: Descriptor indexed shadowmaps
+// Set 4: Shadow atlas, every shadow map is a tile of it
 ///////////////////////////////////////////////
-layout (set = 4, binding = 0) uniform sampler2D shadowMaps[];
+layout (set = 4, binding = 0) uniform sampler2D shadowAtlas;
 
 ///////////////////////////////////////////////
 // Set 4: Ray tracing images: acceleration structure not exposed to fragment shader
@@ -19,18 +19,20 @@ layout(location=5) flat out uint instanceID;
 #include "host.glsl"
 
 void main() {
-	gl_Position = TRANSFORMS[gl_InstanceIndex].localToClip * vec4(inPosition, 1.0);
+	uint slot = INSTANCES[gl_InstanceIndex];
 
-	outPosition = mat4x3(TRANSFORMS[gl_InstanceIndex].model) * vec4(inPosition, 1.0);
+	outPosition = mat4x3(TRANSFORMS[slot].model) * vec4(inPosition, 1.0);
+
+	gl_Position = scene.viewProj * vec4(outPosition, 1.0);
 	outTexCoord = inTexCoord;
 
-	mat3 normalMatrix = mat3(transpose(TRANSFORMS[gl_InstanceIndex].modelNormal));
+	mat3 normalMatrix = mat3(transpose(TRANSFORMS[slot].modelNormal));
     outNormal = normalize(normalMatrix * inNormal);
 
-	mat3 model = mat3(TRANSFORMS[gl_InstanceIndex].model);
+	mat3 model = mat3(TRANSFORMS[slot].model);
 	outTangent = vec4(normalize(model * inTangent.xyz), inTangent.w);
 
 	outViewPos = (scene.view * vec4(inPosition, 1.0)).xyz;
 
-	instanceID = gl_InstanceIndex;
+	instanceID = slot;
 }
\ No newline at end of file
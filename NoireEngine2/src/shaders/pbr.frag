@@ -177,39 +177,39 @@ vec3 DirectLightingPBR()
 {
 	vec3 lightsSum = vec3(0);
 
-    int shadowMapOffsetId = 0;
-
 	for (int i = 0; i < scene.numLights[0]; ++i)
 	{
         float radiance = DirLightRadiance(i);
 
 		if (radiance > 0 && DIR_LIGHTS[i].shadowOffset > 0)
-			radiance *= DirLightShadow(i, shadowMapOffsetId);
+			radiance *= DirLightShadow(i, DIR_LIGHTS[i].shadowBase);
 
-		shadowMapOffsetId += DIR_LIGHTS[i].shadowOffset;
 		lightsSum += CalcPBRDirectLighting(radiance * vec3(DIR_LIGHTS[i].color), -vec3(DIR_LIGHTS[i].direction));
 	}
 
-	for (int i = 0; i < scene.numLights[1]; ++i)
+	// point and spot lights only from the lists of this fragment's cluster
+	uvec3 cluster = FragmentCluster();
+
+	for (uint k = 0; k < cluster.y; ++k)
 	{
+		int i = int(LIGHT_INDICES[cluster.x + k]);
     	float radiance = PointLightRadiance(i);
 		
 		if (radiance > 0 && POINT_LIGHTS[i].shadowOffset > 0)
-			radiance *= PointLightShadow(i, shadowMapOffsetId);
+			radiance *= PointLightShadow(i, POINT_LIGHTS[i].shadowBase);
 		
-		shadowMapOffsetId += POINT_LIGHTS[i].shadowOffset;
 		vec3 Li = normalize(vec3(POINT_LIGHTS[i].position) - inPosition);
 		lightsSum += CalcPBRDirectLighting(radiance * vec3(POINT_LIGHTS[i].color), Li);
 	}
 
-	for (int i = 0; i < scene.numLights[2]; ++i)
+	for (uint k = 0; k < cluster.z; ++k)
 	{
+		int i = int(LIGHT_INDICES[cluster.x + cluster.y + k]);
     	float radiance = SpotLightRadiance(i);
 
 		if (radiance > 0 && SPOT_LIGHTS[i].shadowOffset > 0)
-			radiance *= SpotLightShadow(i, shadowMapOffsetId);
+			radiance *= SpotLightShadow(i, SPOT_LIGHTS[i].shadowBase);
 
-		shadowMapOffsetId += SPOT_LIGHTS[i].shadowOffset;
 		vec3 Li = normalize(vec3(SPOT_LIGHTS[i].position) - inPosition);
 		lightsSum += CalcPBRDirectLighting(radiance * vec3(SPOT_LIGHTS[i].color), Li);
 	}
@@ -0,0 +1,45 @@
+// shared by shadowmapping.vert and shadowmapping_omni.vert
+
+layout (location = 0) in vec3 inPos;
+
+layout( push_constant ) uniform constants
+{
+	int lightspaceID; // of the first face
+	int pancake; // orthographic lightspaces: clamp casters in front of the near plane onto it
+};
+
+layout(set=0, binding=0, std140) readonly buffer Lightspaces {
+	mat4 LIGHTSPACES[];
+};
+
+// face << 29 | instance slot of every caster drawn, indexed by gl_InstanceIndex.
+// a point light can draw all its faces at once, each face has its own lightspace and viewport
+layout(set=0, binding=1, std430) readonly buffer ShadowInstances {
+	uint SHADOW_INSTANCES[];
+};
+
+// transforms
+struct Transform
+{
+	mat4 model;
+	mat4 modelNormal;
+};
+
+layout(set=1, binding=0, std140) readonly buffer Transforms {
+	Transform TRANSFORMS[];
+};
+
+// writes gl_Position, returns the face the caster is drawn in
+uint ShadowCasterPosition()
+{
+	uint caster = SHADOW_INSTANCES[gl_InstanceIndex];
+	uint face = caster >> 29;
+
+	gl_Position = LIGHTSPACES[lightspaceID + face] * TRANSFORMS[caster & 0x1FFFFFFF].model * vec4(inPos, 1.0);
+
+	// w is 1, so this is exact
+	if (pancake != 0)
+		gl_Position.z = max(gl_Position.z, 0.0);
+
+	return face;
+}
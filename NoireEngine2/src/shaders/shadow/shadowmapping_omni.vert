@@ -0,0 +1,11 @@
+#version 450
+
+#extension GL_ARB_shader_viewport_layer_array : require
+
+#include "shadowmapping.glsl"
+
+// every face of a point light in one draw, each face is routed to the viewport over its tile
+void main()
+{
+	gl_ViewportIndex = int(ShadowCasterPosition());
+}
@@ -9,17 +9,20 @@ layout(location=0) out vec3 outPosition;
 
 struct Transform 
 {
-	mat4 localToClip;
 	mat4 model;
 	mat4 modelNormal;
 };
 
+layout(set=0, binding=0, std140) uniform Camera {
+	mat4 clipFromWorld;
+};
+
 layout(set=0, binding=1, std140) readonly buffer Transforms {
 	Transform TRANSFORMS[];
 };
 
 void main() {
-	gl_Position = TRANSFORMS[gl_InstanceIndex].localToClip * vec4(inPosition, 1.0);
-	
 	outPosition = mat4x3(TRANSFORMS[gl_InstanceIndex].model) * vec4(inPosition, 1.0);
+
+	gl_Position = clipFromWorld * vec4(outPosition, 1.0);
 }
\ No newline at end of file
@@ -2,19 +2,113 @@
 
 #include <stdexcept>
 #include <cassert>
-#include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstring>
 #include <charconv>
+#include <algorithm>
+#include <deque>
+#include <bit>
+
+#if defined(_WIN32)
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SEJP_SSE2
+#endif
 
 namespace sejp {
 
-struct parsed {
-	std::vector< std::optional< std::string > > strings;
+//read-only mapping of a whole file:
+struct mapped_file {
+	char const *data = nullptr;
+	size_t size = 0;
+
+	#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+	#endif
+
+	mapped_file() = default;
+	mapped_file(mapped_file const &) = delete;
+	mapped_file &operator=(mapped_file const &) = delete;
+
+	void open(std::string const &filename) {
+		#if defined(_WIN32)
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("parse error: could not open '" + filename + "'.");
+
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx(file, &file_size)) throw std::runtime_error("parse error: could not read size of '" + filename + "'.");
+		size = size_t(file_size.QuadPart);
+		if (size == 0) return;
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) throw std::runtime_error("parse error: could not map '" + filename + "'.");
+		data = static_cast< char const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!data) throw std::runtime_error("parse error: could not map '" + filename + "'.");
+		#else
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("parse error: could not open '" + filename + "'.");
+
+		struct stat st;
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			throw std::runtime_error("parse error: could not read size of '" + filename + "'.");
+		}
+		size = size_t(st.st_size);
+		if (size == 0) {
+			::close(fd);
+			return;
+		}
+
+		void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd); //(the mapping keeps the file referenced)
+		if (mapped == MAP_FAILED) throw std::runtime_error("parse error: could not map '" + filename + "'.");
+		madvise(mapped, size, MADV_SEQUENTIAL);
+		data = static_cast< char const * >(mapped);
+		#endif
+	}
+
+	~mapped_file() {
+		#if defined(_WIN32)
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		#else
+		if (data) munmap(const_cast< char * >(data), size);
+		#endif
+	}
+};
+
+struct parsed : std::enable_shared_from_this< parsed > {
+	//source text, either mapped from disk or copied from a string:
+	mapped_file file;
+	std::string text;
+	//strings that contained escapes, decoded (a deque so views stay valid as it grows):
+	std::deque< std::string > unescaped;
+
+	std::vector< std::optional< std::string_view > > strings;
 	std::vector< std::optional< double > > numbers;
 	//(nothing to store for booleans and nulls)
-	std::vector< std::optional< std::vector< value > > > arrays;
-	std::vector< std::optional< std::map< std::string, value > > > objects;
+	std::vector< std::optional< array > > arrays;
+	std::vector< std::optional< object > > objects;
+
+	//storage the array and object views point into:
+	std::vector< value > elements;
+	std::vector< member > members;
+	std::vector< float > floats;
 };
 
 enum Masks : uint32_t {
@@ -30,281 +124,529 @@ enum Types : uint32_t {
 	Null    = 0x80000000,
 	Object  = 0xa0000000,
 	Array   = 0xc0000000,
-	Empty   = 0xe0000000, //<--- used during parsing
+	Packed  = 0xe0000000, //array of numbers that only has floats (index is into arrays)
+};
+
+//------------------------------------------
+//stage 1: find structural characters
+
+//one bit per byte of a 64 byte block:
+struct block_masks {
+	uint64_t quote = 0;
+	uint64_t backslash = 0;
+	uint64_t op = 0; // {}[]:,
+	uint64_t whitespace = 0;
 };
 
-value parse(std::istream &from) {
-	//helpers to read from string:
+static block_masks classify(char const *block) {
+	block_masks masks;
+	#ifdef SEJP_SSE2
+	for (uint32_t i = 0; i < 4; ++i) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast< __m128i const * >(block + 16 * i));
+		//'[' and '{', ']' and '}' only differ by 0x20:
+		__m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+
+		__m128i quote = _mm_cmpeq_epi8(c, _mm_set1_epi8('"'));
+		__m128i backslash = _mm_cmpeq_epi8(c, _mm_set1_epi8('\\'));
+		__m128i op = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(':')), _mm_cmpeq_epi8(c, _mm_set1_epi8(',')))
+		);
+		__m128i whitespace = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\r')))
+		);
+
+		uint32_t shift = 16 * i;
+		masks.quote |= uint64_t(uint32_t(_mm_movemask_epi8(quote))) << shift;
+		masks.backslash |= uint64_t(uint32_t(_mm_movemask_epi8(backslash))) << shift;
+		masks.op |= uint64_t(uint32_t(_mm_movemask_epi8(op))) << shift;
+		masks.whitespace |= uint64_t(uint32_t(_mm_movemask_epi8(whitespace))) << shift;
+	}
+	#else
+	for (uint32_t i = 0; i < 64; ++i) {
+		char c = block[i];
+		uint64_t bit = uint64_t(1) << i;
+		if (c == '"') masks.quote |= bit;
+		else if (c == '\\') masks.backslash |= bit;
+		else if (c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',') masks.op |= bit;
+		else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') masks.whitespace |= bit;
+	}
+	#endif
+	return masks;
+}
+
+//bit i of the result is the xor of bits 0..i of x:
+static uint64_t prefix_xor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+//appends the positions of every {}[]:, outside of strings, of both quotes of every string,
+//and of the first character of every number/true/false/null:
+static void find_structurals(char const *text, size_t size, std::vector< uint32_t > &out) {
+	out.reserve(size / 6);
+
+	uint64_t prev_escaped = 0; //first character of this block is escaped
+	uint64_t prev_in_string = 0; //all ones if this block starts inside a string
+	uint64_t prev_separator = 1; //character before this block ends a scalar (start of text counts)
+
+	for (size_t offset = 0; offset < size; offset += 64) {
+		char const *block = text + offset;
+		char padded[64];
+		if (size - offset < 64) {
+			//last block: pad with whitespace so nothing is read past the end of the mapping
+			std::memset(padded, ' ', 64);
+			std::memcpy(padded, block, size - offset);
+			block = padded;
+		}
+
+		block_masks masks = classify(block);
 
-	auto skip_wsp = [&from]() {
-		for(;;) {
-			std::istream::int_type c = from.peek();
-			if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
-				from.get();
+		//a backslash escapes the next character, so in a run of them every other one is escaped:
+		uint64_t escaped = 0;
+		uint64_t backslash = masks.backslash;
+		if (prev_escaped) {
+			escaped = 1;
+			backslash &= ~uint64_t(1);
+		}
+		prev_escaped = 0;
+		while (backslash) {
+			uint32_t i = std::countr_zero(backslash);
+			if (i == 63) {
+				prev_escaped = 1;
 			} else {
-				break;
+				escaped |= uint64_t(2) << i;
+				backslash &= ~(uint64_t(2) << i);
 			}
+			backslash &= backslash - 1;
+		}
+
+		uint64_t quote = masks.quote & ~escaped;
+		//opening quotes and string contents (but not closing quotes):
+		uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+		prev_in_string = uint64_t(int64_t(in_string) >> 63);
+
+		//scalars start right after whitespace, an operator or a quote:
+		uint64_t separator = masks.whitespace | masks.op | masks.quote;
+		uint64_t follows_separator = (separator << 1) | prev_separator;
+		prev_separator = separator >> 63;
+		uint64_t scalar_start = ~separator & ~in_string & follows_separator;
+
+		uint64_t structural = (masks.op & ~in_string) | quote | scalar_start;
+		while (structural) {
+			out.emplace_back(uint32_t(offset + std::countr_zero(structural)));
+			structural &= structural - 1;
 		}
+	}
+}
+
+//------------------------------------------
+//stage 2: walk the structural characters and build values
+
+static std::string unescape(std::string_view str) {
+	std::string ret;
+	ret.reserve(str.size());
+	for (size_t i = 0; i < str.size(); ++i) {
+		char c = str[i];
+		if (c != '\\') {
+			//plain old boring character:
+			ret += c;
+			continue;
+		}
+		//handle escapes:
+		if (++i >= str.size()) throw std::runtime_error("parse error: unexpected end of string in escape.");
+		c = str[i];
+		if      (c == '\\' || c == '/' || c == '"') ret += c;
+		else if (c == 'b') ret += '\b';
+		else if (c == 'f') ret += '\f';
+		else if (c == 'n') ret += '\n';
+		else if (c == 'r') ret += '\r';
+		else if (c == 't') ret += '\t';
+		else if (c == 'u') {
+			uint32_t value = 0;
+			for (uint32_t j = 0; j < 4; ++j) {
+				value <<= 4;
+				if (++i >= str.size()) throw std::runtime_error("parse error: unexpected end of string in \\uNNNN escape.");
+				c = str[i];
+				if      ('0' <= c && c <= '9') value += (c - '0');
+				else if ('a' <= c && c <= 'f') value += (c - 'a') + 10;
+				else if ('A' <= c && c <= 'F') value += (c - 'A') + 10;
+				else throw std::runtime_error(std::string("parse error: invalid character '") + c + "' in \\uNNNN escape.");
+			}
+			assert(value <= 0xffff);
+			//TODO: handle surrogate pairs!
+			// (might result in value > 0xffff)
+
+			//re-encode as UTF8:
+			if (value <= 0x007f) {
+				ret += char(value);
+			} else if (value <= 0x07ff) {
+				ret += char(0xc0 | (value >> 6));
+				ret += char(0x80 | (value & 0x3f));
+			} else if (value <= 0xffff) {
+				ret += char(0xe0 | (value >> 12));
+				ret += char(0x80 | ((value >> 6) & 0x3f));
+				ret += char(0x80 | (value & 0x3f));
+			} else { assert(value <= 0x10ffff);
+				ret += char(0xf0 | (value >> 18));
+				ret += char(0x80 | ((value >> 12) & 0x3f));
+				ret += char(0x80 | ((value >> 6) & 0x3f));
+				ret += char(0x80 | (value & 0x3f));
+			}
+		} else {
+			throw std::runtime_error(std::string("parse error: invalid escape '\\") + c + "'.");
+		}
+	}
+	return ret;
+}
+
+//sorts members by key, keeping only the last of duplicate keys (same as the old map's insert_or_assign):
+static member *sort_members(member *begin, member *end) {
+	auto less = [](member const &a, member const &b) { return a.first < b.first; };
+	if (end - begin <= 16) {
+		//(objects are almost always small, insertion sort is stable and does not allocate)
+		for (member *i = begin + 1; i < end; ++i) {
+			member m = std::move(*i);
+			member *j = i;
+			for (; j > begin && less(m, *(j - 1)); --j) *j = std::move(*(j - 1));
+			*j = std::move(m);
+		}
+	} else {
+		std::stable_sort(begin, end, less);
+	}
+
+	member *out = begin;
+	for (member *i = begin; i < end; ++i) {
+		if (i + 1 < end && i[1].first == i->first) continue;
+		if (out != i) *out = std::move(*i);
+		++out;
+	}
+	return out;
+}
+
+static value parse(std::shared_ptr< parsed > const &data, char const *text, size_t size) {
+	if (size > 0xffffffffu) throw std::runtime_error("parse error: files over 4GB are not supported.");
+
+	std::vector< uint32_t > structurals;
+	find_structurals(text, size, structurals);
+
+	//values stored inside the parsed data borrow it, owning it would be a reference cycle:
+	auto borrow = [&](uint32_t index) {
+		return value(handle::borrow(data.get()), index);
+	};
+
+	//-------------------
+	//helpers to read from structurals:
+
+	size_t next = 0;
+
+	auto read_char = [&]() -> char {
+		if (next >= structurals.size()) throw std::runtime_error("parse error: unexpected EOF.");
+		return text[structurals[next++]];
 	};
 
-	auto read_char = [&from]() -> char {
-		char c;
-		if (!from.get(c)) throw std::runtime_error("parse error: unexpected EOF.");
-		return c;
+	//end of the scalar starting at the last read structural:
+	auto scalar_end = [&]() -> size_t {
+		return next < structurals.size() ? structurals[next] : size;
 	};
-	
-	auto read_exactly = [&read_char](std::string const &expect) {
-		for (auto e : expect) {
-			char c = read_char();
-			if (c != e) throw std::runtime_error(std::string("parse error: expected '") + e + "', got '" + c + "'.");
+
+	//anything left between a scalar and the next structural must be whitespace:
+	auto expect_whitespace = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			char c = text[i];
+			if (!(c == ' ' || c == '\t' || c == '\n' || c == '\r')) throw std::runtime_error(std::string("parse error: unexpected '") + c + "'.");
 		}
 	};
 
-	auto read_number = [&from,&read_char](char first) -> double {
-		std::string acc;
-		acc += first;
-	
-		if (first == '-') {
-			//advance to first digit:
-			first = read_char();
-			acc += first;
+	auto read_exactly = [&](std::string_view expect) {
+		size_t begin = structurals[next - 1];
+		size_t end = scalar_end();
+		if (end - begin < expect.size() || std::string_view(text + begin, expect.size()) != expect) {
+			throw std::runtime_error("parse error: expected '" + std::string(expect) + "'.");
 		}
+		expect_whitespace(begin + expect.size(), end);
+	};
 
-		auto digits = [&acc,&from]() {
-			for(;;) {
-				std::istream::int_type p = from.peek();
-				if ('0' <= p && p <= '9') {
-					acc += char(p);
-					from.get();
-				} else {
-					break;
-				}
-			}
+	auto read_number = [&]() -> double {
+		size_t begin = structurals[next - 1];
+		size_t end = scalar_end();
+
+		//check the JSON number grammar, from_chars alone is more permissive:
+		size_t i = begin;
+		auto digits = [&]() {
+			size_t start = i;
+			while (i < end && '0' <= text[i] && text[i] <= '9') ++i;
+			return i - start;
 		};
 
-		if (first == '0') {
-			//proceed to fraction
-		} else if ('1' <= first && first <= '9') {
-			//might be more digits
-			digits();
-		} else {
-			throw std::runtime_error(std::string("parse error: unexpected '") + first + "' in number.");
+		if (text[i] == '-') ++i;
+		if (i < end && text[i] == '0') {
+			++i; //proceed to fraction
+		} else if (digits() == 0) {
+			throw std::runtime_error(std::string("parse error: unexpected '") + (i < end ? text[i] : ' ') + "' in number.");
 		}
 
 		//fraction:
-		if (from.peek() == '.') {
-			acc += read_char();
-			char c = read_char();
-			if (!('0' <= c && c <= '9')) throw std::runtime_error(std::string("parse error: wanted fraction digits, got '") + c + "'.");
-			acc += c;
-			digits();
+		if (i < end && text[i] == '.') {
+			++i;
+			if (digits() == 0) throw std::runtime_error("parse error: wanted fraction digits.");
 		}
 
 		//exponent:
-		if (from.peek() == 'E' || from.peek() == 'e') {
-			acc += read_char();
-			if (from.peek() == '-' || from.peek() == '+') {
-				acc += read_char();
-			}
-			char c = read_char();
-			if (!('0' <= c && c <= '9')) throw std::runtime_error(std::string("parse error: wanted exponent digits, got '") + c + "'.");
-			acc += c;
-			digits();
+		if (i < end && (text[i] == 'e' || text[i] == 'E')) {
+			++i;
+			if (i < end && (text[i] == '-' || text[i] == '+')) ++i;
+			if (digits() == 0) throw std::runtime_error("parse error: wanted exponent digits.");
 		}
 
+		expect_whitespace(i, end);
+
 		double val;
 		#ifdef __APPLE__
 		//(until clang gets its charconv right)
-		val = std::stod(acc);
+		val = std::stod(std::string(text + begin, text + i));
 		#else
-		const char *begin = acc.data();
-		std::from_chars(begin, begin + acc.size(), val);
+		std::from_chars(text + begin, text + i, val);
 		#endif
 		return val;
 	};
 
-	auto read_string = [&read_char]() -> std::string {
-		std::string ret;
-		for (char c = read_char(); c != '"'; c = read_char()) {
-			if (c == '\\') {
-				//handle escapes:
-				c = read_char();
-				if      (c == '\\' || c == '/' || c == '"') ret += c;
-				else if (c == 'b') ret += '\b';
-				else if (c == 'f') ret += '\f';
-				else if (c == 'n') ret += '\n';
-				else if (c == 'r') ret += '\r';
-				else if (c == 't') ret += '\t';
-				else if (c == 'u') {
-					uint32_t value = 0;
-					for (uint32_t i = 0; i < 4; ++i) {
-						value <<= 4;
-						c = read_char();
-						if      ('0' <= c && c <= '9') value += (c - '0');
-						else if ('a' <= c && c <= 'f') value += (c - 'a') + 10;
-						else if ('A' <= c && c <= 'F') value += (c - 'A') + 10;
-						else throw std::runtime_error(std::string("parse error: invalid character '") + c + "' in \\uNNNN escape.");
-					}
-					assert(value <= 0xffff);
-					//TODO: handle surrogate pairs!
-					// (might result in value > 0xffff)
-
-					//re-encode as UTF8:
-					if (value <= 0x007f) {
-						ret += char(value);
-					} else if (value <= 0x07ff) {
-						ret += char(0xc0 | (value >> 6));
-						ret += char(0x80 | (value & 0x3f));
-					} else if (value <= 0xffff) {
-						ret += char(0xe0 | (value >> 12));
-						ret += char(0x80 | ((value >> 6) & 0x3f));
-						ret += char(0x80 | (value & 0x3f));
-					} else { assert(value <= 0x10ffff);
-						ret += char(0xf0 | (value >> 18));
-						ret += char(0x80 | ((value >> 12) & 0x3f));
-						ret += char(0x80 | ((value >> 6) & 0x3f));
-						ret += char(0x80 | (value & 0x3f));
-					}
-				} else {
-					throw std::runtime_error(std::string("parse error: invalid escape '\\") + c + "'.");
-				}
-			} else {
-				//plain old boring character:
-				ret += c;
-			}
-		}
-		return ret;
+	auto read_string = [&]() -> std::string_view {
+		size_t begin = structurals[next - 1] + 1;
+		//the next structural is always the closing quote, nothing inside a string is structural:
+		if (read_char() != '"') throw std::runtime_error("parse error: unterminated string.");
+		size_t end = structurals[next - 1];
+
+		std::string_view str(text + begin, end - begin);
+		if (str.find('\\') == std::string_view::npos) return str;
+
+		data->unescaped.emplace_back(unescape(str));
+		return data->unescaped.back();
 	};
 
+	//reads the value starting at the last read structural.
+	//containers are only created here, their contents are filled in by the loop below:
+	auto read_value = [&](char c) -> uint32_t {
+		if        (c == '{') { //object
+			if (uint32_t(data->objects.size()) & ~IndexBits) throw std::runtime_error("parser error: too many objects.");
+			data->objects.emplace_back();
+			return Object | uint32_t(data->objects.size() - 1);
+		} else if (c == '[') { //array
+			if (uint32_t(data->arrays.size()) & ~IndexBits) throw std::runtime_error("parser error: too many arrays.");
+			data->arrays.emplace_back();
+			return Array | uint32_t(data->arrays.size() - 1);
+		} else if (c == '"') { //string
+			if (uint32_t(data->strings.size()) & ~IndexBits) throw std::runtime_error("parser error: too many strings.");
+			data->strings.emplace_back(read_string());
+			return String | uint32_t(data->strings.size() - 1);
+		} else if (c == '-' || (c >= '0' && c <= '9')) { //number
+			if (uint32_t(data->numbers.size()) & ~IndexBits) throw std::runtime_error("parser error: too many numbers.");
+			data->numbers.emplace_back(read_number());
+			return Number | uint32_t(data->numbers.size() - 1);
+		} else if (c == 't') { //true
+			read_exactly("true");
+			return True;
+		} else if (c == 'f') { //false
+			read_exactly("false");
+			return False;
+		} else if (c == 'n') { //null
+			read_exactly("null");
+			return Null;
+		} else {
+			throw std::runtime_error(std::string("parse error: value cannot start with '") + c + "'.");
+		}
+	};
 
 	//-------------------
 	//parsing:
 
-	std::shared_ptr< sejp::parsed > parsed = std::make_shared< sejp::parsed >();
+	//contents of open containers are collected on these stacks, and moved to
+	//data->elements/members (contiguously) when the container closes:
+	std::vector< value > element_stack;
+	std::vector< member > member_stack;
 
-	value root = value(parsed, -1U);
-	std::vector< uint32_t > parents; //containing maps/arrays
+	struct container {
+		uint32_t index;
+		uint32_t stack_begin;
+	};
+	std::vector< container > parents;
+
+	//[begin, end) of every array/object in data->elements/members (and data->floats), turned into views at the end:
+	struct array_range {
+		uint32_t begin = 0, end = 0;
+		uint32_t float_begin = 0, float_end = 0;
+		bool numeric = false;
+	};
+	std::vector< array_range > array_ranges;
+	std::vector< std::pair< uint32_t, uint32_t > > object_ranges;
+
+	auto open = [&](uint32_t index) {
+		if ((index & TypeBits) == Object) {
+			parents.push_back({ index, uint32_t(member_stack.size()) });
+			object_ranges.emplace_back();
+		} else if ((index & TypeBits) == Array) {
+			parents.push_back({ index, uint32_t(element_stack.size()) });
+			array_ranges.emplace_back();
+		}
+	};
+
+	uint32_t root = 0;
+	bool have_root = false;
 
 	//overall parsing idea:
-	//value: (target is empty)
-	// whitespace
-	//  set up next entry if target is object or array:
-	//    (only if) target is object:
-	//         '}' -> finish target, continue
-	//         expect ',' if non-empty
-	//         '"' -> expect key, ':', push empty, fall through
-	//    (only if) target is array:
-	//         ']' -> finish target, continue
-	//         expect ',' if non-empty
-	//         push empty, fall through
-	//  now target is empty, fill with value:
-	//  '{' -> key_or_object_end [new object, set target to object, continue]
-	//  '[' -> value_or_array_end [new array, set target to array, continue]
-	//   '"' -> string
-	//   '-', '0'-'9' -> number
-	//   't' -> bool ("true")
-	//   'f' -> bool ("false")
-	//   'n' -> null ("null")
-	//   finish target
-
-	while (root.index == -1U || !parents.empty()) {
-		skip_wsp();
+	//  if the innermost open container is an object:
+	//      '}' -> close it, continue
+	//      expect ',' if non-empty
+	//      expect key, ':', value
+	//  if it is an array:
+	//      ']' -> close it, continue
+	//      expect ',' if non-empty
+	//      expect value
+	//  otherwise the value is the root
+	//  if the value was an object/array, it becomes the innermost open container
+	//  arrays of numbers are packed into floats when they close
+
+	while (!have_root || !parents.empty()) {
 		char c = read_char(); //first character of value
 
-		//value to be filled in later:
-		value *target = nullptr;
-
-		//figure out which value to fill in:
 		if (parents.empty()) {
-			target = &root;
-		} else if ((parents.back() & TypeBits) == Object) {
+			root = read_value(c);
+			have_root = true;
+			open(root);
+			continue;
+		}
+
+		container top = parents.back();
+		if ((top.index & TypeBits) == Object) {
 			if (c == '}') {
 				parents.pop_back();
+				member *begin = member_stack.data() + top.stack_begin;
+				member *end = sort_members(begin, member_stack.data() + member_stack.size());
+				object_ranges[top.index & IndexBits] = { uint32_t(data->members.size()), uint32_t(data->members.size() + (end - begin)) };
+				data->members.insert(data->members.end(), std::make_move_iterator(begin), std::make_move_iterator(end));
+				member_stack.resize(top.stack_begin);
 				continue;
 			}
-			std::map< std::string, value > &map = parsed->objects.at( parents.back() & IndexBits ).value();
-			if (!map.empty()) {
+			if (member_stack.size() != top.stack_begin) {
 				//consume comma between entries:
 				if (c != ',') throw std::runtime_error("parse error: expected ',' between object members.");
-				skip_wsp();
 				c = read_char();
 			}
 			if (c != '"') throw std::runtime_error("parse error: expecting '\"' at start of key.");
-			std::string key = read_string();
-			skip_wsp();
-			c = read_char();
-			if (c != ':') throw std::runtime_error("parse error: expecting ':' after value.");
-			skip_wsp();
-			c = read_char(); //actual first character of value
-			auto ret = map.insert_or_assign(key, value(parsed, -1U));
-			target = &ret.first->second;
-			//(fall through to value-getting code)
-		} else if ((parents.back() & TypeBits) == Array) {
+			std::string_view key = read_string();
+			if (read_char() != ':') throw std::runtime_error("parse error: expecting ':' after value.");
+			uint32_t index = read_value(read_char());
+			member_stack.emplace_back(key, borrow(index));
+			open(index);
+		} else {
 			if (c == ']') {
 				parents.pop_back();
+				auto begin = element_stack.begin() + top.stack_begin;
+				auto end = element_stack.end();
+				uint32_t count = uint32_t(end - begin);
+
+				array_range &range = array_ranges[top.index & IndexBits];
+				range.numeric = std::all_of(begin, end, [](value const &v) { return (v.index & TypeBits) == Number; });
+				if (range.numeric) {
+					range.float_begin = uint32_t(data->floats.size());
+					for (auto it = begin; it != end; ++it) {
+						data->floats.emplace_back(float(*data->numbers[it->index & IndexBits]));
+					}
+					range.float_end = uint32_t(data->floats.size());
+				}
+
+				if (range.numeric && count >= PACKED_ARRAY_MIN) {
+					//its numbers were the last ones read and nothing else refers to them:
+					data->numbers.resize(data->numbers.size() - count);
+					element_stack.resize(top.stack_begin);
+
+					//retag whatever refers to this array:
+					uint32_t packed = Packed | (top.index & IndexBits);
+					if (parents.empty()) root = packed;
+					else if ((parents.back().index & TypeBits) == Object) member_stack.back().second.index = packed;
+					else element_stack.back().index = packed;
+					continue;
+				}
+
+				range.begin = uint32_t(data->elements.size());
+				range.end = range.begin + count;
+				data->elements.insert(data->elements.end(), std::make_move_iterator(begin), std::make_move_iterator(end));
+				element_stack.resize(top.stack_begin);
 				continue;
 			}
-			std::vector< value > &array = parsed->arrays.at( parents.back() & IndexBits ).value();
-			if (!array.empty()) {
+			if (element_stack.size() != top.stack_begin) {
 				if (c != ',') throw std::runtime_error(std::string("parse error: expected ',' between array entries; got '") + c + "'.");
-				skip_wsp();
 				c = read_char(); //actual first character of value
 			}
-			array.emplace_back(parsed, -1U);
-			target = &array.back();
-			//(fall through to value-getting code)
+			uint32_t index = read_value(c);
+			element_stack.emplace_back(borrow(index));
+			open(index);
 		}
+	}
 
-		//actually fill in the value:
-		assert(target && (target->index & TypeBits) == Empty);
+	if (next != structurals.size()) throw std::runtime_error("parse error: trailing junk.");
 
-		if        (c == '{') { //object
-			if (uint32_t(parsed->objects.size()) & ~IndexBits) std::runtime_error("parser error: too many objects.");
-			target->index = Object | uint32_t(parsed->objects.size());
-			parents.emplace_back(target->index);
-			parsed->objects.emplace_back(std::in_place);
-			continue;
-		} else if (c == '[') { //array
-			if (uint32_t(parsed->arrays.size()) & ~IndexBits) std::runtime_error("parser error: too many arrays.");
-			target->index = Array | uint32_t(parsed->arrays.size());
-			parents.emplace_back(target->index);
-			parsed->arrays.emplace_back(std::in_place);
-			continue;
-		} else if (c == '"') { //string
-			if (uint32_t(parsed->strings.size()) & ~IndexBits) std::runtime_error("parser error: too many strings.");
-			target->index = String | uint32_t(parsed->strings.size());
-			parsed->strings.emplace_back(read_string());
-		} else if (c == '-' || (c >= '0' && c <= '9')) { //number
-			if (uint32_t(parsed->numbers.size()) & ~IndexBits) std::runtime_error("parser error: too many numbers.");
-			target->index = Number | uint32_t(parsed->numbers.size());
-			parsed->numbers.emplace_back(read_number(c));
-		} else if (c == 't') { //true
-			read_exactly("rue");
-			target->index = True;
-		} else if (c == 'f') { //false
-			read_exactly("alse");
-			target->index = False;
-		} else if (c == 'n') { //null
-			read_exactly("ull");
-			target->index = Null;
-		} else {
-			throw std::runtime_error(std::string("parse error: value cannot start with '") + c + "'.");
-		}
-	}
+	//(packed arrays left a lot of unused capacity behind)
+	data->numbers.shrink_to_fit();
+
+	//storage is final now, point the views into it:
+	for (size_t i = 0; i < array_ranges.size(); ++i) {
+		array_range const &range = array_ranges[i];
+		value const *elements = data->elements.data();
+		float const *floats = data->floats.data();
 
-	skip_wsp();
+		array &view = data->arrays[i].emplace(array{ elements + range.begin, elements + range.end, std::nullopt, handle::borrow(data.get()) });
+		if (range.numeric) view.numbers.emplace(floats + range.float_begin, floats + range.float_end);
+	}
+	for (size_t i = 0; i < object_ranges.size(); ++i) {
+		member const *members = data->members.data();
+		data->objects[i].emplace(object{ members + object_ranges[i].first, members + object_ranges[i].second, handle::borrow(data.get()) });
+	}
 
-	if (from.peek() != std::iostream::traits_type::eof()) throw std::runtime_error("parse error: trailing junk.");
+	//(a copy that took ownership while parsing would keep the data alive forever)
+	assert(data.use_count() == 1 && "sejp: values stored in the parsed data must not own it");
 
-	return root;
+	return value(handle(data), root);
 }
 
 //------------------------------------------
 
+handle handle::borrow(parsed const *doc_) {
+	handle ret;
+	ret.doc = doc_;
+	return ret;
+}
+
+//copies of borrowed handles can only be made while the data is alive (they are reached through it):
+handle::handle(handle const &other) : owner(other.owner), doc(other.doc) {
+	if (!owner && doc) owner = doc->shared_from_this();
+}
+
+handle &handle::operator=(handle const &other) {
+	if (this != &other) *this = handle(other);
+	return *this;
+}
+
+member const *object::find(std::string_view key) const {
+	member const *it = std::lower_bound(first, last, key, [](member const &m, std::string_view k) { return m.first < k; });
+	return (it != last && it->first == key) ? it : last;
+}
 
-static std::optional< std::string > const emptyStr;
+value const &object::at(std::string_view key) const {
+	member const *it = find(key);
+	if (it == last) throw std::out_of_range("object has no member '" + std::string(key) + "'.");
+	return it->second;
+}
+
+static std::optional< std::string_view > const emptyStr;
 
-std::optional< std::string > const &value::as_string() const {
+std::optional< std::string_view > const &value::as_string() const {
 	if ((index & TypeBits) == String) {
 		return data->strings[index & IndexBits];
 	} else {
@@ -344,17 +686,20 @@ std::optional< nullptr_t > const &value::as_null() const {
 	}
 }
 
-std::optional< std::vector< value > > const &value::as_array() const {
-	static std::optional< std::vector< value > > const empty;
+std::optional< array > const &value::as_array() const {
+	static std::optional< array > const empty;
 	if ((index & TypeBits) == Array) {
 		return data->arrays[index & IndexBits];
+	} else if ((index & TypeBits) == Packed) {
+		//packed arrays keep no per-element values to view:
+		throw std::runtime_error("sejp: array of " + std::to_string(data->arrays[index & IndexBits]->numbers->size()) + " numbers is packed, read it with as_float_span().");
 	} else {
 		return empty;
 	}
 }
 
-std::optional< std::map< std::string, value > > const &value::as_object() const {
-	static std::optional< std::map< std::string, value > > const empty;
+std::optional< object > const &value::as_object() const {
+	static std::optional< object > const empty;
 	if ((index & TypeBits) == Object) {
 		return data->objects[index & IndexBits];
 	} else {
@@ -362,10 +707,18 @@ std::optional< std::map< std::string, value > > const &value::as_object() const
 	}
 }
 
+std::optional< std::span< float const > > value::as_float_span() const {
+	if ((index & TypeBits) == Array || (index & TypeBits) == Packed) {
+		return data->arrays[index & IndexBits]->numbers;
+	} else {
+		return std::nullopt;
+	}
+}
+
 const glm::vec4 value::as_vec4() const
 {
 	const auto& arr = as_array().value();
-	if (arr.size() != 4) throw std::runtime_error("Array size is not compatible with vec4. Found size: " + arr.size());
+	if (arr.size() != 4) throw std::runtime_error("Array size is not compatible with vec4. Found size: " + std::to_string(arr.size()));
 	glm::vec4 ret;
 	for (int i = 0; i < 4; i++)
 		ret[i] = arr[i].as_float();
@@ -375,7 +728,7 @@ const glm::vec4 value::as_vec4() const
 const glm::vec3 value::as_vec3() const
 {
 	const auto& arr = as_array().value();
-	if (arr.size() != 3) throw std::runtime_error("Array size is not compatible with vec3. Found size: " + arr.size());
+	if (arr.size() != 3) throw std::runtime_error("Array size is not compatible with vec3. Found size: " + std::to_string(arr.size()));
 	glm::vec3 ret;
 	for (int i = 0; i < 3; i++)
 		ret[i] = arr[i].as_float();
@@ -392,25 +745,28 @@ float value::as_float() const
 	return (float)as_number().value();
 }
 
-const std::optional<std::string>& value::as_texPath() const
+const std::optional<std::string_view>& value::as_texPath() const
 {
-	if (auto& opt = as_object())
-		if (opt.value().find("src") != opt.value().end()) {
-			return opt.value().at("src").as_string();
-		}
+	if (auto& opt = as_object()) {
+		auto it = opt.value().find("src");
+		if (it != opt.value().end())
+			return it->second.as_string();
+	}
 	return emptyStr;
 }
 
 //-------------------------------
 
 value load(std::string const &filename) {
-	std::ifstream in(filename, std::ios::binary);
-	return parse(in);
+	std::shared_ptr< parsed > data = std::make_shared< parsed >();
+	data->file.open(filename);
+	return parse(data, data->file.data, data->file.size);
 }
 
 value parse(std::string const &string) {
-	std::istringstream in(string, std::ios::binary);
-	return parse(in);
+	std::shared_ptr< parsed > data = std::make_shared< parsed >();
+	data->text = string;
+	return parse(data, data->text.data(), data->text.size());
 }
 
 } //namespace sejp
@@ -3,49 +3,124 @@
 //A "Somewhat Eager JSON Parser" that parses and converts files
 //upon loading into some lists of numbers, objects, bools, nulls;
 //then provides a generic "value" handle to the root.
+//
+//Files are memory-mapped and scanned for structural characters 64 bytes at a time.
+//Strings are views into the mapping (only strings containing escapes are copied),
+//arrays are contiguous runs of values and objects are flat arrays of members sorted by key.
+//Arrays of numbers are also packed into floats; long ones are only stored packed.
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <optional>
 #include <memory>
+#include <utility>
+#include <span>
 
 #include "renderer/scene/Transform.hpp"
 
 namespace sejp {
 	//sejp::parsed represents the results of scanning a JSON file:
 	struct parsed;
-	
+	struct array;
+	struct object;
+
+	//what values (and array/object views) hold on to the parsed data by:
+	//  copies stored inside the parsed data only point at it (owning it would be a reference cycle),
+	//  copying one out of the data takes shared ownership again, so copies can never outlive the data
+	struct handle {
+		handle() = default;
+		handle(std::shared_ptr< parsed const > owner_) : owner(std::move(owner_)), doc(owner.get()) { }
+		static handle borrow(parsed const *doc_);
+
+		handle(handle const &other);
+		handle &operator=(handle const &other);
+		handle(handle &&) noexcept = default;
+		handle &operator=(handle &&) noexcept = default;
+
+		parsed const *operator->() const { return doc; }
+		parsed const *get() const { return doc; }
+		//false for the copies stored inside the parsed data:
+		bool owning() const { return owner != nullptr; }
+
+	private:
+		std::shared_ptr< parsed const > owner;
+		parsed const *doc = nullptr;
+	};
+
 	//generic value:
 	struct value {
 
 		value() = default;
 
 		//internals:
-		std::shared_ptr< parsed const > data;
+		handle data;
 		uint32_t index; //(opaque) index data's value storage
-		value(std::shared_ptr< parsed const > const &data_, uint32_t index_) : data(data_), index(index_) { }
+		value(handle data_, uint32_t index_) : data(std::move(data_)), index(index_) { }
 
 		//interface:
 		//  NOTE: these functions take O(1) time
-		std::optional< std::string > const &as_string() const;
+		//  NOTE: strings are views into the loaded data
+		std::optional< std::string_view > const &as_string() const;
 		std::optional< double > const &as_number() const;
 		std::optional< bool > const &as_bool() const;
 		std::optional< nullptr_t > const &as_null() const;
-		std::optional< std::vector< value > > const &as_array() const;
-		std::optional< std::map< std::string, value > > const &as_object() const;
-		
+		std::optional< array > const &as_array() const;
+		std::optional< object > const &as_object() const;
+
+		//elements of an array of numbers, as floats.
+		//  NOTE: arrays of PACKED_ARRAY_MIN or more numbers are only stored this way, as_array() throws for them
+		std::optional< std::span< float const > > as_float_span() const;
+
 		// NOTE: the following unsafe functions will throw error on exception...
 		const glm::vec4 as_vec4() const;
 		const glm::vec3 as_vec3() const;
 		uint32_t as_uint32t() const;
 		float as_float() const;
-		const std::optional<std::string>& as_texPath() const;
+		const std::optional<std::string_view>& as_texPath() const;
+	};
+
+	using member = std::pair< std::string_view, value >;
+
+	//arrays of at least this many numbers keep no per-element values:
+	constexpr uint32_t PACKED_ARRAY_MIN = 16;
+
+	//elements of an array, stored contiguously:
+	struct array {
+		value const *first = nullptr;
+		value const *last = nullptr;
+		//set if every element is a number:
+		std::optional< std::span< float const > > numbers;
+		handle data; //keeps first/last valid
+
+		value const *begin() const { return first; }
+		value const *end() const { return last; }
+		size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+		value const &operator[](size_t i) const { return first[i]; }
+	};
+
+	//members of an object, sorted by key (lookups are a binary search):
+	struct object {
+		member const *first = nullptr;
+		member const *last = nullptr;
+		handle data; //keeps first/last valid
+
+		member const *begin() const { return first; }
+		member const *end() const { return last; }
+		size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+
+		//returns end() if there is no such key
+		member const *find(std::string_view key) const;
+		//  NOTE: throws std::out_of_range if there is no such key
+		value const &at(std::string_view key) const;
 	};
 
 	//how you make values:
 	//  NOTE: O(length of data) time, space.
-	//  NOTE: loaded data is retained via shared_ptr until values referring to it go out of scope
+	//  NOTE: loaded data is retained via shared_ptr until the value returned here, and every value,
+	//        array and object copied out of it, go out of scope
 	//  NOTE: throws on parse error
 	value load(std::string const &filename);
 	value parse(std::string const &string);